@@ -276,27 +276,36 @@ static int virtio_netdev_recv_done(struct virtqueue *vq, void *priv)
 	return 1;
 }
 
+#define TX_FREE_BATCHLEN 64
+
 static void virtio_netdev_xmit_free(struct uk_netdev_tx_queue *txq)
 {
-	struct uk_netbuf *pkt = NULL;
+	struct uk_netbuf *pkt[TX_FREE_BATCHLEN];
+	unsigned int nb_pkts = 0;
 	int cnt = 0;
 	int rc;
 
 	for (;;) {
-		rc = virtqueue_buffer_dequeue(txq->vq, (void **) &pkt, NULL);
+		rc = virtqueue_buffer_dequeue(txq->vq, (void **) &pkt[nb_pkts],
+					      NULL);
 		if (rc < 0)
 			break;
 
-		UK_ASSERT(pkt);
+		UK_ASSERT(pkt[nb_pkts]);
+		cnt++;
 
 		/**
-		 * Releasing the free buffer back to netbuf. The netbuf could
-		 * use the destructor to inform the stack regarding the free up
-		 * of memory.
+		 * Releasing the free buffers back to netbuf in batches. The
+		 * netbuf could use the destructor to inform the stack
+		 * regarding the free up of memory.
 		 */
-		uk_netbuf_free(pkt);
-		cnt++;
+		if (++nb_pkts == TX_FREE_BATCHLEN) {
+			uk_netbuf_free_batch(pkt, nb_pkts);
+			nb_pkts = 0;
+		}
 	}
+	if (nb_pkts > 0)
+		uk_netbuf_free_batch(pkt, nb_pkts);
 	uk_pr_debug("Free %"__PRIu16" descriptors\n", cnt);
 }
 
@@ -309,7 +318,7 @@ static int virtio_netdev_rx_fillup(struct virtio_net_device *vndev,
 	struct uk_netbuf *netbuf[RX_FILLUP_BATCHLEN];
 	int rc = 0;
 	int status = 0x0;
-	__u16 i, j;
+	__u16 i;
 	__u16 req;
 	__u16 cnt = 0;
 	__u16 filled = 0;
@@ -338,8 +347,7 @@ static int virtio_netdev_rx_fillup(struct virtio_net_device *vndev,
 				 * Release netbufs that we are not going
 				 * to use anymore
 				 */
-				for (j = i; j < cnt; j++)
-					uk_netbuf_free(netbuf[j]);
+				uk_netbuf_free_batch(&netbuf[i], cnt - i);
 				status |= UK_NETDEV_STATUS_UNDERRUN;
 				goto out;
 			}
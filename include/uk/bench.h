@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Internal helpers of the benchmark libraries (ukallocbench, ukschedbench):
+ * a reproducible random sequence and a latency recorder that keeps a
+ * uniform reservoir sample of all operations for percentiles.
+ */
+
+#ifndef __UK_BENCH_H__
+#define __UK_BENCH_H__
+
+#include <stddef.h>
+#include <string.h>
+#include <uk/arch/types.h>
+#include <uk/essentials.h>
+#include <uk/plat/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UK_BENCH_NR_SAMPLES	8192	/* latency reservoir */
+
+struct uk_bench_lat {
+	__u64 sample_rnd;	/* reservoir sampling */
+	unsigned int ops;
+	__nsec total;
+	__nsec max;		/* of all operations, not only the samples */
+	unsigned int nr_samples;
+	__nsec samples[UK_BENCH_NR_SAMPLES];
+};
+
+/* xorshift64: fast and reproducible across runs */
+static inline __u64 uk_bench_rand(__u64 *state)
+{
+	__u64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/* Forget all recorded operations, the samples are not cleared */
+static inline void uk_bench_lat_reset(struct uk_bench_lat *l)
+{
+	memset(l, 0, offsetof(struct uk_bench_lat, samples));
+	l->sample_rnd = 0xd1b54a32d192ed03ULL;
+}
+
+/* Account a single operation that took `lat` nanoseconds */
+static inline void uk_bench_record(struct uk_bench_lat *l, __nsec lat)
+{
+	__u64 j;
+
+	l->total += lat;
+	if (lat > l->max)
+		l->max = lat;
+	if (l->ops < UK_BENCH_NR_SAMPLES) {
+		l->samples[l->ops] = lat;
+		l->nr_samples++;
+	} else {
+		j = uk_bench_rand(&l->sample_rnd) % (l->ops + 1);
+		if (j < UK_BENCH_NR_SAMPLES)
+			l->samples[j] = lat;
+	}
+	l->ops++;
+}
+
+#define UK_BENCH_TIMED(l, expr)						\
+	do {								\
+		__nsec _t0 = ukplat_monotonic_clock();			\
+		expr;							\
+		uk_bench_record((l), ukplat_monotonic_clock() - _t0);	\
+	} while (0)
+
+/* Sort the samples for uk_bench_percentile(). Shell sort: good enough for
+ * the reservoir and needs no memory.
+ */
+static inline void uk_bench_sort(struct uk_bench_lat *l)
+{
+	unsigned int gap, i, j;
+	__nsec tmp;
+
+	for (gap = l->nr_samples / 2; gap > 0; gap /= 2) {
+		for (i = gap; i < l->nr_samples; i++) {
+			tmp = l->samples[i];
+			for (j = i; j >= gap && l->samples[j - gap] > tmp;
+			     j -= gap)
+				l->samples[j] = l->samples[j - gap];
+			l->samples[j] = tmp;
+		}
+	}
+}
+
+/* `p`-th percentile of the sorted samples. Once there were more operations
+ * than samples, the 100th percentile may miss the slowest operation; use
+ * `max` for it.
+ */
+static inline __nsec uk_bench_percentile(const struct uk_bench_lat *l,
+					 unsigned int p)
+{
+	if (!l->nr_samples)
+		return 0;
+	return l->samples[((l->nr_samples - 1) * p) / 100];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_BENCH_H__ */
@@ -34,6 +34,7 @@
 #ifndef __UKPLAT_TIME_H__
 #define __UKPLAT_TIME_H__
 
+#include <uk/config.h>
 #include <uk/arch/time.h>
 
 #ifdef __cplusplus
@@ -48,6 +49,22 @@ __nsec ukplat_time_get_ticks(void);
 __nsec ukplat_monotonic_clock(void);
 __nsec ukplat_wall_clock(void);
 
+#if CONFIG_HAVE_TIME_ALARM
+/**
+ * Requests the timer interrupt (`ukplat_time_get_irq()`) of the current
+ * logical CPU at the monotonic time `until` without halting. A pending
+ * request that expires earlier is kept, and halting with
+ * `ukplat_lcpu_halt_irq_until()` replaces it. The interrupt may arrive
+ * early, so the handler has to check the time and request again. On
+ * platforms where the timer interrupt reaches the boot CPU only, requests
+ * of other logical CPUs are ignored.
+ *
+ * @param until
+ *   Monotonic time in nanoseconds
+ */
+void ukplat_time_set_alarm(__nsec until);
+#endif /* CONFIG_HAVE_TIME_ALARM */
+
 /* Time tick length */
 #define UKPLAT_TIME_TICK_NSEC  (UKARCH_NSEC_PER_SEC / CONFIG_HZ)
 #define UKPLAT_TIME_TICK_MSEC  ukarch_time_nsec_to_msec(UKPLAT_TIME_TICK_NSEC)
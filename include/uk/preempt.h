@@ -34,7 +34,111 @@
 #ifndef __UK_PREEMPT_H__
 #define __UK_PREEMPT_H__
 
-#define uk_preempt_disable()  barrier()
-#define uk_preempt_enable()   barrier()
+#include <uk/config.h>
+
+#if CONFIG_LIBUKSCHED_PREEMPT
+#include <uk/arch/lcpu.h>
+#include <uk/plat/lcpu.h>
+#include <uk/arch/time.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Preemption state of a logical CPU (managed by uksched) */
+struct uk_preempt_lcpu {
+	/* Preemption is disabled while greater than 0 */
+	unsigned int count;
+	/* The time slice expired while preemption was disabled */
+	int need_resched;
+	/* End of the time slice of the current thread, 0 for idle threads */
+	__nsec slice_end;
+} __align(CACHE_LINE_SIZE);
+
+extern UKPLAT_PER_LCPU_DEFINE(struct uk_preempt_lcpu, uk_preempt_lcpu);
+
+/**
+ * Gives up the logical CPU if the time slice of the current thread expired.
+ * Must be called with interrupts enabled; nothing is done if preemption is
+ * disabled.
+ */
+void uk_preempt_schedule(void);
+
+static inline unsigned int uk_preempt_count(void)
+{
+	return ukplat_per_lcpu_current(uk_preempt_lcpu).count;
+}
+
+/**
+ * Disables preemption of the current thread. Calls can be nested. The
+ * thread must not block or yield until preemption is enabled again.
+ */
+static inline void uk_preempt_disable(void)
+{
+	unsigned long flags;
+
+	/* The thread may still be preempted and migrated to another LCPU
+	 * while it looks up its counter, so the increment must not be
+	 * interrupted
+	 */
+	flags = ukplat_lcpu_save_irqf();
+	ukplat_per_lcpu_current(uk_preempt_lcpu).count++;
+	ukplat_lcpu_restore_irqf(flags);
+	barrier();
+}
+
+/**
+ * Enables preemption without checking for an expired time slice
+ */
+static inline void uk_preempt_enable_no_resched(void)
+{
+	struct uk_preempt_lcpu *p;
+	unsigned long flags;
+
+	/* Like the increment, the decrement must not be interrupted */
+	barrier();
+	flags = ukplat_lcpu_save_irqf();
+	p = &ukplat_per_lcpu_current(uk_preempt_lcpu);
+	UK_ASSERT(p->count > 0);
+	p->count--;
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+/**
+ * Enables preemption. The thread is preempted here if its time slice
+ * expired while preemption was disabled.
+ */
+static inline void uk_preempt_enable(void)
+{
+	struct uk_preempt_lcpu *p;
+	unsigned long flags;
+	int resched;
+
+	/* Once the count drops to 0, the thread can be migrated before it
+	 * checks for a pending reschedule
+	 */
+	barrier();
+	flags = ukplat_lcpu_save_irqf();
+	p = &ukplat_per_lcpu_current(uk_preempt_lcpu);
+	UK_ASSERT(p->count > 0);
+	resched = --p->count == 0 && p->need_resched;
+	ukplat_lcpu_restore_irqf(flags);
+
+	if (unlikely(resched) && !ukplat_lcpu_irqs_disabled())
+		uk_preempt_schedule();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#else /* !CONFIG_LIBUKSCHED_PREEMPT */
+#define uk_preempt_count()		(0)
+#define uk_preempt_disable()		barrier()
+#define uk_preempt_enable_no_resched()	barrier()
+#define uk_preempt_enable()		barrier()
+#endif /* !CONFIG_LIBUKSCHED_PREEMPT */
 
 #endif /* __UK_PREEMPT_H__ */
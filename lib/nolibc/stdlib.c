@@ -58,6 +58,9 @@
 #include <ctype.h>
 #include <uk/print.h>
 #include <uk/plat/bootstrap.h>
+#if CONFIG_LIBUKALLOC
+#include <uk/alloc_profile.h>
+#endif /* CONFIG_LIBUKALLOC */
 
 #define __DECONST(type, var) ((type)(uintptr_t)(const void *)(var))
 
@@ -68,7 +71,8 @@
  */
 void *malloc(size_t size)
 {
-	return uk_malloc(uk_alloc_get_default(), size);
+	return uk_alloc_profile_entry(uk_malloc(uk_alloc_get_default(),
+						 size));
 }
 
 /* Release memory previously allocated by malloc(). ptr must be a pointer
@@ -84,7 +88,8 @@ void free(void *ptr)
  */
 void *calloc(size_t nmemb, size_t size)
 {
-	return uk_calloc(uk_alloc_get_default(), nmemb, size);
+	return uk_alloc_profile_entry(uk_calloc(uk_alloc_get_default(),
+						 nmemb, size));
 }
 
 /* Change the size of the memory block pointed to by ptr to size bytes.
@@ -93,7 +98,8 @@ void *calloc(size_t nmemb, size_t size)
  */
 void *realloc(void *ptr, size_t size)
 {
-	return uk_realloc(uk_alloc_get_default(), ptr, size);
+	return uk_alloc_profile_entry(uk_realloc(uk_alloc_get_default(),
+						  ptr, size));
 }
 
 /* Allocate size bytes of memory, aligned to align bytes, and return the
@@ -102,8 +108,8 @@ void *realloc(void *ptr, size_t size)
  */
 int posix_memalign(void **memptr, size_t align, size_t size)
 {
-	return uk_posix_memalign(uk_alloc_get_default(),
-				 memptr, align, size);
+	return uk_alloc_profile_entry(
+		uk_posix_memalign(uk_alloc_get_default(), memptr, align, size));
 }
 
 /* Allocate size bytes of memory, aligned to align bytes. Returns pointer to
@@ -111,7 +117,8 @@ int posix_memalign(void **memptr, size_t align, size_t size)
  */
 void *memalign(size_t align, size_t size)
 {
-	return uk_memalign(uk_alloc_get_default(), align, size);
+	return uk_alloc_profile_entry(uk_memalign(uk_alloc_get_default(),
+						   align, size));
 }
 #endif /* CONFIG_LIBUKALLOC */
 
@@ -49,16 +49,17 @@
 #include <uk/syscall.h>
 #include <uk/atomic.h>
 #include <uk/thread.h>
-#include <uk/thread.h>
 #include <uk/list.h>
 #if CONFIG_LIBPOSIX_PROCESS_CLONE
 #include <uk/process.h>
 #endif /* CONFIG_LIBPOSIX_PROCESS_CLONE */
 #include <uk/sched.h>
-#include <uk/list.h>
 #include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
 #include <uk/print.h>
 #include <uk/spinlock.h>
+#include <uk/arch/lcpu.h>
 #include <uk/plat/lcpu.h>
 #include <uk/plat/time.h>
 
@@ -67,42 +68,142 @@
  */
 struct uk_futex {
 	uint32_t *uaddr; /** The futex address. */
+	uint32_t bitset; /** Wakeups this waiter accepts (FUTEX_WAIT_BITSET) */
 	struct uk_thread *thread; /** The thread waiting on the futex. */
-	struct uk_list_head list_node; /** The list containing all the futexes
-					 * on which the threads are waiting.
+	struct uk_list_head list_node; /** The wait list of the hash bucket,
+					 * empty when the waiter was woken.
 					 */
 };
 
-static UK_LIST_HEAD(futex_list);
-static uk_spinlock futex_list_lock = UK_SPINLOCK_INITIALIZER();
+/*
+ * Waiters are kept in a hash table that is keyed on the futex address, so
+ * that operations on independent futexes neither scan each other's waiters
+ * nor contend for the same lock. All threads share one address space, so
+ * private and shared futexes are the same.
+ */
+#define FUTEX_HASH_ORDER	CONFIG_LIBPOSIX_FUTEX_HASH_ORDER
+#define FUTEX_HASH_SIZE		(1UL << FUTEX_HASH_ORDER)
+
+struct futex_bucket {
+	uk_spinlock lock;
+	/* Number of queued waiters. Read without the lock so that a wake
+	 * operation on a futex without waiters returns right away.
+	 */
+	unsigned int nr_waiters;
+	struct uk_list_head waiters;
+} __align(CACHE_LINE_SIZE);
+
+static struct futex_bucket futex_table[FUTEX_HASH_SIZE];
+
+/* Futex of the current thread while it waits, see thread_exit_handler() */
+static __uk_tls struct uk_futex *futex_waiting;
+
+static inline struct futex_bucket *futex_bucket(const uint32_t *uaddr)
+{
+	/* Futex words are 32-bit aligned, Fibonacci hashing of the rest */
+	__u64 key = (__u64) (__uptr) uaddr >> 2;
+
+	return &futex_table[(key * 0x9e3779b97f4a7c15ULL)
+			    >> (64 - FUTEX_HASH_ORDER)];
+}
+
+/* Locks two buckets in address order, or one if both are the same */
+static void futex_lock_pair(struct futex_bucket *b1, struct futex_bucket *b2)
+{
+	if (b1 == b2) {
+		uk_spin_lock(&b1->lock);
+	} else if (b1 < b2) {
+		uk_spin_lock(&b1->lock);
+		uk_spin_lock(&b2->lock);
+	} else {
+		uk_spin_lock(&b2->lock);
+		uk_spin_lock(&b1->lock);
+	}
+}
+
+static void futex_unlock_pair(struct futex_bucket *b1, struct futex_bucket *b2)
+{
+	uk_spin_unlock(&b1->lock);
+	if (b1 != b2)
+		uk_spin_unlock(&b2->lock);
+}
+
+/* Locks the bucket of a waiter, which changes when it is requeued */
+static struct futex_bucket *futex_lock_waiter(struct uk_futex *f,
+					      unsigned long *irqf)
+{
+	struct futex_bucket *b;
+
+	for (;;) {
+		b = futex_bucket(UK_READ_ONCE(f->uaddr));
+		uk_spin_lock_irqsave(&b->lock, *irqf);
+		if (likely(b == futex_bucket(f->uaddr)))
+			return b;
+		uk_spin_unlock_irqrestore(&b->lock, *irqf);
+	}
+}
+
+static inline void futex_dequeue(struct futex_bucket *b, struct uk_futex *f)
+{
+	uk_list_del_init(&f->list_node);
+	uk_dec(&b->nr_waiters);
+}
+
+/**
+ * Returns whether the bucket of a futex may have waiters.
+ *
+ * The caller changed the futex word before. A waiter increments the counter
+ * before it reads the word, so either the waiter sees the new value or we
+ * see the waiter.
+ */
+static inline int futex_has_waiters(struct futex_bucket *b)
+{
+	mb();
+	return uk_load_n(&b->nr_waiters) != 0;
+}
 
 /**
  * Prepare to wait on a futex.
  *
  * Get the futex value atomically and compare it with the expected value. Add
  * the thread to the wait list and then block it if the value is equal to the
- * expected one. If the futex was not removed from the list when the thread was
- * unblocked, then it means that it timed out.
+ * expected one. The comparison and the blocking happen under the lock of the
+ * hash bucket, so a wakeup in between cannot be lost. If the futex was not
+ * removed from the list when the thread was unblocked, then it means that it
+ * timed out.
  *
  * @param uaddr		The futex userspace address
  * @param val		The expected value
+ * @param bitset	Only wake operations with a common bit wake the thread
  * @param timeout	The deadline until the function will block at most.
  * 			If it is NULL, the thread will wait indefinitely.
  *
  * @return
  *	0: uaddr contains val and the thread finished waiting;
- *	<1: -EAGAIN (uaddr does not contain val) or -ETIMEDOUT (the futex timed
- *       out)
+ *	<1: -EAGAIN (uaddr does not contain val), -ETIMEDOUT (the futex timed
+ *       out), or -EINVAL (bitset is 0)
  */
-static int futex_wait(uint32_t *uaddr, uint32_t val, const __nsec *timeout)
+static int futex_wait(uint32_t *uaddr, uint32_t val, uint32_t bitset,
+		      const __nsec *timeout)
 {
 	unsigned long irqf;
-	struct uk_list_head *itr, *tmp;
-	struct uk_futex *f_tmp;
+	struct futex_bucket *b;
 	struct uk_thread *current = uk_thread_current();
-	struct uk_futex f = {.uaddr = uaddr, .thread = current};
+	struct uk_futex f = {.uaddr = uaddr, .bitset = bitset,
+			     .thread = current};
+	int ret = 0;
+
+	if (unlikely(!bitset))
+		return -EINVAL;
+
+	b = futex_bucket(uaddr);
+	uk_inc(&b->nr_waiters);
+	uk_spin_lock_irqsave(&b->lock, irqf);
 
 	if (uk_load_n(uaddr) != val) {
+		uk_spin_unlock_irqrestore(&b->lock, irqf);
+		uk_dec(&b->nr_waiters);
+
 		uk_pr_debug("FUTEX_WAIT: Condition not met (*uaddr != %"PRIu32", uaddr: %p)\n",
 			    val, uaddr);
 		return -EAGAIN;
@@ -113,46 +214,79 @@ static int futex_wait(uint32_t *uaddr, uint32_t val, const __nsec *timeout)
 			val, uaddr);
 
 	/* Enqueue thread to wait list */
-	irqf = ukplat_lcpu_save_irqf();
-	uk_spin_lock(&futex_list_lock);
-	uk_list_add_tail(&f.list_node, &futex_list);
-	uk_spin_unlock(&futex_list_lock);
-	ukplat_lcpu_restore_irqf(irqf);
+	uk_list_add_tail(&f.list_node, &b->waiters);
+	futex_waiting = &f;
+
+	for (;;) {
+		if (timeout) {
+			/* Block at most until `timeout` nanosecs */
+			uk_pr_debug("FUTEX_WAIT: Wait %"__PRIsnsec" nsec for wake-up\n",
+					(__snsec) (*timeout));
+			uk_thread_block_until(current, (__snsec) (*timeout));
+		} else {
+			/* Block indefinitely */
+			uk_pr_debug("FUTEX_WAIT: Wait indefinitely for wake-up\n");
+			uk_thread_block(current);
+		}
+		uk_spin_unlock_irqrestore(&b->lock, irqf);
+		uk_sched_yield();
 
-	if (timeout) {
-		/* Block at most until `timeout` nanosecs */
-		uk_pr_debug("FUTEX_WAIT: Wait %"__PRIsnsec" nsec for wake-up\n",
-				(__snsec) (*timeout));
-		uk_thread_block_until(current, (__snsec) (*timeout));
-	} else {
-		/* Block indefinitely */
-		uk_pr_debug("FUTEX_WAIT: Wait indefinitely for wake-up\n");
-		uk_thread_block(current);
-	}
-	uk_sched_yield();
+		uk_pr_debug("FUTEX_WAIT: Woke up (uaddr: %p)\n", uaddr);
+		b = futex_lock_waiter(&f, &irqf);
 
-	uk_pr_debug("FUTEX_WAIT: Woke up (uaddr: %p)\n", uaddr);
-	irqf = ukplat_lcpu_save_irqf();
-	uk_spin_lock(&futex_list_lock);
+		/* Removed from the wait list by a wake operation */
+		if (uk_list_empty(&f.list_node))
+			break;
 
-	/* If the futex is still in the wait list, then it timed out */
-	uk_list_for_each_safe(itr, tmp, &futex_list) {
-		f_tmp = uk_list_entry(itr, struct uk_futex, list_node);
-
-		if (f_tmp->uaddr == uaddr && f_tmp->thread == current) {
-			/* Remove the thread from the futex list */
-			uk_list_del(&f_tmp->list_node);
-			uk_spin_unlock(&futex_list_lock);
-			ukplat_lcpu_restore_irqf(irqf);
+		/* If the futex is still in the wait list, then it timed out */
+		if (timeout && ukplat_monotonic_clock() >= *timeout) {
+			futex_dequeue(b, &f);
 
 			uk_pr_debug("FUTEX_WAIT: Woke up because of timeout\n");
-			return -ETIMEDOUT;
+			ret = -ETIMEDOUT;
+			break;
 		}
+
+		/* Woken up by something else, wait again */
 	}
-	uk_spin_unlock(&futex_list_lock);
-	ukplat_lcpu_restore_irqf(irqf);
 
-	return 0;
+	futex_waiting = NULL;
+	uk_spin_unlock_irqrestore(&b->lock, irqf);
+
+	return ret;
+}
+
+/*
+ * Wakes up at least one and at most `val` waiters of `uaddr` whose bitset
+ * matches. The bucket of `uaddr` must be locked.
+ */
+static int futex_wake_locked(struct futex_bucket *b, uint32_t *uaddr,
+			     uint32_t val, uint32_t bitset)
+{
+	struct uk_futex *f, *tmp;
+	struct uk_thread *thread;
+	int count = 0;
+
+	uk_list_for_each_entry_safe(f, tmp, &b->waiters, list_node) {
+		if (f->uaddr != uaddr || !(f->bitset & bitset))
+			continue;
+
+		/* The waiter may return as soon as it is dequeued and the
+		 * bucket is unlocked
+		 */
+		thread = f->thread;
+		futex_dequeue(b, f);
+
+		/* TODO: Replace with uk_thread_wakeup when the new
+		 * scheduler API is ready
+		 */
+		uk_thread_wake(thread);
+
+		/* Wake at most val threads */
+		if ((uint32_t) ++count >= val)
+			break;
+	}
+	return count;
 }
 
 /**
@@ -163,43 +297,153 @@ static int futex_wait(uint32_t *uaddr, uint32_t val, const __nsec *timeout)
  *
  * @param uaddr	The futex userspace address
  * @param val	The number of threads waiting on the futex to be woken up
+ * @param bitset	Only threads waiting with a common bit are woken
  *
  * @return
  *	0: no threads were woken up;
  *	>0: the number of threads woken up
+ *	-EINVAL: bitset is 0
  */
-static int futex_wake(uint32_t *uaddr, uint32_t val)
+static int futex_wake(uint32_t *uaddr, uint32_t val, uint32_t bitset)
 {
 	unsigned long irqf;
-	struct uk_list_head *itr, *tmp;
-	struct uk_futex *f;
-	uint32_t count = 0;
+	struct futex_bucket *b;
+	int count;
 
-	irqf = ukplat_lcpu_save_irqf();
-	uk_spin_lock(&futex_list_lock);
+	if (unlikely(!bitset))
+		return -EINVAL;
 
-	uk_list_for_each_safe(itr, tmp, &futex_list) {
-		f = uk_list_entry(itr, struct uk_futex, list_node);
+	b = futex_bucket(uaddr);
+	if (!futex_has_waiters(b))
+		return 0;
 
-		if (f->uaddr == uaddr) {
-			/* Remove the thread from the futex list */
-			uk_list_del(&f->list_node);
+	uk_spin_lock_irqsave(&b->lock, irqf);
+	count = futex_wake_locked(b, uaddr, val, bitset);
+	uk_spin_unlock_irqrestore(&b->lock, irqf);
 
-			/* TODO: Replace with uk_thread_wakeup when the new
-			 * scheduler API is ready
-			 */
-			uk_thread_wake(f->thread);
+	return count;
+}
+
+/* Applies the operation of FUTEX_WAKE_OP and returns the old value */
+static int futex_atomic_op(uint32_t *uaddr, uint32_t encoded_op,
+			   uint32_t *oldval)
+{
+	uint32_t op = (encoded_op >> 28) & 0x7;
+	uint32_t oparg = (uint32_t) (((int32_t) (encoded_op << 8)) >> 20);
+	uint32_t old, new;
+
+	if (encoded_op & (FUTEX_OP_OPARG_SHIFT << 28)) {
+		if (oparg > 31)
+			return -EINVAL;
+		oparg = 1U << oparg;
+	}
 
-			/* Wake at most val threads */
-			if (++count >= val)
-				break;
+	old = uk_load_n(uaddr);
+	do {
+		switch (op) {
+		case FUTEX_OP_SET:
+			new = oparg;
+			break;
+		case FUTEX_OP_ADD:
+			new = old + oparg;
+			break;
+		case FUTEX_OP_OR:
+			new = old | oparg;
+			break;
+		case FUTEX_OP_ANDN:
+			new = old & ~oparg;
+			break;
+		case FUTEX_OP_XOR:
+			new = old ^ oparg;
+			break;
+		default:
+			return -ENOSYS;
 		}
+	} while (!uk_compare_exchange_n(uaddr, &old, new));
+
+	*oldval = old;
+	return 0;
+}
+
+static int futex_op_cmp(uint32_t encoded_op, uint32_t oldval)
+{
+	uint32_t cmp = (encoded_op >> 24) & 0xf;
+	int32_t cmparg = ((int32_t) (encoded_op << 20)) >> 20;
+	int32_t old = (int32_t) oldval;
+
+	switch (cmp) {
+	case FUTEX_OP_CMP_EQ:
+		return old == cmparg;
+	case FUTEX_OP_CMP_NE:
+		return old != cmparg;
+	case FUTEX_OP_CMP_LT:
+		return old < cmparg;
+	case FUTEX_OP_CMP_LE:
+		return old <= cmparg;
+	case FUTEX_OP_CMP_GT:
+		return old > cmparg;
+	case FUTEX_OP_CMP_GE:
+		return old >= cmparg;
+	default:
+		return -ENOSYS;
+	}
+}
+
+/**
+ * Modify a futex and wake up waiters of two futexes.
+ *
+ * Atomically applies the operation that is encoded in val3 to the futex at
+ * uaddr2 and wakes up to val waiters on uaddr. If the old value of uaddr2
+ * passes the comparison that is encoded in val3, up to val2 waiters on
+ * uaddr2 are woken up as well. Condition variables use this to signal and
+ * release the internal lock with one call.
+ *
+ * @param uaddr		First futex user address
+ * @param val		Number of waiters on uaddr to wake
+ * @param val2		Number of waiters on uaddr2 to wake
+ * @param uaddr2	Second futex user address
+ * @param val3		Encoded operation and comparison (see FUTEX_OP())
+ *
+ * @return
+ *	>=0: on success, the number of woken waiters;
+ *	<0: on error
+ */
+static int futex_wake_op(uint32_t *uaddr, uint32_t val, uint32_t val2,
+			 uint32_t *uaddr2, uint32_t val3)
+{
+	unsigned long irqf;
+	struct futex_bucket *b1, *b2;
+	uint32_t oldval;
+	int count, cmp, rc;
+
+	b1 = futex_bucket(uaddr);
+	b2 = futex_bucket(uaddr2);
+
+	irqf = ukplat_lcpu_save_irqf();
+	futex_lock_pair(b1, b2);
+
+	rc = futex_atomic_op(uaddr2, val3, &oldval);
+	if (unlikely(rc < 0)) {
+		count = rc;
+		goto out;
 	}
 
-	uk_spin_unlock(&futex_list_lock);
+	count = futex_wake_locked(b1, uaddr, val, FUTEX_BITSET_MATCH_ANY);
+
+	cmp = futex_op_cmp(val3, oldval);
+	if (unlikely(cmp < 0)) {
+		count = cmp;
+		goto out;
+	}
+	if (cmp)
+		count += futex_wake_locked(b2, uaddr2, val2,
+					   FUTEX_BITSET_MATCH_ANY);
+
+out:
+	futex_unlock_pair(b1, b2);
 	ukplat_lcpu_restore_irqf(irqf);
 
-	return (int) count;
+	return count;
 }
 
 /**
@@ -217,49 +461,56 @@ static int futex_wake(uint32_t *uaddr, uint32_t val)
  * @param val2		Number of waiters to requeue (0-INT_MAX)
  * @param uaddr2	Target futex user address
  * @param val3		uaddr expected value
+ * @param cmp		Compare the value of uaddr with val3 (FUTEX_CMP_REQUEUE)
  *
  * @return
  *	>=0: on success, the number of tasks requeued or woken;
  *	<0: on error
  */
-static int futex_cmp_requeue(uint32_t *uaddr, uint32_t val, uint32_t val2,
-			     uint32_t *uaddr2, uint32_t val3)
+static int futex_requeue(uint32_t *uaddr, uint32_t val, uint32_t val2,
+			 uint32_t *uaddr2, uint32_t val3, int cmp)
 {
 	unsigned long irqf;
-	struct uk_list_head *itr, *tmp;
-	struct uk_futex *f;
+	struct futex_bucket *b1, *b2;
+	struct uk_futex *f, *tmp;
 	int woken_uaddr1;
 	uint32_t waiters_uaddr2 = 0;
 
-	if (!((uint32_t)val3 == uk_load_n(uaddr)))
-		return -EAGAIN;
+	b1 = futex_bucket(uaddr);
+	b2 = futex_bucket(uaddr2);
 
-	/* Wake up val waiters on uaddr */
-	woken_uaddr1 = futex_wake(uaddr, val);
+	irqf = ukplat_lcpu_save_irqf();
+	futex_lock_pair(b1, b2);
 
-	if (!val2)
-		return woken_uaddr1;
+	if (cmp && !((uint32_t)val3 == uk_load_n(uaddr))) {
+		futex_unlock_pair(b1, b2);
+		ukplat_lcpu_restore_irqf(irqf);
+		return -EAGAIN;
+	}
 
-	irqf = ukplat_lcpu_save_irqf();
-	uk_spin_lock(&futex_list_lock);
+	/* Wake up val waiters on uaddr */
+	woken_uaddr1 = futex_wake_locked(b1, uaddr, val,
+					 FUTEX_BITSET_MATCH_ANY);
 
 	/* Requeue val2 waiters on uaddr2 */
-	uk_list_for_each_safe(itr, tmp, &futex_list) {
-		f = uk_list_entry(itr, struct uk_futex, list_node);
-
-		if (f->uaddr == uaddr) {
-			/* Requeue thread to uaddr2 */
-			uk_list_del(&f->list_node);
-			f->uaddr = uaddr2;
-			uk_list_add_tail(&f->list_node, &futex_list);
-
-			/* Requeue at most val2 threads */
-			if (++waiters_uaddr2 >= val2)
-				break;
+	uk_list_for_each_entry_safe(f, tmp, &b1->waiters, list_node) {
+		if (waiters_uaddr2 >= val2)
+			break;
+		if (f->uaddr != uaddr)
+			continue;
+
+		/* Requeue thread to uaddr2 */
+		uk_list_del(&f->list_node);
+		UK_WRITE_ONCE(f->uaddr, uaddr2);
+		uk_list_add_tail(&f->list_node, &b2->waiters);
+		if (b1 != b2) {
+			uk_inc(&b2->nr_waiters);
+			uk_dec(&b1->nr_waiters);
 		}
+		waiters_uaddr2++;
 	}
 
-	uk_spin_unlock(&futex_list_lock);
+	futex_unlock_pair(b1, b2);
 	ukplat_lcpu_restore_irqf(irqf);
 
 	return woken_uaddr1 + waiters_uaddr2;
@@ -286,6 +537,8 @@ UK_LLSYSCALL_R_DEFINE(int, futex, uint32_t *, uaddr, int, futex_op,
 {
 	__nsec timeout_ns;
  	int cmd = futex_op & FUTEX_CMD_MASK;
+	/* Some operations pass a number instead of a timeout */
+	uint32_t val2 = (uint32_t) (__uptr) timeout;
 
 	/* Reject invalid combinations of the realtime clock flag */
 	if (futex_op & FUTEX_CLOCK_REALTIME && !(
@@ -311,33 +564,35 @@ UK_LLSYSCALL_R_DEFINE(int, futex, uint32_t *, uaddr, int, futex_op,
 			timeout_ns = ukplat_monotonic_clock() +
 				     ukarch_time_sec_to_nsec(timeout->tv_sec) +
 				     timeout->tv_nsec;
-		return futex_wait(uaddr, val, timeout ? &timeout_ns : NULL);
+		return futex_wait(uaddr, val, FUTEX_BITSET_MATCH_ANY,
+				  timeout ? &timeout_ns : NULL);
 
 	case FUTEX_WAIT_BITSET:
-		/*
-		 * Special case implementation for cases where the val3/mask has
-		 * all bits set. Some applications do this to use the absolute
-		 * timeout mode. We return ENOSYS for all non-supported calls.
-		 */
-		if (val3 != UINT32_MAX)
-			return -ENOSYS;
-
+		/* `timeout` is absolute */
 		if (timeout)
 			timeout_ns = ukarch_time_sec_to_nsec(timeout->tv_sec)
 				     + timeout->tv_nsec;
 
-		return futex_wait(uaddr, val, timeout ? &timeout_ns : NULL);
+		return futex_wait(uaddr, val, val3,
+				  timeout ? &timeout_ns : NULL);
 
 	case FUTEX_WAKE:
-		return futex_wake(uaddr, val);
+		return futex_wake(uaddr, val, FUTEX_BITSET_MATCH_ANY);
+
+	case FUTEX_WAKE_BITSET:
+		return futex_wake(uaddr, val, val3);
+
+	case FUTEX_WAKE_OP:
+		return futex_wake_op(uaddr, val, val2, uaddr2, val3);
 
-	case FUTEX_FD:
 	case FUTEX_REQUEUE:
-		return -ENOSYS;
+		return futex_requeue(uaddr, val, val2, uaddr2, 0, 0);
 
 	case FUTEX_CMP_REQUEUE:
-		return futex_cmp_requeue(uaddr, val, (unsigned long)timeout,
-					 uaddr2, val3);
+		return futex_requeue(uaddr, val, val2, uaddr2, val3, 1);
+
+	case FUTEX_FD:
+		return -ENOSYS;
 
 	default:
 		return -ENOSYS;
@@ -382,29 +637,43 @@ UK_LLSYSCALL_R_DEFINE(pid_t, set_tid_address, pid_t *, tid_ref)
 	return self_tid;
 }
 
-static void thread_exit_handler(struct uk_thread *child)
+static void thread_exit_handler(struct uk_thread *child __unused)
 {
-	struct uk_list_head *itr, *tmp;
-	struct uk_futex *f;
+	struct futex_bucket *b;
+	unsigned long irqf;
 
 	/* Clear child TID at the stored reference */
 	if (child_tid_clear_ref != NULL) {
 		*((pid_t *) child_tid_clear_ref) = 0;
-		futex_wake((uint32_t *) child_tid_clear_ref, 0);
+		futex_wake((uint32_t *) child_tid_clear_ref, 1,
+			   FUTEX_BITSET_MATCH_ANY);
 	}
 
-	/* Clear this thread's entries from the list */
-	uk_spin_lock(&futex_list_lock);
-	uk_list_for_each_safe(itr, tmp, &futex_list) {
-		f = uk_list_entry(itr, struct uk_futex, list_node);
-		if (f->thread == child) {
-			uk_list_del(&f->list_node);
-			break; /* a thread can wait on one futex */
-		}
+	/* Remove this thread's entry from its wait list. A thread can wait
+	 * on one futex only.
+	 */
+	if (futex_waiting) {
+		b = futex_lock_waiter(futex_waiting, &irqf);
+		if (!uk_list_empty(&futex_waiting->list_node))
+			futex_dequeue(b, futex_waiting);
+		uk_spin_unlock_irqrestore(&b->lock, irqf);
+		futex_waiting = NULL;
 	}
-	uk_spin_unlock(&futex_list_lock);
 }
 
 UK_THREAD_INIT_PRIO(0x0, thread_exit_handler, UK_PRIO_EARLIEST);
 
 #endif /* CONFIG_LIBPOSIX_PROCESS_CLONE */
+
+static int futex_init(struct uk_init_ctx *ictx __unused)
+{
+	unsigned long i;
+
+	for (i = 0; i < FUTEX_HASH_SIZE; i++) {
+		uk_spin_init(&futex_table[i].lock);
+		UK_INIT_LIST_HEAD(&futex_table[i].waiters);
+	}
+	return 0;
+}
+
+uk_early_initcall(futex_init, 0x0);
@@ -442,4 +442,95 @@ UK_TESTCASE(posix_futex_testsuite, test_cmp_requeue_two_waiters_one_waker)
 	UK_TEST_EXPECT_SNUM_EQ(var_to_change, 3);
 }
 
+UK_TESTCASE(posix_futex_testsuite, test_wait_bitset_zero)
+{
+	uint32_t futex_val = 10;
+
+	int ret = futex(&futex_val, FUTEX_WAIT_BITSET, futex_val, NULL, NULL,
+			0);
+
+	UK_TEST_EXPECT_SNUM_EQ(ret, -1);
+	UK_TEST_EXPECT_SNUM_EQ(errno, EINVAL);
+}
+
+static uint32_t bitset_futex_val;
+static int bitset_waiter_ret;
+
+/**
+ * Wait on the futex with bitset 0x1.
+ */
+static __noreturn void bitset_waiter_func(void *arg __unused)
+{
+	bitset_waiter_ret = futex(&bitset_futex_val, FUTEX_WAIT_BITSET_PRIVATE,
+				  0, NULL, NULL, 0x1);
+	uk_sched_thread_exit();
+}
+
+UK_TESTCASE(posix_futex_testsuite, test_wake_bitset)
+{
+	struct uk_thread *waiter;
+	int ret;
+
+	bitset_futex_val = 0;
+	bitset_waiter_ret = -2;
+	waiter = uk_sched_thread_create(uk_sched_current(),
+			bitset_waiter_func, NULL, "Waiter");
+	uk_sched_yield();
+
+	/* A non-matching bitset does not wake the waiter */
+	ret = futex(&bitset_futex_val, FUTEX_WAKE_BITSET_PRIVATE, 1, NULL,
+		    NULL, 0x2);
+	UK_TEST_EXPECT_ZERO(ret);
+
+	ret = futex(&bitset_futex_val, FUTEX_WAKE_BITSET_PRIVATE, 1, NULL,
+		    NULL, 0x3);
+	UK_TEST_EXPECT_SNUM_EQ(ret, 1);
+
+	wait_thread(waiter);
+	UK_TEST_EXPECT_ZERO(bitset_waiter_ret);
+}
+
+UK_TESTCASE(posix_futex_testsuite, test_wake_op)
+{
+	uint32_t i;
+	uint32_t futex_val = 0;
+	uint32_t futex2_val = 5;
+	uint32_t var_to_change = 0;
+	uint32_t var_to_change_vals[1][1];
+	int rets[1][1];
+	struct uk_thread *waiter;
+	struct test_args args = {
+		.futex_val = &futex_val,
+		.var_to_change = &var_to_change,
+		.var_to_change_vals = var_to_change_vals[0],
+		.rets = rets[0],
+		.num_iterations = 1,
+		.timeout = NULL,
+	};
+	int ret;
+
+	waiter = uk_sched_thread_create(uk_sched_current(),
+			waiter_func, &args, "Waiter");
+	uk_sched_yield();
+
+	/* futex2 += 1; wake one waiter of futex and, if futex2 was 0,
+	 * one of futex2
+	 */
+	ret = futex(&futex_val, FUTEX_WAKE_OP_PRIVATE, 1, (struct timespec *)1,
+		    &futex2_val, FUTEX_OP(FUTEX_OP_ADD, 1, FUTEX_OP_CMP_EQ, 0));
+	UK_TEST_EXPECT_SNUM_EQ(ret, 1);
+	UK_TEST_EXPECT_SNUM_EQ(futex2_val, 6);
+
+	wait_thread(waiter);
+	UK_TEST_EXPECT_ZERO(rets[0][0]);
+	UK_TEST_EXPECT_SNUM_EQ(var_to_change, 1);
+
+	/* Unsupported operation */
+	i = FUTEX_OP(7, 0, FUTEX_OP_CMP_EQ, 0);
+	ret = futex(&futex_val, FUTEX_WAKE_OP, 1, (struct timespec *)1,
+		    &futex2_val, i);
+	UK_TEST_EXPECT_SNUM_EQ(ret, -1);
+	UK_TEST_EXPECT_SNUM_EQ(errno, ENOSYS);
+}
+
 uk_testsuite_register(posix_futex_testsuite, NULL);
@@ -37,6 +37,7 @@
 #include <arch/clone.h>
 #include <uk/config.h>
 #include <stdbool.h>
+#include <sys/types.h>
 #if CONFIG_LIBUKSCHED
 #include <uk/thread.h>
 #endif
@@ -136,6 +137,13 @@ int uk_posix_process_create(struct uk_alloc *a,
 			    struct uk_thread *thread,
 			    struct uk_thread *parent);
 void uk_posix_process_kill(struct uk_thread *thread);
+
+#if CONFIG_LIBPOSIX_PROCESS_PIDS
+/**
+ * Returns the thread with the given thread ID or NULL if there is none
+ */
+struct uk_thread *tid2ukthread(pid_t tid);
+#endif /* CONFIG_LIBPOSIX_PROCESS_PIDS */
 #endif /* CONFIG_LIBUKSCHED */
 
 #if CONFIG_LIBPOSIX_PROCESS_CLONE
@@ -37,10 +37,10 @@
 #include <sys/types.h>
 #if CONFIG_LIBPOSIX_PROCESS_PIDS
 #include <uk/thread.h>
+#include <uk/process.h>
 #endif /* CONFIG_LIBPOSIX_PROCESS_PIDS */
 
 #if CONFIG_LIBPOSIX_PROCESS_PIDS
-struct uk_thread *tid2ukthread(pid_t tid);
 pid_t ukthread2tid(struct uk_thread *thread);
 pid_t ukthread2pid(struct uk_thread *thread);
 #endif /* CONFIG_LIBPOSIX_PROCESS_PIDS */
@@ -70,6 +70,54 @@ int uk_alloc_register(struct uk_alloc *a)
 	return 0;
 }
 
+int uk_alloc_unregister(struct uk_alloc *a)
+{
+	struct uk_alloc *this, *prev;
+
+	UK_ASSERT(a);
+
+	if (_uk_alloc_head == a) {
+		_uk_alloc_head = a->next;
+		a->next = __NULL;
+		return 0;
+	}
+
+	for (prev = _uk_alloc_head, this = prev ? prev->next : __NULL;
+	     this != __NULL;
+	     prev = this, this = this->next) {
+		if (this == a) {
+			prev->next = a->next;
+			a->next = __NULL;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+int uk_alloc_set_default(struct uk_alloc *a)
+{
+	struct uk_alloc *this, *prev;
+
+	UK_ASSERT(a);
+
+	if (_uk_alloc_head == a)
+		return 0;
+
+	/* Unlink the allocator in case it is already registered */
+	for (prev = _uk_alloc_head, this = prev ? prev->next : __NULL;
+	     this != __NULL;
+	     prev = this, this = this->next) {
+		if (this == a) {
+			prev->next = a->next;
+			break;
+		}
+	}
+
+	a->next = _uk_alloc_head;
+	_uk_alloc_head = a;
+	return 0;
+}
+
 #ifdef CONFIG_HAVE_MEMTAG
 #define __align_metadata_ifpages __align(MEMTAG_GRANULE)
 #else
@@ -600,6 +648,61 @@ long uk_alloc_pavailmem_compat(struct uk_alloc *a)
 	return (long) (mem >> __PAGE_SHIFT);
 }
 
+unsigned int uk_malloc_batch_compat(struct uk_alloc *a, __sz align, __sz size,
+				    void *obj[], unsigned int count)
+{
+	unsigned int i;
+
+	UK_ASSERT(a);
+
+	for (i = 0; i < count; ++i) {
+		if (align)
+			obj[i] = uk_do_memalign(a, align, size);
+		else
+			obj[i] = uk_do_malloc(a, size);
+		if (unlikely(!obj[i]))
+			break;
+	}
+	return i;
+}
+
+void uk_free_batch_compat(struct uk_alloc *a, void *obj[], unsigned int count)
+{
+	unsigned int i;
+
+	UK_ASSERT(a);
+
+	for (i = 0; i < count; ++i)
+		uk_do_free(a, obj[i]);
+}
+
+unsigned int uk_palloc_batch_compat(struct uk_alloc *a,
+				    unsigned long num_pages,
+				    void *obj[], unsigned int count)
+{
+	unsigned int i;
+
+	UK_ASSERT(a);
+
+	for (i = 0; i < count; ++i) {
+		obj[i] = uk_do_palloc(a, num_pages);
+		if (unlikely(!obj[i]))
+			break;
+	}
+	return i;
+}
+
+void uk_pfree_batch_compat(struct uk_alloc *a, void *obj[],
+			   unsigned long num_pages, unsigned int count)
+{
+	unsigned int i;
+
+	UK_ASSERT(a);
+
+	for (i = 0; i < count; ++i)
+		uk_do_pfree(a, obj[i], num_pages);
+}
+
 __sz uk_alloc_availmem_total(void)
 {
 	struct uk_alloc *a;
@@ -38,6 +38,7 @@
 #include <uk/config.h>
 #include <uk/assert.h>
 #include <uk/essentials.h>
+#include <uk/preempt.h>
 #include <errno.h>
 
 #ifdef __cplusplus
@@ -62,6 +63,17 @@ typedef void* (*uk_alloc_palloc_func_t)
 		(struct uk_alloc *a, unsigned long num_pages);
 typedef void  (*uk_alloc_pfree_func_t)
 		(struct uk_alloc *a, void *ptr, unsigned long num_pages);
+typedef unsigned int (*uk_alloc_malloc_batch_func_t)
+		(struct uk_alloc *a, __sz align, __sz size,
+		 void *obj[], unsigned int count);
+typedef void  (*uk_alloc_free_batch_func_t)
+		(struct uk_alloc *a, void *obj[], unsigned int count);
+typedef unsigned int (*uk_alloc_palloc_batch_func_t)
+		(struct uk_alloc *a, unsigned long num_pages,
+		 void *obj[], unsigned int count);
+typedef void  (*uk_alloc_pfree_batch_func_t)
+		(struct uk_alloc *a, void *obj[], unsigned long num_pages,
+		 unsigned int count);
 typedef int   (*uk_alloc_addmem_func_t)
 		(struct uk_alloc *a, void *base, __sz size);
 typedef __ssz (*uk_alloc_getsize_func_t)
@@ -104,6 +116,11 @@ struct uk_alloc {
 	/* page allocation interface */
 	uk_alloc_palloc_func_t palloc;
 	uk_alloc_pfree_func_t pfree;
+	/* batch interface, compat wrappers are used if not implemented */
+	uk_alloc_malloc_batch_func_t malloc_batch;
+	uk_alloc_free_batch_func_t free_batch;
+	uk_alloc_palloc_batch_func_t palloc_batch;
+	uk_alloc_pfree_batch_func_t pfree_batch;
 	/* optional interfaces, but recommended */
 	uk_alloc_getsize_func_t maxalloc; /* biggest alloc req. (bytes) */
 	uk_alloc_getsize_func_t availmem; /* total memory available (bytes) */
@@ -129,6 +146,13 @@ extern struct uk_alloc *_uk_alloc_head;
 	     iter != __NULL;			\
 	     iter = iter->next)
 
+/**
+ * Make the given allocator the default allocator that is returned by
+ * `uk_alloc_get_default()`. The allocator is registered if this has not
+ * happened yet.
+ */
+int uk_alloc_set_default(struct uk_alloc *a);
+
 #if CONFIG_LIBUKALLOC_IFSTATS_PERLIB
 struct uk_alloc *uk_alloc_get_default(void);
 #else /* !CONFIG_LIBUKALLOC_IFSTATS_PERLIB */
@@ -138,11 +162,21 @@ static inline struct uk_alloc *uk_alloc_get_default(void)
 }
 #endif /* !CONFIG_LIBUKALLOC_IFSTATS_PERLIB */
 
-/* wrapper functions */
+/* wrapper functions
+ *
+ * The allocators are not reentrant, so the current thread must not be
+ * preempted by another thread that enters the same allocator. Preemption
+ * is disabled around each call.
+ */
 static inline void *uk_do_malloc(struct uk_alloc *a, __sz size)
 {
+	void *ret;
+
 	UK_ASSERT(a);
-	return a->malloc(a, size);
+	uk_preempt_disable();
+	ret = a->malloc(a, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline void *uk_malloc(struct uk_alloc *a, __sz size)
@@ -157,8 +191,13 @@ static inline void *uk_malloc(struct uk_alloc *a, __sz size)
 static inline void *uk_do_calloc(struct uk_alloc *a,
 				 __sz nmemb, __sz size)
 {
+	void *ret;
+
 	UK_ASSERT(a);
-	return a->calloc(a, nmemb, size);
+	uk_preempt_disable();
+	ret = a->calloc(a, nmemb, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline void *uk_calloc(struct uk_alloc *a,
@@ -177,8 +216,13 @@ static inline void *uk_calloc(struct uk_alloc *a,
 static inline void *uk_do_realloc(struct uk_alloc *a,
 				  void *ptr, __sz size)
 {
+	void *ret;
+
 	UK_ASSERT(a);
-	return a->realloc(a, ptr, size);
+	uk_preempt_disable();
+	ret = a->realloc(a, ptr, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline void *uk_realloc(struct uk_alloc *a, void *ptr, __sz size)
@@ -193,8 +237,13 @@ static inline void *uk_realloc(struct uk_alloc *a, void *ptr, __sz size)
 static inline int uk_do_posix_memalign(struct uk_alloc *a, void **memptr,
 				       __sz align, __sz size)
 {
+	int ret;
+
 	UK_ASSERT(a);
-	return a->posix_memalign(a, memptr, align, size);
+	uk_preempt_disable();
+	ret = a->posix_memalign(a, memptr, align, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline int uk_posix_memalign(struct uk_alloc *a, void **memptr,
@@ -210,8 +259,13 @@ static inline int uk_posix_memalign(struct uk_alloc *a, void **memptr,
 static inline void *uk_do_memalign(struct uk_alloc *a,
 				   __sz align, __sz size)
 {
+	void *ret;
+
 	UK_ASSERT(a);
-	return a->memalign(a, align, size);
+	uk_preempt_disable();
+	ret = a->memalign(a, align, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline void *uk_memalign(struct uk_alloc *a,
@@ -225,7 +279,9 @@ static inline void *uk_memalign(struct uk_alloc *a,
 static inline void uk_do_free(struct uk_alloc *a, void *ptr)
 {
 	UK_ASSERT(a);
+	uk_preempt_disable();
 	a->free(a, ptr);
+	uk_preempt_enable();
 }
 
 static inline void uk_free(struct uk_alloc *a, void *ptr)
@@ -235,8 +291,13 @@ static inline void uk_free(struct uk_alloc *a, void *ptr)
 
 static inline void *uk_do_palloc(struct uk_alloc *a, unsigned long num_pages)
 {
+	void *ret;
+
 	UK_ASSERT(a);
-	return a->palloc(a, num_pages);
+	uk_preempt_disable();
+	ret = a->palloc(a, num_pages);
+	uk_preempt_enable();
+	return ret;
 }
 
 static inline void *uk_palloc(struct uk_alloc *a, unsigned long num_pages)
@@ -250,7 +311,9 @@ static inline void uk_do_pfree(struct uk_alloc *a, void *ptr,
 			       unsigned long num_pages)
 {
 	UK_ASSERT(a);
+	uk_preempt_disable();
 	a->pfree(a, ptr, num_pages);
+	uk_preempt_enable();
 }
 
 static inline void uk_pfree(struct uk_alloc *a, void *ptr,
@@ -259,14 +322,150 @@ static inline void uk_pfree(struct uk_alloc *a, void *ptr,
 	uk_do_pfree(a, ptr, num_pages);
 }
 
+/**
+ * Allocate up to `count` objects of `size` bytes with a single call to the
+ * allocator. Allocators that implement this natively avoid the per-object
+ * indirect call and can amortize their internal bookkeeping. All allocator
+ * registration helpers install the batch operations, falling back to
+ * per-object calls. Like their single-object counterparts, the `uk_*_batch()`
+ * allocation wrappers fail for a NULL allocator and the release wrappers
+ * expect a valid one.
+ *
+ * @param a
+ *   Allocator to allocate from
+ * @param align
+ *   Alignment of each object (power of two, multiple of `sizeof(void *)`)
+ *   or 0 for the default alignment of `uk_malloc()`
+ * @param size
+ *   Size of each object in bytes
+ * @param obj
+ *   Array that is filled with the allocated objects
+ * @param count
+ *   Number of requested objects
+ * @return
+ *   Number of objects that were allocated, they are stored at the beginning
+ *   of `obj`. A value smaller than `count` indicates an out-of-memory
+ *   condition.
+ */
+static inline unsigned int uk_do_malloc_batch(struct uk_alloc *a, __sz align,
+					      __sz size, void *obj[],
+					      unsigned int count)
+{
+	unsigned int ret;
+
+	UK_ASSERT(a);
+	UK_ASSERT(a->malloc_batch);
+	UK_ASSERT(obj || !count);
+	uk_preempt_disable();
+	ret = a->malloc_batch(a, align, size, obj, count);
+	uk_preempt_enable();
+	return ret;
+}
+
+static inline unsigned int uk_malloc_batch(struct uk_alloc *a, __sz size,
+					   void *obj[], unsigned int count)
+{
+	if (unlikely(!a))
+		return 0;
+	return uk_do_malloc_batch(a, 0, size, obj, count);
+}
+
+static inline unsigned int uk_memalign_batch(struct uk_alloc *a, __sz align,
+					     __sz size, void *obj[],
+					     unsigned int count)
+{
+	if (unlikely(!a))
+		return 0;
+	return uk_do_malloc_batch(a, align, size, obj, count);
+}
+
+/**
+ * Release `count` objects that were allocated from `a` with a single call to
+ * the allocator. NULL entries are ignored.
+ */
+static inline void uk_do_free_batch(struct uk_alloc *a, void *obj[],
+				    unsigned int count)
+{
+	UK_ASSERT(a);
+	UK_ASSERT(a->free_batch);
+	UK_ASSERT(obj || !count);
+	uk_preempt_disable();
+	a->free_batch(a, obj, count);
+	uk_preempt_enable();
+}
+
+static inline void uk_free_batch(struct uk_alloc *a, void *obj[],
+				 unsigned int count)
+{
+	uk_do_free_batch(a, obj, count);
+}
+
+/**
+ * Allocate up to `count` page ranges of `num_pages` pages each with a single
+ * call to the allocator.
+ *
+ * @return
+ *   Number of allocated page ranges stored at the beginning of `obj`
+ */
+static inline unsigned int uk_do_palloc_batch(struct uk_alloc *a,
+					      unsigned long num_pages,
+					      void *obj[], unsigned int count)
+{
+	unsigned int ret;
+
+	UK_ASSERT(a);
+	UK_ASSERT(a->palloc_batch);
+	UK_ASSERT(obj || !count);
+	uk_preempt_disable();
+	ret = a->palloc_batch(a, num_pages, obj, count);
+	uk_preempt_enable();
+	return ret;
+}
+
+static inline unsigned int uk_palloc_batch(struct uk_alloc *a,
+					   unsigned long num_pages,
+					   void *obj[], unsigned int count)
+{
+	if (unlikely(!a))
+		return 0;
+	return uk_do_palloc_batch(a, num_pages, obj, count);
+}
+
+/**
+ * Release `count` page ranges of `num_pages` pages each with a single call to
+ * the allocator.
+ */
+static inline void uk_do_pfree_batch(struct uk_alloc *a, void *obj[],
+				     unsigned long num_pages,
+				     unsigned int count)
+{
+	UK_ASSERT(a);
+	UK_ASSERT(a->pfree_batch);
+	UK_ASSERT(obj || !count);
+	uk_preempt_disable();
+	a->pfree_batch(a, obj, num_pages, count);
+	uk_preempt_enable();
+}
+
+static inline void uk_pfree_batch(struct uk_alloc *a, void *obj[],
+				  unsigned long num_pages, unsigned int count)
+{
+	uk_do_pfree_batch(a, obj, num_pages, count);
+}
+
 static inline int uk_alloc_addmem(struct uk_alloc *a, void *base,
 				  __sz size)
 {
+	int ret;
+
 	UK_ASSERT(a);
-	if (a->addmem)
-		return a->addmem(a, base, size);
-	else
+	if (!a->addmem)
 		return -ENOTSUP;
+
+	uk_preempt_disable();
+	ret = a->addmem(a, base, size);
+	uk_preempt_enable();
+	return ret;
 }
 
 /* current biggest allocation request possible */
@@ -318,9 +517,14 @@ void uk_alloc_stats_get_global(struct uk_alloc_stats *dst);
 #endif /* CONFIG_LIBUKALLOC_IFSTATS_GLOBAL */
 
 #if CONFIG_LIBUKALLOC_IFSTATS_PERLIB
+struct uk_alloc_profile;
+
 struct uk_alloc_libstats_entry {
 	const char *libname;
 	struct uk_alloc *a; /* default allocator wrapper for the library */
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+	struct uk_alloc_profile *prof; /* see uk/alloc_profile.h */
+#endif /* CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
 };
 
 extern struct uk_alloc_libstats_entry _uk_alloc_libstats_start[];
@@ -47,6 +47,15 @@ extern "C" {
 
 int uk_alloc_register(struct uk_alloc *a);
 
+/**
+ * Remove an allocator from the list of registered allocators. The caller
+ * has to make sure that the allocator is not in use anymore.
+ *
+ * @return
+ *   0 on success, -ENOENT if the allocator was not registered
+ */
+int uk_alloc_unregister(struct uk_alloc *a);
+
 /**
  * Compatibility functions that can be used by allocator implementations to
  * fill out callback functions in `struct uk_alloc` when just a subset of the
@@ -81,6 +90,16 @@ void uk_pfree_compat(struct uk_alloc *a, void *ptr, unsigned long num_pages);
 long uk_alloc_pavailmem_compat(struct uk_alloc *a);
 long uk_alloc_pmaxalloc_compat(struct uk_alloc *a);
 
+/* Batch operations that are provided based on the single-object interface */
+unsigned int uk_malloc_batch_compat(struct uk_alloc *a, __sz align, __sz size,
+				    void *obj[], unsigned int count);
+void uk_free_batch_compat(struct uk_alloc *a, void *obj[], unsigned int count);
+unsigned int uk_palloc_batch_compat(struct uk_alloc *a,
+				    unsigned long num_pages,
+				    void *obj[], unsigned int count);
+void uk_pfree_batch_compat(struct uk_alloc *a, void *obj[],
+			   unsigned long num_pages, unsigned int count);
+
 #if CONFIG_LIBUKALLOC_IFSTATS
 #include <string.h>
 #include <uk/preempt.h>
@@ -217,6 +236,10 @@ static inline void _uk_alloc_stats_count_free(struct uk_alloc_stats *stats,
 		(a)->free           = (free_f);				\
 		(a)->palloc         = uk_palloc_compat;			\
 		(a)->pfree          = uk_pfree_compat;			\
+		(a)->malloc_batch   = uk_malloc_batch_compat;		\
+		(a)->free_batch     = uk_free_batch_compat;		\
+		(a)->palloc_batch   = uk_palloc_batch_compat;		\
+		(a)->pfree_batch    = uk_pfree_batch_compat;		\
 		(a)->availmem       = (availmem_f);			\
 		(a)->pavailmem      = (availmem_f != NULL)		\
 				      ? uk_alloc_pavailmem_compat : NULL; \
@@ -243,6 +266,10 @@ static inline void _uk_alloc_stats_count_free(struct uk_alloc_stats *stats,
 		(a)->free           = uk_free_ifmalloc;			\
 		(a)->palloc         = uk_palloc_compat;			\
 		(a)->pfree          = uk_pfree_compat;			\
+		(a)->malloc_batch   = uk_malloc_batch_compat;		\
+		(a)->free_batch     = uk_free_batch_compat;		\
+		(a)->palloc_batch   = uk_palloc_batch_compat;		\
+		(a)->pfree_batch    = uk_pfree_batch_compat;		\
 		(a)->availmem       = (availmem_f);			\
 		(a)->pavailmem      = (availmem_f != NULL)		\
 				      ? uk_alloc_pavailmem_compat : NULL; \
@@ -270,6 +297,10 @@ static inline void _uk_alloc_stats_count_free(struct uk_alloc_stats *stats,
 		(a)->free           = uk_free_ifpages;			\
 		(a)->palloc         = (palloc_func);			\
 		(a)->pfree          = (pfree_func);			\
+		(a)->malloc_batch   = uk_malloc_batch_compat;		\
+		(a)->free_batch     = uk_free_batch_compat;		\
+		(a)->palloc_batch   = uk_palloc_batch_compat;		\
+		(a)->pfree_batch    = uk_pfree_batch_compat;		\
 		(a)->pavailmem      = (pavailmem_func);			\
 		(a)->availmem       = (pavailmem_func != NULL)		\
 				      ? uk_alloc_availmem_ifpages : NULL; \
@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Per-callsite allocation profiling
+ * ---------------------------------
+ * The per-library allocator wrappers (see libstats.c) sample allocations
+ * every `CONFIG_LIBUKALLOC_IFSTATS_PROFILE_INTERVAL` bytes. For each sample,
+ * the callsite of the allocation, a size histogram and, as soon as the
+ * object is released, a lifetime histogram are updated. The callsite is the
+ * return address of the allocator call, or of the libc entry point such as
+ * malloc() that forwarded the call (see `uk_alloc_profile_entry()`).
+ * A sampled allocation of `size` bytes stands for `MAX(size, interval)`
+ * allocated bytes, so that counts are estimates of the actual totals.
+ */
+
+#ifndef __UK_ALLOC_PROFILE_H__
+#define __UK_ALLOC_PROFILE_H__
+
+#include <uk/alloc.h>
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+#include <uk/plat/lcpu.h>
+#include <uk/preempt.h>
+#endif /* CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+/* Size bucket `i` counts requests of [2^i, 2^(i+1)) bytes, the last bucket
+ * all bigger requests.
+ */
+#define UK_ALLOC_PROFILE_SIZE_BUCKETS		24
+/* Lifetime bucket `i` counts objects that lived less than 10^i us, the last
+ * bucket all objects that lived longer.
+ */
+#define UK_ALLOC_PROFILE_LIFETIME_BUCKETS	10
+
+struct uk_alloc_profile_site {
+	__uptr caller;	/* return address of the allocation call */
+	__u64 calls;	/* estimated number of allocations */
+	__u64 bytes;	/* estimated number of allocated bytes */
+	__u64 samples;	/* number of sampled allocations */
+};
+
+struct uk_alloc_profile {
+	__ssz sample_left;	/* bytes to allocate until next sample */
+	__u64 nb_samples;	/* number of sampled allocations */
+	__u64 nb_dropped;	/* samples without callsite or lifetime slot */
+	__u64 size_hist[UK_ALLOC_PROFILE_SIZE_BUCKETS];
+	__u64 lifetime_hist[UK_ALLOC_PROFILE_LIFETIME_BUCKETS];
+	struct uk_alloc_profile_site sites[CONFIG_LIBUKALLOC_IFSTATS_PROFILE_CALLSITES];
+};
+
+/* Callsite of the allocation in progress on an LCPU, set by entry points
+ * that forward to the allocator on behalf of their caller; 0 otherwise
+ */
+extern UKPLAT_PER_LCPU_DEFINE(__uptr, _uk_alloc_profile_caller);
+
+/**
+ * Evaluates the allocator call `expr` on behalf of the caller of the current
+ * function: sampled allocations are attributed to the return address of
+ * the current function instead of to the function itself. Used by libc
+ * entry points like malloc(). Preemption is disabled during the call so
+ * that the callsite stays with the LCPU, as the per-library wrappers do
+ * anyway.
+ *
+ * NOTE: An allocation from interrupt context during the call picks up the
+ *       callsite as well. This only distorts the sampled statistics.
+ */
+#define uk_alloc_profile_entry(expr)					\
+	({								\
+		__uptr *__caller;					\
+		__uptr __prev;						\
+		__typeof__(expr) __ret;					\
+									\
+		uk_preempt_disable();					\
+		__caller = &ukplat_per_lcpu_current(			\
+					_uk_alloc_profile_caller);	\
+		__prev = *__caller;					\
+		*__caller = (__uptr) __builtin_return_address(0);	\
+		__ret = (expr);						\
+		*__caller = __prev;					\
+		uk_preempt_enable();					\
+		__ret;							\
+	})
+
+/* Callsite for the sample of a per-library wrapper, to be called from the
+ * wrapper itself
+ */
+#define uk_alloc_profile_caller()					\
+	(ukplat_per_lcpu_current(_uk_alloc_profile_caller)		\
+	 ?: (__uptr) __builtin_return_address(0))
+
+/* Number of sampled objects that are currently allocated */
+extern unsigned int _uk_alloc_profile_nb_live;
+
+void _uk_alloc_profile_sample(struct uk_alloc_profile *p, void *ptr,
+			      __sz size, __uptr caller);
+void _uk_alloc_profile_release(void *ptr);
+
+/**
+ * Account an allocation to a library profile. Called by the per-library
+ * allocator wrappers.
+ *
+ * @param p
+ *   Profile of the library
+ * @param ptr
+ *   Returned object, nothing is recorded for NULL
+ * @param size
+ *   Requested size in bytes
+ * @param caller
+ *   Callsite of the allocation, see `uk_alloc_profile_caller()`
+ */
+static inline void uk_alloc_profile_alloc(struct uk_alloc_profile *p,
+					  void *ptr, __sz size,
+					  __uptr caller)
+{
+	if (unlikely(!ptr))
+		return;
+
+	/* NOTE: The counter is updated without synchronization. A lost
+	 *       update only shifts the next sampling point.
+	 */
+	p->sample_left -= (__ssz) size;
+	if (likely(p->sample_left > 0))
+		return;
+	_uk_alloc_profile_sample(p, ptr, size, caller);
+}
+
+/**
+ * Account the release of an object. If the object was sampled, its lifetime
+ * is recorded to the profile of the library that allocated it.
+ *
+ * @param ptr
+ *   Released object
+ */
+static inline void uk_alloc_profile_free(void *ptr)
+{
+	if (!ptr || likely(!_uk_alloc_profile_nb_live))
+		return;
+	_uk_alloc_profile_release(ptr);
+}
+
+/**
+ * Iterate over all library profiles and callsites and rank callsites by
+ * estimated bytes and by estimated calls. The result is printed to the kernel
+ * console together with the size and lifetime histograms of each library.
+ * Callsites are printed as return addresses; use `addr2line` on the debug
+ * image for resolving them.
+ *
+ * @param klvl
+ *   Kernel log level for the output
+ * @param top
+ *   Number of callsites for each ranking
+ */
+void uk_alloc_profile_dumpk(int klvl, unsigned int top);
+
+/**
+ * Reset all library profiles. Objects that are currently sampled do not
+ * contribute to the lifetime histogram anymore.
+ */
+void uk_alloc_profile_reset(void);
+
+/**
+ * Set the sampling interval. An interval of 1 records every allocation.
+ *
+ * @param interval
+ *   Number of bytes between two samples
+ * @return
+ *   0 on success, -EINVAL for a zero interval
+ */
+int uk_alloc_profile_set_interval(__sz interval);
+
+/**
+ * @return
+ *   The current sampling interval in bytes
+ */
+__sz uk_alloc_profile_get_interval(void);
+#else /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
+#define uk_alloc_profile_entry(expr)	(expr)
+#endif /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_ALLOC_PROFILE_H__ */
@@ -18,5 +18,16 @@
 #define UK_ALLOC_STATS_CUR_MEM_USE		0x09
 #define UK_ALLOC_STATS_MAX_MEM_USE		0x0a
 #define UK_ALLOC_STATS_NUM_ENOMEM		0x0b
+#define UK_ALLOC_STATS_PROFILE_INTERVAL		0x0c
+#define UK_ALLOC_STATS_PROFILE_NUM_SAMPLES	0x0d
+#define UK_ALLOC_STATS_PROFILE_NUM_DROPPED	0x0e
+
+/* per-library profile object entry IDs */
+#define UK_ALLOC_PROFILE_CALLS			0x01
+#define UK_ALLOC_PROFILE_BYTES			0x02
+#define UK_ALLOC_PROFILE_NUM_SAMPLES		0x03
+#define UK_ALLOC_PROFILE_NUM_DROPPED		0x04
+#define UK_ALLOC_PROFILE_TOP_SITE		0x05
+#define UK_ALLOC_PROFILE_TOP_SITE_BYTES		0x06
 
 #endif /* __UK_ALLOC_STORE_H__ */
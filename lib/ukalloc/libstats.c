@@ -47,6 +47,9 @@
 #include <uk/alloc_impl.h>
 #include <uk/essentials.h>
 #include <uk/preempt.h>
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+#include <uk/alloc_profile.h>
+#endif /* CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
 
 static inline struct uk_alloc *_uk_alloc_get_actual_default(void)
 {
@@ -88,6 +91,29 @@ static inline struct uk_alloc *_uk_alloc_get_actual_default(void)
 		*(alloc_size) = 0; /* there was no new allocation */	\
 	uk_preempt_enable();
 
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+static struct uk_alloc_profile _uk_alloc_lib_profile = {
+	.sample_left = CONFIG_LIBUKALLOC_IFSTATS_PROFILE_INTERVAL,
+};
+
+/* NOTE: The wrappers are called through the allocator function table, by
+ *       `uk_malloc()` & co. that are inlined into the caller or by libc
+ *       entry points like `malloc()`. The latter announce their own caller
+ *       with `uk_alloc_profile_entry()`, otherwise the return address of the
+ *       wrapper is the allocation callsite.
+ */
+#define PROFILE_ALLOC(ptr, size)					\
+	uk_alloc_profile_alloc(&_uk_alloc_lib_profile, (ptr), (size),	\
+			       uk_alloc_profile_caller())
+#define PROFILE_FREE(ptr)						\
+	uk_alloc_profile_free(ptr)
+#else /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
+#define PROFILE_ALLOC(ptr, size)					\
+	do { } while (0)
+#define PROFILE_FREE(ptr)						\
+	do { } while (0)
+#endif /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
+
 static inline void update_stats(struct uk_alloc_stats *stats,
 				__ssz nb_allocs_diff,
 				__ssz nb_enomem_diff,
@@ -134,6 +160,7 @@ static void *wrapper_malloc(struct uk_alloc *a, __sz size)
 	/* NOTE: We record `alloc_size` only when allocation was successful */
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret != NULL ? alloc_size : 0);
+	PROFILE_ALLOC(ret, size);
 	return ret;
 }
 
@@ -156,6 +183,7 @@ static void *wrapper_calloc(struct uk_alloc *a, __sz nmemb, __sz size)
 
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret != NULL ? alloc_size : 0);
+	PROFILE_ALLOC(ret, nmemb * size);
 	return ret;
 }
 
@@ -178,6 +206,8 @@ static int wrapper_posix_memalign(struct uk_alloc *a, void **memptr,
 
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret == 0 ? alloc_size : 0);
+	if (ret == 0)
+		PROFILE_ALLOC(*memptr, size);
 	return ret;
 }
 
@@ -200,6 +230,7 @@ static void *wrapper_memalign(struct uk_alloc *a, __sz align, __sz size)
 
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret != NULL ? alloc_size : 0);
+	PROFILE_ALLOC(ret, size);
 	return ret;
 }
 
@@ -222,6 +253,10 @@ static void *wrapper_realloc(struct uk_alloc *a, void *ptr, __sz size)
 
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret != NULL ? alloc_size : 0);
+	/* `ptr` is released on success and on a resize to zero */
+	if (ret || !size)
+		PROFILE_FREE(ptr);
+	PROFILE_ALLOC(ret, size);
 	return ret;
 }
 
@@ -233,6 +268,11 @@ static void wrapper_free(struct uk_alloc *a, void *ptr)
 
 	UK_ASSERT(p);
 
+	/* NOTE: The profile must forget the object before it can be handed
+	 *       out and sampled again.
+	 */
+	PROFILE_FREE(ptr);
+
 	WATCH_STATS_START(p);
 	uk_do_free(p, ptr);
 	WATCH_STATS_END(p, &nb_allocs, &nb_enomem, &mem_use, &alloc_size);
@@ -255,6 +295,7 @@ static void *wrapper_palloc(struct uk_alloc *a, unsigned long num_pages)
 
 	update_stats(&a->_stats, nb_allocs, nb_enomem, mem_use,
 		     ret != NULL ? alloc_size : 0);
+	PROFILE_ALLOC(ret, num_pages << __PAGE_SHIFT);
 	return ret;
 }
 
@@ -267,6 +308,8 @@ static void wrapper_pfree(struct uk_alloc *a, void *ptr,
 
 	UK_ASSERT(p);
 
+	PROFILE_FREE(ptr);
+
 	WATCH_STATS_START(p);
 	uk_do_pfree(p, ptr, num_pages);
 	WATCH_STATS_END(p, &nb_allocs, &nb_enomem, &mem_use, &alloc_size);
@@ -317,6 +360,13 @@ static struct uk_alloc _uk_alloc_lib_default = {
 	.free           = wrapper_free,
 	.palloc         = wrapper_palloc,
 	.pfree          = wrapper_pfree,
+	/* NOTE: Batches are split into single requests so that the statistics
+	 *       of each allocation can be observed.
+	 */
+	.malloc_batch   = uk_malloc_batch_compat,
+	.free_batch     = uk_free_batch_compat,
+	.palloc_batch   = uk_palloc_batch_compat,
+	.pfree_batch    = uk_pfree_batch_compat,
 	.maxalloc       = wrapper_maxalloc,
 	.pmaxalloc      = uk_alloc_pmaxalloc_compat,
 	.availmem       = wrapper_availmem,
@@ -330,6 +380,9 @@ static __used __section(".uk_alloc_libstats") __align(8)
 struct uk_alloc_libstats_entry _uk_alloc_libstats_entry = {
 	.libname = STRINGIFY(__LIBNAME__),
 	.a       = &_uk_alloc_lib_default,
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE
+	.prof    = &_uk_alloc_lib_profile,
+#endif /* CONFIG_LIBUKALLOC_IFSTATS_PROFILE */
 };
 
 /* Return this wrapper allocator instead of the actual default allocator */
@@ -0,0 +1,579 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Per-callsite allocation profiling
+ * ---------------------------------
+ * The fast path (uk_alloc_profile_alloc(), uk_alloc_profile_free()) is inlined
+ * into the per-library wrappers and only counts down the bytes until the next
+ * sample. Sampled allocations are recorded here under a single lock: the
+ * callsite is accounted in an open-addressing table of the library profile
+ * and the object is remembered in a global table of live objects until it
+ * is released, so that its lifetime can be recorded.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <uk/alloc_impl.h>
+#include <uk/alloc_profile.h>
+#include <uk/alloc_store.h>
+#include <uk/arch/spinlock.h>
+#include <uk/errptr.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/print.h>
+#include <uk/store.h>
+
+#define LIVE_SLOTS	CONFIG_LIBUKALLOC_IFSTATS_PROFILE_LIVE
+#define SITE_SLOTS	CONFIG_LIBUKALLOC_IFSTATS_PROFILE_CALLSITES
+
+/* Maximum number of callsites in a ranking */
+#define DUMP_TOP_MAX	32
+
+UKPLAT_PER_LCPU_DEFINE(__uptr, _uk_alloc_profile_caller);
+
+struct live_obj {
+	__uptr ptr;			/* 0 for an empty slot */
+	__nsec born;
+	__u64 calls;			/* allocations represented by the sample */
+	struct uk_alloc_profile *p;	/* profile of the allocating library */
+};
+
+/* The live table is never filled completely so that probes terminate */
+static struct live_obj live[LIVE_SLOTS + 1];
+unsigned int _uk_alloc_profile_nb_live;
+
+static __sz prof_interval = CONFIG_LIBUKALLOC_IFSTATS_PROFILE_INTERVAL;
+static __spinlock prof_lock = UKARCH_SPINLOCK_INITIALIZER();
+
+#define prof_foreach(iter)						\
+	uk_alloc_foreach_libstats(iter)					\
+		if ((iter)->prof)
+
+static inline unsigned int prof_hash(__uptr v, unsigned int slots)
+{
+	/* Objects and return addresses have few significant low bits, so
+	 * mix the address before reducing it to a slot index.
+	 */
+	return (unsigned int) (((__u64) v * 0x9e3779b97f4a7c15ULL) >> 32)
+	       % slots;
+}
+
+static inline unsigned int size_bucket(__sz size)
+{
+	unsigned int b;
+
+	b = (unsigned int) (sizeof(unsigned long) * 8 - 1
+			    - __builtin_clzl((unsigned long) size));
+	return MIN(b, UK_ALLOC_PROFILE_SIZE_BUCKETS - 1U);
+}
+
+static inline unsigned int lifetime_bucket(__nsec lifetime)
+{
+	__nsec limit = 1000; /* 1us */
+	unsigned int b;
+
+	for (b = 0; b < UK_ALLOC_PROFILE_LIFETIME_BUCKETS - 1; b++) {
+		if (lifetime < limit)
+			break;
+		limit *= 10;
+	}
+	return b;
+}
+
+static struct uk_alloc_profile_site *site_get(struct uk_alloc_profile *p,
+					      __uptr caller)
+{
+	struct uk_alloc_profile_site *site;
+	unsigned int idx = prof_hash(caller, SITE_SLOTS);
+	unsigned int i;
+
+	for (i = 0; i < SITE_SLOTS; i++) {
+		site = &p->sites[(idx + i) % SITE_SLOTS];
+		if (site->caller == caller)
+			return site;
+		if (!site->caller) {
+			site->caller = caller;
+			return site;
+		}
+	}
+	return NULL; /* table is full */
+}
+
+static int live_find(__uptr ptr)
+{
+	unsigned int idx = prof_hash(ptr, LIVE_SLOTS + 1);
+	unsigned int i;
+
+	for (i = 0; i <= LIVE_SLOTS; i++) {
+		if (live[idx].ptr == ptr)
+			return (int) idx;
+		if (!live[idx].ptr)
+			break;
+		idx = (idx + 1) % (LIVE_SLOTS + 1);
+	}
+	return -1;
+}
+
+static int live_add(struct uk_alloc_profile *p, __uptr ptr, __nsec born,
+		    __u64 calls)
+{
+	unsigned int idx = prof_hash(ptr, LIVE_SLOTS + 1);
+
+	/* An entry for the same address is left over if the object was
+	 * released without going through a profiled wrapper: reuse it.
+	 */
+	while (live[idx].ptr && live[idx].ptr != ptr)
+		idx = (idx + 1) % (LIVE_SLOTS + 1);
+
+	if (!live[idx].ptr) {
+		if (_uk_alloc_profile_nb_live == LIVE_SLOTS)
+			return -ENOSPC;
+		_uk_alloc_profile_nb_live++;
+	}
+
+	live[idx].ptr   = ptr;
+	live[idx].born  = born;
+	live[idx].calls = calls;
+	live[idx].p     = p;
+	return 0;
+}
+
+/* Remove a slot with backward shift deletion (no tombstones) */
+static void live_del(unsigned int i)
+{
+	unsigned int j = i;
+	unsigned int k;
+
+	for (;;) {
+		live[i].ptr = 0;
+		for (;;) {
+			j = (j + 1) % (LIVE_SLOTS + 1);
+			if (!live[j].ptr)
+				goto out;
+			k = prof_hash(live[j].ptr, LIVE_SLOTS + 1);
+			/* Keep entry j in place if its home slot k lies
+			 * cyclically in (i, j]
+			 */
+			if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+				continue;
+			break;
+		}
+		live[i] = live[j];
+		i = j;
+	}
+out:
+	_uk_alloc_profile_nb_live--;
+}
+
+void _uk_alloc_profile_sample(struct uk_alloc_profile *p, void *ptr,
+			      __sz size, __uptr caller)
+{
+	struct uk_alloc_profile_site *site;
+	unsigned long flags;
+	__sz interval;
+	__u64 calls;
+	__sz bytes;
+	__nsec now;
+	int dropped = 0;
+
+	now = ukplat_monotonic_clock();
+	size = MAX(size, (__sz) 1);
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&prof_lock);
+
+	/* Another lcpu may have taken this sample in the meantime */
+	if (unlikely(p->sample_left > 0))
+		goto out;
+
+	/* A sample stands for all bytes that were allocated since the last
+	 * one. Allocations bigger than the interval are always sampled and
+	 * represent only themselves.
+	 */
+	interval = prof_interval;
+	bytes = MAX(size, interval);
+	calls = bytes / size;
+	p->sample_left = (__ssz) interval;
+
+	p->nb_samples++;
+	p->size_hist[size_bucket(size)] += calls;
+
+	site = site_get(p, caller);
+	if (likely(site)) {
+		site->calls += calls;
+		site->bytes += bytes;
+		site->samples++;
+	} else {
+		dropped = 1;
+	}
+
+	if (unlikely(live_add(p, (__uptr) ptr, now, calls)))
+		dropped = 1;
+	p->nb_dropped += dropped;
+
+out:
+	ukarch_spin_unlock(&prof_lock);
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+void _uk_alloc_profile_release(void *ptr)
+{
+	struct live_obj *obj;
+	unsigned int idx = prof_hash((__uptr) ptr, LIVE_SLOTS + 1);
+	unsigned long flags;
+	unsigned int i;
+	__uptr cur;
+	__nsec now;
+	int slot;
+
+	/* Most released objects were not sampled. Probe the table without
+	 * the lock first. A concurrent deletion may hide an entry from this
+	 * probe, which only costs a lifetime sample.
+	 */
+	for (i = 0; i <= LIVE_SLOTS; i++) {
+		cur = *((volatile __uptr *) &live[idx].ptr);
+		if (!cur)
+			return;
+		if (cur == (__uptr) ptr)
+			break;
+		idx = (idx + 1) % (LIVE_SLOTS + 1);
+	}
+	if (i > LIVE_SLOTS)
+		return;
+
+	now = ukplat_monotonic_clock();
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&prof_lock);
+	slot = live_find((__uptr) ptr);
+	if (slot >= 0) {
+		obj = &live[slot];
+		obj->p->lifetime_hist[lifetime_bucket(now - obj->born)] +=
+			obj->calls;
+		live_del((unsigned int) slot);
+	}
+	ukarch_spin_unlock(&prof_lock);
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+void uk_alloc_profile_reset(void)
+{
+	struct uk_alloc_libstats_entry *iter;
+	unsigned long flags;
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&prof_lock);
+	prof_foreach(iter) {
+		memset(iter->prof, 0, sizeof(*iter->prof));
+		iter->prof->sample_left = (__ssz) prof_interval;
+	}
+	memset(live, 0, sizeof(live));
+	_uk_alloc_profile_nb_live = 0;
+	ukarch_spin_unlock(&prof_lock);
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+int uk_alloc_profile_set_interval(__sz interval)
+{
+	struct uk_alloc_libstats_entry *iter;
+
+	if (unlikely(!interval))
+		return -EINVAL;
+
+	prof_interval = interval;
+	prof_foreach(iter) {
+		if (iter->prof->sample_left > (__ssz) interval)
+			iter->prof->sample_left = (__ssz) interval;
+	}
+	return 0;
+}
+
+__sz uk_alloc_profile_get_interval(void)
+{
+	return prof_interval;
+}
+
+struct rank {
+	const char *libname;
+	const struct uk_alloc_profile_site *site;
+};
+
+static inline __u64 rank_value(const struct uk_alloc_profile_site *site,
+			       int by_bytes)
+{
+	return by_bytes ? site->bytes : site->calls;
+}
+
+/* Insertion sort of all callsites into the (descending) top list */
+static unsigned int rank_sites(struct rank *r, unsigned int top,
+			       int by_bytes)
+{
+	struct uk_alloc_libstats_entry *iter;
+	const struct uk_alloc_profile_site *site;
+	unsigned int nr = 0;
+	unsigned int i, j;
+	__u64 val;
+
+	prof_foreach(iter) {
+		for (i = 0; i < SITE_SLOTS; i++) {
+			site = &iter->prof->sites[i];
+			if (!site->caller)
+				continue;
+
+			val = rank_value(site, by_bytes);
+			if (nr == top && val <= rank_value(r[nr - 1].site,
+							   by_bytes))
+				continue;
+
+			j = (nr < top) ? nr++ : nr - 1;
+			for (; j > 0; j--) {
+				if (rank_value(r[j - 1].site, by_bytes) >= val)
+					break;
+				r[j] = r[j - 1];
+			}
+			r[j].libname = iter->libname;
+			r[j].site = site;
+		}
+	}
+	return nr;
+}
+
+static void dumpk_ranking(int klvl, unsigned int top, int by_bytes)
+{
+	struct rank r[DUMP_TOP_MAX];
+	unsigned int nr, i;
+
+	nr = rank_sites(r, top, by_bytes);
+	uk_printk(klvl, "Top %u callsites by %s:\n",
+		  nr, by_bytes ? "bytes" : "calls");
+	for (i = 0; i < nr; i++) {
+		uk_printk(klvl,
+			  " %2u. %-20s %p: %"__PRIu64" B, %"__PRIu64" calls, "
+			  "avg %"__PRIu64" B (%"__PRIu64" samples)\n",
+			  i + 1, r[i].libname, (void *) r[i].site->caller,
+			  r[i].site->bytes, r[i].site->calls,
+			  r[i].site->calls ? r[i].site->bytes / r[i].site->calls
+					   : 0,
+			  r[i].site->samples);
+	}
+}
+
+static void dumpk_histograms(int klvl, const char *libname,
+			     const struct uk_alloc_profile *p)
+{
+	__u64 limit;
+	unsigned int b;
+
+	uk_printk(klvl, "%s: %"__PRIu64" samples, %"__PRIu64" dropped\n",
+		  libname, p->nb_samples, p->nb_dropped);
+
+	for (b = 0; b < UK_ALLOC_PROFILE_SIZE_BUCKETS; b++) {
+		if (!p->size_hist[b])
+			continue;
+		if (b < UK_ALLOC_PROFILE_SIZE_BUCKETS - 1)
+			uk_printk(klvl, "  size [%lu, %lu): %"__PRIu64" calls\n",
+				  1UL << b, 1UL << (b + 1), p->size_hist[b]);
+		else
+			uk_printk(klvl, "  size >= %lu: %"__PRIu64" calls\n",
+				  1UL << b, p->size_hist[b]);
+	}
+
+	limit = 1;
+	for (b = 0; b < UK_ALLOC_PROFILE_LIFETIME_BUCKETS; b++) {
+		if (p->lifetime_hist[b]) {
+			if (b < UK_ALLOC_PROFILE_LIFETIME_BUCKETS - 1)
+				uk_printk(klvl,
+					  "  lifetime < %"__PRIu64" us: %"__PRIu64" calls\n",
+					  limit, p->lifetime_hist[b]);
+			else
+				uk_printk(klvl,
+					  "  lifetime >= %"__PRIu64" us: %"__PRIu64" calls\n",
+					  limit / 10, p->lifetime_hist[b]);
+		}
+		limit *= 10;
+	}
+}
+
+void uk_alloc_profile_dumpk(int klvl, unsigned int top)
+{
+	struct uk_alloc_libstats_entry *iter;
+
+	top = MIN(top, (unsigned int) DUMP_TOP_MAX);
+
+	uk_printk(klvl,
+		  "Allocation profile (interval: %"__PRIsz" B, live samples: %u):\n",
+		  prof_interval, _uk_alloc_profile_nb_live);
+	if (top) {
+		dumpk_ranking(klvl, top, 1);
+		dumpk_ranking(klvl, top, 0);
+	}
+	prof_foreach(iter) {
+		if (iter->prof->nb_samples)
+			dumpk_histograms(klvl, iter->libname, iter->prof);
+	}
+}
+
+/*
+ * ukstore
+ */
+static int get_interval(void *cookie __unused, __u64 *out)
+{
+	*out = (__u64) prof_interval;
+	return 0;
+}
+
+static int set_interval(void *cookie __unused, __u64 val)
+{
+	return uk_alloc_profile_set_interval((__sz) val);
+}
+UK_STORE_STATIC_ENTRY(UK_ALLOC_STATS_PROFILE_INTERVAL, profile_interval, u64,
+		      get_interval, set_interval);
+
+static int get_nb_samples(void *cookie __unused, __u64 *out)
+{
+	struct uk_alloc_libstats_entry *iter;
+
+	*out = 0;
+	prof_foreach(iter)
+		*out += iter->prof->nb_samples;
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_ALLOC_STATS_PROFILE_NUM_SAMPLES, profile_nb_samples,
+		      u64, get_nb_samples, NULL);
+
+static int get_nb_dropped(void *cookie __unused, __u64 *out)
+{
+	struct uk_alloc_libstats_entry *iter;
+
+	*out = 0;
+	prof_foreach(iter)
+		*out += iter->prof->nb_dropped;
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_ALLOC_STATS_PROFILE_NUM_DROPPED, profile_nb_dropped,
+		      u64, get_nb_dropped, NULL);
+
+#if CONFIG_LIBUKSTORE
+static const struct uk_alloc_profile_site *
+top_site(const struct uk_alloc_profile *p)
+{
+	const struct uk_alloc_profile_site *top = NULL;
+	unsigned int i;
+
+	for (i = 0; i < SITE_SLOTS; i++) {
+		if (p->sites[i].caller &&
+		    (!top || p->sites[i].bytes > top->bytes))
+			top = &p->sites[i];
+	}
+	return top;
+}
+
+static int get_lib_calls(void *cookie, __u64 *out)
+{
+	const struct uk_alloc_profile *p = cookie;
+	unsigned int i;
+
+	*out = 0;
+	for (i = 0; i < SITE_SLOTS; i++)
+		*out += p->sites[i].calls;
+	return 0;
+}
+
+static int get_lib_bytes(void *cookie, __u64 *out)
+{
+	const struct uk_alloc_profile *p = cookie;
+	unsigned int i;
+
+	*out = 0;
+	for (i = 0; i < SITE_SLOTS; i++)
+		*out += p->sites[i].bytes;
+	return 0;
+}
+
+static int get_lib_nb_samples(void *cookie, __u64 *out)
+{
+	*out = ((const struct uk_alloc_profile *) cookie)->nb_samples;
+	return 0;
+}
+
+static int get_lib_nb_dropped(void *cookie, __u64 *out)
+{
+	*out = ((const struct uk_alloc_profile *) cookie)->nb_dropped;
+	return 0;
+}
+
+static int get_lib_top_site(void *cookie, __uptr *out)
+{
+	const struct uk_alloc_profile_site *site = top_site(cookie);
+
+	*out = site ? site->caller : 0;
+	return 0;
+}
+
+static int get_lib_top_site_bytes(void *cookie, __u64 *out)
+{
+	const struct uk_alloc_profile_site *site = top_site(cookie);
+
+	*out = site ? site->bytes : 0;
+	return 0;
+}
+
+static const struct uk_store_entry *prof_entries[] = {
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_CALLS, calls, u64,
+		       get_lib_calls, NULL),
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_BYTES, bytes, u64,
+		       get_lib_bytes, NULL),
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_NUM_SAMPLES, nb_samples, u64,
+		       get_lib_nb_samples, NULL),
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_NUM_DROPPED, nb_dropped, u64,
+		       get_lib_nb_dropped, NULL),
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_TOP_SITE, top_site, uptr,
+		       get_lib_top_site, NULL),
+	UK_STORE_ENTRY(UK_ALLOC_PROFILE_TOP_SITE_BYTES, top_site_bytes, u64,
+		       get_lib_top_site_bytes, NULL),
+	NULL
+};
+
+/* Export one object per library profile, named after the library */
+static int prof_store_init(struct uk_init_ctx *ictx __unused)
+{
+	struct uk_alloc_libstats_entry *iter;
+	struct uk_store_object *obj;
+	__u64 id = 0;
+	int rc;
+
+	prof_foreach(iter) {
+		obj = uk_store_obj_alloc(uk_alloc_get_default(), id++,
+					 iter->libname, prof_entries,
+					 iter->prof);
+		if (unlikely(PTRISERR(obj)))
+			return PTR2ERR(obj);
+
+		rc = uk_store_obj_add(obj);
+		if (unlikely(rc))
+			return rc;
+	}
+	return 0;
+}
+#else /* !CONFIG_LIBUKSTORE */
+#define prof_store_init 0x0
+#endif /* !CONFIG_LIBUKSTORE */
+
+#if CONFIG_LIBUKALLOC_IFSTATS_PROFILE_DUMP
+static void prof_dump_term(const struct uk_term_ctx *tctx __unused)
+{
+	uk_alloc_profile_dumpk(KLVL_INFO, DUMP_TOP_MAX);
+}
+#else /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE_DUMP */
+#define prof_dump_term 0x0
+#endif /* !CONFIG_LIBUKALLOC_IFSTATS_PROFILE_DUMP */
+
+#if CONFIG_LIBUKSTORE || CONFIG_LIBUKALLOC_IFSTATS_PROFILE_DUMP
+uk_late_initcall(prof_store_init, prof_dump_term);
+#endif /* CONFIG_LIBUKSTORE || CONFIG_LIBUKALLOC_IFSTATS_PROFILE_DUMP */
@@ -81,6 +81,8 @@ struct uk_bbpalloc_memr {
 
 struct uk_bbpalloc {
 	unsigned long nr_free_pages;
+	unsigned long free_orders; /* bit i set => free_head[i] not empty */
+	unsigned long nr_free_chunks[FREELIST_SIZE];
 	chunk_head_t *free_head[FREELIST_SIZE];
 	chunk_head_t free_tail[FREELIST_SIZE];
 	struct uk_bbpalloc_memr *memr_head;
@@ -143,15 +145,15 @@ for (size_t i = 0; i < FREELIST_SIZE; i++) { \
 #endif /* CONFIG_LIBUKALLOCBBUDDY_FREELIST_SANITY */
 
 /*********************
- * ALLOCATION BITMAP
- *  One bit per page of memory. Bit set => page is allocated.
+ * FREE CHUNK BITMAP
+ *  One bit per page of memory. Bit cleared => page is the first page of a
+ *  free chunk. Pages that are allocated or that are not the first page of a
+ *  free chunk have their bit set.
  *
- * Hint regarding bitwise arithmetic in map_{alloc,free}:
- *  -(1<<n)  sets all bits >= n.
- *  (1<<n)-1 sets all bits <  n.
- * Variable names in map_{alloc,free}:
- *  *_idx == Index into `mm_alloc_bitmap' array.
- *  *_off == Bit offset within an element of the `mm_alloc_bitmap' array.
+ *  Two buddies can only be merged if the buddy of a freed chunk is itself a
+ *  free chunk of the same order. Tracking the first page of each free chunk
+ *  is thus sufficient and keeps bitmap updates O(1), independent of the size
+ *  of the chunk.
  */
 #define BITS_PER_BYTE       8
 #define BYTES_PER_MAPWORD   (sizeof(unsigned long))
@@ -180,98 +182,111 @@ static inline struct uk_bbpalloc_memr *map_get_memr(struct uk_bbpalloc *b,
 	return NULL;
 }
 
-static inline unsigned long allocated_in_map(struct uk_bbpalloc *b,
-				   unsigned long page_va)
+static inline unsigned long *map_get_word(struct uk_bbpalloc_memr *memr,
+					  unsigned long page_va,
+					  unsigned long *bm_mask)
 {
-	struct uk_bbpalloc_memr *memr = map_get_memr(b, page_va);
 	unsigned long page_idx;
-	unsigned long bm_idx, bm_off;
+
+	page_idx = (page_va - memr->first_page) >> __PAGE_SHIFT;
+	*bm_mask = 1UL << (page_idx & (PAGES_PER_MAPWORD - 1));
+	return &memr->mm_alloc_bitmap[page_idx / PAGES_PER_MAPWORD];
+}
+
+static inline int map_is_free_chunk(struct uk_bbpalloc *b,
+				    unsigned long page_va)
+{
+	struct uk_bbpalloc_memr *memr = map_get_memr(b, page_va);
+	unsigned long bm_mask;
 
 	/* treat pages outside of region as allocated */
 	if (!memr)
-		return 1;
+		return 0;
 
-	page_idx = (page_va - memr->first_page) >> __PAGE_SHIFT;
-	bm_idx = page_idx / PAGES_PER_MAPWORD;
-	bm_off = page_idx & (PAGES_PER_MAPWORD - 1);
+	return !(*map_get_word(memr, page_va, &bm_mask) & bm_mask);
+}
 
-	return ((memr)->mm_alloc_bitmap[bm_idx] & (1UL << bm_off));
+/* Whether the page is part of a free chunk. A chunk of order i starts at
+ * the page address aligned down to its size, so only one candidate head per
+ * order needs to be checked.
+ */
+static inline int map_in_free_chunk(struct uk_bbpalloc *b,
+				    unsigned long page_va)
+{
+	unsigned long head;
+	unsigned int order;
+
+	for (order = 0; order < FREELIST_SIZE; order++) {
+		head = page_va & ~((1UL << (order + __PAGE_SHIFT)) - 1);
+		if (map_is_free_chunk(b, head) &&
+		    ((chunk_head_t *)head)->level == order)
+			return 1;
+	}
+	return 0;
 }
 
-static void map_alloc(struct uk_bbpalloc *b, uintptr_t first_page,
-		      unsigned long nr_pages)
+static inline void map_set_free_chunk(struct uk_bbpalloc *b,
+				      unsigned long page_va, int is_free)
 {
 	struct uk_bbpalloc_memr *memr;
-	unsigned long first_page_idx, end_page_idx;
-	unsigned long start_off, end_off, curr_idx, end_idx;
+	unsigned long bm_mask;
+	unsigned long *bm_word;
 
 	/*
 	 * In case there was no memory region found, the allocator
 	 * is in a really bad state. It means that the specified page
-	 * region is not covered by our allocator.
+	 * is not covered by our allocator.
 	 */
-	memr = map_get_memr(b, first_page);
+	memr = map_get_memr(b, page_va);
 	UK_ASSERT(memr != NULL);
-	UK_ASSERT((first_page + (nr_pages << __PAGE_SHIFT))
-		  <= (memr->first_page + (memr->nr_pages << __PAGE_SHIFT)));
-
-	first_page -= memr->first_page;
-	first_page_idx = first_page >> __PAGE_SHIFT;
-	curr_idx = first_page_idx / PAGES_PER_MAPWORD;
-	start_off = first_page_idx & (PAGES_PER_MAPWORD - 1);
-	end_page_idx = first_page_idx + nr_pages;
-	end_idx = end_page_idx / PAGES_PER_MAPWORD;
-	end_off = end_page_idx & (PAGES_PER_MAPWORD - 1);
-
-	if (curr_idx == end_idx) {
-		memr->mm_alloc_bitmap[curr_idx] |=
-		    ((1UL << end_off) - 1) & -(1UL << start_off);
-	} else {
-		memr->mm_alloc_bitmap[curr_idx] |= -(1UL << start_off);
-		while (++curr_idx < end_idx)
-			memr->mm_alloc_bitmap[curr_idx] = ~0UL;
-		memr->mm_alloc_bitmap[curr_idx] |= (1UL << end_off) - 1;
-	}
 
-	b->nr_free_pages -= nr_pages;
+	bm_word = map_get_word(memr, page_va, &bm_mask);
+	if (is_free)
+		*bm_word &= ~bm_mask;
+	else
+		*bm_word |= bm_mask;
 }
 
-static void map_free(struct uk_bbpalloc *b, uintptr_t first_page,
-		     unsigned long nr_pages)
+/*********************
+ * FREE LISTS
+ *  Besides the lists, the number of free chunks of each order is counted.
+ *  `free_orders` has bit i set if there is at least one free chunk of order
+ *  i so that the smallest fitting and the biggest available order can be
+ *  found with a single bit scan.
+ */
+static inline void freelist_add(struct uk_bbpalloc *b, chunk_head_t *ch,
+				unsigned int order)
 {
-	struct uk_bbpalloc_memr *memr;
-	unsigned long first_page_idx, end_page_idx;
-	unsigned long start_off, end_off, curr_idx, end_idx;
+	chunk_tail_t *ct;
 
-	/*
-	 * In case there was no memory region found, the allocator
-	 * is in a really bad state. It means that the specified page
-	 * region is not covered by our allocator.
-	 */
-	memr = map_get_memr(b, first_page);
-	UK_ASSERT(memr != NULL);
-	UK_ASSERT((first_page + (nr_pages << __PAGE_SHIFT))
-		  <= (memr->first_page + (memr->nr_pages << __PAGE_SHIFT)));
-
-	first_page -= memr->first_page;
-	first_page_idx = first_page >> __PAGE_SHIFT;
-	curr_idx = first_page_idx / PAGES_PER_MAPWORD;
-	start_off = first_page_idx & (PAGES_PER_MAPWORD - 1);
-	end_page_idx = first_page_idx + nr_pages;
-	end_idx = end_page_idx / PAGES_PER_MAPWORD;
-	end_off = end_page_idx & (PAGES_PER_MAPWORD - 1);
-
-	if (curr_idx == end_idx) {
-		memr->mm_alloc_bitmap[curr_idx] &=
-		    -(1UL << end_off) | ((1UL << start_off) - 1);
-	} else {
-		memr->mm_alloc_bitmap[curr_idx] &= (1UL << start_off) - 1;
-		while (++curr_idx != end_idx)
-			memr->mm_alloc_bitmap[curr_idx] = 0;
-		memr->mm_alloc_bitmap[curr_idx] &= -(1UL << end_off);
-	}
+	ct = (chunk_tail_t *)((char *)ch + (1UL << (order + __PAGE_SHIFT))) - 1;
+
+	ch->level = order;
+	ch->next = b->free_head[order];
+	ch->pprev = &b->free_head[order];
+	ct->level = order;
+
+	ch->next->pprev = &ch->next;
+	b->free_head[order] = ch;
+
+	b->nr_free_chunks[order]++;
+	b->free_orders |= 1UL << order;
+	map_set_free_chunk(b, (unsigned long)ch, 1);
+}
+
+static inline void freelist_del(struct uk_bbpalloc *b, chunk_head_t *ch)
+{
+	unsigned int order = ch->level;
 
-	b->nr_free_pages += nr_pages;
+	UK_ASSERT(order < FREELIST_SIZE);
+	UK_ASSERT(b->nr_free_chunks[order] > 0);
+
+	*(ch->pprev) = ch->next;
+	ch->next->pprev = ch->pprev;
+
+	if (--b->nr_free_chunks[order] == 0)
+		b->free_orders &= ~(1UL << order);
+	map_set_free_chunk(b, (unsigned long)ch, 0);
 }
 
 /* return log of the next power of two of passed number */
@@ -298,8 +313,8 @@ static void *bbuddy_palloc(struct uk_alloc *a, unsigned long num_pages)
 {
 	struct uk_bbpalloc *b;
 	size_t i;
+	unsigned long avail;
 	chunk_head_t *alloc_ch, *spare_ch;
-	chunk_tail_t *spare_ct;
 
 	UK_ASSERT(a != NULL);
 	b = (struct uk_bbpalloc *)&a->priv;
@@ -309,17 +324,16 @@ static void *bbuddy_palloc(struct uk_alloc *a, unsigned long num_pages)
 	size_t order = (size_t)num_pages_to_order(num_pages);
 
 	/* Find smallest order which can satisfy the request. */
-	for (i = order; i < FREELIST_SIZE; i++) {
-		if (!FREELIST_EMPTY(b->free_head[i]))
-			break;
-	}
-	if (i >= FREELIST_SIZE)
+	if (unlikely(order >= FREELIST_SIZE))
+		goto no_memory;
+	avail = b->free_orders & (~0UL << order);
+	if (!avail)
 		goto no_memory;
+	i = uk_ffsl(avail);
 
 	/* Unlink a chunk. */
 	alloc_ch = b->free_head[i];
-	b->free_head[i] = alloc_ch->next;
-	alloc_ch->next->pprev = alloc_ch->pprev;
+	freelist_del(b, alloc_ch);
 
 	/* We may have to break the chunk a number of times. */
 	while (i != order) {
@@ -327,21 +341,12 @@ static void *bbuddy_palloc(struct uk_alloc *a, unsigned long num_pages)
 		i--;
 		spare_ch = (chunk_head_t *)((char *)alloc_ch
 					    + (1UL << (i + __PAGE_SHIFT)));
-		spare_ct = (chunk_tail_t *)((char *)spare_ch
-					    + (1UL << (i + __PAGE_SHIFT))) - 1;
-
-		/* Create new header for spare chunk. */
-		spare_ch->level = i;
-		spare_ch->next = b->free_head[i];
-		spare_ch->pprev = &b->free_head[i];
-		spare_ct->level = i;
 
 		/* Link in the spare chunk. */
-		spare_ch->next->pprev = &spare_ch->next;
-		b->free_head[i] = spare_ch;
+		freelist_add(b, spare_ch, i);
 	}
 	UK_ASSERT(FREELIST_ALIGNED(alloc_ch, order));
-	map_alloc(b, (uintptr_t)alloc_ch, 1UL << order);
+	b->nr_free_pages -= 1UL << order;
 
 	uk_alloc_stats_count_palloc(a, (void *) alloc_ch, num_pages);
 	freelist_sanitycheck(b->free_head);
@@ -360,7 +365,6 @@ static void bbuddy_pfree(struct uk_alloc *a, void *obj, unsigned long num_pages)
 {
 	struct uk_bbpalloc *b;
 	chunk_head_t *freed_ch, *to_merge_ch;
-	chunk_tail_t *freed_ct;
 	unsigned long mask;
 
 	UK_ASSERT(a != NULL);
@@ -374,74 +378,136 @@ static void bbuddy_pfree(struct uk_alloc *a, void *obj, unsigned long num_pages)
 
 	/* if the object is not page aligned it was clearly not from us */
 	UK_ASSERT((((uintptr_t)obj) & (__PAGE_SIZE - 1)) == 0);
+	/* the chunk must not be free already, also not as part of a chunk
+	 * that it was merged into
+	 */
+	UK_ASSERT(!map_in_free_chunk(b, (uintptr_t)obj));
 
-	/* First free the chunk */
-	map_free(b, (uintptr_t)obj, 1UL << order);
-
-	/* Create free chunk */
+	b->nr_free_pages += 1UL << order;
 	freed_ch = (chunk_head_t *)obj;
-	freed_ct = (chunk_tail_t *)((char *)obj
-				    + (1UL << (order + __PAGE_SHIFT))) - 1;
 
 	/* Now, possibly we can conseal chunks together */
-	while (order < FREELIST_SIZE) {
+	while (order < FREELIST_SIZE - 1) {
 		mask = 1UL << (order + __PAGE_SHIFT);
-		if ((unsigned long)freed_ch & mask) {
-			to_merge_ch = (chunk_head_t *)((char *)freed_ch - mask);
-			if (allocated_in_map(b, (uintptr_t)to_merge_ch)
-			    || to_merge_ch->level != order)
-				break;
-
-			/* Merge with predecessor */
-			freed_ch = to_merge_ch;
-		} else {
-			to_merge_ch = (chunk_head_t *)((char *)freed_ch + mask);
-			if (allocated_in_map(b, (uintptr_t)to_merge_ch)
-			    || to_merge_ch->level != order)
-				break;
-
-			/* Merge with successor */
-			freed_ct =
-			    (chunk_tail_t *)((char *)to_merge_ch + mask) - 1;
-		}
+		to_merge_ch = (chunk_head_t *)((uintptr_t)freed_ch ^ mask);
+		if (!map_is_free_chunk(b, (uintptr_t)to_merge_ch)
+		    || to_merge_ch->level != order)
+			break;
 
 		/* We are commited to merging, unlink the chunk */
-		*(to_merge_ch->pprev) = to_merge_ch->next;
-		to_merge_ch->next->pprev = to_merge_ch->pprev;
+		freelist_del(b, to_merge_ch);
+
+		/* Merge with predecessor */
+		if ((uintptr_t)to_merge_ch < (uintptr_t)freed_ch)
+			freed_ch = to_merge_ch;
 
 		order++;
 	}
 
 	/* Link the new chunk */
-	freed_ch->level = order;
-	freed_ch->next = b->free_head[order];
-	freed_ch->pprev = &b->free_head[order];
-	freed_ct->level = order;
+	freelist_add(b, freed_ch, order);
 
-	freed_ch->next->pprev = &freed_ch->next;
-	b->free_head[order] = freed_ch;
+	freelist_sanitycheck(b->free_head);
+}
 
+/* Takes up to `n` chunks of `order` from the free chunk `ch` of order `i`
+ * and puts the rest back onto the free lists, as chunks as large as
+ * possible. Returns the number of chunks taken.
+ */
+static unsigned int chunk_carve(struct uk_bbpalloc *b, chunk_head_t *ch,
+				size_t i, size_t order, void *obj[],
+				unsigned int n)
+{
+	unsigned long nr = 1UL << (i - order);
+	unsigned long j;
+	unsigned int taken;
+
+	if (!n) {
+		freelist_add(b, ch, i);
+		return 0;
+	}
+	if (n >= nr) {
+		for (j = 0; j < nr; j++)
+			obj[j] = (char *)ch + (j << (order + __PAGE_SHIFT));
+		return (unsigned int)nr;
+	}
+
+	/* Split, the lower half is used first */
+	taken = chunk_carve(b, ch, i - 1, order, obj, n);
+	ch = (chunk_head_t *)((char *)ch + (1UL << (i - 1 + __PAGE_SHIFT)));
+	return taken + chunk_carve(b, ch, i - 1, order, obj + taken,
+				   n - taken);
+}
+
+/* Takes free chunks of the requested order first. Larger chunks are split
+ * only once into all the pieces that are needed, instead of splitting off
+ * and re-linking a buddy for every page.
+ */
+static unsigned int bbuddy_palloc_batch(struct uk_alloc *a,
+					unsigned long num_pages,
+					void *obj[], unsigned int count)
+{
+	struct uk_bbpalloc *b;
+	unsigned int taken = 0, j;
+	chunk_head_t *ch;
+	unsigned long avail;
+	size_t order, i;
+
+	UK_ASSERT(a != NULL);
+	b = (struct uk_bbpalloc *)&a->priv;
+
+	freelist_sanitycheck(b->free_head);
+
+	order = (size_t)num_pages_to_order(num_pages);
+	if (unlikely(order >= FREELIST_SIZE))
+		goto out;
+
+	while (taken < count) {
+		while (taken < count && (b->free_orders & (1UL << order))) {
+			ch = b->free_head[order];
+			freelist_del(b, ch);
+			obj[taken++] = ch;
+		}
+		if (taken == count)
+			break;
+
+		avail = b->free_orders & (~0UL << order);
+		if (!avail)
+			break;
+		i = uk_ffsl(avail);
+		ch = b->free_head[i];
+		freelist_del(b, ch);
+		taken += chunk_carve(b, ch, i, order, &obj[taken],
+				     count - taken);
+	}
+	b->nr_free_pages -= (unsigned long)taken << order;
+
+	for (j = 0; j < taken; j++) {
+		UK_ASSERT(FREELIST_ALIGNED(obj[j], order));
+		uk_alloc_stats_count_palloc(a, obj[j], num_pages);
+	}
 	freelist_sanitycheck(b->free_head);
+
+out:
+	if (unlikely(taken < count)) {
+		uk_alloc_stats_count_penomem(a, num_pages);
+		errno = ENOMEM;
+	}
+	return taken;
 }
 
 static long bbuddy_pmaxalloc(struct uk_alloc *a)
 {
 	struct uk_bbpalloc *b;
-	size_t i, order;
 
 	UK_ASSERT(a != NULL);
 	b = (struct uk_bbpalloc *)&a->priv;
 
 	/* Find biggest order that has still elements available */
-	order = FREELIST_SIZE;
-	for (i = 0; i < FREELIST_SIZE; i++) {
-		if (!FREELIST_EMPTY(b->free_head[i]))
-			order = i;
-	}
-	if (order == FREELIST_SIZE)
+	if (!b->free_orders)
 		return 0; /* no memory left */
 
-	return (long) (1 << order);
+	return 1L << uk_flsl(b->free_orders);
 }
 
 static long bbuddy_pavailmem(struct uk_alloc *a)
@@ -461,7 +527,6 @@ static int bbuddy_addmem(struct uk_alloc *a, void *base, size_t len)
 	size_t memr_size;
 	unsigned long i;
 	chunk_head_t *ch;
-	chunk_tail_t *ct;
 	uintptr_t min, max, range;
 
 	UK_ASSERT(a != NULL);
@@ -520,12 +585,12 @@ static int bbuddy_addmem(struct uk_alloc *a, void *base, size_t len)
 	memr->next = b->memr_head;
 	b->memr_head = memr;
 
-	/* All allocated by default. */
+	/* No free chunks by default. */
 	memset(memr->mm_alloc_bitmap, (unsigned char) ~0,
 			memr->mm_alloc_bitmap_size);
 
 	/* free up the memory we've been given to play with */
-	map_free(b, min, memr->nr_pages);
+	b->nr_free_pages += memr->nr_pages;
 
 	while (range != 0) {
 		/*
@@ -543,14 +608,7 @@ static int bbuddy_addmem(struct uk_alloc *a, void *base, size_t len)
 		ch = (chunk_head_t *)min;
 		min += 1UL << i;
 		range -= 1UL << i;
-		ct = (chunk_tail_t *)min - 1;
-		i -= __PAGE_SHIFT;
-		ch->level = i;
-		ch->next = b->free_head[i];
-		ch->pprev = &b->free_head[i];
-		ch->next->pprev = &ch->next;
-		b->free_head[i] = ch;
-		ct->level = i;
+		freelist_add(b, ch, i - __PAGE_SHIFT);
 	}
 
 	freelist_sanitycheck(b->free_head);
@@ -598,6 +656,7 @@ struct uk_alloc *uk_allocbbuddy_init(void *base, size_t len)
 	uk_alloc_init_palloc(a, bbuddy_palloc, bbuddy_pfree,
 			     bbuddy_pmaxalloc, bbuddy_pavailmem,
 			     bbuddy_addmem);
+	a->palloc_batch = bbuddy_palloc_batch;
 
 	if (max > min) {
 		/* add left memory - ignore return value */
@@ -0,0 +1,290 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <uk/test.h>
+#include <uk/alloc_impl.h>
+#include <uk/allocbbuddy.h>
+#include <uk/bitops.h>
+#include <uk/essentials.h>
+#include <uk/plat/time.h>
+
+#define HEAP_PAGES	4096
+#define NR_OPS		256
+
+/* Mixed-order stress: allocations of up to 2^STRESS_ORDER_MAX pages */
+#define STRESS_ORDER_MAX	6
+#define STRESS_SLOTS		256
+#define STRESS_OPS		16384
+
+static void *pages[HEAP_PAGES];
+
+static struct {
+	void *p;
+	unsigned long num_pages;
+} slots[STRESS_SLOTS];
+
+/* All allocators register themselves and cannot be unregistered, so the
+ * test cases share a single buddy allocator on a heap that is taken from
+ * the default allocator.
+ */
+static struct uk_alloc *test_bbuddy(void)
+{
+	static struct uk_alloc *a;
+	void *heap;
+
+	if (!a) {
+		heap = uk_palloc(uk_alloc_get_default(), HEAP_PAGES);
+		if (heap)
+			a = uk_allocbbuddy_init(heap,
+						HEAP_PAGES * __PAGE_SIZE);
+	}
+	return a;
+}
+
+/* Allocating all memory page by page and freeing it again must merge the
+ * buddies back into the initial chunks
+ */
+UK_TESTCASE(ukallocbbuddy, alloc_all_and_merge)
+{
+	struct uk_alloc *a = test_bbuddy();
+	long avail, maxalloc;
+	unsigned int i, n;
+
+	UK_TEST_ASSERT(a != NULL);
+
+	avail = uk_alloc_pavailmem(a);
+	maxalloc = uk_alloc_pmaxalloc(a);
+	UK_TEST_EXPECT_SNUM_GT(avail, 0);
+	UK_TEST_EXPECT_SNUM_LE(maxalloc, avail);
+
+	n = uk_palloc_batch(a, 1, pages, HEAP_PAGES);
+	UK_TEST_EXPECT_SNUM_EQ(n, avail);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), 0);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pmaxalloc(a), 0);
+	UK_TEST_EXPECT_NULL(uk_palloc(a, 1));
+
+	/* Free every other page first so that merging happens late */
+	for (i = 0; i < n; i += 2)
+		uk_pfree(a, pages[i], 1);
+	for (i = 1; i < n; i += 2)
+		uk_pfree(a, pages[i], 1);
+
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pmaxalloc(a), maxalloc);
+}
+
+UK_TESTCASE(ukallocbbuddy, alloc_orders)
+{
+	struct uk_alloc *a = test_bbuddy();
+	long avail;
+	unsigned long num_pages;
+	void *p;
+
+	UK_TEST_ASSERT(a != NULL);
+	avail = uk_alloc_pavailmem(a);
+
+	for (num_pages = 1; num_pages <= 64; num_pages <<= 1) {
+		p = uk_palloc(a, num_pages);
+		UK_TEST_EXPECT_NOT_NULL(p);
+		UK_TEST_EXPECT_ZERO((__uptr) p
+				    & ((num_pages << __PAGE_SHIFT) - 1));
+		UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a),
+				       avail - (long) num_pages);
+		uk_pfree(a, p, num_pages);
+	}
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail);
+}
+
+/* A batch splits a large chunk into several pieces at once; the pieces
+ * must be aligned, distinct, and the rest must stay allocatable
+ */
+UK_TESTCASE(ukallocbbuddy, batch_split)
+{
+	struct uk_alloc *a = test_bbuddy();
+	long avail, maxalloc;
+	unsigned int i, j, n, nr_bad = 0;
+
+	UK_TEST_ASSERT(a != NULL);
+	avail = uk_alloc_pavailmem(a);
+	maxalloc = uk_alloc_pmaxalloc(a);
+
+	/* 3 pages are served from order-2 chunks */
+	n = uk_palloc_batch(a, 3, pages, 5);
+	UK_TEST_EXPECT_SNUM_EQ(n, 5);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail - 5 * 4);
+	for (i = 0; i < n; i++) {
+		if ((__uptr) pages[i] & ((4UL << __PAGE_SHIFT) - 1))
+			nr_bad++;
+		for (j = 0; j < i; j++) {
+			if (pages[j] == pages[i])
+				nr_bad++;
+		}
+	}
+	UK_TEST_EXPECT_ZERO(nr_bad);
+
+	uk_pfree_batch(a, pages, 3, n);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pmaxalloc(a), maxalloc);
+}
+
+/* Order of the chunk that serves a request of `num_pages` */
+static unsigned int num_pages_order(unsigned long num_pages)
+{
+	return (num_pages == 1) ? 0 : uk_flsl(num_pages - 1) + 1;
+}
+
+static __u32 stress_rand(__u32 *state)
+{
+	/* xorshift32, deterministic so that failures can be reproduced */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+/* Stamp the first and the last word of every page range with its slot, so
+ * that overlapping allocations are detected when the range is freed
+ */
+static void stress_stamp(unsigned int slot)
+{
+	__uptr *first = slots[slot].p;
+	__uptr *last = (__uptr *) ((char *) slots[slot].p
+				   + (slots[slot].num_pages << __PAGE_SHIFT))
+		       - 1;
+
+	*first = slot;
+	*last = slot;
+}
+
+static int stress_check(unsigned int slot)
+{
+	__uptr *first = slots[slot].p;
+	__uptr *last = (__uptr *) ((char *) slots[slot].p
+				   + (slots[slot].num_pages << __PAGE_SHIFT))
+		       - 1;
+
+	return *first == slot && *last == slot;
+}
+
+/* Random allocations and frees of mixed orders, including sizes that are not
+ * powers of two. Once everything is freed again, coalescing must restore
+ * the initial availability and the biggest chunk.
+ */
+UK_TESTCASE(ukallocbbuddy, mixed_order_stress)
+{
+	struct uk_alloc *a = test_bbuddy();
+	unsigned int nr_allocs = 0, nr_frees = 0, nr_enomem = 0;
+	unsigned int nr_unaligned = 0, nr_overlaps = 0;
+	unsigned int i, slot, order;
+	long avail, maxalloc, live = 0;
+	__u32 seed = 0x2545f491;
+	__nsec t0;
+
+	UK_TEST_ASSERT(a != NULL);
+
+	avail = uk_alloc_pavailmem(a);
+	maxalloc = uk_alloc_pmaxalloc(a);
+
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < STRESS_OPS; i++) {
+		slot = stress_rand(&seed) % STRESS_SLOTS;
+		if (slots[slot].p) {
+			if (!stress_check(slot))
+				nr_overlaps++;
+			uk_pfree(a, slots[slot].p, slots[slot].num_pages);
+			live -= 1L << num_pages_order(slots[slot].num_pages);
+			slots[slot].p = NULL;
+			nr_frees++;
+			continue;
+		}
+
+		order = stress_rand(&seed) % (STRESS_ORDER_MAX + 1);
+		slots[slot].num_pages = 1UL << order;
+		/* Every other request is not a power of two */
+		if (order && (stress_rand(&seed) & 1))
+			slots[slot].num_pages -= stress_rand(&seed)
+						 % (slots[slot].num_pages / 2);
+
+		slots[slot].p = uk_palloc(a, slots[slot].num_pages);
+		if (!slots[slot].p) {
+			nr_enomem++;
+			continue;
+		}
+		if ((__uptr) slots[slot].p & ((__PAGE_SIZE << order) - 1))
+			nr_unaligned++;
+		stress_stamp(slot);
+		live += 1L << order;
+		nr_allocs++;
+	}
+	t0 = ukplat_monotonic_clock() - t0;
+
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail - live);
+
+	for (slot = 0; slot < STRESS_SLOTS; slot++) {
+		if (!slots[slot].p)
+			continue;
+		if (!stress_check(slot))
+			nr_overlaps++;
+		uk_pfree(a, slots[slot].p, slots[slot].num_pages);
+		slots[slot].p = NULL;
+	}
+
+	uk_test_printf("%u pallocs (%u ENOMEM), %u pfrees: %"__PRInsec" ns/op\n",
+		       nr_allocs, nr_enomem, nr_frees,
+		       t0 / STRESS_OPS);
+	UK_TEST_EXPECT_SNUM_GT(nr_allocs, 0);
+	UK_TEST_EXPECT_ZERO(nr_unaligned);
+	UK_TEST_EXPECT_ZERO(nr_overlaps);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pavailmem(a), avail);
+	UK_TEST_EXPECT_SNUM_EQ(uk_alloc_pmaxalloc(a), maxalloc);
+
+	/* The whole heap is allocatable in the biggest chunk again */
+	pages[0] = uk_palloc(a, maxalloc);
+	UK_TEST_EXPECT_NOT_NULL(pages[0]);
+	if (pages[0])
+		uk_pfree(a, pages[0], maxalloc);
+}
+
+/* Report the cost of the page allocator operations */
+UK_TESTCASE(ukallocbbuddy, ns_per_op)
+{
+	struct uk_alloc *a = test_bbuddy();
+	unsigned long num_pages;
+	__nsec t0, t_alloc, t_free, t_max;
+	unsigned int i, n;
+
+	UK_TEST_ASSERT(a != NULL);
+
+	for (num_pages = 1; num_pages <= 16; num_pages <<= 2) {
+		t0 = ukplat_monotonic_clock();
+		for (n = 0; n < NR_OPS; n++) {
+			pages[n] = uk_palloc(a, num_pages);
+			if (!pages[n])
+				break;
+		}
+		t_alloc = ukplat_monotonic_clock() - t0;
+
+		t0 = ukplat_monotonic_clock();
+		for (i = 0; i < n; i++)
+			uk_pfree(a, pages[i], num_pages);
+		t_free = ukplat_monotonic_clock() - t0;
+
+		UK_TEST_EXPECT_SNUM_GT(n, 0);
+		if (!n)
+			continue;
+		uk_test_printf("order %lu: palloc %"__PRInsec" ns/op, pfree %"__PRInsec" ns/op (%u ops)\n",
+			       (unsigned long) uk_flsl(num_pages),
+			       t_alloc / n, t_free / n, n);
+	}
+
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < NR_OPS; i++)
+		uk_alloc_pmaxalloc(a);
+	t_max = ukplat_monotonic_clock() - t0;
+	uk_test_printf("pmaxalloc %"__PRInsec" ns/op\n", t_max / NR_OPS);
+}
+
+uk_testsuite_register(ukallocbbuddy, NULL);
@@ -0,0 +1,707 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <uk/allocbench.h>
+#include <uk/alloc_impl.h>
+#include <uk/assert.h>
+#include <uk/bench.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/print.h>
+#include <uk/plat/time.h>
+#if CONFIG_LIBUKALLOCBBUDDY
+#include <uk/allocbbuddy.h>
+#endif /* CONFIG_LIBUKALLOCBBUDDY */
+#if CONFIG_LIBUKALLOCREGION
+#include <uk/allocregion.h>
+#endif /* CONFIG_LIBUKALLOCREGION */
+#if CONFIG_LIBUKALLOCPOOL
+#include <uk/allocpool.h>
+#endif /* CONFIG_LIBUKALLOCPOOL */
+#if CONFIG_LIBUKALLOCSLAB
+#include <uk/allocslab.h>
+#endif /* CONFIG_LIBUKALLOCSLAB */
+#if CONFIG_LIBUKALLOCCACHE
+#include <uk/alloccache.h>
+#endif /* CONFIG_LIBUKALLOCCACHE */
+#if CONFIG_LIBUKALLOCSTACK
+#if CONFIG_LIBUKVMEM
+#include <uk/vmem.h>
+#endif /* CONFIG_LIBUKVMEM */
+#include <uk/allocstack.h>
+#endif /* CONFIG_LIBUKALLOCSTACK */
+#if CONFIG_LIBUKSCHED
+#include <uk/sched.h>
+#include <uk/thread.h>
+#endif /* CONFIG_LIBUKSCHED */
+#if CONFIG_LIBUKALLOCBENCH_TLB
+#include <uk/arch/paging.h>
+#include <uk/vmem.h>
+#endif /* CONFIG_LIBUKALLOCBENCH_TLB */
+
+#define bench_printf(fmt, ...)						\
+	_uk_printk(KLVL_INFO, UKLIBID_NONE, __NULL, 0x0,		\
+		   "allocbench: " fmt, ##__VA_ARGS__)
+
+#define BENCH_ITERATIONS	CONFIG_LIBUKALLOCBENCH_ITERATIONS
+#define BENCH_HEAP_LEN		((__sz) CONFIG_LIBUKALLOCBENCH_HEAP_SIZE << 10)
+#define BENCH_NR_SLOTS		256	/* live objects of churn workloads */
+
+/*
+ * Benchmark state that is shared between the runner and the workloads
+ */
+struct bench_ctx {
+	struct uk_alloc *a;
+	void *heap;
+
+	__u64 rnd;		/* workload random sequence */
+	unsigned int fails;
+	__ssz avail_peak;
+	__ssz maxalloc_peak;
+
+	struct uk_bench_lat lat;
+};
+
+static void *slots[BENCH_NR_SLOTS];
+static __sz slot_len[BENCH_NR_SLOTS];
+static struct bench_ctx ctx;
+
+#define BENCH_TIMED(c, expr)	UK_BENCH_TIMED(&(c)->lat, expr)
+#define bench_percentile(c, p)	uk_bench_percentile(&(c)->lat, p)
+
+/* Allocators that are stacked on top of a parent keep their internal
+ * structures within the benchmark heap. For the figures of a backend we thus
+ * consider all allocators that live within the heap.
+ */
+static inline int bench_in_heap(struct bench_ctx *c, const void *ptr)
+{
+	return ((__uptr) ptr >= (__uptr) c->heap
+		&& (__uptr) ptr < (__uptr) c->heap + BENCH_HEAP_LEN);
+}
+
+static __ssz bench_availmem(struct bench_ctx *c)
+{
+	struct uk_alloc *a;
+	__ssz avail, total = -1;
+
+	uk_alloc_foreach(a) {
+		if (a != c->a && !bench_in_heap(c, a))
+			continue;
+		avail = uk_alloc_availmem(a);
+		if (avail < 0)
+			continue;
+		total = (total < 0) ? avail : total + avail;
+	}
+	return total;
+}
+
+static void bench_sample_peak(struct bench_ctx *c)
+{
+	__ssz maxalloc;
+
+	c->avail_peak = bench_availmem(c);
+	maxalloc = uk_alloc_maxalloc(c->a);
+	c->maxalloc_peak = (maxalloc < 0) ? -1 : maxalloc;
+}
+
+static void bench_free_slots(struct bench_ctx *c, int pages)
+{
+	unsigned int i;
+
+	for (i = 0; i < BENCH_NR_SLOTS; i++) {
+		if (!slots[i])
+			continue;
+		if (pages)
+			uk_pfree(c->a, slots[i], slot_len[i]);
+		else
+			uk_free(c->a, slots[i]);
+		slots[i] = NULL;
+	}
+}
+
+/*
+ * Workloads
+ */
+#define WL_CHURN_FIXED_LEN	64
+#define WL_POWERLAW_MIN_LEN	16
+#define WL_POWERLAW_MAX_LEN	(64 << 10)
+#define WL_PAGES_MAX		16
+#define WL_REALLOC_MAX_LEN	(64 << 10)
+
+/* Random malloc/free on a fixed number of slots */
+static void wl_churn(struct bench_ctx *c, __sz (*next_len)(struct bench_ctx *))
+{
+	unsigned int i, s;
+	void *ptr;
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		if (i == BENCH_ITERATIONS / 2)
+			bench_sample_peak(c);
+
+		s = uk_bench_rand(&c->rnd) % BENCH_NR_SLOTS;
+		if (slots[s]) {
+			BENCH_TIMED(c, uk_free(c->a, slots[s]));
+			slots[s] = NULL;
+			continue;
+		}
+
+		slot_len[s] = next_len(c);
+		BENCH_TIMED(c, ptr = uk_malloc(c->a, slot_len[s]));
+		if (unlikely(!ptr)) {
+			c->fails++;
+			continue;
+		}
+		*((char *) ptr) = 0; /* touch */
+		slots[s] = ptr;
+	}
+	bench_free_slots(c, 0);
+}
+
+static __sz len_fixed(struct bench_ctx *c __unused)
+{
+	return WL_CHURN_FIXED_LEN;
+}
+
+/* Sizes from WL_POWERLAW_MIN_LEN to WL_POWERLAW_MAX_LEN where every doubling
+ * of the size halves the probability (P(len) ~ 1/len)
+ */
+static __sz len_powerlaw(struct bench_ctx *c)
+{
+	__u64 r = uk_bench_rand(&c->rnd);
+	unsigned int order = 0;
+	__sz len;
+
+	while ((r & 1) && (WL_POWERLAW_MIN_LEN << (order + 1))
+			  <= WL_POWERLAW_MAX_LEN) {
+		order++;
+		r >>= 1;
+	}
+	len = (__sz) WL_POWERLAW_MIN_LEN << order;
+	return len + (__sz) ((r >> 16) % len);
+}
+
+static void wl_churn_fixed(struct bench_ctx *c)
+{
+	wl_churn(c, len_fixed);
+}
+
+static void wl_churn_powerlaw(struct bench_ctx *c)
+{
+	wl_churn(c, len_powerlaw);
+}
+
+/* Buffers grow by 50% with every realloc until they are released */
+static void wl_realloc_grow(struct bench_ctx *c)
+{
+	unsigned int i, s;
+	void *ptr;
+	__sz len;
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		if (i == BENCH_ITERATIONS / 2)
+			bench_sample_peak(c);
+
+		s = uk_bench_rand(&c->rnd) % (BENCH_NR_SLOTS / 4);
+		len = slots[s] ? slot_len[s] + slot_len[s] / 2 : 16;
+		if (len > WL_REALLOC_MAX_LEN) {
+			BENCH_TIMED(c, uk_free(c->a, slots[s]));
+			slots[s] = NULL;
+			continue;
+		}
+
+		BENCH_TIMED(c, ptr = uk_realloc(c->a, slots[s], len));
+		if (unlikely(!ptr)) {
+			c->fails++;
+			continue;
+		}
+		((char *) ptr)[len - 1] = 0; /* touch */
+		slots[s] = ptr;
+		slot_len[s] = len;
+	}
+	bench_free_slots(c, 0);
+}
+
+/* Random palloc/pfree of 1 to WL_PAGES_MAX pages */
+static void wl_pages(struct bench_ctx *c)
+{
+	unsigned int i, s;
+	void *ptr;
+
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		if (i == BENCH_ITERATIONS / 2)
+			bench_sample_peak(c);
+
+		s = uk_bench_rand(&c->rnd) % (BENCH_NR_SLOTS / 4);
+		if (slots[s]) {
+			BENCH_TIMED(c, uk_pfree(c->a, slots[s], slot_len[s]));
+			slots[s] = NULL;
+			continue;
+		}
+
+		slot_len[s] = 1 + uk_bench_rand(&c->rnd) % WL_PAGES_MAX;
+		BENCH_TIMED(c, ptr = uk_palloc(c->a, slot_len[s]));
+		if (unlikely(!ptr)) {
+			c->fails++;
+			continue;
+		}
+		*((char *) ptr) = 0; /* touch */
+		slots[s] = ptr;
+	}
+	bench_free_slots(c, 1);
+}
+
+/* Fill the allocator with mixed sizes, then release every other object. The
+ * peak figures show how much of the free memory is usable as one block.
+ */
+static void wl_fragmentation(struct bench_ctx *c)
+{
+	void **objs = slots;
+	unsigned int i, n, max;
+	void *ptr;
+
+	/* Reuse the slot array as a list of up to BENCH_NR_SLOTS objects
+	 * and scale the object size to the heap so that the heap fills up
+	 */
+	max = BENCH_NR_SLOTS;
+	for (n = 0; n < max; n++) {
+		slot_len[n] = (BENCH_HEAP_LEN / max)
+			      / (1 + uk_bench_rand(&c->rnd) % 4);
+		BENCH_TIMED(c, ptr = uk_malloc(c->a, slot_len[n]));
+		if (!ptr) {
+			c->fails++;
+			break;
+		}
+		objs[n] = ptr;
+	}
+
+	for (i = 0; i < n; i += 2) {
+		BENCH_TIMED(c, uk_free(c->a, objs[i]));
+		objs[i] = NULL;
+	}
+	bench_sample_peak(c);
+	bench_free_slots(c, 0);
+}
+
+#if CONFIG_LIBUKSCHED
+/* Objects are allocated by the benchmark thread and released by a second
+ * thread. Both threads hand over the objects through a ring.
+ */
+#define XT_RING_LEN	64
+
+struct xthread_ring {
+	void *obj[XT_RING_LEN];
+	unsigned int head;	/* next slot to produce */
+	unsigned int tail;	/* next slot to consume */
+	int producer_done;
+	int consumer_done;
+};
+
+static struct xthread_ring xt_ring;
+
+static __noreturn void xthread_consumer(void *arg)
+{
+	struct bench_ctx *c = (struct bench_ctx *) arg;
+	struct xthread_ring *r = &xt_ring;
+
+	for (;;) {
+		while (r->tail == r->head) {
+			if (r->producer_done)
+				goto out;
+			uk_sched_yield();
+		}
+
+		BENCH_TIMED(c, uk_free(c->a, r->obj[r->tail % XT_RING_LEN]));
+		r->tail++;
+	}
+
+out:
+	r->consumer_done = 1;
+	uk_sched_thread_exit();
+}
+
+static void wl_xthread(struct bench_ctx *c)
+{
+	struct xthread_ring *r = &xt_ring;
+	struct uk_thread *t;
+	unsigned int i;
+	void *ptr;
+
+	memset(r, 0, sizeof(*r));
+	t = uk_sched_thread_create(uk_sched_current(), xthread_consumer, c,
+				   "allocbench-xthread");
+	if (unlikely(!t)) {
+		c->fails = BENCH_ITERATIONS;
+		return;
+	}
+
+	for (i = 0; i < BENCH_ITERATIONS / 2; i++) {
+		if (i == BENCH_ITERATIONS / 4)
+			bench_sample_peak(c);
+
+		while (r->head - r->tail == XT_RING_LEN)
+			uk_sched_yield();
+
+		BENCH_TIMED(c, ptr = uk_malloc(c->a, WL_CHURN_FIXED_LEN));
+		if (unlikely(!ptr)) {
+			c->fails++;
+			continue;
+		}
+		r->obj[r->head % XT_RING_LEN] = ptr;
+		r->head++;
+	}
+
+	r->producer_done = 1;
+	while (!r->consumer_done)
+		uk_sched_yield();
+}
+#endif /* CONFIG_LIBUKSCHED */
+
+#define WL_MALLOC	0x1	/* uses malloc/free */
+#define WL_PAGE		0x2	/* uses palloc/pfree */
+#define WL_REALLOC	0x4	/* uses realloc */
+#define WL_FILL		0x8	/* fills the backing heap */
+
+struct bench_workload {
+	const char *name;
+	void (*run)(struct bench_ctx *c);
+	unsigned int flags;
+	__sz max_len;		/* largest object */
+	__sz align;		/* strongest alignment */
+};
+
+static const struct bench_workload workloads[] = {
+	{ "churn-fixed", wl_churn_fixed, WL_MALLOC,
+	  WL_CHURN_FIXED_LEN, sizeof(void *) },
+	{ "churn-powerlaw", wl_churn_powerlaw, WL_MALLOC,
+	  2 * WL_POWERLAW_MAX_LEN, sizeof(void *) },
+#if CONFIG_LIBUKSCHED
+	{ "xthread-free", wl_xthread, WL_MALLOC,
+	  WL_CHURN_FIXED_LEN, sizeof(void *) },
+#endif /* CONFIG_LIBUKSCHED */
+	{ "realloc-grow", wl_realloc_grow, WL_MALLOC | WL_REALLOC,
+	  WL_REALLOC_MAX_LEN, sizeof(void *) },
+	{ "pages", wl_pages, WL_PAGE,
+	  WL_PAGES_MAX * __PAGE_SIZE, __PAGE_SIZE },
+	{ "fragmentation", wl_fragmentation, WL_MALLOC | WL_FILL,
+	  BENCH_HEAP_LEN / BENCH_NR_SLOTS, sizeof(void *) },
+};
+
+/*
+ * Allocator backends: every backend creates a fresh allocator on the given
+ * heap. Stacked allocators use a binary buddy allocator on the heap as
+ * parent.
+ */
+struct bench_backend {
+	const char *name;
+	struct uk_alloc *(*init)(void *base, __sz len,
+				 const struct bench_workload *wl);
+	unsigned int skip;	/* workload flags that are not supported */
+};
+
+#if CONFIG_LIBUKALLOCBBUDDY
+static struct uk_alloc *be_bbuddy(void *base, __sz len,
+				  const struct bench_workload *wl __unused)
+{
+	return uk_allocbbuddy_init(base, len);
+}
+#endif /* CONFIG_LIBUKALLOCBBUDDY */
+
+#if CONFIG_LIBUKALLOCREGION
+static struct uk_alloc *be_region(void *base, __sz len,
+				  const struct bench_workload *wl __unused)
+{
+	return uk_allocregion_init(base, len);
+}
+#endif /* CONFIG_LIBUKALLOCREGION */
+
+#if CONFIG_LIBUKALLOCPOOL
+static struct uk_alloc *be_pool(void *base, __sz len,
+				const struct bench_workload *wl)
+{
+	struct uk_allocpool *p;
+
+	/* A pool serves only one object size: Use the largest one */
+	p = uk_allocpool_init(base, len, wl->max_len, wl->align);
+	return p ? uk_allocpool2ukalloc(p) : NULL;
+}
+#endif /* CONFIG_LIBUKALLOCPOOL */
+
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCPOOL
+static struct uk_alloc *be_pool_grow(void *base, __sz len,
+				     const struct bench_workload *wl)
+{
+	struct uk_alloc *parent = uk_allocbbuddy_init(base, len);
+	struct uk_allocpool *p;
+
+	if (!parent)
+		return NULL;
+	p = uk_allocpool_create(parent, wl->max_len, wl->align, 0);
+	return p ? uk_allocpool2ukalloc(p) : NULL;
+}
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCPOOL */
+
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSLAB
+static struct uk_alloc *be_slab(void *base, __sz len,
+				const struct bench_workload *wl __unused)
+{
+	struct uk_alloc *parent = uk_allocbbuddy_init(base, len);
+
+	return parent ? uk_allocslab_create(parent) : NULL;
+}
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSLAB */
+
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCCACHE
+static struct uk_alloc *be_cache(void *base, __sz len,
+				 const struct bench_workload *wl __unused)
+{
+	struct uk_alloc *parent = uk_allocbbuddy_init(base, len);
+
+	return parent ? uk_alloccache_create(parent) : NULL;
+}
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCCACHE */
+
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSTACK
+static struct uk_alloc *be_stack(void *base, __sz len,
+				 const struct bench_workload *wl __unused)
+{
+	struct uk_alloc *parent = uk_allocbbuddy_init(base, len);
+
+	if (!parent)
+		return NULL;
+	return uk_allocstack_init(parent
+#if CONFIG_LIBUKVMEM
+				  , uk_vas_get_active(), 0
+#endif /* CONFIG_LIBUKVMEM */
+				 );
+}
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSTACK */
+
+static const struct bench_backend backends[] = {
+#if CONFIG_LIBUKALLOCBBUDDY
+	{ "bbuddy", be_bbuddy, 0 },
+#endif /* CONFIG_LIBUKALLOCBBUDDY */
+#if CONFIG_LIBUKALLOCREGION
+	{ "region", be_region, 0 },
+#endif /* CONFIG_LIBUKALLOCREGION */
+#if CONFIG_LIBUKALLOCPOOL
+	/* Objects do not grow, so realloc does not make sense */
+	{ "pool", be_pool, WL_REALLOC },
+#endif /* CONFIG_LIBUKALLOCPOOL */
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCPOOL
+	{ "pool-grow", be_pool_grow, WL_REALLOC },
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCPOOL */
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSLAB
+	{ "slab", be_slab, 0 },
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSLAB */
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCCACHE
+	{ "cache", be_cache, 0 },
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCCACHE */
+#if CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSTACK
+	/* Stacks may be mapped with guard pages outside of the heap and
+	 * uk_realloc_compat() would read beyond the old stack
+	 */
+	{ "stack", be_stack, WL_PAGE | WL_REALLOC | WL_FILL },
+#endif /* CONFIG_LIBUKALLOCBBUDDY && CONFIG_LIBUKALLOCSTACK */
+};
+
+/*
+ * Runner
+ */
+static void bench_unregister_heap(struct bench_ctx *c)
+{
+	struct uk_alloc *a, *next;
+
+	for (a = _uk_alloc_head; a != NULL; a = next) {
+		next = a->next;
+		if (a == c->a || bench_in_heap(c, a))
+			uk_alloc_unregister(a);
+	}
+}
+
+static void bench_run_one(const struct bench_backend *be,
+			  const struct bench_workload *wl)
+{
+	struct bench_ctx *c = &ctx;
+	__ssz avail_start, avail_end;
+	__u64 ops_per_s;
+	void *heap = c->heap;
+
+	memset(c, 0, offsetof(struct bench_ctx, lat));
+	c->heap = heap;
+	c->rnd = 0x9e3779b97f4a7c15ULL;
+	c->avail_peak = -1;
+	c->maxalloc_peak = -1;
+	memset(slots, 0, sizeof(slots));
+	uk_bench_lat_reset(&c->lat);
+
+	c->a = be->init(c->heap, BENCH_HEAP_LEN, wl);
+	if (unlikely(!c->a)) {
+		uk_pr_err("%s: Failed to initialize allocator for %s\n",
+			  be->name, wl->name);
+		return;
+	}
+
+	avail_start = bench_availmem(c);
+	wl->run(c);
+	avail_end = bench_availmem(c);
+
+	bench_unregister_heap(c);
+
+	uk_bench_sort(&c->lat);
+	ops_per_s = c->lat.total ? ((__u64) c->lat.ops * UKARCH_NSEC_PER_SEC)
+				   / c->lat.total : 0;
+	bench_printf("alloc=%s workload=%s ops=%u fails=%u total_ns=%"__PRInsec" ops_per_s=%"__PRIu64" p50_ns=%"__PRInsec" p90_ns=%"__PRInsec" p99_ns=%"__PRInsec" max_ns=%"__PRInsec" avail_start=%"__PRIssz" avail_peak=%"__PRIssz" maxalloc_peak=%"__PRIssz" avail_end=%"__PRIssz"\n",
+		     be->name, wl->name, c->lat.ops, c->fails, c->lat.total,
+		     ops_per_s, bench_percentile(c, 50),
+		     bench_percentile(c, 90), bench_percentile(c, 99),
+		     c->lat.max,
+		     avail_start, c->avail_peak, c->maxalloc_peak, avail_end);
+}
+
+#if CONFIG_LIBUKALLOCBENCH_TLB
+/*
+ * TLB benchmark: An anonymous mapping is touched page by page (fault phase)
+ * and then walked by a pointer chase that visits the pages in random order
+ * (access phase). Every step of the chase depends on the previous load so
+ * that TLB misses are not hidden by the out-of-order execution. The chase
+ * uses a different cache line in every page to avoid cache set conflicts.
+ */
+#define TLB_LEN		((__sz) CONFIG_LIBUKALLOCBENCH_TLB_SIZE << 20)
+#define TLB_PAGES	((__u32) (TLB_LEN >> PAGE_SHIFT))
+#define TLB_LINE	64
+
+static inline volatile __u32 *tlb_slot(__vaddr_t base, __u32 page)
+{
+	return (volatile __u32 *) (base + ((__vaddr_t) page << PAGE_SHIFT)
+			  + (page % (PAGE_SIZE / TLB_LINE)) * TLB_LINE);
+}
+
+static void tlb_run_one(const char *name, __u32 *perm, unsigned long flags)
+{
+	struct uk_vmem_pagefault_stats pf_start, pf_end;
+	struct uk_vas *vas = uk_vas_get_active();
+	__vaddr_t vaddr = __VADDR_ANY;
+	__nsec t0, fault_ns, access_ns;
+	__u64 faults;
+	__u64 rnd = 0x9e3779b97f4a7c15ULL;
+	__u32 i, j, tmp, page;
+	int rc;
+
+	rc = uk_vma_map_anon(vas, &vaddr, TLB_LEN, PAGE_ATTR_PROT_RW, flags,
+			     "allocbench-tlb");
+	if (unlikely(rc)) {
+		uk_pr_err("%s: Failed to map %"__PRIsz" bytes: %d\n",
+			  name, TLB_LEN, rc);
+		return;
+	}
+
+	uk_vmem_pagefault_stats(&pf_start);
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < TLB_PAGES; i++)
+		*tlb_slot(vaddr, i) = 0;
+	fault_ns = ukplat_monotonic_clock() - t0;
+	uk_vmem_pagefault_stats(&pf_end);
+
+	/* Sattolo's algorithm: a random permutation with a single cycle */
+	for (i = 0; i < TLB_PAGES; i++)
+		perm[i] = i;
+	for (i = TLB_PAGES - 1; i > 0; i--) {
+		j = uk_bench_rand(&rnd) % i;
+		tmp = perm[i];
+		perm[i] = perm[j];
+		perm[j] = tmp;
+	}
+	for (i = 0; i < TLB_PAGES; i++)
+		*tlb_slot(vaddr, perm[i]) = perm[(i + 1) % TLB_PAGES];
+
+	page = perm[0];
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		page = *tlb_slot(vaddr, page);
+	access_ns = ukplat_monotonic_clock() - t0;
+
+	uk_vma_unmap(vas, vaddr, TLB_LEN, 0);
+
+	faults = (pf_end.nr_small - pf_start.nr_small)
+		 + (pf_end.nr_large - pf_start.nr_large);
+	bench_printf("tlb=%s len=%"__PRIsz" fault_ns=%"__PRInsec" faults_per_s=%"__PRIu64" faults_small=%"__PRIu64" faults_large=%"__PRIu64" faults_fallback=%"__PRIu64" accesses=%u access_ns=%"__PRInsec" ns_per_access=%"__PRInsec" end=%"__PRIu32"\n",
+		     name, TLB_LEN, fault_ns,
+		     fault_ns ? (faults * UKARCH_NSEC_PER_SEC) / fault_ns : 0,
+		     pf_end.nr_small - pf_start.nr_small,
+		     pf_end.nr_large - pf_start.nr_large,
+		     pf_end.nr_fallback - pf_start.nr_fallback,
+		     (unsigned int) BENCH_ITERATIONS, access_ns,
+		     access_ns / BENCH_ITERATIONS, page);
+}
+
+static void tlb_run(struct uk_alloc *a)
+{
+	__u32 *perm;
+
+	if (unlikely(!uk_vas_get_active())) {
+		uk_pr_err("No active address space for TLB benchmark\n");
+		return;
+	}
+
+	perm = uk_malloc(a, TLB_PAGES * sizeof(*perm));
+	if (unlikely(!perm)) {
+		uk_pr_err("Failed to allocate TLB benchmark state\n");
+		return;
+	}
+
+	tlb_run_one("small", perm, 0);
+	tlb_run_one("huge", perm, UK_VMA_MAP_HUGE);
+	uk_free(a, perm);
+}
+#endif /* CONFIG_LIBUKALLOCBENCH_TLB */
+
+int uk_allocbench_run(void)
+{
+	struct uk_alloc *a = uk_alloc_get_default();
+	unsigned int i, j;
+
+	ctx.heap = uk_palloc(a, BENCH_HEAP_LEN >> __PAGE_SHIFT);
+	if (unlikely(!ctx.heap)) {
+		uk_pr_err("Failed to allocate %"__PRIsz" bytes for benchmark heap\n",
+			  BENCH_HEAP_LEN);
+		return -ENOMEM;
+	}
+
+	bench_printf("version=1 iterations=%u heap=%"__PRIsz" backends=%u workloads=%u\n",
+		     (unsigned int) BENCH_ITERATIONS, BENCH_HEAP_LEN,
+		     (unsigned int) ARRAY_SIZE(backends),
+		     (unsigned int) ARRAY_SIZE(workloads));
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		for (j = 0; j < ARRAY_SIZE(workloads); j++) {
+			if (backends[i].skip & workloads[j].flags)
+				continue;
+			bench_run_one(&backends[i], &workloads[j]);
+		}
+	}
+
+	uk_pfree(a, ctx.heap, BENCH_HEAP_LEN >> __PAGE_SHIFT);
+	ctx.heap = NULL;
+
+#if CONFIG_LIBUKALLOCBENCH_TLB
+	tlb_run(a);
+#endif /* CONFIG_LIBUKALLOCBENCH_TLB */
+	return 0;
+}
+
+#if CONFIG_LIBUKALLOCBENCH_AUTORUN
+static int allocbench_autorun(struct uk_init_ctx *ictx __unused)
+{
+	/* A failing benchmark should not stop the boot */
+	uk_allocbench_run();
+	return 0;
+}
+
+uk_late_initcall(allocbench_autorun, 0x0);
+#endif /* CONFIG_LIBUKALLOCBENCH_AUTORUN */
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#ifndef __UKALLOCBENCH_H__
+#define __UKALLOCBENCH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Run all workloads against all allocator implementations that are part of
+ * the build. Every combination prints one line of the form:
+ *
+ *   allocbench: alloc=<name> workload=<name> ops=<n> fails=<n> ...
+ *
+ * with the following keys:
+ *   ops, fails           Number of operations and failed allocations
+ *   total_ns, ops_per_s  Time spent in the allocator and resulting rate
+ *   p50_ns, p90_ns,
+ *   p99_ns, max_ns       Latency percentiles of single operations
+ *   avail_start,
+ *   avail_peak,
+ *   avail_end            Free memory (bytes) of the allocator before the
+ *                        workload, at the peak of the workload, and after
+ *                        all memory was released again
+ *   maxalloc_peak        Biggest possible allocation at the peak; compared
+ *                        with avail_peak this indicates fragmentation
+ *
+ * Values that an allocator does not support are printed as -1.
+ *
+ * With CONFIG_LIBUKALLOCBENCH_TLB, an anonymous mapping is additionally
+ * walked with base pages and with large pages. Each run prints:
+ *
+ *   allocbench: tlb=<small|huge> len=<n> fault_ns=<n> ...
+ *
+ * with the following keys:
+ *   fault_ns             Time for touching every page of the mapping once
+ *   faults_per_s         Resolved page faults per second during the touch
+ *   faults_small,
+ *   faults_large,
+ *   faults_fallback      Page faults resolved with base pages, with large
+ *                        pages, and large page faults that fell back to base
+ *                        pages during the touch
+ *   accesses, access_ns,
+ *   ns_per_access        Dependent loads in random page order and the time
+ *                        they took
+ *
+ * @return
+ *   0 on success, negative errno if the benchmark heap could not be
+ *   allocated
+ */
+int uk_allocbench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UKALLOCBENCH_H__ */
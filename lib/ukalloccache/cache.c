@@ -0,0 +1,444 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <uk/alloccache.h>
+#include <uk/alloc_impl.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/plat/lcpu.h>
+#include <uk/print.h>
+#include <uk/spinlock.h>
+
+/*
+ * Every object handed out by the front-end is preceded by a header that
+ * records the size class it belongs to. Cached objects are allocated from
+ * the parent with the size of their class, so they can be recycled for any
+ * request of the same class. Requests that are too large or that need a
+ * stronger alignment bypass the magazines; for those, the length of the
+ * object is additionally stored at the beginning of the parent allocation:
+ *
+ *   cached:    [ hdr ][ object ......... ]
+ *              ^ base
+ *
+ *   bypassed:  [ len ][ // padding // ][ hdr ][ object ........... ]
+ *              ^ base
+ */
+#define CACHE_HDR_LEN		16
+#define CACHE_NOCLASS		((__u32) -1)
+
+struct cache_hdr {
+	void *base;		/* start of the parent allocation */
+	__u32 cls;		/* size class or CACHE_NOCLASS */
+};
+
+UK_CTASSERT(sizeof(struct cache_hdr) <= CACHE_HDR_LEN);
+
+static const __sz cache_class_len[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+#define CACHE_NR_CLASSES	ARRAY_SIZE(cache_class_len)
+#define CACHE_MAX_OBJ_LEN	1024
+
+/* Lookup table from request size (in CACHE_HDR_LEN units) to size class */
+#define CACHE_LUT_LEN		(CACHE_MAX_OBJ_LEN / CACHE_HDR_LEN + 1)
+#define cache_lut_idx(size)	DIV_ROUND_UP((size), CACHE_HDR_LEN)
+
+#define MAG_DEPTH		CONFIG_LIBUKALLOCCACHE_MAGAZINE_DEPTH
+#define MAG_BATCH		(MAG_DEPTH / 2)
+
+struct cache_mag {
+	unsigned int count;
+	struct cache_hdr *obj[MAG_DEPTH];
+};
+
+/* Aligned to avoid false sharing of magazines between lcpus */
+struct cache_lcpu {
+	struct cache_mag mag[CACHE_NR_CLASSES];
+#if CONFIG_LIBUKALLOCCACHE_STATS
+	struct uk_alloccache_stats stats;
+#endif /* CONFIG_LIBUKALLOCCACHE_STATS */
+} __align(64);
+
+struct uk_alloccache {
+	struct uk_alloc a;
+	struct uk_alloc *parent;
+	/* Serializes calls to the parent. Always taken with interrupts
+	 * disabled, refills happen in interrupt context as well.
+	 */
+	uk_spinlock parent_lock;
+	__u8 lut[CACHE_LUT_LEN];
+	struct cache_lcpu lcpu[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+};
+
+#if CONFIG_LIBUKALLOCCACHE_STATS
+#define cache_stats_inc(lc, field)	((lc)->stats.field++)
+#else /* !CONFIG_LIBUKALLOCCACHE_STATS */
+#define cache_stats_inc(lc, field)	do {} while (0)
+#endif /* !CONFIG_LIBUKALLOCCACHE_STATS */
+
+static inline struct uk_alloccache *to_alloccache(struct uk_alloc *a)
+{
+	UK_ASSERT(a);
+
+	return __containerof(a, struct uk_alloccache, a);
+}
+
+static inline struct cache_hdr *obj2hdr(const void *ptr)
+{
+	return (struct cache_hdr *) ((__uptr) ptr - CACHE_HDR_LEN);
+}
+
+static inline void *hdr2obj(struct cache_hdr *hdr)
+{
+	return (void *) ((__uptr) hdr + CACHE_HDR_LEN);
+}
+
+static __sz cache_obj_len(const void *ptr)
+{
+	struct cache_hdr *hdr = obj2hdr(ptr);
+
+	if (likely(hdr->cls != CACHE_NOCLASS))
+		return cache_class_len[hdr->cls];
+	return *((__sz *) hdr->base);
+}
+
+/* Fill an empty magazine with half of its capacity from the parent */
+static void cache_refill(struct uk_alloccache *c, __u32 cls,
+			 struct cache_mag *mag)
+{
+	struct cache_hdr *hdr;
+	unsigned long flags;
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	while (mag->count < MAG_BATCH) {
+		hdr = uk_malloc(c->parent,
+				CACHE_HDR_LEN + cache_class_len[cls]);
+		if (unlikely(!hdr))
+			break;
+
+		hdr->base = hdr;
+		hdr->cls = cls;
+		mag->obj[mag->count++] = hdr;
+	}
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+}
+
+/* Return half of the objects of a full magazine to the parent */
+static void cache_drain(struct uk_alloccache *c, struct cache_mag *mag)
+{
+	unsigned long flags;
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	while (mag->count > MAG_DEPTH - MAG_BATCH)
+		uk_free(c->parent, mag->obj[--mag->count]->base);
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+}
+
+static void *cache_bypass_alloc(struct uk_alloccache *c, __sz size,
+				__sz align)
+{
+	struct cache_hdr *hdr;
+	unsigned long flags;
+	__sz realsize;
+	__uptr base;
+	void *ptr;
+
+	/* Space for the length, the header, and for aligning the object */
+	realsize = size + 2 * CACHE_HDR_LEN + align;
+	if (unlikely(realsize < size))
+		return NULL;
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	base = (__uptr) uk_malloc(c->parent, realsize);
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+	if (unlikely(!base))
+		return NULL;
+
+	ptr = (void *) ALIGN_UP(base + 2 * CACHE_HDR_LEN, (__uptr) align);
+	*((__sz *) base) = size;
+	hdr = obj2hdr(ptr);
+	hdr->base = (void *) base;
+	hdr->cls = CACHE_NOCLASS;
+	return ptr;
+}
+
+static void *cache_do_alloc(struct uk_alloccache *c, __sz size, __sz align)
+{
+	struct cache_lcpu *lc;
+	struct cache_mag *mag;
+	struct cache_hdr *hdr;
+	unsigned long flags;
+	__u32 cls;
+
+	if (unlikely(size > CACHE_MAX_OBJ_LEN || align > CACHE_HDR_LEN)) {
+		flags = ukplat_lcpu_save_irqf();
+		cache_stats_inc(&c->lcpu[ukplat_lcpu_idx()], bypassed);
+		ukplat_lcpu_restore_irqf(flags);
+		return cache_bypass_alloc(c, size, MAX(align,
+						       (__sz) CACHE_HDR_LEN));
+	}
+
+	cls = c->lut[cache_lut_idx(size)];
+
+	/* Disabling interrupts keeps us on this lcpu and protects the
+	 * magazine against allocations from interrupt context
+	 */
+	flags = ukplat_lcpu_save_irqf();
+	lc = &c->lcpu[ukplat_lcpu_idx()];
+	mag = &lc->mag[cls];
+	if (unlikely(mag->count == 0)) {
+		cache_stats_inc(lc, alloc_misses);
+		cache_refill(c, cls, mag);
+		if (unlikely(mag->count == 0)) {
+			ukplat_lcpu_restore_irqf(flags);
+			return NULL;
+		}
+	} else {
+		cache_stats_inc(lc, alloc_hits);
+	}
+	hdr = mag->obj[--mag->count];
+	ukplat_lcpu_restore_irqf(flags);
+
+	return hdr2obj(hdr);
+}
+
+static void cache_free(struct uk_alloc *a, void *ptr)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	struct cache_lcpu *lc;
+	struct cache_mag *mag;
+	struct cache_hdr *hdr;
+	unsigned long flags;
+
+	if (unlikely(!ptr))
+		return;
+
+	uk_alloc_stats_count_free(a, ptr, cache_obj_len(ptr));
+
+	hdr = obj2hdr(ptr);
+	if (unlikely(hdr->cls == CACHE_NOCLASS)) {
+		uk_spin_lock_irqsave(&c->parent_lock, flags);
+		uk_free(c->parent, hdr->base);
+		uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+		return;
+	}
+
+	UK_ASSERT(hdr->cls < CACHE_NR_CLASSES);
+	UK_ASSERT(hdr->base == hdr);
+
+	flags = ukplat_lcpu_save_irqf();
+	lc = &c->lcpu[ukplat_lcpu_idx()];
+	mag = &lc->mag[hdr->cls];
+	if (unlikely(mag->count == MAG_DEPTH)) {
+		cache_stats_inc(lc, free_misses);
+		cache_drain(c, mag);
+	} else {
+		cache_stats_inc(lc, free_hits);
+	}
+	mag->obj[mag->count++] = hdr;
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+static void *cache_malloc(struct uk_alloc *a, __sz size)
+{
+	void *obj;
+
+	if (unlikely(!size))
+		return NULL;
+
+	obj = cache_do_alloc(to_alloccache(a), size, CACHE_HDR_LEN);
+	if (unlikely(!obj)) {
+		uk_alloc_stats_count_enomem(a, size);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	uk_alloc_stats_count_alloc(a, obj, cache_obj_len(obj));
+	return obj;
+}
+
+static int cache_posix_memalign(struct uk_alloc *a, void **memptr,
+				__sz align, __sz size)
+{
+	void *obj;
+
+	if (((align - 1) & align) != 0
+	    || (align % sizeof(void *)) != 0)
+		return EINVAL;
+
+	/* Leave memptr untouched. See comment in uk_posix_memalign_ifpages. */
+	if (!size)
+		return EINVAL;
+
+	obj = cache_do_alloc(to_alloccache(a), size, align);
+	if (unlikely(!obj)) {
+		uk_alloc_stats_count_enomem(a, size);
+		return ENOMEM;
+	}
+
+	uk_alloc_stats_count_alloc(a, obj, cache_obj_len(obj));
+	*memptr = obj;
+	return 0;
+}
+
+static void *cache_realloc(struct uk_alloc *a, void *ptr, __sz size)
+{
+	void *retptr;
+	__sz cursize;
+
+	if (!ptr)
+		return cache_malloc(a, size);
+
+	if (!size) {
+		cache_free(a, ptr);
+		return NULL;
+	}
+
+	cursize = cache_obj_len(ptr);
+	if (size <= cursize && size > cursize / 2)
+		return ptr;
+
+	retptr = cache_malloc(a, size);
+	if (!retptr)
+		return NULL;
+
+	memcpy(retptr, ptr, MIN(size, cursize));
+	cache_free(a, ptr);
+	return retptr;
+}
+
+static void *cache_palloc(struct uk_alloc *a, unsigned long num_pages)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	unsigned long flags;
+	void *ptr;
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	ptr = uk_palloc(c->parent, num_pages);
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+
+	uk_alloc_stats_count_palloc(a, ptr, num_pages);
+	return ptr;
+}
+
+static void cache_pfree(struct uk_alloc *a, void *ptr, unsigned long num_pages)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	unsigned long flags;
+
+	uk_alloc_stats_count_pfree(a, ptr, num_pages);
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	uk_pfree(c->parent, ptr, num_pages);
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+}
+
+static __ssz cache_maxalloc(struct uk_alloc *a)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	__ssz maxalloc;
+
+	maxalloc = uk_alloc_maxalloc(c->parent);
+	if (maxalloc < 0)
+		return maxalloc;
+	if (maxalloc <= 3 * CACHE_HDR_LEN)
+		return 0;
+	return maxalloc - 3 * CACHE_HDR_LEN;
+}
+
+/* NOTE: The parent is registered as allocator as well and reports its free
+ *       memory itself. We only report what is kept in the magazines.
+ */
+static __ssz cache_availmem(struct uk_alloc *a)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	unsigned int i, j;
+	__ssz availmem = 0;
+
+	for (i = 0; i < CONFIG_UKPLAT_LCPU_MAXCOUNT; i++)
+		for (j = 0; j < CACHE_NR_CLASSES; j++)
+			availmem += c->lcpu[i].mag[j].count
+				    * cache_class_len[j];
+	return availmem;
+}
+
+static int cache_addmem(struct uk_alloc *a, void *base, __sz len)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	unsigned long flags;
+	int rc;
+
+	uk_spin_lock_irqsave(&c->parent_lock, flags);
+	rc = uk_alloc_addmem(c->parent, base, len);
+	uk_spin_unlock_irqrestore(&c->parent_lock, flags);
+	return rc;
+}
+
+#if CONFIG_LIBUKALLOCCACHE_STATS
+void uk_alloccache_stats_get(struct uk_alloc *a,
+			     struct uk_alloccache_stats *dst)
+{
+	struct uk_alloccache *c = to_alloccache(a);
+	struct uk_alloccache_stats *s;
+	unsigned int i;
+
+	UK_ASSERT(dst);
+
+	memset(dst, 0, sizeof(*dst));
+	for (i = 0; i < CONFIG_UKPLAT_LCPU_MAXCOUNT; i++) {
+		s = &c->lcpu[i].stats;
+		dst->alloc_hits   += s->alloc_hits;
+		dst->alloc_misses += s->alloc_misses;
+		dst->free_hits    += s->free_hits;
+		dst->free_misses  += s->free_misses;
+		dst->bypassed     += s->bypassed;
+	}
+}
+#endif /* CONFIG_LIBUKALLOCCACHE_STATS */
+
+struct uk_alloc *uk_alloccache_create(struct uk_alloc *parent)
+{
+	struct uk_alloccache *c;
+	unsigned int i, j;
+
+	UK_ASSERT(parent);
+
+	c = uk_memalign(parent, __alignof__(*c), sizeof(*c));
+	if (unlikely(!c)) {
+		uk_pr_err("Failed to allocate caching allocator\n");
+		return NULL;
+	}
+	memset(c, 0, sizeof(*c));
+	c->parent = parent;
+	uk_spin_init(&c->parent_lock);
+
+	for (i = 0, j = 0; i < CACHE_NR_CLASSES; i++) {
+		for (; j <= cache_lut_idx(cache_class_len[i]); j++)
+			c->lut[j] = (__u8) i;
+	}
+	UK_ASSERT(j == CACHE_LUT_LEN);
+
+	uk_alloc_init_malloc(&c->a,
+			     cache_malloc,
+			     uk_calloc_compat,
+			     cache_realloc,
+			     cache_free,
+			     cache_posix_memalign,
+			     uk_memalign_compat,
+			     cache_maxalloc,
+			     cache_availmem,
+			     cache_addmem);
+	/* Page allocations are not cached and go straight to the parent */
+	c->a.palloc = cache_palloc;
+	c->a.pfree  = cache_pfree;
+
+	uk_pr_debug("%p: Caching front-end created on parent %p (magazine depth %u)\n",
+		    &c->a, parent, (unsigned int) MAG_DEPTH);
+	return &c->a;
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#ifndef __UKALLOCCACHE_H__
+#define __UKALLOCCACHE_H__
+
+#include <uk/alloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a caching front-end for a parent allocator.
+ * Small objects that are freed through the returned allocator are kept in
+ * per-lcpu magazines (one per size class) and are handed out again by
+ * subsequent allocations on the same lcpu without calling the parent.
+ * Magazines are refilled from and drained to the parent in batches of half
+ * the magazine depth (CONFIG_LIBUKALLOCCACHE_MAGAZINE_DEPTH). Calls to the
+ * parent are serialized with a lock, so the parent does not need to be
+ * SMP-safe.
+ *
+ * NOTE: Memory returned by the front-end must only be released with the
+ *       front-end and not with the parent allocator.
+ *
+ * @param parent
+ *   The allocator that is cached. It is also used for allocating the
+ *   internal structures of the front-end.
+ * @return
+ *   The caching allocator or NULL on error
+ */
+struct uk_alloc *uk_alloccache_create(struct uk_alloc *parent);
+
+#if CONFIG_LIBUKALLOCCACHE_STATS
+struct uk_alloccache_stats {
+	__u64 alloc_hits;	/* allocations served by a magazine */
+	__u64 alloc_misses;	/* allocations that needed a refill */
+	__u64 free_hits;	/* frees absorbed by a magazine */
+	__u64 free_misses;	/* frees that needed a drain */
+	__u64 bypassed;		/* requests not eligible for caching */
+};
+
+/**
+ * Retrieve the statistics of a caching allocator, summed up over all lcpus.
+ *
+ * @param a
+ *   Allocator returned by `uk_alloccache_create()`
+ * @param dst
+ *   Destination for the statistics
+ */
+void uk_alloccache_stats_get(struct uk_alloc *a,
+			     struct uk_alloccache_stats *dst);
+#endif /* CONFIG_LIBUKALLOCCACHE_STATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UKALLOCCACHE_H__ */
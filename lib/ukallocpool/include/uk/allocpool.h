@@ -79,9 +79,52 @@ struct uk_allocpool *uk_allocpool_alloc(struct uk_alloc *parent,
 					unsigned int obj_count,
 					__sz obj_len, __sz obj_align);
 
+/**
+ * Creates a growable memory pool on a parent allocator.
+ * The pool starts empty and allocates chunks of `chunk_pages` pages from
+ * the parent whenever it runs out of objects. Free objects are cached
+ * per lcpu and shared between lcpus with a lock-free stack, so that
+ * taking and returning objects is SMP-safe. Chunks that became completely
+ * idle are only returned to the parent by uk_allocpool_reclaim(), never
+ * while objects are returned.
+ *
+ * @param parent
+ *  Allocator from which the pool and its chunks are allocated.
+ *  Calls to the parent are serialized by the pool.
+ * @param obj_len
+ *  Size of one object (bytes).
+ * @param obj_align
+ *  Alignment requirement for each pool object.
+ * @param chunk_pages
+ *  Number of pages of a chunk, 0 selects a size that fits at least
+ *  32 objects.
+ * @return
+ *  - (NULL): If allocation failed (e.g., ENOMEM) or if an object does
+ *            not fit into a chunk (EINVAL).
+ *  - pointer to allocated pool.
+ */
+struct uk_allocpool *uk_allocpool_create(struct uk_alloc *parent,
+					 __sz obj_len, __sz obj_align,
+					 unsigned long chunk_pages);
+
+/**
+ * Returns chunks of a growable pool whose objects are all idle to the
+ * parent allocator, except for CONFIG_LIBUKALLOCPOOL_IDLE_CHUNKS of them.
+ * Objects that are cached by lcpus keep their chunk alive. The call waits
+ * for concurrent refills of lcpu caches and may be called from interrupt
+ * context. For pools of fixed size, this function does nothing.
+ *
+ * @param p
+ *  Pointer to memory pool.
+ * @return
+ *  Number of bytes returned to the parent allocator.
+ */
+__sz uk_allocpool_reclaim(struct uk_allocpool *p);
+
 /**
  * Frees a memory pool that was allocated with
- * uk_allocpool_alloc(). The memory is returned to
+ * uk_allocpool_alloc() or
+ * uk_allocpool_create(). The memory is returned to
  * the parent allocator.
  * Note: Please make sure that all taken objects
  * are returned to the pool before free'ing the
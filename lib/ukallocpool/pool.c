@@ -37,7 +37,11 @@
 #include <uk/essentials.h>
 #include <uk/alloc_impl.h>
 #include <uk/allocpool.h>
+#include <uk/arch/lcpu.h>
+#include <uk/atomic.h>
 #include <uk/list.h>
+#include <uk/plat/lcpu.h>
+#include <uk/spinlock.h>
 #include <string.h>
 #include <errno.h>
 
@@ -60,9 +64,87 @@
  *          v                       v
  */
 
+/*
+ * GROWABLE POOL: MEMORY LAYOUT
+ *
+ * A pool created with uk_allocpool_create() carves its objects out of
+ * chunks that are allocated from the parent on demand:
+ *
+ *          ++---------------------++
+ *          || struct pool_chunk   ||
+ *          ++---------------------++
+ *          |    // padding //      |
+ *          +=======================+
+ *          |       OBJECT 1        |
+ *          +=======================+
+ *          |         ...           |
+ *          +=======================+
+ *          |       OBJECT n        |
+ *          +=======================+
+ *          |    // unused //       |
+ *          v                       v
+ *
+ * Free objects are kept in per-lcpu caches and on a shared lock-free stack.
+ * A cache exchanges half of its depth with the shared stack when it runs
+ * empty or full. Chunks whose objects are all on the shared stack are
+ * returned to the parent by uk_allocpool_reclaim(). The chunk list is kept
+ * sorted by address, so that reclaiming can assign the sorted idle objects
+ * to their chunks in a single pass.
+ *
+ * A pop from the shared stack reads the link of the top object without
+ * owning it. Reclaimed chunks are thus only released after every lcpu left
+ * the pop that it may have been in (see grow_quiesce()).
+ */
+
 #define MIN_OBJ_ALIGN sizeof(void *)
 #define MIN_OBJ_LEN   sizeof(struct uk_list_head)
 
+#define LCPU_DEPTH	CONFIG_LIBUKALLOCPOOL_LCPU_DEPTH
+#define LCPU_BATCH	(LCPU_DEPTH / 2)
+
+/* Minimum number of objects in a chunk when the chunk size is chosen */
+#define CHUNK_MIN_OBJS	32
+
+/* The top of the shared stack is a pointer with a generation tag in the
+ * upper 16 bits. The tag is incremented with every update, so that a stale
+ * top (ABA) makes the compare-exchange fail. The pointer is sign extended
+ * from bit 47 when it is unpacked.
+ */
+#define STACK_TAG_SHIFT	48
+#define STACK_PTR_MASK	((1ULL << STACK_TAG_SHIFT) - 1)
+
+UK_CTASSERT(sizeof(void *) == sizeof(__u64));
+
+struct stack_obj {
+	struct stack_obj *next;
+};
+
+struct pool_chunk {
+	struct pool_chunk *next;	/* next chunk at a higher address */
+	__uptr obj_start;
+	__uptr obj_end;
+};
+
+struct pool_lcpu {
+	unsigned int count;
+	unsigned long pop_seq;	/* odd while popping from the shared stack */
+	void *obj[LCPU_DEPTH];
+} __align(64);
+
+struct pool_grow {
+	/* Shared stack, on its own cache line */
+	__u64 top __align(64);
+	unsigned long nr_shared;	/* objects on the shared stack */
+
+	uk_spinlock lock __align(64);	/* serializes the chunk list */
+	struct pool_chunk *chunks;
+	unsigned int nr_chunks;
+	unsigned int chunk_objs;
+	unsigned long chunk_pages;
+
+	struct pool_lcpu lcpu[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+};
+
 struct uk_allocpool {
 	struct uk_alloc self;
 
@@ -75,6 +157,8 @@ struct uk_allocpool {
 
 	struct uk_alloc *parent;
 	void *base;
+
+	struct pool_grow *grow; /* NULL for pools of fixed size */
 };
 
 struct free_obj {
@@ -123,6 +207,376 @@ static inline void *_take_free_obj(struct uk_allocpool *p)
 	return (void *) obj;
 }
 
+/*
+ * Growable pool
+ */
+static inline __u64 stack_pack(struct stack_obj *obj, __u64 old)
+{
+	return ((((old >> STACK_TAG_SHIFT) + 1) << STACK_TAG_SHIFT)
+		| ((__u64) (__uptr) obj & STACK_PTR_MASK));
+}
+
+static inline struct stack_obj *stack_ptr(__u64 top)
+{
+	return (struct stack_obj *) (__uptr)
+		((__s64) (top << (64 - STACK_TAG_SHIFT))
+		 >> (64 - STACK_TAG_SHIFT));
+}
+
+/* Push a linked list of `count` objects from `first` to `last` */
+static void stack_push(struct pool_grow *g, struct stack_obj *first,
+		       struct stack_obj *last, unsigned long count)
+{
+	__u64 old = uk_load_n(&g->top);
+
+	do {
+		last->next = stack_ptr(old);
+	} while (!uk_compare_exchange_n(&g->top, &old,
+					stack_pack(first, old)));
+	uk_add_fetch(&g->nr_shared, count);
+}
+
+static struct stack_obj *stack_pop(struct pool_grow *g)
+{
+	__u64 old = uk_load_n(&g->top);
+	struct stack_obj *obj;
+	struct stack_obj *next;
+
+	do {
+		obj = stack_ptr(old);
+		if (!obj)
+			return NULL;
+
+		/* `obj` may have been taken and reused by another lcpu in
+		 * the meantime. `next` is garbage then, but the tag of the
+		 * top changed so that the exchange fails.
+		 */
+		next = UK_READ_ONCE(obj->next);
+	} while (!uk_compare_exchange_n(&g->top, &old,
+					stack_pack(next, old)));
+	uk_sub_fetch(&g->nr_shared, 1);
+	return obj;
+}
+
+/* Take all objects from the shared stack */
+static struct stack_obj *stack_pop_all(struct pool_grow *g,
+				       unsigned long *count)
+{
+	__u64 old = uk_load_n(&g->top);
+	struct stack_obj *list;
+	struct stack_obj *obj;
+
+	*count = 0;
+	do {
+		list = stack_ptr(old);
+		if (!list)
+			return NULL;
+	} while (!uk_compare_exchange_n(&g->top, &old,
+					stack_pack(NULL, old)));
+
+	for (obj = list; obj; obj = obj->next)
+		(*count)++;
+	uk_sub_fetch(&g->nr_shared, *count);
+	return list;
+}
+
+/* Merge sort of a list of `count` objects by ascending address */
+static struct stack_obj *obj_list_sort(struct stack_obj *list,
+				       unsigned long count)
+{
+	struct stack_obj *a, *b, *head, **tail;
+	unsigned long i;
+
+	if (count < 2) {
+		if (list)
+			list->next = NULL;
+		return list;
+	}
+
+	for (b = list, i = 1; i < count / 2; i++)
+		b = b->next;
+	a = list;
+	list = b->next;
+	b->next = NULL;
+	a = obj_list_sort(a, count / 2);
+	b = obj_list_sort(list, count - count / 2);
+
+	tail = &head;
+	while (a && b) {
+		if ((__uptr) a < (__uptr) b) {
+			*tail = a;
+			a = a->next;
+		} else {
+			*tail = b;
+			b = b->next;
+		}
+		tail = &(*tail)->next;
+	}
+	*tail = a ? a : b;
+	return head;
+}
+
+/* Wait until every lcpu that is popping from the shared stack finished
+ * its pop. Pops that start afterwards cannot see objects that were removed
+ * from the stack before.
+ */
+static void grow_quiesce(struct pool_grow *g)
+{
+	unsigned long seq;
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_UKPLAT_LCPU_MAXCOUNT; i++) {
+		seq = uk_load_n(&g->lcpu[i].pop_seq);
+		if (!(seq & 1))
+			continue;
+		while (uk_load_n(&g->lcpu[i].pop_seq) == seq)
+			ukarch_spinwait();
+	}
+}
+
+/* Allocate a new chunk from the parent and push its objects */
+static int grow_add_chunk(struct uk_allocpool *p)
+{
+	struct pool_grow *g = p->grow;
+	struct stack_obj *first = NULL;
+	struct pool_chunk **cp, *c;
+	struct stack_obj *obj;
+	unsigned long flags;
+	__uptr addr;
+
+	uk_spin_lock_irqsave(&g->lock, flags);
+	c = uk_palloc(p->parent, g->chunk_pages);
+	if (unlikely(!c)) {
+		uk_spin_unlock_irqrestore(&g->lock, flags);
+		return -ENOMEM;
+	}
+	c->obj_start = ALIGN_UP((__uptr) c + sizeof(*c), p->obj_align);
+	c->obj_end   = c->obj_start + (__uptr) g->chunk_objs * p->obj_len;
+	for (cp = &g->chunks; *cp && (__uptr) *cp < (__uptr) c;
+	     cp = &(*cp)->next)
+		;
+	c->next = *cp;
+	*cp     = c;
+	g->nr_chunks++;
+	uk_spin_unlock_irqrestore(&g->lock, flags);
+
+	/* Link objects in ascending address order */
+	for (addr = c->obj_end - p->obj_len;; addr -= p->obj_len) {
+		obj = (struct stack_obj *) addr;
+		obj->next = first;
+		first = obj;
+		if (addr == c->obj_start)
+			break;
+	}
+	stack_push(g, first,
+		   (struct stack_obj *) (c->obj_end - p->obj_len),
+		   g->chunk_objs);
+
+	uk_pr_debug("%p: Grown by %lu pages to %u chunks\n",
+		    p, g->chunk_pages, g->nr_chunks);
+	return 0;
+}
+
+/* Fill an empty cache with half of its depth */
+static void grow_lcpu_refill(struct uk_allocpool *p, struct pool_lcpu *lc)
+{
+	struct stack_obj *obj;
+
+	uk_inc(&lc->pop_seq);
+	while (lc->count < LCPU_BATCH) {
+		obj = stack_pop(p->grow);
+		if (unlikely(!obj)) {
+			/* Grow only if we did not get anything */
+			if (lc->count)
+				break;
+			uk_inc(&lc->pop_seq);
+			if (grow_add_chunk(p) < 0)
+				return;
+			uk_inc(&lc->pop_seq);
+			continue;
+		}
+		lc->obj[lc->count++] = obj;
+	}
+	uk_inc(&lc->pop_seq);
+}
+
+/* Move half of the objects of a full cache to the shared stack */
+static void grow_lcpu_flush(struct uk_allocpool *p, struct pool_lcpu *lc)
+{
+	struct stack_obj *obj;
+	unsigned int i;
+
+	UK_ASSERT(lc->count >= LCPU_BATCH);
+
+	for (i = lc->count - LCPU_BATCH; i < lc->count - 1; i++) {
+		obj = (struct stack_obj *) lc->obj[i];
+		obj->next = (struct stack_obj *) lc->obj[i + 1];
+	}
+	stack_push(p->grow,
+		   (struct stack_obj *) lc->obj[lc->count - LCPU_BATCH],
+		   (struct stack_obj *) lc->obj[lc->count - 1],
+		   LCPU_BATCH);
+	lc->count -= LCPU_BATCH;
+}
+
+static void *grow_take(struct uk_allocpool *p)
+{
+	struct pool_lcpu *lc;
+	unsigned long flags;
+	void *obj = NULL;
+
+	/* Disabling interrupts keeps us on this lcpu and protects the
+	 * cache against pool operations from interrupt context
+	 */
+	flags = ukplat_lcpu_save_irqf();
+	lc = &p->grow->lcpu[ukplat_lcpu_idx()];
+	if (unlikely(!lc->count))
+		grow_lcpu_refill(p, lc);
+	if (likely(lc->count))
+		obj = lc->obj[--lc->count];
+	ukplat_lcpu_restore_irqf(flags);
+
+	if (unlikely(!obj)) {
+		uk_alloc_stats_count_enomem(allocpool2ukalloc(p), p->obj_len);
+		return NULL;
+	}
+	uk_alloc_stats_count_alloc(allocpool2ukalloc(p), obj, p->obj_len);
+	return obj;
+}
+
+static void grow_return(struct uk_allocpool *p, void *obj)
+{
+	struct pool_lcpu *lc;
+	unsigned long flags;
+
+	UK_ASSERT(obj);
+
+	uk_alloc_stats_count_free(allocpool2ukalloc(p), obj, p->obj_len);
+
+	flags = ukplat_lcpu_save_irqf();
+	lc = &p->grow->lcpu[ukplat_lcpu_idx()];
+	if (unlikely(lc->count == LCPU_DEPTH))
+		grow_lcpu_flush(p, lc);
+	lc->obj[lc->count++] = obj;
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+static unsigned long grow_availcount(struct pool_grow *g)
+{
+	unsigned long count = uk_load_n(&g->nr_shared);
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_UKPLAT_LCPU_MAXCOUNT; i++)
+		count += UK_READ_ONCE(g->lcpu[i].count);
+	return count;
+}
+
+__sz uk_allocpool_reclaim(struct uk_allocpool *p)
+{
+	struct stack_obj *first = NULL, *last = NULL;
+	struct stack_obj *obj, *cfirst, *clast;
+	struct pool_chunk **cp, *c, *dead = NULL;
+	unsigned long count, kept = 0, n;
+	unsigned int idle = 0;
+	struct pool_grow *g;
+	unsigned long flags;
+	__sz released = 0;
+
+	UK_ASSERT(p);
+
+	g = p->grow;
+	if (!g)
+		return 0;
+
+	uk_spin_lock_irqsave(&g->lock, flags);
+	obj = stack_pop_all(g, &count);
+	obj = obj_list_sort(obj, count);
+
+	/* The objects of a chunk follow each other in the sorted list */
+	cp = &g->chunks;
+	while ((c = *cp)) {
+		cfirst = obj;
+		clast = NULL;
+		for (n = 0; obj && (__uptr) obj < c->obj_end; n++) {
+			UK_ASSERT((__uptr) obj >= c->obj_start);
+			clast = obj;
+			obj = obj->next;
+		}
+
+		/* Keep a few idle chunks for the next burst of allocations */
+		if (n == g->chunk_objs
+		    && idle++ >= CONFIG_LIBUKALLOCPOOL_IDLE_CHUNKS) {
+			*cp = c->next;
+			c->next = dead;
+			dead = c;
+			g->nr_chunks--;
+			released += g->chunk_pages << __PAGE_SHIFT;
+			continue;
+		}
+
+		if (n) {
+			if (last)
+				last->next = cfirst;
+			else
+				first = cfirst;
+			last = clast;
+			kept += n;
+		}
+		cp = &c->next;
+	}
+	UK_ASSERT(!obj);
+
+	if (first)
+		stack_push(g, first, last, kept);
+
+	/* Pops that started before we took the objects may still read the
+	 * links of objects in released chunks
+	 */
+	if (dead)
+		grow_quiesce(g);
+	while ((c = dead)) {
+		dead = c->next;
+		uk_pfree(p->parent, c, g->chunk_pages);
+	}
+	uk_spin_unlock_irqrestore(&g->lock, flags);
+
+	if (released)
+		uk_pr_debug("%p: Released %"__PRIsz" B, %u chunks left\n",
+			    p, released, g->nr_chunks);
+	return released;
+}
+
+/* Release all chunks; all objects must have been returned */
+static void grow_destroy(struct uk_allocpool *p)
+{
+	struct pool_grow *g = p->grow;
+	struct stack_obj *obj;
+	struct pool_lcpu *lc;
+	struct pool_chunk *c;
+	unsigned int i;
+
+	for (i = 0; i < CONFIG_UKPLAT_LCPU_MAXCOUNT; i++) {
+		lc = &g->lcpu[i];
+		while (lc->count >= LCPU_BATCH)
+			grow_lcpu_flush(p, lc);
+		while (lc->count) {
+			obj = (struct stack_obj *) lc->obj[--lc->count];
+			stack_push(g, obj, obj, 1);
+		}
+	}
+
+	/* Make sure we got all objects back */
+	UK_ASSERT(g->nr_shared == (unsigned long) g->nr_chunks
+				  * g->chunk_objs);
+
+	while ((c = g->chunks)) {
+		g->chunks = c->next;
+		uk_pfree(p->parent, c, g->chunk_pages);
+	}
+	uk_free(p->parent, g);
+}
+
+
 static void pool_free(struct uk_alloc *a, void *ptr)
 {
 	struct uk_allocpool *p = ukalloc2pool(a);
@@ -167,12 +621,39 @@ static int pool_posix_memalign(struct uk_alloc *a, void **memptr, __sz align,
 	return 0;
 }
 
+static unsigned int pool_malloc_batch(struct uk_alloc *a, __sz align,
+				      __sz size, void *obj[],
+				      unsigned int count)
+{
+	struct uk_allocpool *p = ukalloc2pool(a);
+
+	if (unlikely((size > p->obj_len)
+		     || (align > p->obj_align))) {
+		uk_alloc_stats_count_enomem(a, p->obj_len);
+		return 0;
+	}
+
+	return uk_allocpool_take_batch(p, obj, count);
+}
+
+static void pool_free_batch(struct uk_alloc *a, void *obj[],
+			    unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; ++i)
+		pool_free(a, obj[i]);
+}
+
 void *uk_allocpool_take(struct uk_allocpool *p)
 {
 	void *obj;
 
 	UK_ASSERT(p);
 
+	if (p->grow)
+		return grow_take(p);
+
 	if (unlikely(uk_list_empty(&p->free_obj))) {
 		uk_alloc_stats_count_enomem(allocpool2ukalloc(p),
 					    p->obj_len);
@@ -193,6 +674,15 @@ unsigned int uk_allocpool_take_batch(struct uk_allocpool *p,
 	UK_ASSERT(p);
 	UK_ASSERT(obj);
 
+	if (p->grow) {
+		for (i = 0; i < count; ++i) {
+			obj[i] = grow_take(p);
+			if (unlikely(!obj[i]))
+				break;
+		}
+		return i;
+	}
+
 	for (i = 0; i < count; ++i) {
 		if (unlikely(uk_list_empty(&p->free_obj)))
 			break;
@@ -212,6 +702,11 @@ void uk_allocpool_return(struct uk_allocpool *p, void *obj)
 {
 	UK_ASSERT(p);
 
+	if (p->grow) {
+		grow_return(p, obj);
+		return;
+	}
+
 	_prepend_free_obj(p, obj);
 	uk_alloc_stats_count_free(allocpool2ukalloc(p),
 				  obj, p->obj_len);
@@ -225,6 +720,12 @@ void uk_allocpool_return_batch(struct uk_allocpool *p,
 	UK_ASSERT(p);
 	UK_ASSERT(obj);
 
+	if (p->grow) {
+		for (i = 0; i < count; ++i)
+			grow_return(p, obj[i]);
+		return;
+	}
+
 	for (i = 0; i < count; ++i) {
 		_prepend_free_obj(p, obj[i]);
 		uk_alloc_stats_count_free(allocpool2ukalloc(p),
@@ -263,6 +764,8 @@ __sz uk_allocpool_reqmem(unsigned int obj_count, __sz obj_len,
 
 unsigned int uk_allocpool_availcount(struct uk_allocpool *p)
 {
+	if (p->grow)
+		return (unsigned int) grow_availcount(p->grow);
 	return p->free_obj_count;
 }
 
@@ -332,12 +835,144 @@ out:
 			     pool_maxalloc,
 			     pool_availmem,
 			     NULL);
+	a->malloc_batch = pool_malloc_batch;
+	a->free_batch   = pool_free_batch;
 
 	uk_pr_debug("%p: Pool created (%"__PRIsz" B): %u objs of %"__PRIsz" B, aligned to %"__PRIsz" B\n",
 		    p, len, p->obj_count, p->obj_len, p->obj_align);
 	return p;
 }
 
+static void *grow_malloc(struct uk_alloc *a, __sz size)
+{
+	struct uk_allocpool *p = ukalloc2pool(a);
+	void *obj;
+
+	if (unlikely(size > p->obj_len)) {
+		uk_alloc_stats_count_enomem(a, p->obj_len);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	obj = grow_take(p);
+	if (unlikely(!obj))
+		errno = ENOMEM;
+	return obj;
+}
+
+static int grow_posix_memalign(struct uk_alloc *a, void **memptr, __sz align,
+			       __sz size)
+{
+	struct uk_allocpool *p = ukalloc2pool(a);
+
+	if (unlikely((size > p->obj_len) || (align > p->obj_align))) {
+		uk_alloc_stats_count_enomem(a, p->obj_len);
+		return ENOMEM;
+	}
+
+	*memptr = grow_take(p);
+	return *memptr ? 0 : ENOMEM;
+}
+
+static void grow_free(struct uk_alloc *a, void *ptr)
+{
+	if (likely(ptr))
+		grow_return(ukalloc2pool(a), ptr);
+}
+
+static void grow_free_batch(struct uk_alloc *a, void *obj[],
+			    unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; ++i)
+		grow_free(a, obj[i]);
+}
+
+static __ssz grow_availmem(struct uk_alloc *a)
+{
+	struct uk_allocpool *p = ukalloc2pool(a);
+
+	/* Memory of the parent is reported by the parent */
+	return (__ssz) (grow_availcount(p->grow) * p->obj_len);
+}
+
+struct uk_allocpool *uk_allocpool_create(struct uk_alloc *parent,
+					 __sz obj_len, __sz obj_align,
+					 unsigned long chunk_pages)
+{
+	struct uk_allocpool *p;
+	struct pool_grow *g;
+	struct uk_alloc *a;
+	__sz chunk_hdr;
+	__sz obj_alen;
+	__sz chunk_objs;
+
+	UK_ASSERT(parent);
+	UK_ASSERT(POWER_OF_2(obj_align));
+
+	/* apply minimum requirements */
+	obj_len   = MAX(obj_len, MIN_OBJ_LEN);
+	obj_align = MAX(obj_align, MIN_OBJ_ALIGN);
+	obj_alen  = ALIGN_UP(obj_len, obj_align);
+
+	/* worst case space for the chunk header and the padding */
+	chunk_hdr = sizeof(struct pool_chunk) + obj_align;
+	if (!chunk_pages)
+		chunk_pages = DIV_ROUND_UP(chunk_hdr
+					   + CHUNK_MIN_OBJS * obj_alen,
+					   __PAGE_SIZE);
+	if (unlikely((chunk_pages << __PAGE_SHIFT) < chunk_hdr + obj_alen)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	chunk_objs = ((chunk_pages << __PAGE_SHIFT) - chunk_hdr) / obj_alen;
+	if (unlikely(chunk_objs > __U32_MAX)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	p = uk_malloc(parent, sizeof(*p));
+	if (unlikely(!p))
+		return NULL;
+	g = uk_memalign(parent, __alignof__(*g), sizeof(*g));
+	if (unlikely(!g)) {
+		uk_free(parent, p);
+		return NULL;
+	}
+
+	memset(p, 0, sizeof(*p));
+	memset(g, 0, sizeof(*g));
+	uk_spin_init(&g->lock);
+	g->chunk_pages = chunk_pages;
+	g->chunk_objs  = (unsigned int) chunk_objs;
+
+	p->obj_len   = obj_alen;
+	p->obj_align = obj_align;
+	p->parent    = parent;
+	p->base      = p;
+	p->grow      = g;
+	UK_INIT_LIST_HEAD(&p->free_obj);
+
+	a = allocpool2ukalloc(p);
+	uk_alloc_init_malloc(a,
+			     grow_malloc,
+			     uk_calloc_compat,
+			     uk_realloc_compat,
+			     grow_free,
+			     grow_posix_memalign,
+			     uk_memalign_compat,
+			     pool_maxalloc,
+			     grow_availmem,
+			     NULL);
+	a->malloc_batch = pool_malloc_batch;
+	a->free_batch   = grow_free_batch;
+
+	uk_pr_debug("%p: Growable pool created: %u objs of %"__PRIsz" B, aligned to %"__PRIsz" B per chunk of %lu pages\n",
+		    p, g->chunk_objs, p->obj_len, p->obj_align, chunk_pages);
+	return p;
+}
+
 struct uk_allocpool *uk_allocpool_alloc(struct uk_alloc *parent,
 					unsigned int obj_count,
 					__sz obj_len, __sz obj_align)
@@ -371,12 +1006,16 @@ void uk_allocpool_free(struct uk_allocpool *p)
 	 */
 	UK_ASSERT(p->parent);
 
+	if (p->grow) {
+		grow_destroy(p);
+		uk_alloc_unregister(allocpool2ukalloc(p));
+		uk_free(p->parent, p->base);
+		return;
+	}
+
 	/* Make sure we got all objects back */
 	UK_ASSERT(p->free_obj_count == p->obj_count);
 
-	/* FIXME: Unregister `ukalloc` interface from `lib/ukalloc` */
-	/* TODO: Provide unregistration interface at `lib/ukalloc` */
-	UK_CRASH("Unregistering from `lib/ukalloc` not implemented.\n");
-
+	uk_alloc_unregister(allocpool2ukalloc(p));
 	uk_free(p->parent, p->base);
 }
@@ -0,0 +1,355 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/* Arenas are regions that are allocated from a parent allocator and that
+ * can be released as a whole: A mark records the current allocation
+ * position, rewinding to a mark drops every allocation that was done after
+ * it, and a reset drops all allocations. Both are O(1) because no
+ * per-object bookkeeping is done.
+ *
+ * An arena consists of a list of chunks. With UK_ALLOCREGION_ARENAF_CHAIN,
+ * a new chunk is appended when the current one is full. Chunks are kept
+ * when the arena is rewound and reused by later allocations, so that a
+ * request handler that rewinds its arena at the end of each request does
+ * not reach the parent allocator again in its steady state. Chunks after
+ * the current position are returned to the parent with
+ * uk_allocregion_arena_trim().
+ *
+ *   +-------------+--------+---------+     +-------+-----------------+
+ *   | arena_chunk | struct | objects | --> | chunk | objects ...     |
+ *   |             | arena  | ...     |     |       |                 |
+ *   +-------------+--------+---------+     +-------+-----------------+
+ *   ^ head (the arena lives in its first chunk)   ^ cur      ^ pos
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <uk/allocregion.h>
+#include <uk/alloc_impl.h>
+#include <uk/essentials.h>
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	uintptr_t end;
+};
+
+struct uk_allocregion_arena {
+	struct uk_alloc a;
+	struct uk_alloc *parent;
+	struct arena_chunk *head;
+	struct arena_chunk *cur;
+	uintptr_t pos;		/* next free byte in `cur` */
+	size_t chunk_len;
+	int flags;
+};
+
+#define ARENA_MIN_ALIGN		sizeof(void *)
+
+static inline struct uk_allocregion_arena *to_arena(struct uk_alloc *a)
+{
+	UK_ASSERT(a);
+
+	return __containerof(a, struct uk_allocregion_arena, a);
+}
+
+static inline uintptr_t chunk_start(struct arena_chunk *c)
+{
+	return (uintptr_t) c + sizeof(*c);
+}
+
+static struct arena_chunk *arena_chunk_alloc(struct uk_alloc *parent,
+					     size_t len)
+{
+	struct arena_chunk *c;
+
+	c = uk_malloc(parent, len);
+	if (unlikely(!c))
+		return NULL;
+
+	c->next = NULL;
+	c->end  = (uintptr_t) c + len;
+	return c;
+}
+
+/* Find a chunk with `size` bytes aligned to `align` after the current one,
+ * either by reusing a retained chunk or by allocating a new one
+ */
+static int arena_next_chunk(struct uk_allocregion_arena *ar, size_t align,
+			    size_t size)
+{
+	struct arena_chunk *c = ar->cur->next;
+	size_t len;
+
+	if (!(ar->flags & UK_ALLOCREGION_ARENAF_CHAIN))
+		return -ENOMEM;
+
+	/* worst case space for the header and the alignment */
+	len = sizeof(*c) + align + size;
+	if (unlikely(len < size))
+		return -ENOMEM;
+
+	if (!c || c->end - chunk_start(c) < align + size) {
+		/* Oversized requests get a chunk on their own. A retained
+		 * chunk that is too small stays behind the new one.
+		 */
+		c = arena_chunk_alloc(ar->parent, MAX(len, ar->chunk_len));
+		if (unlikely(!c))
+			return -ENOMEM;
+		c->next = ar->cur->next;
+		ar->cur->next = c;
+	}
+
+	ar->cur = c;
+	ar->pos = chunk_start(c);
+	return 0;
+}
+
+static void *arena_alloc(struct uk_allocregion_arena *ar, size_t align,
+			 size_t size)
+{
+	uintptr_t intptr;
+
+	UK_ASSERT(POWER_OF_2(align));
+
+	if (unlikely(!size))
+		return NULL;
+
+	intptr = ALIGN_UP(ar->pos, (uintptr_t) align);
+	if (unlikely(intptr < ar->pos || intptr > ar->cur->end
+		     || ar->cur->end - intptr < size)) {
+		if (arena_next_chunk(ar, align, size) < 0)
+			return NULL;
+		intptr = ALIGN_UP(ar->pos, (uintptr_t) align);
+	}
+
+	ar->pos = intptr + size;
+	return (void *) intptr;
+}
+
+static void *arena_malloc(struct uk_alloc *a, size_t size)
+{
+	void *ptr;
+
+	/* Nothing to allocate is not a lack of memory */
+	if (unlikely(!size))
+		return NULL;
+
+	ptr = arena_alloc(to_arena(a), ARENA_MIN_ALIGN, size);
+	uk_alloc_stats_count_alloc(a, ptr, size);
+	if (unlikely(!ptr))
+		errno = ENOMEM;
+	return ptr;
+}
+
+static int arena_posix_memalign(struct uk_alloc *a, void **memptr,
+				size_t align, size_t size)
+{
+	void *ptr;
+
+	/* `memptr` is left untouched on failure */
+	if (unlikely(!size))
+		return EINVAL;
+
+	ptr = arena_alloc(to_arena(a), MAX(align, ARENA_MIN_ALIGN), size);
+	uk_alloc_stats_count_alloc(a, ptr, size);
+	if (unlikely(!ptr))
+		return ENOMEM;
+
+	*memptr = ptr;
+	return 0;
+}
+
+static void arena_free(struct uk_alloc *a __maybe_unused,
+		       void *ptr __maybe_unused)
+{
+	/* Memory is released with a rewind or a reset of the arena. Count
+	 * a free operation but do not release memory from stats.
+	 */
+	uk_alloc_stats_count_free(a, ptr, 0);
+}
+
+static unsigned int arena_malloc_batch(struct uk_alloc *a, size_t align,
+				       size_t size, void *obj[],
+				       unsigned int count)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+	unsigned int i;
+
+	align = MAX(align, ARENA_MIN_ALIGN);
+	for (i = 0; i < count; ++i) {
+		obj[i] = arena_alloc(ar, align, size);
+		if (unlikely(!obj[i]))
+			break;
+		uk_alloc_stats_count_alloc(a, obj[i], size);
+	}
+	if (unlikely(i == 0 && size))
+		uk_alloc_stats_count_enomem(a, size);
+	return i;
+}
+
+static void arena_free_batch(struct uk_alloc *a __maybe_unused,
+			     void *obj[] __maybe_unused,
+			     unsigned int count __maybe_unused)
+{
+#if CONFIG_LIBUKALLOC_IFSTATS
+	unsigned int i;
+
+	for (i = 0; i < count; ++i)
+		uk_alloc_stats_count_free(a, obj[i], 0);
+#endif /* CONFIG_LIBUKALLOC_IFSTATS */
+}
+
+/* The largest space of the arena's own chunks. Chained arenas can take
+ * more from the parent, which reports its memory itself.
+ */
+static ssize_t arena_maxalloc(struct uk_alloc *a)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+	struct arena_chunk *c;
+	ssize_t maxalloc;
+
+	maxalloc = (ssize_t) (ar->cur->end - ar->pos);
+	for (c = ar->cur->next; c; c = c->next)
+		maxalloc = MAX(maxalloc, (ssize_t) (c->end - chunk_start(c)));
+	return maxalloc;
+}
+
+/* Free space of the arena's own chunks, see arena_maxalloc() */
+static ssize_t arena_availmem(struct uk_alloc *a)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+	struct arena_chunk *c;
+	ssize_t avail;
+
+	avail = (ssize_t) (ar->cur->end - ar->pos);
+	for (c = ar->cur->next; c; c = c->next)
+		avail += (ssize_t) (c->end - chunk_start(c));
+	return avail;
+}
+
+struct uk_alloc *uk_allocregion_arena_create(struct uk_alloc *parent,
+					     size_t chunk_len, int flags)
+{
+	struct uk_allocregion_arena *ar;
+	struct arena_chunk *c;
+	struct uk_alloc *a;
+
+	UK_ASSERT(parent);
+
+	if (!chunk_len)
+		chunk_len = CONFIG_LIBUKALLOCREGION_ARENA_CHUNK_LEN;
+	if (unlikely(chunk_len < sizeof(*c) + sizeof(*ar))) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	c = arena_chunk_alloc(parent, chunk_len);
+	if (unlikely(!c))
+		return NULL;
+
+	/* The arena itself lives at the beginning of the first chunk */
+	ar = (struct uk_allocregion_arena *)
+		ALIGN_UP(chunk_start(c), __alignof__(*ar));
+	memset(ar, 0, sizeof(*ar));
+	ar->parent    = parent;
+	ar->head      = c;
+	ar->chunk_len = chunk_len;
+	ar->flags     = flags;
+	uk_allocregion_arena_reset(&ar->a);
+
+	/* NOTE: Arenas are short-living and their memory is accounted by the
+	 *       parent already, so they are not registered as allocators
+	 *       (see uk_alloc_init_malloc()).
+	 */
+	a = &ar->a;
+	a->malloc         = arena_malloc;
+	a->calloc         = uk_calloc_compat;
+	a->realloc        = uk_realloc_compat;
+	a->posix_memalign = arena_posix_memalign;
+	a->memalign       = uk_memalign_compat;
+	a->free           = arena_free;
+	a->palloc         = uk_palloc_compat;
+	a->pfree          = uk_pfree_compat;
+	a->malloc_batch   = arena_malloc_batch;
+	a->free_batch     = arena_free_batch;
+	a->palloc_batch   = uk_palloc_batch_compat;
+	a->pfree_batch    = uk_pfree_batch_compat;
+	a->maxalloc       = arena_maxalloc;
+	a->pmaxalloc      = uk_alloc_pmaxalloc_compat;
+	a->availmem       = arena_availmem;
+	a->pavailmem      = uk_alloc_pavailmem_compat;
+	a->addmem         = NULL;
+	uk_alloc_stats_reset(a);
+
+	uk_pr_debug("%p: Arena created on %p with chunks of %"__PRIsz" B\n",
+		    a, parent, chunk_len);
+	return a;
+}
+
+void uk_allocregion_arena_destroy(struct uk_alloc *a)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+	struct uk_alloc *parent = ar->parent;
+	struct arena_chunk *c, *next;
+
+	/* The first chunk holds the arena, so it is released last */
+	for (c = ar->head->next; c; c = next) {
+		next = c->next;
+		uk_free(parent, c);
+	}
+	uk_free(parent, ar->head);
+}
+
+void uk_allocregion_arena_mark(struct uk_alloc *a,
+			       struct uk_allocregion_mark *m)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+
+	UK_ASSERT(m);
+
+	m->chunk = ar->cur;
+	m->pos   = ar->pos;
+}
+
+void uk_allocregion_arena_rewind(struct uk_alloc *a,
+				 const struct uk_allocregion_mark *m)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+
+	UK_ASSERT(m);
+	UK_ASSERT(m->chunk);
+	UK_ASSERT(m->pos >= chunk_start(m->chunk)
+		  && m->pos <= ((struct arena_chunk *) m->chunk)->end);
+
+	ar->cur = m->chunk;
+	ar->pos = m->pos;
+}
+
+void uk_allocregion_arena_reset(struct uk_alloc *a)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+
+	ar->cur = ar->head;
+	ar->pos = (uintptr_t) ar + sizeof(*ar);
+}
+
+size_t uk_allocregion_arena_trim(struct uk_alloc *a)
+{
+	struct uk_allocregion_arena *ar = to_arena(a);
+	struct arena_chunk *c, *next;
+	size_t released = 0;
+
+	for (c = ar->cur->next; c; c = next) {
+		next = c->next;
+		released += c->end - (uintptr_t) c;
+		uk_free(ar->parent, c);
+	}
+	ar->cur->next = NULL;
+	return released;
+}
@@ -43,6 +43,88 @@ extern "C" {
 /* allocator initialization */
 struct uk_alloc *uk_allocregion_init(void *base, size_t len);
 
+#if CONFIG_LIBUKALLOCREGION_ARENA
+/* Append chunks from the parent when the arena is full */
+#define UK_ALLOCREGION_ARENAF_CHAIN	0x1
+
+/* Allocation position of an arena, see uk_allocregion_arena_mark() */
+struct uk_allocregion_mark {
+	void *chunk;
+	__uptr pos;
+};
+
+/**
+ * Create an arena on a parent allocator. An arena is a region allocator
+ * whose allocations are released together by rewinding it to a mark or by
+ * resetting it. `uk_free()` on an arena does not release memory.
+ * Arenas are not thread-safe.
+ *
+ * @param parent
+ *   Allocator from which the chunks of the arena are allocated
+ * @param chunk_len
+ *   Size of a chunk in bytes, the arena structure is part of the first
+ *   chunk. 0 selects CONFIG_LIBUKALLOCREGION_ARENA_CHUNK_LEN.
+ * @param flags
+ *   UK_ALLOCREGION_ARENAF_CHAIN for allocating more chunks when the arena
+ *   is full. Without it, the arena is limited to its first chunk.
+ * @return
+ *   The arena or NULL on error (errno is set)
+ */
+struct uk_alloc *uk_allocregion_arena_create(struct uk_alloc *parent,
+					     size_t chunk_len, int flags);
+
+/**
+ * Destroy an arena and return all of its chunks to the parent.
+ *
+ * @param a
+ *   Arena returned by uk_allocregion_arena_create()
+ */
+void uk_allocregion_arena_destroy(struct uk_alloc *a);
+
+/**
+ * Record the current allocation position of an arena.
+ *
+ * @param a
+ *   Arena
+ * @param m
+ *   Destination for the mark
+ */
+void uk_allocregion_arena_mark(struct uk_alloc *a,
+			       struct uk_allocregion_mark *m);
+
+/**
+ * Release all allocations that were done after a mark was taken, in O(1).
+ * The mark becomes invalid if a rewind to an earlier mark, a reset, or a
+ * trim released the chunk it refers to.
+ *
+ * @param a
+ *   Arena
+ * @param m
+ *   Mark taken with uk_allocregion_arena_mark()
+ */
+void uk_allocregion_arena_rewind(struct uk_alloc *a,
+				 const struct uk_allocregion_mark *m);
+
+/**
+ * Release all allocations of an arena in O(1). Chained chunks are kept for
+ * subsequent allocations.
+ *
+ * @param a
+ *   Arena
+ */
+void uk_allocregion_arena_reset(struct uk_alloc *a);
+
+/**
+ * Return the chunks behind the current allocation position to the parent.
+ *
+ * @param a
+ *   Arena
+ * @return
+ *   Number of bytes returned to the parent
+ */
+size_t uk_allocregion_arena_trim(struct uk_alloc *a);
+#endif /* CONFIG_LIBUKALLOCREGION_ARENA */
+
 #ifdef __cplusplus
 }
 #endif
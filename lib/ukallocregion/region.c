@@ -149,6 +149,65 @@ static void uk_allocregion_free(struct uk_alloc *a __maybe_unused,
 	uk_alloc_stats_count_free(a, ptr, 0);
 }
 
+static unsigned int uk_allocregion_malloc_batch(struct uk_alloc *a,
+						size_t align, size_t size,
+						void *obj[],
+						unsigned int count)
+{
+	struct uk_allocregion *b;
+	uintptr_t intptr;
+	size_t stride;
+	unsigned int i;
+
+	UK_ASSERT(a != NULL);
+
+	b = (struct uk_allocregion *)&a->priv;
+
+	UK_ASSERT(b != NULL);
+
+	align = MAX(align, sizeof(void *));
+
+	/* align must be a power of two */
+	UK_ASSERT(((align - 1) & align) == 0);
+
+	/* The objects are carved out of the heap back to back, so that the
+	 * whole batch costs a single bounds check
+	 */
+	stride = ALIGN_UP(size, align);
+	intptr = ALIGN_UP((uintptr_t) b->heap_base, (uintptr_t) align);
+	if (!size || stride < size || intptr < (uintptr_t) b->heap_base
+	    || intptr >= (uintptr_t) b->heap_top) {
+		uk_alloc_stats_count_enomem(a, size);
+		return 0;
+	}
+
+	count = MIN(count, ((uintptr_t) b->heap_top - intptr) / stride);
+	for (i = 0; i < count; ++i) {
+		obj[i] = (void *) intptr;
+		intptr += stride;
+		uk_alloc_stats_count_alloc(a, obj[i], size);
+	}
+	if (unlikely(count == 0))
+		uk_alloc_stats_count_enomem(a, size);
+	else
+		b->heap_base = (void *) intptr;
+
+	return count;
+}
+
+static void uk_allocregion_free_batch(struct uk_alloc *a __maybe_unused,
+				      void *obj[] __maybe_unused,
+				      unsigned int count __maybe_unused)
+{
+#if CONFIG_LIBUKALLOC_IFSTATS
+	unsigned int i;
+
+	/* Count free operations but do not release memory from stats */
+	for (i = 0; i < count; ++i)
+		uk_alloc_stats_count_free(a, obj[i], 0);
+#endif /* CONFIG_LIBUKALLOC_IFSTATS */
+}
+
 /* NOTE: We use `uk_allocregion_leftspace()` for `maxalloc` and `availmem`
  *       because it is the same for this region allocator
  */
@@ -214,6 +273,8 @@ struct uk_alloc *uk_allocregion_init(void *base, size_t len)
 				uk_memalign_compat, uk_allocregion_leftspace,
 				uk_allocregion_leftspace,
 				uk_allocregion_addmem);
+	a->malloc_batch = uk_allocregion_malloc_batch;
+	a->free_batch   = uk_allocregion_free_batch;
 
 	return a;
 }
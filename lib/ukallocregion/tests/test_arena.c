@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <uk/test.h>
+#include <uk/alloc.h>
+#include <uk/allocregion.h>
+#include <uk/essentials.h>
+
+#define CHUNK_LEN	4096
+#define OBJ_LEN		48
+#define NR_OBJS		16
+
+static void *objs[NR_OBJS];
+
+/* Arenas are not registered as allocators, so each test case creates and
+ * destroys its own
+ */
+UK_TESTCASE(ukallocregion_arena, alloc)
+{
+	struct uk_alloc *a;
+	unsigned int i;
+
+	a = uk_allocregion_arena_create(uk_alloc_get_default(), CHUNK_LEN, 0);
+	UK_TEST_ASSERT(a != NULL);
+	if (!a)
+		return;
+
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = uk_malloc(a, OBJ_LEN);
+		UK_TEST_EXPECT_NOT_NULL(objs[i]);
+		UK_TEST_EXPECT_ZERO((__uptr) objs[i] & (sizeof(void *) - 1));
+		memset(objs[i], (int) i, OBJ_LEN);
+	}
+	/* Allocations follow each other without overlapping */
+	for (i = 1; i < NR_OBJS; i++)
+		UK_TEST_EXPECT_SNUM_GE((__uptr) objs[i] - (__uptr) objs[i - 1],
+				       OBJ_LEN);
+	UK_TEST_EXPECT_ZERO(((unsigned char *) objs[0])[OBJ_LEN - 1]);
+
+	/* An empty request is not a lack of memory */
+	errno = 0;
+	UK_TEST_EXPECT_NULL(uk_malloc(a, 0));
+	UK_TEST_EXPECT_SNUM_NQ(errno, ENOMEM);
+	uk_allocregion_arena_destroy(a);
+}
+
+UK_TESTCASE(ukallocregion_arena, rewind_and_reset)
+{
+	struct uk_allocregion_mark m;
+	struct uk_alloc *a;
+	void *first, *p;
+
+	a = uk_allocregion_arena_create(uk_alloc_get_default(), CHUNK_LEN, 0);
+	UK_TEST_ASSERT(a != NULL);
+	if (!a)
+		return;
+
+	first = uk_malloc(a, OBJ_LEN);
+	UK_TEST_EXPECT_NOT_NULL(first);
+
+	/* Allocations after a mark are dropped by rewinding to it */
+	uk_allocregion_arena_mark(a, &m);
+	p = uk_malloc(a, OBJ_LEN);
+	UK_TEST_EXPECT_NOT_NULL(p);
+	uk_malloc(a, OBJ_LEN);
+	uk_allocregion_arena_rewind(a, &m);
+	UK_TEST_EXPECT_PTR_EQ(uk_malloc(a, OBJ_LEN), p);
+
+	/* A reset drops everything */
+	uk_allocregion_arena_reset(a);
+	UK_TEST_EXPECT_PTR_EQ(uk_malloc(a, OBJ_LEN), first);
+
+	uk_allocregion_arena_destroy(a);
+}
+
+UK_TESTCASE(ukallocregion_arena, memalign)
+{
+	__sz aligns[] = { 8, 16, 64, 256, 1024 };
+	struct uk_alloc *a;
+	unsigned int i;
+	void *p;
+	int rc;
+
+	a = uk_allocregion_arena_create(uk_alloc_get_default(), CHUNK_LEN, 0);
+	UK_TEST_ASSERT(a != NULL);
+	if (!a)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(aligns); i++) {
+		/* Misalign the position first */
+		uk_malloc(a, 8);
+		rc = uk_posix_memalign(a, &p, aligns[i], 24);
+		UK_TEST_EXPECT_ZERO(rc);
+		UK_TEST_EXPECT_ZERO((__uptr) p & (aligns[i] - 1));
+	}
+
+	/* Failing requests leave `memptr` untouched */
+	p = objs;
+	rc = uk_posix_memalign(a, &p, 16, 0);
+	UK_TEST_EXPECT_SNUM_EQ(rc, EINVAL);
+	UK_TEST_EXPECT_PTR_EQ(p, objs);
+
+	rc = uk_posix_memalign(a, &p, 16, CHUNK_LEN);
+	UK_TEST_EXPECT_SNUM_EQ(rc, ENOMEM);
+	UK_TEST_EXPECT_PTR_EQ(p, objs);
+
+	uk_allocregion_arena_destroy(a);
+}
+
+UK_TESTCASE(ukallocregion_arena, exhaustion)
+{
+	struct uk_alloc *a;
+	unsigned int n;
+	void *p;
+
+	/* Without chaining, the arena is limited to its first chunk */
+	a = uk_allocregion_arena_create(uk_alloc_get_default(), CHUNK_LEN, 0);
+	UK_TEST_ASSERT(a != NULL);
+	if (!a)
+		return;
+
+	for (n = 0; n <= CHUNK_LEN / OBJ_LEN; n++) {
+		if (!uk_malloc(a, OBJ_LEN))
+			break;
+	}
+	UK_TEST_EXPECT_SNUM_GT(n, 0);
+	UK_TEST_EXPECT_SNUM_LT(n, CHUNK_LEN / OBJ_LEN);
+	UK_TEST_EXPECT_NULL(uk_malloc(a, OBJ_LEN));
+	UK_TEST_EXPECT_SNUM_LT(uk_alloc_maxalloc(a), OBJ_LEN);
+
+	/* Rewound memory can be allocated again */
+	uk_allocregion_arena_reset(a);
+	UK_TEST_EXPECT_NOT_NULL(uk_malloc(a, OBJ_LEN));
+	uk_allocregion_arena_destroy(a);
+
+	/* With chaining, full chunks are followed by new ones, also for
+	 * requests that are bigger than a chunk
+	 */
+	a = uk_allocregion_arena_create(uk_alloc_get_default(), CHUNK_LEN,
+					UK_ALLOCREGION_ARENAF_CHAIN);
+	UK_TEST_ASSERT(a != NULL);
+	if (!a)
+		return;
+
+	/* The memory of the parent is not reported as the arena's */
+	UK_TEST_EXPECT_SNUM_LE(uk_alloc_availmem(a), CHUNK_LEN);
+	UK_TEST_EXPECT_SNUM_LE(uk_alloc_maxalloc(a), CHUNK_LEN);
+
+	for (n = 0; n < 4 * CHUNK_LEN / OBJ_LEN; n++) {
+		if (!uk_malloc(a, OBJ_LEN))
+			break;
+	}
+	UK_TEST_EXPECT_SNUM_EQ(n, 4 * CHUNK_LEN / OBJ_LEN);
+	p = uk_malloc(a, 2 * CHUNK_LEN);
+	UK_TEST_EXPECT_NOT_NULL(p);
+
+	/* Chunks behind the position are kept by a reset until trimmed */
+	uk_allocregion_arena_reset(a);
+	UK_TEST_EXPECT_SNUM_GT(uk_allocregion_arena_trim(a), 4 * CHUNK_LEN);
+	UK_TEST_EXPECT_ZERO(uk_allocregion_arena_trim(a));
+
+	uk_allocregion_arena_destroy(a);
+}
+
+uk_testsuite_register(ukallocregion_arena, NULL);
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#ifndef __UKALLOCSLAB_H__
+#define __UKALLOCSLAB_H__
+
+#include <uk/alloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a slab allocator on top of a parent allocator.
+ * Small objects are served from size-class slabs, each slab being a single
+ * page requested with `uk_palloc()` from the parent. Allocations larger than
+ * half a page, as well as all page allocations, are forwarded to the parent
+ * as whole pages.
+ *
+ * @param parent
+ *   Page allocator that backs the slabs and that is used for the internal
+ *   allocator structures
+ * @return
+ *   The slab allocator or NULL on error
+ */
+struct uk_alloc *uk_allocslab_create(struct uk_alloc *parent);
+
+/**
+ * Initialize a slab allocator on the memory region [base, base + len).
+ * A binary buddy page allocator is initialized on the region as page backend
+ * and the slab allocator is made the default allocator. Further memory is
+ * added to the page backend with `uk_alloc_addmem()`.
+ *
+ * @param base
+ *   Start of the memory region
+ * @param len
+ *   Length of the memory region in bytes
+ * @return
+ *   The slab allocator or NULL on error
+ */
+struct uk_alloc *uk_allocslab_init(void *base, __sz len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UKALLOCSLAB_H__ */
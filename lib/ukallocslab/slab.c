@@ -0,0 +1,499 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <uk/allocslab.h>
+#include <uk/allocbbuddy.h>
+#include <uk/alloc_impl.h>
+#include <uk/arch/limits.h>
+#include <uk/arch/paging.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/list.h>
+#include <uk/page.h>
+#include <uk/print.h>
+
+/*
+ * SLAB: MEMORY LAYOUT
+ *
+ * Every slab is a single page that is requested from the parent allocator.
+ * The slab header is placed at the beginning of the page and is padded to
+ * SLAB_HDR_LEN bytes. It is followed by the objects of a single size class:
+ *
+ *          ++-------------------++  <- page aligned
+ *          ||    struct slab    ||
+ *          ++-------------------++  <- SLAB_HDR_LEN
+ *          |      OBJECT 1       |
+ *          +=====================+
+ *          |      OBJECT 2       |
+ *          +=====================+
+ *          |        ...          |
+ *          v                     v
+ *
+ * Allocations that are too large for a slab get whole pages from the parent
+ * and carry a `struct slab_large` header instead. Both headers start with a
+ * pointer to the size class, which is NULL for large allocations. Because
+ * slab objects are never page aligned, the header of an object is always at
+ * the beginning of its page. For page aligned (large) allocations, the header
+ * is at the beginning of the preceding page, like with uk_malloc_ifpages().
+ */
+
+#define SLAB_HDR_LEN		64
+#define SLAB_MIN_ALIGN		16
+#define SLAB_PAYLOAD_LEN	(__PAGE_SIZE - SLAB_HDR_LEN)
+#define SLAB_MAX_OBJ_LEN	ALIGN_DOWN(SLAB_PAYLOAD_LEN / 2, SLAB_MIN_ALIGN)
+
+/* Object sizes of the size classes in ascending order. The last classes are
+ * chosen so that they fill a slab without leaving unused space behind.
+ */
+static const __sz slab_class_len[] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	ALIGN_DOWN(SLAB_PAYLOAD_LEN / 6, SLAB_MIN_ALIGN),
+	ALIGN_DOWN(SLAB_PAYLOAD_LEN / 4, SLAB_MIN_ALIGN),
+	ALIGN_DOWN(SLAB_PAYLOAD_LEN / 3, SLAB_MIN_ALIGN),
+	SLAB_MAX_OBJ_LEN,
+};
+
+#define SLAB_NR_CLASSES		ARRAY_SIZE(slab_class_len)
+
+/* Lookup table from request size (in SLAB_MIN_ALIGN units) to size class */
+#define SLAB_LUT_LEN		(SLAB_MAX_OBJ_LEN / SLAB_MIN_ALIGN + 1)
+#define slab_lut_idx(size)	DIV_ROUND_UP((size), SLAB_MIN_ALIGN)
+
+UK_CTASSERT(ALIGN_DOWN(SLAB_PAYLOAD_LEN / 6, SLAB_MIN_ALIGN) > 512);
+
+struct slab_class {
+	__sz obj_len;
+	unsigned int obj_count;		/* objects per slab */
+	struct uk_list_head partial;	/* slabs with free objects */
+	struct slab *spare;		/* completely free slab kept for reuse */
+	unsigned long nr_slabs;
+};
+
+struct slab {
+	struct slab_class *cls;
+	struct uk_list_head list;
+	void *free_obj;			/* singly-linked list of free objects */
+	unsigned int free_count;
+};
+
+struct slab_large {
+	struct slab_class *cls;		/* always NULL */
+	void *base;
+	unsigned long num_pages;
+};
+
+UK_CTASSERT(sizeof(struct slab) <= SLAB_HDR_LEN);
+UK_CTASSERT(sizeof(struct slab_large) <= SLAB_HDR_LEN);
+UK_CTASSERT(__offsetof(struct slab, cls) ==
+	    __offsetof(struct slab_large, cls));
+
+struct uk_allocslab {
+	struct uk_alloc a;
+	struct uk_alloc *parent;
+	__sz free_bytes;		/* bytes of free objects in slabs */
+	struct slab_class classes[SLAB_NR_CLASSES];
+	__u8 lut[SLAB_LUT_LEN];
+};
+
+static inline struct uk_allocslab *to_allocslab(struct uk_alloc *a)
+{
+	UK_ASSERT(a);
+
+	return __containerof(a, struct uk_allocslab, a);
+}
+
+static inline struct slab *slab_hdr(const void *ptr)
+{
+	__uptr page = PAGE_ALIGN_DOWN((__uptr) ptr);
+
+	/* Slab objects are never page aligned, see memory layout */
+	if (page == (__uptr) ptr)
+		page -= __PAGE_SIZE;
+	return (struct slab *) page;
+}
+
+static __sz slab_usable_size(const void *ptr)
+{
+	struct slab *slab = slab_hdr(ptr);
+	struct slab_large *hdr;
+
+	if (likely(slab->cls))
+		return slab->cls->obj_len;
+
+	hdr = (struct slab_large *) slab;
+	return (__uptr) hdr->base + (hdr->num_pages << __PAGE_SHIFT)
+	       - (__uptr) ptr;
+}
+
+static struct slab_class *slab_class_of(struct uk_allocslab *s,
+					__sz size, __sz align)
+{
+	unsigned int i;
+
+	if (size > SLAB_MAX_OBJ_LEN || align > SLAB_HDR_LEN)
+		return NULL;
+
+	/* Objects are at SLAB_HDR_LEN + n * obj_len within their page, so
+	 * they are aligned to `align` if obj_len is a multiple of it.
+	 */
+	for (i = s->lut[slab_lut_idx(size)]; i < SLAB_NR_CLASSES; i++) {
+		if ((s->classes[i].obj_len & (align - 1)) == 0)
+			return &s->classes[i];
+	}
+	return NULL;
+}
+
+static struct slab *slab_new(struct uk_allocslab *s, struct slab_class *cls)
+{
+	struct slab *slab;
+	unsigned int i;
+	__uptr obj;
+
+	slab = uk_palloc(s->parent, 1);
+	if (unlikely(!slab))
+		return NULL;
+
+	slab->cls = cls;
+	slab->free_obj = NULL;
+	slab->free_count = cls->obj_count;
+
+	/* Build the free list backwards so that objects are handed out in
+	 * ascending address order
+	 */
+	obj = (__uptr) slab + SLAB_HDR_LEN
+	      + (cls->obj_count - 1) * cls->obj_len;
+	for (i = 0; i < cls->obj_count; i++) {
+		*((void **) obj) = slab->free_obj;
+		slab->free_obj = (void *) obj;
+		obj -= cls->obj_len;
+	}
+
+	cls->nr_slabs++;
+	s->free_bytes += cls->obj_count * cls->obj_len;
+	return slab;
+}
+
+static void *slab_class_alloc(struct uk_allocslab *s, struct slab_class *cls)
+{
+	struct slab *slab;
+	void *obj;
+
+	if (likely(!uk_list_empty(&cls->partial))) {
+		slab = uk_list_first_entry(&cls->partial, struct slab, list);
+	} else {
+		if (cls->spare) {
+			slab = cls->spare;
+			cls->spare = NULL;
+		} else {
+			slab = slab_new(s, cls);
+			if (unlikely(!slab))
+				return NULL;
+		}
+		uk_list_add(&slab->list, &cls->partial);
+	}
+
+	UK_ASSERT(slab->free_count > 0);
+	obj = slab->free_obj;
+	slab->free_obj = *((void **) obj);
+	if (--slab->free_count == 0)
+		uk_list_del(&slab->list);
+
+	s->free_bytes -= cls->obj_len;
+	return obj;
+}
+
+static void slab_class_free(struct uk_allocslab *s, struct slab *slab,
+			    void *obj)
+{
+	struct slab_class *cls = slab->cls;
+
+	UK_ASSERT(((__uptr) obj - (__uptr) slab - SLAB_HDR_LEN)
+		  % cls->obj_len == 0);
+	UK_ASSERT(slab->free_count < cls->obj_count);
+
+	*((void **) obj) = slab->free_obj;
+	slab->free_obj = obj;
+	s->free_bytes += cls->obj_len;
+
+	/* A full slab becomes available again */
+	if (slab->free_count++ == 0)
+		uk_list_add(&slab->list, &cls->partial);
+	if (slab->free_count < cls->obj_count)
+		return;
+
+	/* The slab is completely free now. We keep one of them per class to
+	 * avoid bouncing pages with the parent on alloc/free cycles.
+	 */
+	uk_list_del(&slab->list);
+	if (!cls->spare) {
+		cls->spare = slab;
+		return;
+	}
+
+	cls->nr_slabs--;
+	s->free_bytes -= cls->obj_count * cls->obj_len;
+	uk_pfree(s->parent, slab, 1);
+}
+
+static void *slab_large_alloc(struct uk_allocslab *s, __sz size, __sz align)
+{
+	struct slab_large *hdr;
+	unsigned long num_pages;
+	__sz realsize;
+	__uptr base;
+	void *ptr;
+
+	/* Reserve space for the header and for aligning the object */
+	realsize = size + SLAB_HDR_LEN + ((align > SLAB_HDR_LEN) ? align : 0);
+	if (unlikely(realsize < size || PAGE_ALIGN_UP(realsize) < realsize))
+		return NULL;
+
+	num_pages = PAGE_ALIGN_UP(realsize) >> __PAGE_SHIFT;
+	base = (__uptr) uk_palloc(s->parent, num_pages);
+	if (unlikely(!base))
+		return NULL;
+
+	ptr = (void *) ALIGN_UP(base + SLAB_HDR_LEN, (__uptr) align);
+	hdr = (struct slab_large *) slab_hdr(ptr);
+	UK_ASSERT((__uptr) hdr >= base);
+
+	hdr->cls = NULL;
+	hdr->base = (void *) base;
+	hdr->num_pages = num_pages;
+	return ptr;
+}
+
+static void slab_free(struct uk_alloc *a, void *ptr)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+	struct slab_large *hdr;
+	struct slab *slab;
+
+	if (unlikely(!ptr))
+		return;
+
+	uk_alloc_stats_count_free(a, ptr, slab_usable_size(ptr));
+
+	slab = slab_hdr(ptr);
+	if (likely(slab->cls)) {
+		slab_class_free(s, slab, ptr);
+		return;
+	}
+
+	hdr = (struct slab_large *) slab;
+	UK_ASSERT(hdr->base);
+	UK_ASSERT(hdr->num_pages);
+	uk_pfree(s->parent, hdr->base, hdr->num_pages);
+}
+
+static void *slab_malloc(struct uk_alloc *a, __sz size)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+	struct slab_class *cls;
+	void *obj;
+
+	if (unlikely(!size))
+		return NULL;
+
+	cls = slab_class_of(s, size, SLAB_MIN_ALIGN);
+	if (likely(cls))
+		obj = slab_class_alloc(s, cls);
+	else
+		obj = slab_large_alloc(s, size, SLAB_MIN_ALIGN);
+
+	if (unlikely(!obj)) {
+		uk_alloc_stats_count_enomem(a, size);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	uk_alloc_stats_count_alloc(a, obj, slab_usable_size(obj));
+	return obj;
+}
+
+static int slab_posix_memalign(struct uk_alloc *a, void **memptr,
+			       __sz align, __sz size)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+	struct slab_class *cls;
+	void *obj;
+
+	if (((align - 1) & align) != 0
+	    || (align % sizeof(void *)) != 0)
+		return EINVAL;
+
+	/* Leave memptr untouched. See comment in uk_posix_memalign_ifpages. */
+	if (!size)
+		return EINVAL;
+
+	align = MAX(align, (__sz) SLAB_MIN_ALIGN);
+
+	cls = slab_class_of(s, size, align);
+	if (cls)
+		obj = slab_class_alloc(s, cls);
+	else
+		obj = slab_large_alloc(s, size, align);
+
+	if (unlikely(!obj)) {
+		uk_alloc_stats_count_enomem(a, size);
+		return ENOMEM;
+	}
+
+	uk_alloc_stats_count_alloc(a, obj, slab_usable_size(obj));
+	*memptr = obj;
+	return 0;
+}
+
+static void *slab_realloc(struct uk_alloc *a, void *ptr, __sz size)
+{
+	void *retptr;
+	__sz cursize;
+
+	if (!ptr)
+		return slab_malloc(a, size);
+
+	if (!size) {
+		slab_free(a, ptr);
+		return NULL;
+	}
+
+	/* Keep the object in place as long as it fits and we would not
+	 * save more than half of it by moving to a smaller one
+	 */
+	cursize = slab_usable_size(ptr);
+	if (size <= cursize && size > cursize / 2)
+		return ptr;
+
+	retptr = slab_malloc(a, size);
+	if (!retptr)
+		return NULL;
+
+	memcpy(retptr, ptr, MIN(size, cursize));
+	slab_free(a, ptr);
+	return retptr;
+}
+
+/* Page allocations bypass the slabs and go straight to the parent */
+static void *slab_palloc(struct uk_alloc *a, unsigned long num_pages)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+	void *ptr;
+
+	ptr = uk_palloc(s->parent, num_pages);
+	uk_alloc_stats_count_palloc(a, ptr, num_pages);
+	return ptr;
+}
+
+static void slab_pfree(struct uk_alloc *a, void *ptr, unsigned long num_pages)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+
+	uk_alloc_stats_count_pfree(a, ptr, num_pages);
+	uk_pfree(s->parent, ptr, num_pages);
+}
+
+static __ssz slab_maxalloc(struct uk_alloc *a)
+{
+	struct uk_allocslab *s = to_allocslab(a);
+	long num_pages;
+	__ssz maxalloc;
+
+	num_pages = uk_alloc_pmaxalloc(s->parent);
+	if (num_pages < 0)
+		return (__ssz) num_pages;
+
+	maxalloc = ((__ssz) num_pages) << __PAGE_SHIFT;
+	if (maxalloc <= SLAB_HDR_LEN)
+		return 0;
+	return maxalloc - SLAB_HDR_LEN;
+}
+
+/* NOTE: The parent allocator is registered as well and accounts for its
+ *       free pages itself. In order to not count memory twice with
+ *       `uk_alloc_availmem_total()`, we only report the memory that is held
+ *       as free objects in our slabs.
+ */
+static __ssz slab_availmem(struct uk_alloc *a)
+{
+	return (__ssz) to_allocslab(a)->free_bytes;
+}
+
+static int slab_addmem(struct uk_alloc *a, void *base, __sz len)
+{
+	return uk_alloc_addmem(to_allocslab(a)->parent, base, len);
+}
+
+struct uk_alloc *uk_allocslab_create(struct uk_alloc *parent)
+{
+	struct uk_allocslab *s;
+	struct slab_class *cls;
+	unsigned int i, j;
+
+	UK_ASSERT(parent);
+
+	s = uk_malloc(parent, sizeof(*s));
+	if (unlikely(!s)) {
+		uk_pr_err("Failed to allocate slab allocator\n");
+		return NULL;
+	}
+	memset(s, 0, sizeof(*s));
+	s->parent = parent;
+
+	for (i = 0, j = 0; i < SLAB_NR_CLASSES; i++) {
+		cls = &s->classes[i];
+		cls->obj_len = slab_class_len[i];
+		cls->obj_count = SLAB_PAYLOAD_LEN / cls->obj_len;
+		UK_INIT_LIST_HEAD(&cls->partial);
+
+		/* Map all sizes up to obj_len that are not covered by a
+		 * smaller class to this class
+		 */
+		for (; j <= slab_lut_idx(cls->obj_len); j++)
+			s->lut[j] = (__u8) i;
+	}
+	UK_ASSERT(j == SLAB_LUT_LEN);
+
+	uk_alloc_init_malloc(&s->a,
+			     slab_malloc,
+			     uk_calloc_compat,
+			     slab_realloc,
+			     slab_free,
+			     slab_posix_memalign,
+			     uk_memalign_compat,
+			     slab_maxalloc,
+			     slab_availmem,
+			     slab_addmem);
+	s->a.palloc = slab_palloc;
+	s->a.pfree  = slab_pfree;
+
+	uk_pr_debug("%p: Slab allocator created on parent %p: %u size classes up to %"__PRIsz" B\n",
+		    &s->a, parent, (unsigned int) SLAB_NR_CLASSES,
+		    (__sz) SLAB_MAX_OBJ_LEN);
+	return &s->a;
+}
+
+struct uk_alloc *uk_allocslab_init(void *base, __sz len)
+{
+	struct uk_alloc *pa, *a;
+
+	pa = uk_allocbbuddy_init(base, len);
+	if (unlikely(!pa))
+		return NULL;
+
+	a = uk_allocslab_create(pa);
+	if (unlikely(!a))
+		return NULL;
+
+	uk_pr_info("Initialize slab allocator %p on page allocator %p\n",
+		   a, pa);
+
+	/* The page backend registered itself first */
+	uk_alloc_set_default(a);
+	return a;
+}
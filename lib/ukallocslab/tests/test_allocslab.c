@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <string.h>
+#include <uk/test.h>
+#include <uk/alloc_impl.h>
+#include <uk/allocslab.h>
+#include <uk/essentials.h>
+
+#define NR_OBJS		1024
+#define OBJ_LEN		32
+
+static void *objs[NR_OBJS];
+
+/* All allocators register themselves and cannot be unregistered, so the
+ * test cases share a single slab allocator on top of the default allocator.
+ */
+static struct uk_alloc *test_slab(void)
+{
+	static struct uk_alloc *a;
+
+	if (!a)
+		a = uk_allocslab_create(uk_alloc_get_default());
+	return a;
+}
+
+UK_TESTCASE(ukallocslab, malloc_free_sizes)
+{
+	struct uk_alloc *a = test_slab();
+	__sz sizes[] = { 1, 16, 17, 100, 512, 1000, 2016, 2017, 8192, 65536 };
+	unsigned int i;
+
+	UK_TEST_ASSERT(a != NULL);
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		objs[i] = uk_malloc(a, sizes[i]);
+		UK_TEST_EXPECT_NOT_NULL(objs[i]);
+		UK_TEST_EXPECT_ZERO((__uptr) objs[i] & 15);
+		memset(objs[i], 0xa5, sizes[i]);
+	}
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		uk_free(a, objs[i]);
+
+	UK_TEST_EXPECT_NULL(uk_malloc(a, 0));
+}
+
+UK_TESTCASE(ukallocslab, memalign)
+{
+	struct uk_alloc *a = test_slab();
+	__sz aligns[] = { 16, 32, 64, 128, 4096, 16384 };
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < ARRAY_SIZE(aligns); i++) {
+		rc = uk_posix_memalign(a, &objs[i], aligns[i], 40);
+		UK_TEST_EXPECT_ZERO(rc);
+		UK_TEST_EXPECT_ZERO((__uptr) objs[i] & (aligns[i] - 1));
+	}
+	for (i = 0; i < ARRAY_SIZE(aligns); i++)
+		uk_free(a, objs[i]);
+}
+
+UK_TESTCASE(ukallocslab, realloc_keeps_data)
+{
+	struct uk_alloc *a = test_slab();
+	char *p;
+
+	p = uk_malloc(a, 24);
+	UK_TEST_ASSERT(p != NULL);
+	memcpy(p, "slab-realloc", 13);
+
+	p = uk_realloc(a, p, 3000);
+	UK_TEST_ASSERT(p != NULL);
+	UK_TEST_EXPECT_ZERO(memcmp(p, "slab-realloc", 13));
+
+	p = uk_realloc(a, p, 20);
+	UK_TEST_ASSERT(p != NULL);
+	UK_TEST_EXPECT_ZERO(memcmp(p, "slab-realloc", 13));
+	uk_free(a, p);
+}
+
+/* Small objects must share pages instead of consuming a page each */
+UK_TESTCASE(ukallocslab, small_object_overhead)
+{
+	struct uk_alloc *a = test_slab();
+	long before, after;
+	unsigned int i;
+
+	before = uk_alloc_pavailmem_total();
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = uk_malloc(a, OBJ_LEN);
+		UK_TEST_ASSERT(objs[i] != NULL);
+	}
+	after = uk_alloc_pavailmem_total();
+
+	uk_test_printf("%u objects of %u B consumed %ld pages\n",
+		       NR_OBJS, OBJ_LEN, before - after);
+	UK_TEST_EXPECT_SNUM_LE(before - after,
+			       DIV_ROUND_UP(NR_OBJS * OBJ_LEN,
+					    __PAGE_SIZE / 2) + 1);
+
+	for (i = 0; i < NR_OBJS; i++)
+		uk_free(a, objs[i]);
+}
+
+/* Freed objects must be reused: a second round of allocations must not
+ * consume more pages than the first, and live objects must not overlap.
+ */
+UK_TESTCASE(ukallocslab, small_object_reuse)
+{
+	struct uk_alloc *a = test_slab();
+	unsigned int i, j, nr_bad;
+	long first, second;
+	unsigned char *o;
+
+	first = uk_alloc_pavailmem_total();
+	for (i = 0; i < NR_OBJS; i++) {
+		objs[i] = uk_malloc(a, OBJ_LEN);
+		UK_TEST_ASSERT(objs[i] != NULL);
+	}
+	first -= uk_alloc_pavailmem_total();
+	for (i = 0; i < NR_OBJS; i++)
+		uk_free(a, objs[i]);
+
+	for (j = 0; j < 4; j++) {
+		second = uk_alloc_pavailmem_total();
+		for (i = 0; i < NR_OBJS; i++) {
+			objs[i] = uk_malloc(a, OBJ_LEN);
+			if (!objs[i])
+				break;
+			memset(objs[i], (int) (i & 0xff), OBJ_LEN);
+		}
+		UK_TEST_EXPECT_SNUM_EQ(i, NR_OBJS);
+		if (unlikely(i < NR_OBJS)) {
+			while (i--)
+				uk_free(a, objs[i]);
+			return;
+		}
+		second -= uk_alloc_pavailmem_total();
+		UK_TEST_EXPECT_SNUM_LE(second, first);
+
+		nr_bad = 0;
+		for (i = 0; i < NR_OBJS; i++) {
+			o = objs[i];
+			if (o[0] != (i & 0xff) || o[OBJ_LEN - 1] != (i & 0xff))
+				nr_bad++;
+			uk_free(a, o);
+		}
+		UK_TEST_EXPECT_ZERO(nr_bad);
+	}
+}
+
+uk_testsuite_register(ukallocslab, NULL);
@@ -55,6 +55,9 @@
 #elif CONFIG_LIBUKBOOT_INITREGION
 #include <uk/allocregion.h>
 #define uk_alloc_init uk_allocregion_init
+#elif CONFIG_LIBUKBOOT_INITSLAB
+#include <uk/allocslab.h>
+#define uk_alloc_init uk_allocslab_init
 #elif CONFIG_LIBUKBOOT_INITMIMALLOC
 #include <uk/mimalloc.h>
 #define uk_alloc_init uk_mimalloc_init
@@ -78,6 +81,13 @@
 #if CONFIG_LIBUKBOOT_INITSCHEDCOOP
 #include <uk/schedcoop.h>
 #endif /* CONFIG_LIBUKBOOT_INITSCHEDCOOP */
+#if CONFIG_LIBUKBOOT_INITSCHEDSMP
+#include <uk/schedsmp.h>
+#include <uk/alloccache.h>
+#endif /* CONFIG_LIBUKBOOT_INITSCHEDSMP */
+#if CONFIG_LIBUKBOOT_INITSCHEDPRIO
+#include <uk/schedprio.h>
+#endif /* CONFIG_LIBUKBOOT_INITSCHEDPRIO */
 #include <uk/arch/lcpu.h>
 #include <uk/plat/bootstrap.h>
 #include <uk/plat/common/lcpu.h>
@@ -150,6 +160,11 @@ static struct uk_alloc *heap_init()
 #ifdef CONFIG_LIBUKVMEM
 #define HEAP_INITIAL_PAGES		16
 #define HEAP_INITIAL_LEN		(HEAP_INITIAL_PAGES << PAGE_SHIFT)
+#ifdef CONFIG_LIBUKBOOT_HEAP_HUGE
+#define HEAP_VMA_FLAGS		(UK_VMA_MAP_UNINITIALIZED | UK_VMA_MAP_HUGE)
+#else /* CONFIG_LIBUKBOOT_HEAP_HUGE */
+#define HEAP_VMA_FLAGS		UK_VMA_MAP_UNINITIALIZED
+#endif /* !CONFIG_LIBUKBOOT_HEAP_HUGE */
 	/* In addition to paging, we have virtual address space management. We
 	 * will thus also represent the heap as a dedicated VMA to enable
 	 * on-demand paging for the heap. However, we have a chicken-egg
@@ -184,8 +199,7 @@ static struct uk_alloc *heap_init()
 	vaddr = heap_base;
 	rc = uk_vma_map_anon(&kernel_vas, &vaddr,
 			     (alloc_pages + HEAP_INITIAL_PAGES) << PAGE_SHIFT,
-			     PAGE_ATTR_PROT_RW, UK_VMA_MAP_UNINITIALIZED,
-			     "heap");
+			     PAGE_ATTR_PROT_RW, HEAP_VMA_FLAGS, "heap");
 	if (unlikely(rc))
 		return NULL;
 
@@ -329,11 +343,21 @@ void ukplat_entry(int argc, char *argv[])
 	a = heap_init();
 	if (unlikely(!a))
 		UK_CRASH("Failed to initialize memory allocator\n");
-	else {
-		rc = ukplat_memallocator_set(a);
-		if (unlikely(rc != 0))
-			UK_CRASH("Could not set the platform memory allocator\n");
-	}
+#if CONFIG_LIBUKBOOT_INITSCHEDSMP
+	/* The heap allocators are not thread-safe. With threads running on
+	 * all lcpus, every request goes through the caching front-end, which
+	 * calls into the heap only under its parent lock.
+	 */
+	a = uk_alloccache_create(a);
+	if (unlikely(!a))
+		UK_CRASH("Failed to initialize caching allocator\n");
+	rc = uk_alloc_set_default(a);
+	if (unlikely(rc != 0))
+		UK_CRASH("Could not set the default memory allocator\n");
+#endif /* CONFIG_LIBUKBOOT_INITSCHEDSMP */
+	rc = ukplat_memallocator_set(a);
+	if (unlikely(rc != 0))
+		UK_CRASH("Could not set the platform memory allocator\n");
 
 	sa = uk_allocstack_init(a
 #if CONFIG_LIBUKVMEM
@@ -397,6 +421,10 @@ void ukplat_entry(int argc, char *argv[])
 	uk_pr_info("Initialize scheduling...\n");
 #if CONFIG_LIBUKBOOT_INITSCHEDCOOP
 	s = uk_schedcoop_create(a, sa, auxsa, a);
+#elif CONFIG_LIBUKBOOT_INITSCHEDSMP
+	s = uk_schedsmp_create(a, sa, auxsa, a);
+#elif CONFIG_LIBUKBOOT_INITSCHEDPRIO
+	s = uk_schedprio_create(a, sa, auxsa, a);
 #endif
 	if (unlikely(!s))
 		UK_CRASH("Failed to initialize scheduling\n");
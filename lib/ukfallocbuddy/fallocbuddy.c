@@ -41,6 +41,9 @@
 #include <uk/atomic.h>
 #include <uk/list.h>
 #include <uk/print.h>
+#include <uk/arch/spinlock.h>
+#include <uk/plat/lcpu.h>
+#include <uk/init.h>
 
 #include <string.h>
 #include <errno.h>
@@ -149,6 +152,32 @@ struct bfa_memblock {
 	unsigned int level;
 };
 
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+#define BFA_PCP_HIGH		CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE_HIGH
+#define BFA_PCP_BATCH		(BFA_PCP_HIGH / 2)
+
+/* Single frames are the most frequent request (e.g., from page faults). Each
+ * logical CPU thus has a list of free frames from which it serves single-frame
+ * allocations and to which it returns single-frame frees without taking the
+ * allocator lock. The list is refilled from the buddy system with
+ * BFA_PCP_BATCH frames when it runs empty and the BFA_PCP_BATCH coldest
+ * frames are returned when it is full. Frames are taken from and put at the
+ * top of the list, so the bottom holds the coldest frames. For the buddy
+ * system, the frames in the list are allocated. They are thus not counted in
+ * `free_memory`.
+ */
+struct bfa_lcpu_cache {
+	unsigned int count;
+	__paddr_t frames[BFA_PCP_HIGH];
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_STATS
+	unsigned long nr_hits;
+	unsigned long nr_refills;
+	unsigned long nr_drains;
+#endif /* CONFIG_LIBUKFALLOCBUDDY_STATS */
+};
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
+
 /* The buddy allocator keeps track of all free memory across all zones in the
  * shared free lists so that a single check is enough to see if an allocation
  * of a certain size can directly be satisfied. If no element in the correct
@@ -165,6 +194,13 @@ struct buddy_framealloc {
 
 	struct uk_list_head free_list[BFA_LEVELS];
 	unsigned int free_list_map;
+
+	/* Protects the zones and free lists */
+	__spinlock lock;
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+	struct bfa_lcpu_cache lcpu[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
 };
 
 /* Forward declarations */
@@ -1193,11 +1229,138 @@ static int bfa_do_alloc_any(struct buddy_framealloc *bfa, __paddr_t *paddr,
 	return 0;
 }
 
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+/* The lists are indexed by the current lcpu, which is not known yet while the
+ * platform sets up paging. Until the early initcalls run, all requests go to
+ * the buddy system.
+ */
+static int bfa_pcp_enabled;
+
+static int bfa_pcp_enable(struct uk_init_ctx *ictx __unused)
+{
+	bfa_pcp_enabled = 1;
+	return 0;
+}
+
+uk_early_initcall(bfa_pcp_enable, 0x0);
+
+/* Must be called with the allocator lock held */
+static void bfa_pcp_refill(struct buddy_framealloc *bfa,
+			   struct bfa_lcpu_cache *pcp)
+{
+	__paddr_t paddr;
+
+	UK_ASSERT(pcp->count == 0);
+
+	while (pcp->count < BFA_PCP_BATCH) {
+		if (unlikely(bfa_do_alloc_any(bfa, &paddr, PAGE_SIZE)))
+			break;
+
+		pcp->frames[pcp->count++] = paddr;
+	}
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_STATS
+	pcp->nr_refills++;
+#endif /* CONFIG_LIBUKFALLOCBUDDY_STATS */
+}
+
+/* Return the `n` coldest frames of the list to the buddy system. Must be called
+ * with the allocator lock held.
+ */
+static int bfa_pcp_drain(struct buddy_framealloc *bfa,
+			 struct bfa_lcpu_cache *pcp, unsigned int n)
+{
+	unsigned int i;
+	int rc, ret = 0;
+
+	UK_ASSERT(n <= pcp->count);
+
+	for (i = 0; i < n; i++) {
+		rc = bfa_do_free(bfa, pcp->frames[i], PAGE_SIZE);
+		if (unlikely(rc)) {
+			/* The frame was released through the list, so the
+			 * caller of the free is not around anymore
+			 */
+			uk_pr_warn("%"__PRIuptr": Failed to free frame at 0x%"
+				   __PRIpaddr": %d\n", (__uptr)bfa,
+				   pcp->frames[i], rc);
+			ret = rc;
+		}
+	}
+
+	pcp->count -= n;
+	memmove(&pcp->frames[0], &pcp->frames[n],
+		pcp->count * sizeof(pcp->frames[0]));
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_STATS
+	pcp->nr_drains++;
+#endif /* CONFIG_LIBUKFALLOCBUDDY_STATS */
+
+	return ret;
+}
+
+static int bfa_pcp_alloc(struct buddy_framealloc *bfa, __paddr_t *paddr)
+{
+	struct bfa_lcpu_cache *pcp;
+	unsigned long irqf;
+	int rc = 0;
+
+	irqf = ukplat_lcpu_save_irqf();
+	pcp = &bfa->lcpu[ukplat_lcpu_idx()];
+
+	if (unlikely(pcp->count == 0)) {
+		ukarch_spin_lock(&bfa->lock);
+		bfa_pcp_refill(bfa, pcp);
+		ukarch_spin_unlock(&bfa->lock);
+
+		if (unlikely(pcp->count == 0)) {
+			rc = -ENOMEM;
+			goto out;
+		}
+	}
+
+	*paddr = pcp->frames[--pcp->count];
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_STATS
+	pcp->nr_hits++;
+#endif /* CONFIG_LIBUKFALLOCBUDDY_STATS */
+
+out:
+	ukplat_lcpu_restore_irqf(irqf);
+	return rc;
+}
+
+static int bfa_pcp_free(struct buddy_framealloc *bfa, __paddr_t paddr)
+{
+	struct bfa_lcpu_cache *pcp;
+	unsigned long irqf;
+	int rc = 0;
+
+	UK_ASSERT(PAGE_ALIGNED(paddr));
+
+	irqf = ukplat_lcpu_save_irqf();
+	pcp = &bfa->lcpu[ukplat_lcpu_idx()];
+
+	if (unlikely(pcp->count == BFA_PCP_HIGH)) {
+		ukarch_spin_lock(&bfa->lock);
+		rc = bfa_pcp_drain(bfa, pcp, BFA_PCP_BATCH);
+		ukarch_spin_unlock(&bfa->lock);
+	}
+
+	pcp->frames[pcp->count++] = paddr;
+
+	ukplat_lcpu_restore_irqf(irqf);
+	return rc;
+}
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
+
 static int bfa_alloc(struct uk_falloc *fa, __paddr_t *paddr,
 		     unsigned long frames, unsigned long flags __unused)
 {
 	struct buddy_framealloc *bfa = (struct buddy_framealloc *)fa;
+	unsigned long irqf;
 	__sz len;
+	int rc;
 
 	UK_ASSERT(frames > 0);
 	UK_ASSERT(frames <= (__SZ_MAX / PAGE_SIZE));
@@ -1207,13 +1370,38 @@ static int bfa_alloc(struct uk_falloc *fa, __paddr_t *paddr,
 	/* There is only FALLOC_FLAG_ALIGNED which we implicitly fulfill */
 	UK_ASSERT((flags == 0) || (flags == FALLOC_FLAG_ALIGNED));
 
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+	if (frames == 1 && *paddr == __PADDR_ANY && bfa_pcp_enabled)
+		return bfa_pcp_alloc(bfa, paddr);
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
+
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&bfa->lock);
+
 	/* If a physical address is given, the caller wants to allocate this
 	 * exact memory range. Otherwise, just take a free one from the list.
 	 */
-	if (*paddr == __PADDR_ANY)
-		return bfa_do_alloc_any(bfa, paddr, len);
-	else
-		return bfa_do_alloc(bfa, *paddr, len);
+	if (*paddr == __PADDR_ANY) {
+		rc = bfa_do_alloc_any(bfa, paddr, len);
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+		/* The frames in the list of this CPU might complete a
+		 * contiguous area. Return them to the buddy system and retry.
+		 * NOTE: The lists of other CPUs are left untouched.
+		 */
+		if (unlikely(rc == -ENOMEM) && bfa_pcp_enabled &&
+		    bfa->lcpu[ukplat_lcpu_idx()].count) {
+			bfa_pcp_drain(bfa, &bfa->lcpu[ukplat_lcpu_idx()],
+				      bfa->lcpu[ukplat_lcpu_idx()].count);
+			rc = bfa_do_alloc_any(bfa, paddr, len);
+		}
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
+	} else {
+		rc = bfa_do_alloc(bfa, *paddr, len);
+	}
+
+	ukarch_spin_unlock(&bfa->lock);
+	ukplat_lcpu_restore_irqf(irqf);
+	return rc;
 }
 
 static int bfa_do_alloc_any_in_range(struct buddy_framealloc *bfa,
@@ -1274,7 +1462,9 @@ static int bfa_alloc_from_range(struct uk_falloc *fa, __paddr_t *paddr,
 				__paddr_t min, __paddr_t max)
 {
 	struct buddy_framealloc *bfa = (struct buddy_framealloc *)fa;
+	unsigned long irqf;
 	__sz len;
+	int rc;
 
 	UK_ASSERT(frames > 0);
 	UK_ASSERT(frames <= (__SZ_MAX / PAGE_SIZE));
@@ -1286,7 +1476,13 @@ static int bfa_alloc_from_range(struct uk_falloc *fa, __paddr_t *paddr,
 
 	UK_ASSERT(min <= max);
 
-	return bfa_do_alloc_any_in_range(bfa, paddr, len, min, max);
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&bfa->lock);
+	rc = bfa_do_alloc_any_in_range(bfa, paddr, len, min, max);
+	ukarch_spin_unlock(&bfa->lock);
+	ukplat_lcpu_restore_irqf(irqf);
+
+	return rc;
 }
 
 static struct bfa_memblock *bfa_try_merge(struct buddy_framealloc *bfa,
@@ -1420,16 +1616,33 @@ static int bfa_free(struct uk_falloc *fa, __paddr_t paddr,
 		    unsigned long frames)
 {
 	struct buddy_framealloc *bfa = (struct buddy_framealloc *)fa;
+	unsigned long irqf;
 	__sz len;
+	int rc;
 
 	if (unlikely(frames == 0))
 		return 0;
 
 	UK_ASSERT(frames <= (__SZ_MAX / PAGE_SIZE));
 
+#if defined(CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE) && \
+	!defined(CONFIG_LIBUKFALLOCBUDDY_DEBUG)
+	/* In debug mode, frees go to the buddy system directly so that
+	 * invalid frees are reported to the caller.
+	 */
+	if (frames == 1 && bfa_pcp_enabled)
+		return bfa_pcp_free(bfa, paddr);
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE && !DEBUG */
+
 	len = frames * PAGE_SIZE;
 
-	return bfa_do_free(bfa, paddr, len);
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&bfa->lock);
+	rc = bfa_do_free(bfa, paddr, len);
+	ukarch_spin_unlock(&bfa->lock);
+	ukplat_lcpu_restore_irqf(irqf);
+
+	return rc;
 }
 
 static int bfa_do_addmem(struct buddy_framealloc *bfa, void *metadata,
@@ -1460,7 +1673,9 @@ static int bfa_addmem(struct uk_falloc *fa, void *metadata, __paddr_t paddr,
 		      unsigned long frames, __vaddr_t dm_off)
 {
 	struct buddy_framealloc *bfa = (struct buddy_framealloc *)fa;
+	unsigned long irqf;
 	__sz len;
+	int rc;
 
 	if (unlikely(frames == 0))
 		return 0;
@@ -1469,7 +1684,13 @@ static int bfa_addmem(struct uk_falloc *fa, void *metadata, __paddr_t paddr,
 
 	len = frames * PAGE_SIZE;
 
-	return bfa_do_addmem(bfa, metadata, paddr, len, dm_off);
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&bfa->lock);
+	rc = bfa_do_addmem(bfa, metadata, paddr, len, dm_off);
+	ukarch_spin_unlock(&bfa->lock);
+	ukplat_lcpu_restore_irqf(irqf);
+
+	return rc;
 }
 
 int uk_fallocbuddy_init(struct uk_falloc *fa)
@@ -1492,6 +1713,12 @@ int uk_fallocbuddy_init(struct uk_falloc *fa)
 
 	bfa->zones = __NULL;
 
+	ukarch_spin_init(&bfa->lock);
+
+#ifdef CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE
+	memset(bfa->lcpu, 0, sizeof(bfa->lcpu));
+#endif /* CONFIG_LIBUKFALLOCBUDDY_LCPU_CACHE */
+
 	return 0;
 }
 
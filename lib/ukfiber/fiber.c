@@ -0,0 +1,453 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <errno.h>
+#include <uk/fiber.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/plat/time.h>
+#include <uk/print.h>
+#include <uk/sched.h>
+
+#define FIBER_STACK_SIZE	CONFIG_LIBUKFIBER_STACK_SIZE
+#define FIBER_STACK_CANARY	0x5ca1ab1e5ca1ab1eUL
+
+/* Waiting fibers are checked when no fiber is ready and, so that fibers
+ * that keep yielding do not starve them, at every n-th scheduling decision
+ */
+#define FIBER_POLL_INTERVAL	64
+
+static __uk_tls struct uk_fiber_host *fiber_host;
+
+static inline struct uk_fiber_host *fiber_host_current(void)
+{
+	UK_ASSERT(fiber_host);
+	UK_ASSERT(fiber_host->thread == uk_thread_current());
+	return fiber_host;
+}
+
+static inline void fiber_stack_check(struct uk_fiber *f __maybe_unused)
+{
+	UK_ASSERT(!f->stack ||
+		  *(unsigned long *) f->stack == FIBER_STACK_CANARY);
+}
+
+static void fiber_free(struct uk_fiber_host *h, struct uk_fiber *f)
+{
+	UK_ASSERT(f->state == UK_FIBER_EXITED);
+	UK_ASSERT(f->stack);
+
+	uk_free(h->a, f->stack);
+}
+
+/* A detached fiber cannot free its own stack while it runs on it. This is
+ * done by the next fiber after the switch.
+ */
+static inline void fiber_zombie_free(struct uk_fiber_host *h)
+{
+	if (h->zombie) {
+		fiber_free(h, h->zombie);
+		h->zombie = NULL;
+	}
+}
+
+static inline void fiber_make_ready(struct uk_fiber_host *h,
+				    struct uk_fiber *f)
+{
+	f->state = UK_FIBER_READY;
+	UK_TAILQ_INSERT_TAIL(&h->ready, f, entry);
+}
+
+static void fiber_switch_to(struct uk_fiber_host *h,
+			    struct uk_fiber *prev, struct uk_fiber *next)
+{
+	UK_ASSERT(prev == h->current);
+	UK_ASSERT(prev != next);
+
+	fiber_stack_check(prev);
+
+	next->state = UK_FIBER_RUNNING;
+	h->current = next;
+	h->nr_switches++;
+	ukarch_ctx_switch(&prev->ctx, &next->ctx);
+
+	fiber_zombie_free(h);
+}
+
+#if CONFIG_LIBUKFILE
+/* The notifier unlinks a ticket from the wait list when it fires. Unless the
+ * ticket is the tail, its `next` is non-NULL while it is linked.
+ */
+static bool fiber_ticket_fired(struct uk_pollq *q, struct uk_poll_ticket *t)
+{
+	bool fired;
+
+	uk_rwlock_rlock(&q->waitlock);
+	fired = !t->next && q->waitend != &t->next;
+	uk_rwlock_runlock(&q->waitlock);
+	return fired;
+}
+#endif /* CONFIG_LIBUKFILE */
+
+static bool fiber_wait_done(struct uk_fiber *f, __nsec now)
+{
+	if (f->wait_deadline && now >= f->wait_deadline)
+		return true;
+#if CONFIG_LIBUKFILE
+	if (f->wait_q) {
+		if (uk_pollq_poll_immediate(f->wait_q, f->wait_req))
+			return true;
+		/* The events may have been cleared again in the meantime.
+		 * The fiber checks again and registers a new ticket.
+		 */
+		if (fiber_ticket_fired(f->wait_q, &f->wait_tick))
+			return true;
+	}
+#endif /* CONFIG_LIBUKFILE */
+	return false;
+}
+
+/* Moves waiting fibers whose condition is met to the ready queue. Returns
+ * the earliest deadline of the fibers that keep waiting, or 0 if none.
+ */
+static __nsec fiber_wake_waiting(struct uk_fiber_host *h)
+{
+	struct uk_fiber *f, *tmp;
+	__nsec now = ukplat_monotonic_clock();
+	__nsec deadline = 0;
+
+	UK_TAILQ_FOREACH_SAFE(f, &h->waiting, entry, tmp) {
+		if (fiber_wait_done(f, now)) {
+			UK_TAILQ_REMOVE(&h->waiting, f, entry);
+			fiber_make_ready(h, f);
+		} else if (f->wait_deadline &&
+			   (!deadline || f->wait_deadline < deadline)) {
+			deadline = f->wait_deadline;
+		}
+	}
+	return deadline;
+}
+
+/* No fiber is ready: block the host thread until a poll queue ticket of a
+ * waiting fiber wakes it or the earliest deadline expires
+ */
+static void fiber_idle(struct uk_fiber_host *h)
+{
+	__nsec deadline;
+
+	if (unlikely(UK_TAILQ_EMPTY(&h->waiting)))
+		UK_CRASH("Fiber host %p: all fibers are suspended\n", h);
+
+	deadline = fiber_wake_waiting(h);
+	if (!UK_TAILQ_EMPTY(&h->ready))
+		return;
+
+	uk_thread_block_until(h->thread, deadline);
+	/* An event that occurred before we blocked does not wake us */
+	fiber_wake_waiting(h);
+	if (!UK_TAILQ_EMPTY(&h->ready)) {
+		uk_thread_wake(h->thread);
+		return;
+	}
+	uk_sched_yield();
+}
+
+/* Runs the next ready fiber. The state of the current fiber was already
+ * changed by the caller; if it is ready and first in line, it continues.
+ */
+static void fiber_schedule(struct uk_fiber_host *h)
+{
+	struct uk_fiber *prev = h->current;
+	struct uk_fiber *next;
+
+	if (++h->nr_polls == FIBER_POLL_INTERVAL) {
+		h->nr_polls = 0;
+		if (!UK_TAILQ_EMPTY(&h->waiting))
+			fiber_wake_waiting(h);
+	}
+
+	while (!(next = UK_TAILQ_FIRST(&h->ready)))
+		fiber_idle(h);
+	UK_TAILQ_REMOVE(&h->ready, next, entry);
+
+	if (next == prev) {
+		prev->state = UK_FIBER_RUNNING;
+		return;
+	}
+	fiber_switch_to(h, prev, next);
+}
+
+static __noreturn void fiber_entry(long arg)
+{
+	struct uk_fiber *f = (struct uk_fiber *) arg;
+
+	fiber_zombie_free(f->host);
+	f->fn(f->arg);
+	uk_fiber_exit();
+}
+
+void uk_fiber_host_init(struct uk_fiber_host *h, struct uk_alloc *a)
+{
+	UK_ASSERT(h);
+	UK_ASSERT(a);
+	UK_ASSERT(!fiber_host);
+
+	*h = (struct uk_fiber_host) {
+		.main = {
+			.state = UK_FIBER_RUNNING,
+			.name = "main",
+		},
+		.thread = uk_thread_current(),
+		.a = a,
+	};
+	h->main.host = h;
+	h->current = &h->main;
+	UK_TAILQ_INIT(&h->ready);
+	UK_TAILQ_INIT(&h->waiting);
+
+	fiber_host = h;
+}
+
+void uk_fiber_host_fini(void)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+
+	UK_ASSERT(h->current == &h->main);
+	UK_ASSERT(!h->nr_fibers);
+
+	fiber_zombie_free(h);
+	fiber_host = NULL;
+}
+
+void uk_fiber_host_run(void)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+
+	UK_ASSERT(h->current == &h->main);
+
+	while (h->nr_fibers) {
+		h->main_waits_all = true;
+		h->main.state = UK_FIBER_SUSPENDED;
+		fiber_schedule(h);
+	}
+	h->main_waits_all = false;
+}
+
+struct uk_fiber *uk_fiber_create(const char *name, __sz stack_len,
+				 uk_fiber_fn_t fn, void *arg)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *f;
+	void *stack;
+	__uptr sp;
+
+	UK_ASSERT(fn);
+
+	stack_len = (!!stack_len) ? stack_len : FIBER_STACK_SIZE;
+	UK_ASSERT(stack_len >= sizeof(*f) + __PAGE_SIZE);
+
+	stack = uk_malloc(h->a, stack_len);
+	if (unlikely(!stack))
+		return NULL;
+	*(unsigned long *) stack = FIBER_STACK_CANARY;
+
+	f = (struct uk_fiber *) ALIGN_DOWN((__uptr) stack + stack_len
+					   - sizeof(*f),
+					   __alignof__(struct uk_fiber));
+	*f = (struct uk_fiber) {
+		.host = h,
+		.name = name,
+		.fn = fn,
+		.arg = arg,
+		.stack = stack,
+		.stack_len = stack_len,
+	};
+
+	sp = ALIGN_DOWN((__uptr) f, UKARCH_SP_ALIGN);
+	ukarch_ctx_init_entry1(&f->ctx, sp, 0, fiber_entry, (long) f);
+
+	h->nr_fibers++;
+	fiber_make_ready(h, f);
+	return f;
+}
+
+struct uk_fiber *uk_fiber_current(void)
+{
+	return fiber_host ? fiber_host->current : NULL;
+}
+
+void uk_fiber_yield(void)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+
+	fiber_make_ready(h, h->current);
+	fiber_schedule(h);
+}
+
+void uk_fiber_yield_to(struct uk_fiber *f)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *prev = h->current;
+
+	UK_ASSERT(f);
+	UK_ASSERT(f->host == h);
+
+	if (f == prev)
+		return;
+	UK_ASSERT(f->state == UK_FIBER_READY ||
+		  f->state == UK_FIBER_SUSPENDED);
+
+	if (f->state == UK_FIBER_READY)
+		UK_TAILQ_REMOVE(&h->ready, f, entry);
+	fiber_make_ready(h, prev);
+	fiber_switch_to(h, prev, f);
+}
+
+void uk_fiber_switch(struct uk_fiber *f)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *prev = h->current;
+
+	UK_ASSERT(f);
+	UK_ASSERT(f->host == h);
+
+	if (f == prev)
+		return;
+	UK_ASSERT(f->state == UK_FIBER_READY ||
+		  f->state == UK_FIBER_SUSPENDED);
+
+	if (f->state == UK_FIBER_READY)
+		UK_TAILQ_REMOVE(&h->ready, f, entry);
+	prev->state = UK_FIBER_SUSPENDED;
+	fiber_switch_to(h, prev, f);
+}
+
+void uk_fiber_resume(struct uk_fiber *f)
+{
+	UK_ASSERT(f);
+	UK_ASSERT(f->host == fiber_host_current());
+
+	if (f->state == UK_FIBER_SUSPENDED)
+		fiber_make_ready(f->host, f);
+}
+
+int uk_fiber_join(struct uk_fiber *f)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *cur = h->current;
+
+	UK_ASSERT(f);
+	UK_ASSERT(f->host == h);
+
+	if (unlikely(f == cur || f == &h->main || f->detached || f->joiner))
+		return -EINVAL;
+
+	f->joiner = cur;
+	while (f->state != UK_FIBER_EXITED) {
+		cur->state = UK_FIBER_SUSPENDED;
+		fiber_schedule(h);
+	}
+	fiber_free(h, f);
+	return 0;
+}
+
+void uk_fiber_detach(struct uk_fiber *f)
+{
+	UK_ASSERT(f);
+	UK_ASSERT(f->host == fiber_host_current());
+	UK_ASSERT(f != &f->host->main);
+	UK_ASSERT(!f->joiner);
+
+	f->detached = true;
+	if (f->state == UK_FIBER_EXITED)
+		fiber_free(f->host, f);
+}
+
+void uk_fiber_exit(void)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *f = h->current;
+
+	UK_ASSERT(f != &h->main);
+
+	f->state = UK_FIBER_EXITED;
+	UK_ASSERT(h->nr_fibers);
+	h->nr_fibers--;
+
+	if (f->joiner && f->joiner->state == UK_FIBER_SUSPENDED)
+		fiber_make_ready(h, f->joiner);
+	else if (f->detached)
+		h->zombie = f;
+	if (!h->nr_fibers && h->main_waits_all &&
+	    h->main.state == UK_FIBER_SUSPENDED)
+		fiber_make_ready(h, &h->main);
+
+	fiber_schedule(h);
+	UK_CRASH("Exited fiber %p was scheduled again\n", f);
+}
+
+/* Blocks the current fiber until `fiber_wait_done()` */
+static void fiber_wait(struct uk_fiber_host *h, __nsec deadline)
+{
+	struct uk_fiber *f = h->current;
+
+	f->wait_deadline = deadline;
+	f->state = UK_FIBER_WAITING;
+	UK_TAILQ_INSERT_TAIL(&h->waiting, f, entry);
+	fiber_schedule(h);
+	f->wait_deadline = 0;
+}
+
+void uk_fiber_sleep_until(__nsec deadline)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+
+	while (ukplat_monotonic_clock() < deadline)
+		fiber_wait(h, deadline);
+}
+
+#if CONFIG_LIBUKFILE
+uk_pollevent uk_fiber_pollq_wait_until(struct uk_pollq *q, uk_pollevent req,
+				       __nsec deadline)
+{
+	struct uk_fiber_host *h = fiber_host_current();
+	struct uk_fiber *f = h->current;
+	struct uk_poll_ticket **tail;
+	uk_pollevent ev;
+
+	UK_ASSERT(q);
+
+	for (;;) {
+		if ((ev = uk_pollq_poll_immediate(q, req)))
+			return ev;
+		if (deadline && ukplat_monotonic_clock() >= deadline)
+			return 0;
+		if ((ev = _pollq_lock(q, req, 0)))
+			return ev;
+
+		/* Register like `_pollq_wait()`, but the ticket wakes the
+		 * host thread, which then resumes this fiber
+		 */
+		(void)uk_or(&q->waitmask, req);
+		f->wait_tick = (struct uk_poll_ticket){
+			.next = NULL,
+			.thread = h->thread,
+			.mask = req,
+		};
+		tail = uk_exchange_n(&q->waitend, &f->wait_tick.next);
+		UK_ASSERT(!*tail); /* Should be a genuine list tail */
+		*tail = &f->wait_tick;
+		uk_rwlock_runlock(&q->waitlock);
+
+		f->wait_q = q;
+		f->wait_req = req;
+		fiber_wait(h, deadline);
+		f->wait_q = NULL;
+
+		uk_pollq_cancel_ticket(q, &f->wait_tick);
+	}
+}
+#endif /* CONFIG_LIBUKFILE */
@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Fibers: cooperative coroutines with small stacks that run inside a single
+ * uk_thread (the host). Fibers are switched with the same architecture
+ * context switch as threads, but without TLS, extended context, auxiliary
+ * stack or any scheduler involvement. All fibers of a host share the TLS of
+ * the host thread and run only on the logical CPU of the host.
+ */
+
+#ifndef __UK_FIBER_H__
+#define __UK_FIBER_H__
+
+#include <uk/config.h>
+#include <uk/arch/ctx.h>
+#include <uk/arch/types.h>
+#include <uk/alloc.h>
+#include <uk/essentials.h>
+#include <uk/list.h>
+#include <uk/thread.h>
+#if CONFIG_LIBUKFILE
+#include <uk/file/pollqueue.h>
+#endif /* CONFIG_LIBUKFILE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uk_fiber;
+struct uk_fiber_host;
+
+UK_TAILQ_HEAD(uk_fiber_list, struct uk_fiber);
+
+typedef void (*uk_fiber_fn_t)(void *arg);
+
+enum uk_fiber_state {
+	UK_FIBER_RUNNING = 0,
+	UK_FIBER_READY,		/* on the ready queue of the host */
+	UK_FIBER_SUSPENDED,	/* runs only if switched to or resumed */
+	UK_FIBER_WAITING,	/* waits for a poll queue event or timeout */
+	UK_FIBER_EXITED,
+};
+
+struct uk_fiber {
+	struct ukarch_ctx ctx;
+	struct uk_fiber_host *host;
+	UK_TAILQ_ENTRY(struct uk_fiber) entry; /* ready queue or wait list */
+	enum uk_fiber_state state;
+	const char *name;
+
+	uk_fiber_fn_t fn;
+	void *arg;
+
+	struct uk_fiber *joiner;	/* fiber that waits in uk_fiber_join() */
+	bool detached;
+
+	/* Wait condition of a fiber in UK_FIBER_WAITING */
+#if CONFIG_LIBUKFILE
+	struct uk_pollq *wait_q;
+	uk_pollevent wait_req;
+	struct uk_poll_ticket wait_tick;
+#endif /* CONFIG_LIBUKFILE */
+	__nsec wait_deadline;		/* 0: no timeout */
+
+	/* Memory, the struct is placed at the top of the stack allocation */
+	void *stack;
+	__sz stack_len;
+};
+
+/**
+ * Fiber scheduling state of a host thread. The host thread itself is
+ * represented by `main`, which is the current fiber while no other fiber
+ * runs.
+ */
+struct uk_fiber_host {
+	struct uk_fiber main;
+	struct uk_fiber *current;
+	struct uk_fiber_list ready;
+	struct uk_fiber_list waiting;
+	struct uk_fiber *zombie;	/* detached fiber to free after switch */
+	struct uk_thread *thread;
+	struct uk_alloc *a;
+	unsigned int nr_fibers;		/* created and not yet exited */
+	bool main_waits_all;		/* main is in uk_fiber_host_run() */
+	unsigned int nr_polls;
+	__u64 nr_switches;
+};
+
+/**
+ * Initializes `h` and makes the calling thread its host. The host thread
+ * must have a TLS. A thread can host only one set of fibers at a time.
+ *
+ * @param h
+ *   Host state to initialize
+ * @param a
+ *   Allocator for fiber stacks (required)
+ */
+void uk_fiber_host_init(struct uk_fiber_host *h, struct uk_alloc *a);
+
+/**
+ * Detaches the calling thread from its host state. All fibers must have
+ * exited and must have been joined or detached.
+ */
+void uk_fiber_host_fini(void);
+
+/**
+ * Runs the fibers of the calling host thread until all of them exited.
+ * Fibers that wait for events do not block the host as long as other fibers
+ * are ready. If all fibers wait, the host thread is blocked until an event
+ * or timeout occurs.
+ */
+void uk_fiber_host_run(void);
+
+/**
+ * Creates a fiber on the host of the calling thread and appends it to the
+ * ready queue. The fiber runs `fn(arg)` and exits when `fn` returns.
+ *
+ * @param name
+ *   Optional name of the fiber
+ * @param stack_len
+ *   Size of the stack including the fiber struct, 0 selects
+ *   CONFIG_LIBUKFIBER_STACK_SIZE
+ * @return
+ *   The new fiber or NULL on allocation failure
+ */
+struct uk_fiber *uk_fiber_create(const char *name, __sz stack_len,
+				 uk_fiber_fn_t fn, void *arg);
+
+/**
+ * Returns the currently running fiber of the calling thread, or NULL if
+ * the thread does not host fibers.
+ */
+struct uk_fiber *uk_fiber_current(void);
+
+/**
+ * Appends the current fiber to the ready queue and runs the next ready
+ * fiber. Returns right away if no other fiber is ready.
+ */
+void uk_fiber_yield(void);
+
+/**
+ * Appends the current fiber to the ready queue and runs `f` right away,
+ * ahead of all other ready fibers.
+ */
+void uk_fiber_yield_to(struct uk_fiber *f);
+
+/**
+ * Suspends the current fiber without queueing it and runs `f`. The current
+ * fiber continues only after another fiber switches to it or calls
+ * `uk_fiber_resume()` on it. This is the primitive for symmetric
+ * coroutines.
+ */
+void uk_fiber_switch(struct uk_fiber *f);
+
+/**
+ * Appends a suspended fiber to the ready queue.
+ */
+void uk_fiber_resume(struct uk_fiber *f);
+
+/**
+ * Waits until `f` exited and frees it. Only one fiber may join `f`.
+ * `f` must not be detached.
+ *
+ * @return
+ *   0 on success, -EINVAL if `f` is the current fiber, detached or already
+ *   joined
+ */
+int uk_fiber_join(struct uk_fiber *f);
+
+/**
+ * Lets `f` free itself when it exits. `f` must not be joined.
+ */
+void uk_fiber_detach(struct uk_fiber *f);
+
+/**
+ * Exits the current fiber. Must not be called by the host (main) fiber.
+ */
+void uk_fiber_exit(void) __noreturn;
+
+/**
+ * Blocks the current fiber until the system time reaches `deadline`.
+ * Other fibers of the host continue to run.
+ */
+void uk_fiber_sleep_until(__nsec deadline);
+
+#if CONFIG_LIBUKFILE
+/**
+ * Like `uk_pollq_poll_until()` but only the current fiber blocks, other
+ * fibers of the host continue to run.
+ *
+ * @param q Target queue.
+ * @param req Events to poll for.
+ * @param deadline Max number of nanoseconds to wait for, or 0 if forever
+ *
+ * @return
+ *   Bitwise AND between `req` and the events set in `q`, or 0 if timed out
+ */
+uk_pollevent uk_fiber_pollq_wait_until(struct uk_pollq *q, uk_pollevent req,
+				       __nsec deadline);
+
+#define uk_fiber_pollq_wait(q, req) uk_fiber_pollq_wait_until(q, req, 0)
+#endif /* CONFIG_LIBUKFILE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_FIBER_H__ */
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <string.h>
+#include <uk/alloc.h>
+#include <uk/arch/time.h>
+#include <uk/essentials.h>
+#include <uk/fiber.h>
+#include <uk/plat/time.h>
+#include <uk/sched.h>
+#include <uk/thread.h>
+#include <uk/test.h>
+
+#define NR_ROUNDS	1000
+
+static char order[8];
+static unsigned int order_len;
+
+static void order_fn(void *arg)
+{
+	order[order_len++] = (char) (__uptr) arg;
+	uk_fiber_yield();
+	order[order_len++] = (char) (__uptr) arg + 1;
+}
+
+UK_TESTCASE(ukfiber, yield_order)
+{
+	struct uk_fiber_host h;
+	struct uk_fiber *a, *b;
+
+	uk_fiber_host_init(&h, uk_alloc_get_default());
+	order_len = 0;
+	a = uk_fiber_create("a", 0, order_fn, (void *) 'a');
+	b = uk_fiber_create("b", 0, order_fn, (void *) 'A');
+	UK_TEST_EXPECT_NOT_NULL(a);
+	UK_TEST_EXPECT_NOT_NULL(b);
+
+	UK_TEST_EXPECT_SNUM_EQ(uk_fiber_join(a), 0);
+	UK_TEST_EXPECT_SNUM_EQ(uk_fiber_join(b), 0);
+	UK_TEST_EXPECT_SNUM_EQ(order_len, 4);
+	UK_TEST_EXPECT_ZERO(memcmp(order, "aAbB", 4));
+	uk_fiber_host_fini();
+}
+
+static struct uk_fiber *ping, *pong;
+static unsigned int nr_ping, nr_pong;
+static bool pingpong_done;
+
+static void ping_fn(void *arg __unused)
+{
+	while (nr_ping < NR_ROUNDS) {
+		nr_ping++;
+		uk_fiber_switch(pong);
+	}
+	/* Stay ready so that we run again when pong exits */
+	pingpong_done = true;
+	uk_fiber_yield_to(pong);
+}
+
+static void pong_fn(void *arg __unused)
+{
+	while (!pingpong_done) {
+		nr_pong++;
+		uk_fiber_switch(ping);
+	}
+}
+
+UK_TESTCASE(ukfiber, switch_pingpong)
+{
+	struct uk_fiber_host h;
+
+	uk_fiber_host_init(&h, uk_alloc_get_default());
+	nr_ping = nr_pong = 0;
+	pingpong_done = false;
+	ping = uk_fiber_create("ping", 0, ping_fn, NULL);
+	pong = uk_fiber_create("pong", 0, pong_fn, NULL);
+	UK_TEST_EXPECT_NOT_NULL(ping);
+	UK_TEST_EXPECT_NOT_NULL(pong);
+	uk_fiber_detach(ping);
+	uk_fiber_detach(pong);
+
+	uk_fiber_host_run();
+	UK_TEST_EXPECT_SNUM_EQ(nr_ping, NR_ROUNDS);
+	UK_TEST_EXPECT_SNUM_EQ(nr_pong, NR_ROUNDS);
+	UK_TEST_EXPECT_SNUM_GE(h.nr_switches, 2 * NR_ROUNDS);
+	uk_fiber_host_fini();
+}
+
+#if CONFIG_LIBUKFILE
+static struct uk_pollq pq;
+static uk_pollevent pq_got;
+static unsigned int nr_ticks;
+
+static void waiter_fn(void *arg __unused)
+{
+	pq_got = uk_fiber_pollq_wait(&pq, 0x2);
+}
+
+/* Keeps running while the waiter is blocked */
+static void ticker_fn(void *arg __unused)
+{
+	while (!pq_got) {
+		nr_ticks++;
+		uk_fiber_sleep_until(ukplat_monotonic_clock() +
+				     ukarch_time_msec_to_nsec(1));
+	}
+}
+
+static __noreturn void setter_fn(void *arg __unused)
+{
+	uk_sched_thread_sleep(ukarch_time_msec_to_nsec(10));
+	uk_pollq_set(&pq, 0x3);
+	uk_sched_thread_exit();
+}
+
+UK_TESTCASE(ukfiber, pollq_wait)
+{
+	struct uk_fiber_host h;
+	struct uk_thread *setter;
+	struct uk_fiber *w, *s;
+
+	uk_pollq_init(&pq);
+	pq_got = 0;
+	nr_ticks = 0;
+	uk_fiber_host_init(&h, uk_alloc_get_default());
+	w = uk_fiber_create("waiter", 0, waiter_fn, NULL);
+	s = uk_fiber_create("ticker", 0, ticker_fn, NULL);
+	UK_TEST_EXPECT_NOT_NULL(w);
+	UK_TEST_EXPECT_NOT_NULL(s);
+
+	setter = uk_sched_thread_create(uk_sched_current(), setter_fn, NULL,
+					"ukfiber-setter");
+	UK_TEST_EXPECT_NOT_NULL(setter);
+
+	UK_TEST_EXPECT_SNUM_EQ(uk_fiber_join(w), 0);
+	UK_TEST_EXPECT_SNUM_EQ(uk_fiber_join(s), 0);
+	UK_TEST_EXPECT_SNUM_EQ(pq_got, 0x2);
+	UK_TEST_EXPECT_SNUM_GT(nr_ticks, 0);
+	uk_fiber_host_fini();
+}
+
+static void timeout_fn(void *arg)
+{
+	__nsec deadline;
+
+	deadline = ukplat_monotonic_clock() + ukarch_time_msec_to_nsec(5);
+
+	*(uk_pollevent *) arg = uk_fiber_pollq_wait_until(&pq, 0x4, deadline);
+}
+
+/* All fibers wait, so the host thread blocks until the deadline */
+UK_TESTCASE(ukfiber, pollq_timeout)
+{
+	struct uk_fiber_host h;
+	struct uk_fiber *f;
+	uk_pollevent ev = ~0U;
+	__nsec start;
+
+	uk_pollq_init(&pq);
+	uk_fiber_host_init(&h, uk_alloc_get_default());
+	f = uk_fiber_create("timeout", 0, timeout_fn, &ev);
+	UK_TEST_EXPECT_NOT_NULL(f);
+
+	start = ukplat_monotonic_clock();
+	UK_TEST_EXPECT_SNUM_EQ(uk_fiber_join(f), 0);
+	UK_TEST_EXPECT_SNUM_EQ(ev, 0);
+	UK_TEST_EXPECT_SNUM_GE(ukplat_monotonic_clock() - start,
+			       ukarch_time_msec_to_nsec(5));
+	uk_fiber_host_fini();
+}
+
+#endif /* CONFIG_LIBUKFILE */
+
+uk_testsuite_register(ukfiber, NULL);
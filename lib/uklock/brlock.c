@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <string.h>
+#include <uk/atomic.h>
+#include <uk/assert.h>
+#include <uk/brlock.h>
+#include <uk/plat/lcpu.h>
+
+void uk_brlock_init(struct uk_brlock *brl)
+{
+	UK_ASSERT(brl);
+
+	memset(brl->lcpu, 0, sizeof(brl->lcpu));
+	brl->writer = 0;
+	uk_waitq_init(&brl->shared);
+	uk_waitq_init(&brl->exclusive);
+}
+
+/* Number of readers that hold the lock. Readers that see a writer back
+ * off, so the sum can only decrease while a writer is announced.
+ */
+static long brlock_readers(struct uk_brlock *brl)
+{
+	long readers = 0;
+	unsigned int i;
+
+	for (i = 0; i < ukplat_lcpu_count(); i++)
+		readers += uk_load_n(&brl->lcpu[i].readers);
+	return readers;
+}
+
+void _uk_brlock_wake_writer(struct uk_brlock *brl)
+{
+	uk_waitq_wake_up(&brl->exclusive);
+}
+
+void _uk_brlock_rlock_slow(struct uk_brlock *brl, unsigned int lcpu_idx)
+{
+	for (;;) {
+		/* Back off, the writer may wait for us to leave */
+		uk_dec(&brl->lcpu[lcpu_idx].readers);
+		_uk_brlock_wake_writer(brl);
+
+		uk_waitq_wait_event(&brl->shared, uk_load_n(&brl->writer) == 0);
+
+		/* We may have been migrated while waiting */
+		lcpu_idx = ukplat_lcpu_idx();
+		uk_inc(&brl->lcpu[lcpu_idx].readers);
+		if (likely(!uk_load_n(&brl->writer)))
+			return;
+	}
+}
+
+void uk_brlock_wlock(struct uk_brlock *brl)
+{
+	int unlocked;
+
+	UK_ASSERT(brl);
+
+	/* Wait for other writers, the first one to announce itself wins */
+	for (;;) {
+		uk_waitq_wait_event(&brl->exclusive,
+				    uk_load_n(&brl->writer) == 0);
+		unlocked = 0;
+		if (uk_compare_exchange_n(&brl->writer, &unlocked, 1))
+			break;
+	}
+
+	/* New readers back off now, wait for the active ones to leave */
+	uk_waitq_wait_event(&brl->exclusive, brlock_readers(brl) == 0);
+}
+
+void uk_brlock_wunlock(struct uk_brlock *brl)
+{
+	UK_ASSERT(brl);
+	UK_ASSERT(uk_load_n(&brl->writer) == 1);
+
+	uk_store_n(&brl->writer, 0);
+
+	/* Readers and writers compete for the lock again. Readers that
+	 * enter first keep writers out until they leave.
+	 */
+	uk_waitq_wake_up(&brl->shared);
+	uk_waitq_wake_up(&brl->exclusive);
+}
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Big-reader lock: a reader-writer lock for read-mostly data. Each logical
+ * CPU has its own reader counter, so that readers only touch memory that
+ * is local to their LCPU and do not bounce a shared cache line. A writer
+ * announces itself and then sweeps the counters of all LCPUs until no
+ * reader is left, which makes write locking considerably more expensive
+ * than with `struct uk_rwlock`.
+ *
+ * Waiting writers take precedence over new readers. Like with
+ * `struct uk_rwlock`, readers and writers block on wait queues and may be
+ * migrated between LCPUs while they hold the lock.
+ */
+
+#ifndef __UK_BRLOCK_H__
+#define __UK_BRLOCK_H__
+
+#include <uk/config.h>
+
+#if CONFIG_LIBUKLOCK_BRLOCK
+#include <uk/assert.h>
+#include <uk/atomic.h>
+#include <uk/essentials.h>
+#include <uk/plat/lcpu.h>
+#include <uk/wait.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uk_brlock_lcpu {
+	/** Readers that entered minus readers that left on this LCPU.
+	 * Readers may leave on another LCPU, so single counters can be
+	 * negative; only the sum over all LCPUs is meaningful.
+	 */
+	long readers;
+} __align(CACHE_LINE_SIZE);
+
+struct uk_brlock {
+	/** Reader counters, indexed by LCPU */
+	struct uk_brlock_lcpu lcpu[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	/** 1 if a writer holds the lock or waits for readers to leave */
+	int writer;
+	/** Wait queue for readers */
+	struct uk_waitq shared;
+	/** Wait queue for writers */
+	struct uk_waitq exclusive;
+};
+
+/**
+ * Initialize a big-reader lock
+ *
+ * @param brl
+ *   Big-reader lock to operate on
+ */
+void uk_brlock_init(struct uk_brlock *brl);
+
+#define UK_BRLOCK_INITIALIZER(name) \
+	((struct uk_brlock){ \
+		.lcpu = { { 0 } }, \
+		.writer = 0, \
+		.shared = UK_WAIT_QUEUE_INITIALIZER((name).shared), \
+		.exclusive = UK_WAIT_QUEUE_INITIALIZER((name).exclusive), \
+	})
+
+/* Called by uk_brlock_rlock() when a writer is active (see brlock.c) */
+void _uk_brlock_rlock_slow(struct uk_brlock *brl, unsigned int lcpu_idx);
+/* Called by uk_brlock_runlock() when a writer waits (see brlock.c) */
+void _uk_brlock_wake_writer(struct uk_brlock *brl);
+
+/**
+ * Acquire the big-reader lock for reading. Multiple readers can acquire
+ * the lock at the same time. Without a writer, this only modifies the
+ * counter of the current LCPU.
+ *
+ * @param brl
+ *   Big-reader lock to be acquired
+ */
+static inline void uk_brlock_rlock(struct uk_brlock *brl)
+{
+	unsigned int lcpu_idx;
+
+	UK_ASSERT(brl);
+
+	/* The increment and the load of `writer` are ordered against the
+	 * store of `writer` and the counter sweep of uk_brlock_wlock(): either
+	 * we see the writer or the writer sees us.
+	 */
+	lcpu_idx = ukplat_lcpu_idx();
+	uk_inc(&brl->lcpu[lcpu_idx].readers);
+	if (unlikely(uk_load_n(&brl->writer)))
+		_uk_brlock_rlock_slow(brl, lcpu_idx);
+}
+
+/**
+ * Release the big-reader lock, which has previously been acquired by this
+ * thread for reading. The thread may have been migrated to another LCPU in
+ * the meantime.
+ *
+ * @param brl
+ *   Big-reader lock to be released
+ */
+static inline void uk_brlock_runlock(struct uk_brlock *brl)
+{
+	UK_ASSERT(brl);
+
+	uk_dec(&brl->lcpu[ukplat_lcpu_idx()].readers);
+	if (unlikely(uk_load_n(&brl->writer)))
+		_uk_brlock_wake_writer(brl);
+}
+
+/**
+ * Acquire the big-reader lock for writing. Only a single writer can
+ * acquire the lock at the same time. Waits for the readers of all LCPUs
+ * to leave.
+ *
+ * @param brl
+ *   Big-reader lock to be acquired
+ */
+void uk_brlock_wlock(struct uk_brlock *brl);
+
+/**
+ * Release the big-reader lock, which has previously been acquired by this
+ * thread for writing
+ *
+ * @param brl
+ *   Big-reader lock to be released
+ */
+void uk_brlock_wunlock(struct uk_brlock *brl);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CONFIG_LIBUKLOCK_BRLOCK */
+
+#endif /* __UK_BRLOCK_H__ */
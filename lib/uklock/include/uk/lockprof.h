@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Lock contention profiling: spinlocks of the `uk_spin_*()` interface,
+ * mutexes and reader-writer locks record per lock instance how often they
+ * were acquired, how often and how long acquisitions waited, and the
+ * longest time they were held. Every logical CPU accumulates into its own
+ * table, so that profiling does not share cache lines between LCPUs.
+ * Readers of the profile sum the tables up.
+ */
+
+#ifndef __UK_LOCKPROF_H__
+#define __UK_LOCKPROF_H__
+
+#include <uk/config.h>
+#include <uk/arch/types.h>
+
+/* Kinds of profiled locks */
+#define UK_LOCKPROF_SPINLOCK		0
+#define UK_LOCKPROF_MUTEX		1
+#define UK_LOCKPROF_RWLOCK_READ		2
+#define UK_LOCKPROF_RWLOCK_WRITE	3
+
+/* ukstore entries, exported for the locks with the highest wait time as
+ * objects "top<rank>"
+ */
+#define UK_LOCKPROF_LOCK			0x01
+#define UK_LOCKPROF_SITE			0x02
+#define UK_LOCKPROF_TYPE			0x03
+#define UK_LOCKPROF_ACQUISITIONS		0x04
+#define UK_LOCKPROF_CONTENDED			0x05
+#define UK_LOCKPROF_WAIT_NS			0x06
+#define UK_LOCKPROF_HOLD_MAX_NS			0x07
+
+/* Static ukstore entries of the library */
+#define UK_LOCKPROF_ENABLED			0x10
+#define UK_LOCKPROF_NUM_DROPPED			0x11
+#define UK_LOCKPROF_RESET			0x12
+#define UK_LOCKPROF_TOP_SEQ			0x13
+
+#if CONFIG_LIBUKLOCK_PROFILE
+#include <uk/essentials.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uk_lockprof_stats {
+	__uptr lock;		/* address of the lock */
+	__uptr site;		/* code that acquired it, preferably with
+				 * contention
+				 */
+	unsigned int type;	/* UK_LOCKPROF_* */
+	__u64 acquisitions;
+	__u64 contended;	/* acquisitions that had to wait */
+	__nsec wait_time;	/* sum of all waits */
+	__nsec hold_max;	/* longest time the lock was held */
+};
+
+#define UK_LOCKPROF_HELD_MAX	8
+
+/* Profile of a logical CPU (see isrlockprof.c) */
+struct uk_lockprof_lcpu {
+	/* Open addressing by lock address and type. Locks are never
+	 * evicted, only `uk_lockprof_reset()` frees the slots.
+	 */
+	struct uk_lockprof_stats locks[CONFIG_LIBUKLOCK_PROFILE_LOCKS];
+	unsigned int nr_locks;
+	__u64 nr_dropped;	/* acquisitions of locks that did not fit */
+	unsigned long epoch;	/* resets seen by the table */
+
+	/* Spinlocks do not keep their acquisition time, the holder does
+	 * not leave the LCPU before it releases them
+	 */
+	struct {
+		__uptr lock;
+		__nsec since;
+	} held[UK_LOCKPROF_HELD_MAX];
+	unsigned int nr_held;
+} __align(CACHE_LINE_SIZE);
+
+extern UKPLAT_PER_LCPU_DEFINE(struct uk_lockprof_lcpu, _uk_lockprof_lcpu);
+
+/* Home slot of a lock in the table of an LCPU */
+static inline unsigned int _uk_lockprof_hash(__uptr lock, unsigned int type)
+{
+	/* Locks are aligned, mix the address before reducing it */
+	return (unsigned int) ((((__u64) lock + type)
+				* 0x9e3779b97f4a7c15ULL) >> 32)
+	       % CONFIG_LIBUKLOCK_PROFILE_LOCKS;
+}
+
+/* Runtime switch, see `uk_lockprof_enable()` */
+extern int _uk_lockprof_on;
+
+/* Number of calls to `uk_lockprof_reset()`. Tables of an older epoch are
+ * cleared by their LCPU at its next update and ignored until then.
+ */
+extern unsigned long _uk_lockprof_epoch;
+
+/*
+ * Records an acquisition of `lock`. `since` is the time at which the
+ * caller started to wait for the lock, 0 if it was free. `site` is the
+ * acquiring code, NULL for the return address. Returns the current time
+ * to be handed to `_uk_lockprof_released()`.
+ */
+__nsec _uk_lockprof_acquired(const void *lock, unsigned int type,
+			     __nsec since, const void *site);
+
+/*
+ * Records the release of `lock` that was acquired at `since` (as returned
+ * by `_uk_lockprof_acquired()`, 0 if unknown). Spinlocks pass 0, their
+ * acquisition time is looked up.
+ */
+void _uk_lockprof_released(const void *lock, unsigned int type,
+			   __nsec since);
+
+/* Start time of a wait for a lock */
+static inline __nsec uk_lockprof_wait_begin(void)
+{
+	return _uk_lockprof_on ? ukplat_monotonic_clock() : 0;
+}
+
+/**
+ * Enables or disables profiling at run time. The profile is kept.
+ * Disabled profiling costs one test per lock and unlock operation.
+ */
+void uk_lockprof_enable(int enable);
+
+/**
+ * Forgets all profiled locks, e.g., after the objects that embed them
+ * were freed. Otherwise, locks keep their slot in the tables until the
+ * tables are full, and further locks are only counted as dropped. The
+ * table of the calling LCPU is cleared immediately, the other LCPUs clear
+ * theirs with their next profiled lock operation.
+ */
+void uk_lockprof_reset(void);
+
+/**
+ * Sums up the profiles of all logical CPUs and ranks the locks by their
+ * total wait time.
+ *
+ * @param out
+ *   Array that receives the statistics of the ranked locks in descending
+ *   order
+ * @param n
+ *   Number of elements of `out`
+ * @return
+ *   Number of locks in `out`
+ */
+unsigned int uk_lockprof_top(struct uk_lockprof_stats *out, unsigned int n);
+
+/**
+ * Prints the `top` locks with the highest total wait time. Locks and
+ * sites are printed as addresses; use `addr2line` on the debug image for
+ * resolving sites.
+ */
+void uk_lockprof_dumpk(int klvl, unsigned int top);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
+#endif /* __UK_LOCKPROF_H__ */
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Queued spinlock after Mellor-Crummey and Scott (MCS), in the compact form
+ * of the Linux qspinlock: the lock is a single 32-bit word and the queue
+ * nodes are taken from a small per-lcpu pool, so that the interface is the
+ * same as that of a plain spinlock. Waiters acquire the lock in FIFO order
+ * and each one spins on its own node instead of on the lock word.
+ *
+ * The lock word holds a locked byte and the tail of the waiter queue. An
+ * uncontended lock is acquired with one compare-and-swap. The head of the
+ * queue spins on the lock word until the owner releases it; everybody
+ * behind the head spins on its own node.
+ */
+
+#ifndef __UK_MCSLOCK_H__
+#define __UK_MCSLOCK_H__
+
+#include <uk/arch/types.h>
+#include <uk/arch/lcpu.h>
+#include <uk/essentials.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_HAVE_SMP
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error The MCS lock word layout requires a little-endian architecture
+#endif
+
+/* Unless you know what you are doing, use struct uk_spinlock instead. */
+typedef struct __mcslock __mcslock;
+
+struct __mcslock {
+	union {
+		__u32 val;
+		struct {
+			__u8 locked;	/* owner holds the lock */
+			__u8 __pad;
+			__u16 tail;	/* last waiter, 0 if none */
+		};
+	};
+};
+
+#define UK_MCSLOCK_LOCKED		1U
+#define UK_MCSLOCK_LOCKED_MASK		0xffU
+#define UK_MCSLOCK_TAIL_SHIFT		16
+
+/* Initialize an MCS lock to unlocked state */
+#define UK_MCSLOCK_INITIALIZER()	{ .val = 0 }
+
+/* Queues the calling logical CPU, called if the lock is not free */
+void _uk_mcs_lock_slow(struct __mcslock *lock);
+
+static inline void uk_mcs_init(struct __mcslock *lock)
+{
+	lock->val = 0;
+}
+
+static inline int uk_mcs_trylock(struct __mcslock *lock)
+{
+	__u32 val = 0;
+
+	return __atomic_compare_exchange_n(&lock->val, &val,
+					   UK_MCSLOCK_LOCKED, 0,
+					   __ATOMIC_ACQUIRE,
+					   __ATOMIC_RELAXED);
+}
+
+static inline void uk_mcs_lock(struct __mcslock *lock)
+{
+	if (likely(uk_mcs_trylock(lock)))
+		return;
+	_uk_mcs_lock_slow(lock);
+}
+
+static inline void uk_mcs_unlock(struct __mcslock *lock)
+{
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline int uk_mcs_is_locked(struct __mcslock *lock)
+{
+	return __atomic_load_n(&lock->val, __ATOMIC_RELAXED) != 0;
+}
+
+#else /* CONFIG_HAVE_SMP */
+
+typedef struct __mcslock {
+	/* empty */
+} __mcslock;
+
+#define UK_MCSLOCK_INITIALIZER()	{}
+#define uk_mcs_init(lock)		(void)(lock)
+#define uk_mcs_lock(lock)		\
+	do { barrier(); (void)(lock); } while (0)
+#define uk_mcs_unlock(lock)		\
+	do { barrier(); (void)(lock); } while (0)
+#define uk_mcs_trylock(lock)		({ barrier(); (void)(lock); 1; })
+#define uk_mcs_is_locked(lock)		({ barrier(); (void)(lock); 0; })
+
+#endif /* CONFIG_HAVE_SMP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_MCSLOCK_H__ */
@@ -44,10 +44,10 @@
 #include <uk/wait_types.h>
 #include <uk/plat/time.h>
 
-#ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-#include <uk/plat/spinlock.h>
-#include <string.h>
-#endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
+#include <uk/essentials.h>
+#if CONFIG_LIBUKLOCK_PROFILE
+#include <uk/lockprof.h>
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 
 #ifdef __cplusplus
 extern "C" {
@@ -58,14 +58,31 @@ extern "C" {
 /*
  * Mutex that relies on a scheduler
  * uses wait queues for threads
+ *
+ * A contended lock operation spins while the owner is running on another
+ * LCPU (LIBUKLOCK_MUTEX_ADAPTIVE) and blocks otherwise. Unlock wakes only
+ * the first waiter. A waiter that finds the mutex taken before it blocks
+ * requests a handoff: the next unlock then passes the ownership directly
+ * to this waiter, so that waiters cannot starve. Only one handoff is
+ * pending at a time.
  */
 struct uk_mutex {
 	int lock_count;
 	unsigned int flags;
 	struct uk_thread *owner;
 	struct uk_waitq wait;
+	struct uk_thread *handoff; /* next unlock hands the mutex to it */
+#if CONFIG_LIBUKLOCK_PROFILE
+	__nsec prof_since;	/* acquisition time, see uk/lockprof.h */
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 };
 
+#if CONFIG_LIBUKLOCK_PROFILE
+#define _UK_MUTEX_PROF_INITIALIZER	, 0
+#else /* !CONFIG_LIBUKLOCK_PROFILE */
+#define _UK_MUTEX_PROF_INITIALIZER
+#endif /* !CONFIG_LIBUKLOCK_PROFILE */
+
 static inline int uk_mutex_is_recursive(const struct uk_mutex *m)
 {
 	return (m->flags & UK_MUTEX_CONFIG_RECURSE);
@@ -92,27 +109,62 @@ struct uk_mutex_metrics {
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
 /*
- * Metric storage (see mutex.c).
+ * Metric storage (see mutex.c). Every LCPU counts into its own copy,
+ * uk_mutex_get_metrics() sums them up.
  */
-extern struct uk_mutex_metrics _uk_mutex_metrics;
-extern __spinlock              _uk_mutex_metrics_lock;
+struct _uk_mutex_lcpu_metrics {
+	struct uk_mutex_metrics m;
+} __align(CACHE_LINE_SIZE);
+
+extern UKPLAT_PER_LCPU_DEFINE(struct _uk_mutex_lcpu_metrics,
+			      _uk_mutex_metrics);
+
+/* `locked` mutexes change from unlocked to locked */
+static inline void _uk_mutex_metrics_add(long locked, size_t locks,
+					 size_t ok_trylocks,
+					 size_t failed_trylocks,
+					 size_t unlocks)
+{
+	struct uk_mutex_metrics *mm;
+	unsigned long flags;
+
+	/* The thread must not change the LCPU during the update */
+	flags = ukplat_lcpu_save_irqf();
+	mm = &ukplat_per_lcpu_current(_uk_mutex_metrics).m;
+	mm->active_locked         += locked;
+	mm->active_unlocked       -= locked;
+	mm->total_locks           += locks;
+	mm->total_ok_trylocks     += ok_trylocks;
+	mm->total_failed_trylocks += failed_trylocks;
+	mm->total_unlocks         += unlocks;
+	ukplat_lcpu_restore_irqf(flags);
+}
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 
 #define	UK_MUTEX_INITIALIZER(name)				\
-	{ 0, 0, NULL, __WAIT_QUEUE_INITIALIZER((name).wait) }
+	{ 0, 0, NULL, __WAIT_QUEUE_INITIALIZER((name).wait), NULL	\
+	  _UK_MUTEX_PROF_INITIALIZER }
 
 #define	UK_MUTEX_INITIALIZER_RECURSIVE(name)			\
 	{ 0, UK_MUTEX_CONFIG_RECURSE, 0,			\
-	__WAIT_QUEUE_INITIALIZER((name).wait) }
+	__WAIT_QUEUE_INITIALIZER((name).wait), NULL		\
+	_UK_MUTEX_PROF_INITIALIZER }
 
 void uk_mutex_init_config(struct uk_mutex *m, unsigned int flags);
 void uk_mutex_get_metrics(struct uk_mutex_metrics *dst);
 
+/* Contended lock and unlock operations (see mutex.c) */
+void _uk_mutex_lock_slow(struct uk_mutex *m, struct uk_thread *cur);
+void _uk_mutex_release(struct uk_mutex *m);
+
 #define uk_mutex_init(m) uk_mutex_init_config(m, 0)
 
 static inline void uk_mutex_lock(struct uk_mutex *m)
 {
 	struct uk_thread *cur;
+#if CONFIG_LIBUKLOCK_PROFILE
+	__nsec since = 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 
 	UK_ASSERT(m);
 
@@ -127,23 +179,27 @@ static inline void uk_mutex_lock(struct uk_mutex *m)
 
 	UK_ASSERT(m->owner != cur);
 
-	for (;;) {
-		uk_waitq_wait_event(&m->wait, m->owner == NULL);
-
-		/* If there is no owner, we can acquire the lock */
-		if (uk_compare_exchange_sync(&m->owner, NULL, cur) == cur) {
-			UK_ASSERT(m->lock_count == 0);
-			m->lock_count = 1;
-			break;
-		}
+	/* If there is no owner, we can acquire the lock */
+	if (unlikely(uk_compare_exchange_sync(&m->owner, NULL, cur) != cur)) {
+#if CONFIG_LIBUKLOCK_PROFILE
+		since = uk_lockprof_wait_begin();
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+		_uk_mutex_lock_slow(m, cur);
 	}
 
+	UK_ASSERT(m->owner == cur);
+	UK_ASSERT(m->lock_count == 0);
+	m->lock_count = 1;
+
+#if CONFIG_LIBUKLOCK_PROFILE
+	m->prof_since = unlikely(_uk_lockprof_on)
+			? _uk_lockprof_acquired(m, UK_LOCKPROF_MUTEX, since,
+						__NULL)
+			: 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-	ukarch_spin_lock(&_uk_mutex_metrics_lock);
-	_uk_mutex_metrics.active_locked   += (m->lock_count == 1);
-	_uk_mutex_metrics.active_unlocked -= (m->lock_count == 1);
-	_uk_mutex_metrics.total_locks++;
-	ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+	_uk_mutex_metrics_add(m->lock_count == 1, 1, 0, 0, 0);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 }
 
@@ -161,9 +217,7 @@ static inline int uk_mutex_trylock(struct uk_mutex *m)
 		m->lock_count++;
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-		ukarch_spin_lock(&_uk_mutex_metrics_lock);
-		_uk_mutex_metrics.total_ok_trylocks++;
-		ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+		_uk_mutex_metrics_add(0, 0, 1, 0, 0);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 
 		return 1;
@@ -176,12 +230,15 @@ static inline int uk_mutex_trylock(struct uk_mutex *m)
 			UK_ASSERT(m->lock_count == 0);
 			m->lock_count = 1;
 
+#if CONFIG_LIBUKLOCK_PROFILE
+			m->prof_since = unlikely(_uk_lockprof_on)
+				? _uk_lockprof_acquired(m, UK_LOCKPROF_MUTEX,
+							0, __NULL)
+				: 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-			ukarch_spin_lock(&_uk_mutex_metrics_lock);
-			_uk_mutex_metrics.active_locked++;
-			_uk_mutex_metrics.active_unlocked--;
-			_uk_mutex_metrics.total_ok_trylocks++;
-			ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+			_uk_mutex_metrics_add(1, 0, 1, 0, 0);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 
 			return 1;
@@ -189,9 +246,7 @@ static inline int uk_mutex_trylock(struct uk_mutex *m)
 	}
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-	ukarch_spin_lock(&_uk_mutex_metrics_lock);
-	_uk_mutex_metrics.total_failed_trylocks++;
-	ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+	_uk_mutex_metrics_add(0, 0, 0, 1, 0);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 
 	return 0;
@@ -205,25 +260,27 @@ static inline int uk_mutex_is_locked(struct uk_mutex *m)
 
 static inline void uk_mutex_unlock(struct uk_mutex *m)
 {
+	int released;
+
 	UK_ASSERT(m);
 	UK_ASSERT(m->lock_count > 0);
 	UK_ASSERT(m->owner == uk_thread_current());
 
-	if (--m->lock_count == 0) {
-		/* Make sure lock_count is visible before resetting the
-		 * owner. The lock can be acquired afterwards.
-		 */
-		wmb();
-		m->owner = NULL;
-		uk_waitq_wake_up(&m->wait);
+	/* Once released, the mutex and its lock_count belong to the next
+	 * owner
+	 */
+	released = (--m->lock_count == 0);
+	if (released) {
+#if CONFIG_LIBUKLOCK_PROFILE
+		if (unlikely(_uk_lockprof_on))
+			_uk_lockprof_released(m, UK_LOCKPROF_MUTEX,
+					      m->prof_since);
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+		_uk_mutex_release(m);
 	}
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-	ukarch_spin_lock(&_uk_mutex_metrics_lock);
-	_uk_mutex_metrics.active_locked   -= (m->lock_count == 0);
-	_uk_mutex_metrics.active_unlocked += (m->lock_count == 0);
-	_uk_mutex_metrics.total_unlocks++;
-	ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+	_uk_mutex_metrics_add(-(long) released, 0, 0, 0, 1);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 }
 
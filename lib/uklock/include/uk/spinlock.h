@@ -34,6 +34,7 @@
 #define __UK_SPINLOCK_H__
 
 #include <uk/plat/lcpu.h>
+#include <uk/preempt.h>
 #include <uk/essentials.h>
 
 #ifdef __cplusplus
@@ -42,7 +43,42 @@ extern "C" {
 
 /* See uk/arch/spinlock.h for the interface documentation */
 
-#ifndef CONFIG_LIBUKLOCK_TICKETLOCK
+#if CONFIG_LIBUKLOCK_TICKETLOCK
+
+#ifndef uk_spinlock
+
+#ifdef CONFIG_ARCH_ARM_64
+#include <uk/arch/arm64/ticketlock.h>
+#endif
+
+#define uk_spinlock __ticketlock
+
+#define UK_SPINLOCK_INITIALIZER()  UKARCH_TICKETLOCK_INITIALIZER()
+#define uk_spin_init(lock)         ukarch_ticket_init(lock)
+#define _uk_spin_lock(lock)        ukarch_ticket_lock(lock)
+#define _uk_spin_unlock(lock)      ukarch_ticket_unlock(lock)
+#define _uk_spin_trylock(lock)     ukarch_ticket_trylock(lock)
+#define uk_spin_is_locked(lock)    ukarch_ticket_is_locked(lock)
+#endif /* uk_spinlock */
+
+#elif CONFIG_LIBUKLOCK_MCSLOCK
+
+#ifndef uk_spinlock
+/* Users of the architecture lock __spinlock rely on this header for it */
+#include <uk/arch/spinlock.h>
+#include <uk/mcslock.h>
+
+#define uk_spinlock __mcslock
+
+#define UK_SPINLOCK_INITIALIZER()  UK_MCSLOCK_INITIALIZER()
+#define uk_spin_init(lock)         uk_mcs_init(lock)
+#define _uk_spin_lock(lock)        uk_mcs_lock(lock)
+#define _uk_spin_unlock(lock)      uk_mcs_unlock(lock)
+#define _uk_spin_trylock(lock)     uk_mcs_trylock(lock)
+#define uk_spin_is_locked(lock)    uk_mcs_is_locked(lock)
+#endif /* uk_spinlock */
+
+#else	/* !CONFIG_LIBUKLOCK_TICKETLOCK && !CONFIG_LIBUKLOCK_MCSLOCK */
 
 #ifndef uk_spinlock
 #include <uk/arch/spinlock.h>
@@ -51,31 +87,88 @@ extern "C" {
 
 #define UK_SPINLOCK_INITIALIZER()  UKARCH_SPINLOCK_INITIALIZER()
 #define uk_spin_init(lock)         ukarch_spin_init(lock)
-#define uk_spin_lock(lock)         ukarch_spin_lock(lock)
-#define uk_spin_unlock(lock)       ukarch_spin_unlock(lock)
-#define uk_spin_trylock(lock)      ukarch_spin_trylock(lock)
+#define _uk_spin_lock(lock)        ukarch_spin_lock(lock)
+#define _uk_spin_unlock(lock)      ukarch_spin_unlock(lock)
+#define _uk_spin_trylock(lock)     ukarch_spin_trylock(lock)
 #define uk_spin_is_locked(lock)    ukarch_spin_is_locked(lock)
 #endif /* uk_spinlock */
 
-#else	/* CONFIG_LIBUKLOCK_TICKETLOCK */
+#endif	/* !CONFIG_LIBUKLOCK_TICKETLOCK && !CONFIG_LIBUKLOCK_MCSLOCK */
 
-#ifndef uk_spinlock
+#if CONFIG_LIBUKLOCK_PROFILE
+#include <uk/lockprof.h>
 
-#ifdef CONFIG_ARCH_ARM_64
-#include <uk/arch/arm64/ticketlock.h>
-#endif
+/* An acquisition that does not get the lock at once is contended */
+#define __uk_spin_lock(lock)						\
+	do {								\
+		__nsec __since = 0;					\
+									\
+		if (likely(!_uk_lockprof_on) ||				\
+		    !_uk_spin_trylock(lock)) {				\
+			__since = uk_lockprof_wait_begin();		\
+			_uk_spin_lock(lock);				\
+		}							\
+		if (unlikely(_uk_lockprof_on))				\
+			_uk_lockprof_acquired(lock,			\
+					      UK_LOCKPROF_SPINLOCK,	\
+					      __since, __NULL);		\
+	} while (0)
 
-#define uk_spinlock __ticketlock
+#define __uk_spin_unlock(lock)						\
+	do {								\
+		if (unlikely(_uk_lockprof_on))				\
+			_uk_lockprof_released(lock,			\
+					      UK_LOCKPROF_SPINLOCK, 0);	\
+		_uk_spin_unlock(lock);					\
+	} while (0)
 
-#define UK_SPINLOCK_INITIALIZER()  UKARCH_TICKETLOCK_INITIALIZER()
-#define uk_spin_init(lock)         ukarch_ticket_init(lock)
-#define uk_spin_lock(lock)         ukarch_ticket_lock(lock)
-#define uk_spin_unlock(lock)       ukarch_ticket_unlock(lock)
-#define uk_spin_trylock(lock)      ukarch_ticket_trylock(lock)
-#define uk_spin_is_locked(lock)    ukarch_ticket_is_locked(lock)
-#endif /* uk_spinlock */
+#define __uk_spin_trylock(lock)						\
+	({								\
+		int __acquired = _uk_spin_trylock(lock);		\
+									\
+		if (__acquired && unlikely(_uk_lockprof_on))		\
+			_uk_lockprof_acquired(lock,			\
+					      UK_LOCKPROF_SPINLOCK,	\
+					      0, __NULL);		\
+		__acquired;						\
+	})
+#else /* !CONFIG_LIBUKLOCK_PROFILE */
+#define __uk_spin_lock(lock)       _uk_spin_lock(lock)
+#define __uk_spin_unlock(lock)     _uk_spin_unlock(lock)
+#define __uk_spin_trylock(lock)    _uk_spin_trylock(lock)
+#endif /* !CONFIG_LIBUKLOCK_PROFILE */
+
+#if CONFIG_LIBUKSCHED_PREEMPT
+/* The holder of a spinlock must not be preempted, otherwise waiters on the
+ * same logical CPU spin until the end of their time slice.
+ */
+#define uk_spin_lock(lock)						\
+	do {								\
+		uk_preempt_disable();					\
+		__uk_spin_lock(lock);					\
+	} while (0)
+
+#define uk_spin_unlock(lock)						\
+	do {								\
+		__uk_spin_unlock(lock);					\
+		uk_preempt_enable();					\
+	} while (0)
 
-#endif	/* CONFIG_LIBUKLOCK_TICKETLOCK */
+#define uk_spin_trylock(lock)						\
+	({								\
+		int __r;						\
+									\
+		uk_preempt_disable();					\
+		__r = __uk_spin_trylock(lock);				\
+		if (!__r)						\
+			uk_preempt_enable();				\
+		__r;							\
+	})
+#else /* !CONFIG_LIBUKSCHED_PREEMPT */
+#define uk_spin_lock(lock)         __uk_spin_lock(lock)
+#define uk_spin_unlock(lock)       __uk_spin_unlock(lock)
+#define uk_spin_trylock(lock)      __uk_spin_trylock(lock)
+#endif /* !CONFIG_LIBUKSCHED_PREEMPT */
 
 #define uk_spin_lock_irq(lock)						\
 	do {								\
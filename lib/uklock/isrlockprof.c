@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/* Recording part of the lock profile, spinlocks are also taken in
+ * interrupt context
+ */
+
+#include <string.h>
+#include <uk/atomic.h>
+#include <uk/essentials.h>
+#include <uk/lockprof.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+
+#define LOCK_SLOTS	CONFIG_LIBUKLOCK_PROFILE_LOCKS
+
+UKPLAT_PER_LCPU_DEFINE(struct uk_lockprof_lcpu, _uk_lockprof_lcpu);
+
+int _uk_lockprof_on = 1;
+unsigned long _uk_lockprof_epoch;
+
+/* Profile of the current LCPU, cleared if it predates the last reset.
+ * Must be called with interrupts disabled.
+ */
+static struct uk_lockprof_lcpu *lcpu_get(void)
+{
+	struct uk_lockprof_lcpu *lp;
+	unsigned long epoch = UK_READ_ONCE(_uk_lockprof_epoch);
+
+	lp = &ukplat_per_lcpu_current(_uk_lockprof_lcpu);
+
+	if (unlikely(lp->epoch != epoch)) {
+		memset(lp->locks, 0, sizeof(lp->locks));
+		lp->nr_locks = 0;
+		lp->nr_dropped = 0;
+		lp->epoch = epoch;
+	}
+	return lp;
+}
+
+static struct uk_lockprof_stats *lock_get(struct uk_lockprof_lcpu *lp,
+					  __uptr lock, unsigned int type)
+{
+	struct uk_lockprof_stats *s;
+	unsigned int idx = _uk_lockprof_hash(lock, type);
+	unsigned int i;
+
+	for (i = 0; i < LOCK_SLOTS; i++) {
+		s = &lp->locks[(idx + i) % LOCK_SLOTS];
+		if (s->lock == lock && s->type == type)
+			return s;
+		if (!s->lock) {
+			s->lock = lock;
+			s->type = type;
+			lp->nr_locks++;
+			return s;
+		}
+	}
+	return NULL; /* table is full */
+}
+
+__nsec _uk_lockprof_acquired(const void *lock, unsigned int type,
+			     __nsec since, const void *site)
+{
+	struct uk_lockprof_lcpu *lp;
+	struct uk_lockprof_stats *s;
+	unsigned long flags;
+	__nsec now;
+
+	if (!_uk_lockprof_on)
+		return 0;
+
+	if (!site)
+		site = __builtin_return_address(0);
+	now = ukplat_monotonic_clock();
+
+	/* Neither interrupts nor other threads may update our table */
+	flags = ukplat_lcpu_save_irqf();
+	lp = lcpu_get();
+
+	s = lock_get(lp, (__uptr) lock, type);
+	if (likely(s)) {
+		s->acquisitions++;
+		if (since) {
+			s->contended++;
+			s->wait_time += now - since;
+			s->site = (__uptr) site;
+		} else if (!s->site) {
+			s->site = (__uptr) site;
+		}
+	} else {
+		lp->nr_dropped++;
+	}
+
+	if (type == UK_LOCKPROF_SPINLOCK) {
+		/* Forget the oldest entry, its release was probably not
+		 * seen on this LCPU
+		 */
+		if (unlikely(lp->nr_held == UK_LOCKPROF_HELD_MAX)) {
+			memmove(&lp->held[0], &lp->held[1],
+				sizeof(lp->held[0]) * --lp->nr_held);
+		}
+		lp->held[lp->nr_held].lock = (__uptr) lock;
+		lp->held[lp->nr_held].since = now;
+		lp->nr_held++;
+	}
+
+	ukplat_lcpu_restore_irqf(flags);
+	return now;
+}
+
+void _uk_lockprof_released(const void *lock, unsigned int type,
+			   __nsec since)
+{
+	struct uk_lockprof_lcpu *lp;
+	struct uk_lockprof_stats *s;
+	unsigned long flags;
+	unsigned int i;
+	__nsec now;
+
+	if (!_uk_lockprof_on)
+		return;
+
+	now = ukplat_monotonic_clock();
+
+	flags = ukplat_lcpu_save_irqf();
+	lp = lcpu_get();
+
+	if (type == UK_LOCKPROF_SPINLOCK) {
+		/* Spinlocks are mostly released in reverse order */
+		for (i = lp->nr_held; i > 0; i--) {
+			if (lp->held[i - 1].lock == (__uptr) lock)
+				break;
+		}
+		if (!i)
+			goto out;
+
+		since = lp->held[i - 1].since;
+		memmove(&lp->held[i - 1], &lp->held[i],
+			sizeof(lp->held[0]) * (lp->nr_held - i));
+		lp->nr_held--;
+	}
+	if (!since)
+		goto out;
+
+	/* Mutexes may be released on another LCPU than they were acquired
+	 * on, the readers of the profile take the maximum of all LCPUs
+	 */
+	s = lock_get(lp, (__uptr) lock, type);
+	if (likely(s) && now - since > s->hold_max)
+		s->hold_max = now - since;
+
+out:
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+void uk_lockprof_reset(void)
+{
+	unsigned long flags;
+
+	uk_inc(&_uk_lockprof_epoch);
+
+	/* Spinlocks that are held stay in the list of held locks, their
+	 * release is still recorded
+	 */
+	flags = ukplat_lcpu_save_irqf();
+	lcpu_get();
+	ukplat_lcpu_restore_irqf(flags);
+}
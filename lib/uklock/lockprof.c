@@ -0,0 +1,429 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#define _GNU_SOURCE /* asprintf */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <uk/alloc.h>
+#include <uk/arch/spinlock.h>
+#include <uk/arch/time.h>
+#include <uk/assert.h>
+#include <uk/errptr.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/lockprof.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/preempt.h>
+#include <uk/print.h>
+#include <uk/store.h>
+
+#define LOCK_SLOTS	CONFIG_LIBUKLOCK_PROFILE_LOCKS
+
+/* Maximum number of locks in a ranking */
+#define DUMP_TOP_MAX	32
+
+static const char *const type_names[] = {
+	[UK_LOCKPROF_SPINLOCK]     = "spinlock",
+	[UK_LOCKPROF_MUTEX]        = "mutex",
+	[UK_LOCKPROF_RWLOCK_READ]  = "rwlock-r",
+	[UK_LOCKPROF_RWLOCK_WRITE] = "rwlock-w",
+};
+
+void uk_lockprof_enable(int enable)
+{
+	_uk_lockprof_on = !!enable;
+}
+
+/* Tables that were not cleared after the last reset yet are empty */
+static inline int lcpu_valid(unsigned int lcpu_idx)
+{
+	return ukplat_per_lcpu(_uk_lockprof_lcpu, lcpu_idx).epoch
+	       == UK_READ_ONCE(_uk_lockprof_epoch);
+}
+
+static const struct uk_lockprof_stats *
+lock_find(unsigned int lcpu_idx, __uptr lock, unsigned int type)
+{
+	const struct uk_lockprof_stats *s;
+	unsigned int idx = _uk_lockprof_hash(lock, type);
+	unsigned int i;
+
+	if (!lcpu_valid(lcpu_idx))
+		return NULL;
+
+	for (i = 0; i < LOCK_SLOTS; i++) {
+		s = &ukplat_per_lcpu(_uk_lockprof_lcpu, lcpu_idx)
+			.locks[(idx + i) % LOCK_SLOTS];
+		if (s->lock == lock && s->type == type)
+			return s;
+		if (!s->lock)
+			break;
+	}
+	return NULL;
+}
+
+/* Sums up the statistics of a lock over all LCPUs. The tables are read
+ * while they are updated, so the sum may be slightly inconsistent.
+ */
+static void lock_sum(__uptr lock, unsigned int type,
+		     struct uk_lockprof_stats *sum)
+{
+	const struct uk_lockprof_stats *s;
+	__u64 site_contended = 0;
+	unsigned int i;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->lock = lock;
+	sum->type = type;
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		s = lock_find(i, lock, type);
+		if (!s)
+			continue;
+
+		sum->acquisitions += s->acquisitions;
+		sum->contended += s->contended;
+		sum->wait_time += s->wait_time;
+		sum->hold_max = MAX(sum->hold_max, s->hold_max);
+
+		/* Take the site of the LCPU that waited most often */
+		if (!sum->site || s->contended > site_contended) {
+			sum->site = s->site;
+			site_contended = s->contended;
+		}
+	}
+}
+
+static inline int rank_before(const struct uk_lockprof_stats *a,
+			      const struct uk_lockprof_stats *b)
+{
+	if (a->wait_time != b->wait_time)
+		return a->wait_time > b->wait_time;
+	return a->acquisitions > b->acquisitions;
+}
+
+/* Insertion sort of all locks into the (descending) top list */
+unsigned int uk_lockprof_top(struct uk_lockprof_stats *out, unsigned int n)
+{
+	const struct uk_lockprof_stats *s;
+	struct uk_lockprof_stats sum;
+	unsigned int nr = 0;
+	unsigned int i, j, k;
+
+	UK_ASSERT(out || !n);
+
+	if (!n)
+		return 0;
+
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		if (!lcpu_valid(i))
+			continue;
+
+		for (k = 0; k < LOCK_SLOTS; k++) {
+			s = &ukplat_per_lcpu(_uk_lockprof_lcpu, i).locks[k];
+			if (!s->lock)
+				continue;
+
+			/* Every lock is ranked once, for the first LCPU that
+			 * acquired it
+			 */
+			for (j = 0; j < i; j++) {
+				if (lock_find(j, s->lock, s->type))
+					break;
+			}
+			if (j < i)
+				continue;
+
+			lock_sum(s->lock, s->type, &sum);
+			if (nr == n && !rank_before(&sum, &out[nr - 1]))
+				continue;
+
+			j = (nr < n) ? nr++ : nr - 1;
+			for (; j > 0; j--) {
+				if (!rank_before(&sum, &out[j - 1]))
+					break;
+				out[j] = out[j - 1];
+			}
+			out[j] = sum;
+		}
+	}
+	return nr;
+}
+
+static __u64 nr_dropped(void)
+{
+	__u64 dropped = 0;
+	unsigned int i;
+
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		if (lcpu_valid(i))
+			dropped += ukplat_per_lcpu(_uk_lockprof_lcpu,
+						   i).nr_dropped;
+	}
+	return dropped;
+}
+
+void uk_lockprof_dumpk(int klvl, unsigned int top)
+{
+	struct uk_lockprof_stats r[DUMP_TOP_MAX];
+	unsigned int nr, i;
+
+	nr = uk_lockprof_top(r, MIN(top, (unsigned int) DUMP_TOP_MAX));
+
+	uk_printk(klvl, "Lock profile%s, %"__PRIu64" dropped acquisitions\n",
+		  _uk_lockprof_on ? "" : " (disabled)", nr_dropped());
+	uk_printk(klvl, "Top %u locks by wait time:\n", nr);
+	for (i = 0; i < nr; i++) {
+		uk_printk(klvl,
+			  " %2u. %-8s %p (%p): %"__PRIu64" acquisitions, "
+			  "%"__PRIu64" contended, wait %"__PRInsec"ns "
+			  "(avg %"__PRInsec"ns), hold max %"__PRInsec"ns\n",
+			  i + 1, type_names[r[i].type], (void *) r[i].lock,
+			  (void *) r[i].site, r[i].acquisitions,
+			  r[i].contended, r[i].wait_time,
+			  r[i].contended ? r[i].wait_time / r[i].contended
+					 : 0,
+			  r[i].hold_max);
+	}
+}
+
+/*
+ * ukstore
+ */
+static int get_enabled(void *cookie __unused, __u8 *out)
+{
+	*out = (__u8) _uk_lockprof_on;
+	return 0;
+}
+
+static int set_enabled(void *cookie __unused, __u8 val)
+{
+	uk_lockprof_enable(val);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_LOCKPROF_ENABLED, profile_enabled, u8,
+		      get_enabled, set_enabled);
+
+static int get_nb_dropped(void *cookie __unused, __u64 *out)
+{
+	*out = nr_dropped();
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_LOCKPROF_NUM_DROPPED, profile_nb_dropped, u64,
+		      get_nb_dropped, NULL);
+
+static int set_reset(void *cookie __unused, __u8 val)
+{
+	if (val)
+		uk_lockprof_reset();
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_LOCKPROF_RESET, profile_reset, u8,
+		      NULL, set_reset);
+
+#if CONFIG_LIBUKSTORE
+#define STORE_TOP	CONFIG_LIBUKLOCK_PROFILE_STORE_TOP
+
+/* Maximum age of the ranking behind the "top<rank>" objects */
+#define STORE_SNAPSHOT_NSEC	ukarch_time_sec_to_nsec(1)
+
+/* The entries of the objects are read one by one. They are served from a
+ * snapshot of the ranking, so that all entries of an object describe the
+ * same lock. `seq` counts the snapshots: readers that get the same
+ * sequence number before and after reading the entries saw one ranking.
+ */
+static struct {
+	__spinlock lock;
+	__u64 seq;
+	__nsec taken;
+	unsigned long epoch;
+	unsigned int nr;
+	struct uk_lockprof_stats r[STORE_TOP];
+} snap = {
+	.lock = UKARCH_SPINLOCK_INITIALIZER(),
+};
+
+/* Takes a new snapshot if the current one is too old or predates a reset.
+ * Must be called with `snap.lock` held.
+ */
+static void snap_update(void)
+{
+	__nsec now = ukplat_monotonic_clock();
+	unsigned long epoch = UK_READ_ONCE(_uk_lockprof_epoch);
+
+	if (snap.seq && snap.epoch == epoch
+	    && now - snap.taken < STORE_SNAPSHOT_NSEC)
+		return;
+
+	snap.nr = uk_lockprof_top(snap.r, STORE_TOP);
+	snap.epoch = epoch;
+	snap.taken = now;
+	snap.seq++;
+}
+
+/* The lock is not profiled. Holders do not get preempted, so ranking takes
+ * only short turns.
+ */
+static inline void snap_lock(void)
+{
+	uk_preempt_disable();
+	ukarch_spin_lock(&snap.lock);
+}
+
+static inline void snap_unlock(void)
+{
+	ukarch_spin_unlock(&snap.lock);
+	uk_preempt_enable();
+}
+
+static int get_top_seq(void *cookie __unused, __u64 *out)
+{
+	snap_lock();
+	snap_update();
+	*out = snap.seq;
+	snap_unlock();
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_LOCKPROF_TOP_SEQ, profile_top_seq, u64,
+		      get_top_seq, NULL);
+
+/* Statistics of the lock at the rank given by the cookie, all zero if
+ * fewer locks were profiled
+ */
+static void store_rank(void *cookie, struct uk_lockprof_stats *out)
+{
+	unsigned int rank = (unsigned int) (__uptr) cookie;
+
+	snap_lock();
+	snap_update();
+	if (rank < snap.nr)
+		*out = snap.r[rank];
+	else
+		memset(out, 0, sizeof(*out));
+	snap_unlock();
+}
+
+static int get_lock(void *cookie, __uptr *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.lock;
+	return 0;
+}
+
+static int get_site(void *cookie, __uptr *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.site;
+	return 0;
+}
+
+static int get_type(void *cookie, __u32 *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.type;
+	return 0;
+}
+
+static int get_acquisitions(void *cookie, __u64 *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.acquisitions;
+	return 0;
+}
+
+static int get_contended(void *cookie, __u64 *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.contended;
+	return 0;
+}
+
+static int get_wait_ns(void *cookie, __u64 *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.wait_time;
+	return 0;
+}
+
+static int get_hold_max_ns(void *cookie, __u64 *out)
+{
+	struct uk_lockprof_stats s;
+
+	store_rank(cookie, &s);
+	*out = s.hold_max;
+	return 0;
+}
+
+static const struct uk_store_entry *top_entries[] = {
+	UK_STORE_ENTRY(UK_LOCKPROF_LOCK, lock, uptr, get_lock, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_SITE, site, uptr, get_site, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_TYPE, type, u32, get_type, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_ACQUISITIONS, acquisitions, u64,
+		       get_acquisitions, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_CONTENDED, contended, u64,
+		       get_contended, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_WAIT_NS, wait_ns, u64,
+		       get_wait_ns, NULL),
+	UK_STORE_ENTRY(UK_LOCKPROF_HOLD_MAX_NS, hold_max_ns, u64,
+		       get_hold_max_ns, NULL),
+	NULL
+};
+
+/* Export one object per rank, named "top<rank>". The ranking is taken
+ * when an entry is read and the last one is more than a second old.
+ */
+static int prof_store_init(struct uk_init_ctx *ictx __unused)
+{
+	struct uk_store_object *obj;
+	char *name;
+	__uptr i;
+	int rc;
+
+	for (i = 0; i < STORE_TOP; i++) {
+		if (unlikely(asprintf(&name, "top%u", (unsigned int) i) < 0))
+			return -ENOMEM;
+
+		obj = uk_store_obj_alloc(uk_alloc_get_default(), i, name,
+					 top_entries, (void *) i);
+		free(name);
+		if (unlikely(PTRISERR(obj)))
+			return PTR2ERR(obj);
+
+		rc = uk_store_obj_add(obj);
+		if (unlikely(rc))
+			return rc;
+	}
+	return 0;
+}
+#else /* !CONFIG_LIBUKSTORE */
+#define prof_store_init 0x0
+#endif /* !CONFIG_LIBUKSTORE */
+
+#if CONFIG_LIBUKLOCK_PROFILE_DUMP
+static void prof_dump_term(const struct uk_term_ctx *tctx __unused)
+{
+	uk_lockprof_dumpk(KLVL_INFO, DUMP_TOP_MAX);
+}
+#else /* !CONFIG_LIBUKLOCK_PROFILE_DUMP */
+#define prof_dump_term 0x0
+#endif /* !CONFIG_LIBUKLOCK_PROFILE_DUMP */
+
+#if CONFIG_LIBUKSTORE || CONFIG_LIBUKLOCK_PROFILE_DUMP
+uk_late_initcall(prof_store_init, prof_dump_term);
+#endif /* CONFIG_LIBUKSTORE || CONFIG_LIBUKLOCK_PROFILE_DUMP */
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <stddef.h>
+#include <uk/arch/lcpu.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/mcslock.h>
+#include <uk/plat/lcpu.h>
+
+/*
+ * A logical CPU waits for at most one lock per context. Interrupts can
+ * nest the waiting, up to this depth. Deeper nesting falls back to
+ * spinning on the lock word.
+ */
+#define MCS_MAX_NODES		4
+
+/* The tail is (lcpu index + 1) << 2 | node index */
+#define MCS_TAIL_IDX_BITS	2
+#define MCS_TAIL_IDX_MASK	((1U << MCS_TAIL_IDX_BITS) - 1)
+
+UK_CTASSERT(MCS_MAX_NODES <= (1U << MCS_TAIL_IDX_BITS));
+UK_CTASSERT(CONFIG_UKPLAT_LCPU_MAXCOUNT < (1U << (16 - MCS_TAIL_IDX_BITS)));
+
+struct mcs_node {
+	struct mcs_node *next;
+	int locked;		/* set by the predecessor: we are the head */
+};
+
+struct mcs_lcpu {
+	struct mcs_node nodes[MCS_MAX_NODES];
+	unsigned int count;	/* nodes in use */
+} __align(CACHE_LINE_SIZE);
+
+static UKPLAT_PER_LCPU_DEFINE(struct mcs_lcpu, mcs_lcpu);
+
+static inline __u16 mcs_encode_tail(unsigned int lcpu, unsigned int idx)
+{
+	return (__u16) (((lcpu + 1) << MCS_TAIL_IDX_BITS) | idx);
+}
+
+static inline struct mcs_node *mcs_decode_tail(__u16 tail)
+{
+	unsigned int lcpu = (tail >> MCS_TAIL_IDX_BITS) - 1;
+
+	return &ukplat_per_lcpu(mcs_lcpu, lcpu).nodes[tail & MCS_TAIL_IDX_MASK];
+}
+
+void _uk_mcs_lock_slow(struct __mcslock *lock)
+{
+	struct mcs_lcpu *ml = &ukplat_per_lcpu_current(mcs_lcpu);
+	struct mcs_node *node, *prev, *next;
+	unsigned int idx;
+	__u16 tail, old;
+	__u32 val;
+
+	/* Interrupts that come in between take the next node and release
+	 * it before they return
+	 */
+	idx = ml->count++;
+	if (unlikely(idx >= MCS_MAX_NODES)) {
+		while (!uk_mcs_trylock(lock))
+			ukarch_spinwait();
+		goto out;
+	}
+
+	node = &ml->nodes[idx];
+	node->next = NULL;
+	node->locked = 0;
+	tail = mcs_encode_tail(ukplat_lcpu_idx(), idx);
+
+	/* Append our node to the queue; wait behind the predecessor */
+	old = __atomic_exchange_n(&lock->tail, tail, __ATOMIC_ACQ_REL);
+	if (old) {
+		prev = mcs_decode_tail(old);
+		__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+		while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			ukarch_spinwait();
+	}
+
+	/* We are the head of the queue, wait for the owner */
+	while ((val = __atomic_load_n(&lock->val, __ATOMIC_ACQUIRE))
+	       & UK_MCSLOCK_LOCKED_MASK)
+		ukarch_spinwait();
+
+	/* Take the lock. If we are the last waiter, the queue is empty
+	 * afterwards. Nobody else can set the locked byte while the tail
+	 * is set.
+	 */
+	for (;;) {
+		if ((val >> UK_MCSLOCK_TAIL_SHIFT) != tail) {
+			__atomic_store_n(&lock->locked, UK_MCSLOCK_LOCKED,
+					 __ATOMIC_RELAXED);
+			break;
+		}
+		if (__atomic_compare_exchange_n(&lock->val, &val,
+						UK_MCSLOCK_LOCKED, 0,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_ACQUIRE))
+			goto out;
+	}
+
+	/* Make the successor the head of the queue. It may not have linked
+	 * itself yet.
+	 */
+	while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+		ukarch_spinwait();
+	__atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+
+out:
+	ml->count--;
+}
@@ -1,52 +1,212 @@
 #include <uk/mutex.h>
+#include <uk/arch/lcpu.h>
+#include <uk/arch/time.h>
+#include <uk/atomic.h>
+#include <uk/list.h>
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-#include <uk/init.h>
+#include <string.h>
 #include <uk/assert.h>
 
-struct uk_mutex_metrics _uk_mutex_metrics = { 0 };
-__spinlock              _uk_mutex_metrics_lock;
+UKPLAT_PER_LCPU_DEFINE(struct _uk_mutex_lcpu_metrics, _uk_mutex_metrics);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 
 void uk_mutex_init_config(struct uk_mutex *m, unsigned int flags)
 {
+#ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
+	unsigned long irqf;
+#endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
+
 	m->lock_count = 0;
 	m->flags = flags;
 	m->owner = NULL;
 	uk_waitq_init(&m->wait);
+	m->handoff = NULL;
+#if CONFIG_LIBUKLOCK_PROFILE
+	m->prof_since = 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 
 #ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-	ukarch_spin_lock(&_uk_mutex_metrics_lock);
-	_uk_mutex_metrics.active_unlocked++;
-	ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+	irqf = ukplat_lcpu_save_irqf();
+	ukplat_per_lcpu_current(_uk_mutex_metrics).m.active_unlocked++;
+	ukplat_lcpu_restore_irqf(irqf);
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
 }
 
-#ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
-/**
- * Initializes the mutex metric counters and its spinlock.
- * @return 0 on success.
+/* Acquires the free mutex, which is not handed over to another thread.
+ * Returns 1 on success.
+ */
+static int mutex_acquire(struct uk_mutex *m, struct uk_thread *cur)
+{
+	if (uk_compare_exchange_sync(&m->owner, NULL, cur) != cur)
+		return 0;
+
+	/* We might have asked for a handoff before the mutex became free */
+	if (UK_READ_ONCE(m->handoff) == cur)
+		UK_WRITE_ONCE(m->handoff, NULL);
+	return 1;
+}
+
+#if CONFIG_LIBUKLOCK_MUTEX_ADAPTIVE
+#define MUTEX_SPIN_NS ((__nsec) ukarch_time_usec_to_nsec(	\
+	CONFIG_LIBUKLOCK_MUTEX_SPIN_USEC))
+
+/*
+ * Spins as long as the owner is running on another LCPU, since it is then
+ * likely to release the mutex sooner than blocking and waking up would
+ * take. Returns 1 if the mutex was acquired.
  *
- * NOTE: this function is registered as a CTOR for this library.
+ * NOTE: The owner may exit and its thread may be released while we look at
+ *       it. The checks only read from it and the owner is re-read in every
+ *       iteration, so this is harmless.
  */
-static int mutex_metrics_ctor(void)
+static int mutex_spin(struct uk_mutex *m, struct uk_thread *cur)
+{
+	struct uk_thread *owner, *handoff;
+	__nsec deadline = 0, now;
+
+	for (;;) {
+		owner = UK_READ_ONCE(m->owner);
+		if (owner == cur)
+			return 1; /* handed over to us */
+		if (!owner) {
+			/* Leave the mutex to the waiter that asked for it.
+			 * We block until the waiter releases it again.
+			 */
+			handoff = UK_READ_ONCE(m->handoff);
+			if (handoff && handoff != cur)
+				return 0;
+			if (mutex_acquire(m, cur))
+				return 1;
+			continue;
+		}
+		if (!uk_thread_is_running(owner))
+			return 0;
+
+		now = ukplat_monotonic_clock();
+		if (!deadline)
+			deadline = now + MUTEX_SPIN_NS;
+		else if (now >= deadline)
+			return 0;
+		ukarch_spinwait();
+	}
+}
+#endif /* CONFIG_LIBUKLOCK_MUTEX_ADAPTIVE */
+
+void _uk_mutex_lock_slow(struct uk_mutex *m, struct uk_thread *cur)
+{
+	struct uk_thread *owner, *handoff;
+	unsigned long flags;
+	DEFINE_WAIT(wait);
+
+	for (;;) {
+#if CONFIG_LIBUKLOCK_MUTEX_ADAPTIVE
+		if (mutex_spin(m, cur))
+			break;
+#endif /* CONFIG_LIBUKLOCK_MUTEX_ADAPTIVE */
+
+		/* The owner is checked and we block under the wait queue
+		 * lock, so that a release cannot be missed
+		 */
+		ukplat_spin_lock_irqsave(&m->wait.sl, flags);
+		owner = UK_READ_ONCE(m->owner);
+		if (owner == cur) {
+			/* The unlocking thread handed the mutex over to us */
+			ukplat_spin_unlock_irqrestore(&m->wait.sl, flags);
+			break;
+		}
+		if (!owner) {
+			/* A mutex that is free but promised to another
+			 * waiter is not available: that waiter takes it and
+			 * wakes the next one when it unlocks
+			 */
+			handoff = UK_READ_ONCE(m->handoff);
+			if ((!handoff || handoff == cur)
+			    && mutex_acquire(m, cur)) {
+				ukplat_spin_unlock_irqrestore(&m->wait.sl,
+							      flags);
+				break;
+			}
+		} else {
+			/* Whenever we find the mutex taken, have it handed
+			 * over to us at the next unlock, so that lockers on
+			 * the fast path cannot starve us. If another waiter
+			 * already asked for it, we ask again after its turn.
+			 */
+			uk_compare_exchange_sync(&m->handoff, NULL, cur);
+		}
+
+		uk_waitq_add(&m->wait, &wait);
+		uk_thread_set_blocked(cur);
+		uk_sched_thread_blocked(cur);
+		ukplat_spin_unlock_irqrestore(&m->wait.sl, flags);
+		uk_sched_yield();
+	}
+
+	uk_waitq_remove_waiter(&m->wait, &wait);
+}
+
+void _uk_mutex_release(struct uk_mutex *m)
 {
-	ukarch_spin_init(&_uk_mutex_metrics_lock);
+	struct uk_waitq_entry *head;
+	struct uk_thread *next;
+	unsigned long flags;
+
+	/* Waiters check the owner while holding the wait queue lock before
+	 * they block, so that changing it under the lock loses no wakeup
+	 */
+	ukplat_spin_lock_irqsave(&m->wait.sl, flags);
+
+	/* Make sure lock_count is visible before changing the owner.
+	 * The lock can be acquired afterwards.
+	 */
+	wmb();
+	next = UK_READ_ONCE(m->handoff);
+	if (next) {
+		/* Only the thread that asked for the handoff clears it
+		 * otherwise, and it cannot do so while we own the mutex
+		 */
+		UK_WRITE_ONCE(m->handoff, NULL);
+		UK_WRITE_ONCE(m->owner, next);
+	} else {
+		head = UK_STAILQ_FIRST(&m->wait.wait_list);
+		next = head ? head->thread : NULL;
+		UK_WRITE_ONCE(m->owner, NULL);
+	}
 
-	return 0;
+	/* Wake a single waiter only, the others would just find the mutex
+	 * taken again
+	 */
+	if (next)
+		uk_thread_wake(next);
+	ukplat_spin_unlock_irqrestore(&m->wait.sl, flags);
 }
-uk_lib_initcall_prio(mutex_metrics_ctor, 0x0, 1);
 
+#ifdef CONFIG_LIBUKLOCK_MUTEX_METRICS
 /**
- * Makes a copy of mutex metrics to avoid direct user access.
+ * Sums up the mutex metrics of all LCPUs.
  * @dst : destination buffer (must have been already allocated)
+ *
+ * NOTE: The copies of other LCPUs are read while they are updated. The
+ *       sum may be off by the operations that are in progress.
  */
 void uk_mutex_get_metrics(struct uk_mutex_metrics *dst)
 {
+	const struct uk_mutex_metrics *mm;
+	unsigned int i;
+
 	UK_ASSERT(dst);
 
-	ukarch_spin_lock(&_uk_mutex_metrics_lock);
-	memcpy(dst, &_uk_mutex_metrics, sizeof(*dst));
-	ukarch_spin_unlock(&_uk_mutex_metrics_lock);
+	memset(dst, 0, sizeof(*dst));
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		mm = &ukplat_per_lcpu(_uk_mutex_metrics, i).m;
+		dst->active_locked         += UK_READ_ONCE(mm->active_locked);
+		dst->active_unlocked       += UK_READ_ONCE(mm->active_unlocked);
+		dst->total_locks           += UK_READ_ONCE(mm->total_locks);
+		dst->total_ok_trylocks     += UK_READ_ONCE(mm->total_ok_trylocks);
+		dst->total_failed_trylocks +=
+			UK_READ_ONCE(mm->total_failed_trylocks);
+		dst->total_unlocks         += UK_READ_ONCE(mm->total_unlocks);
+	}
 }
 #endif /* CONFIG_LIBUKLOCK_MUTEX_METRICS */
@@ -9,6 +9,9 @@
 #include <uk/rwlock.h>
 #include <uk/assert.h>
 #include <uk/config.h>
+#if CONFIG_LIBUKLOCK_PROFILE
+#include <uk/lockprof.h>
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 
 void uk_rwlock_init_config(struct uk_rwlock *rwl, unsigned int config_flags)
 {
@@ -25,15 +28,27 @@ void uk_rwlock_init_config(struct uk_rwlock *rwl, unsigned int config_flags)
 	uk_spin_init(&rwl->sl);
 	uk_waitq_init(&rwl->shared);
 	uk_waitq_init(&rwl->exclusive);
+#if CONFIG_LIBUKLOCK_PROFILE
+	rwl->prof_since = 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 }
 
 void uk_rwlock_rlock(struct uk_rwlock *rwl)
 {
+#if CONFIG_LIBUKLOCK_PROFILE
+	__nsec since = 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 	UK_ASSERT(rwl);
 
 	uk_spin_lock(&rwl->sl);
 	rwl->npending_reads++;
 
+#if CONFIG_LIBUKLOCK_PROFILE
+	if (rwl->npending_writes > 0 || rwl->nactive < 0)
+		since = uk_lockprof_wait_begin();
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 	/* We let readers wait when there are writers pending. This is
 	 * necessary to avoid a situation where new readers continuously enter
 	 * the critical section while other readers are still in - thereby
@@ -62,15 +77,31 @@ void uk_rwlock_rlock(struct uk_rwlock *rwl)
 	rwl->nactive++;
 	rwl->npending_reads--;
 	uk_spin_unlock(&rwl->sl);
+
+#if CONFIG_LIBUKLOCK_PROFILE
+	/* Readers share the lock, only writers record the hold time */
+	if (unlikely(_uk_lockprof_on))
+		_uk_lockprof_acquired(rwl, UK_LOCKPROF_RWLOCK_READ, since,
+				      __builtin_return_address(0));
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 }
 
 void uk_rwlock_wlock(struct uk_rwlock *rwl)
 {
+#if CONFIG_LIBUKLOCK_PROFILE
+	__nsec since = 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 	UK_ASSERT(rwl);
 
 	uk_spin_lock(&rwl->sl);
 	rwl->npending_writes++;
 
+#if CONFIG_LIBUKLOCK_PROFILE
+	if (rwl->nactive != 0)
+		since = uk_lockprof_wait_begin();
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 	/* Wait for all readers to have left the lock. New readers will
 	 * block in uk_rwlock_rlock while we are waiting.
 	 */
@@ -86,6 +117,15 @@ void uk_rwlock_wlock(struct uk_rwlock *rwl)
 	rwl->npending_writes--;
 	rwl->nactive = -1;
 	uk_spin_unlock(&rwl->sl);
+
+#if CONFIG_LIBUKLOCK_PROFILE
+	rwl->prof_since = unlikely(_uk_lockprof_on)
+			  ? _uk_lockprof_acquired(rwl,
+						  UK_LOCKPROF_RWLOCK_WRITE,
+						  since,
+						  __builtin_return_address(0))
+			  : 0;
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
 }
 
 void uk_rwlock_runlock(struct uk_rwlock *rwl)
@@ -116,6 +156,12 @@ void uk_rwlock_wunlock(struct uk_rwlock *rwl)
 
 	UK_ASSERT(rwl);
 
+#if CONFIG_LIBUKLOCK_PROFILE
+	if (unlikely(_uk_lockprof_on))
+		_uk_lockprof_released(rwl, UK_LOCKPROF_RWLOCK_WRITE,
+				      rwl->prof_since);
+#endif /* CONFIG_LIBUKLOCK_PROFILE */
+
 	uk_spin_lock(&rwl->sl);
 	UK_ASSERT(rwl->nactive == -1);
 
@@ -316,6 +316,35 @@ struct uk_netbuf *uk_netbuf_alloc_buf(struct uk_alloc *a, size_t buflen,
 				      size_t bufalign, uint16_t headroom,
 				      size_t privlen, uk_netbuf_dtor_t dtor);
 
+/**
+ * Allocates multiple netbufs with the same properties as `uk_netbuf_alloc_buf()`
+ * with a single batch request to the allocator. This is intended for
+ * refilling receive queues (`uk_netdev_alloc_rxpkts`).
+ * @param a
+ *   Allocator to use for the netbuf allocations
+ * @param buflen
+ *   Size of each data buffer
+ * @param bufalign
+ *   Alignment of each data buffer
+ * @param headroom
+ *   Number of bytes reserved as headroom from the buffer area
+ * @param privlen
+ *   Length for reserved memory to store private data
+ * @param dtor
+ *   Destructor that is called when a netbuf is free'd (optional)
+ * @param m
+ *   Array that is filled with the allocated netbufs
+ * @param count
+ *   Number of requested netbufs
+ * @returns
+ *   Number of netbufs that were allocated and stored at the beginning of `m`
+ */
+unsigned int uk_netbuf_alloc_buf_batch(struct uk_alloc *a, size_t buflen,
+				       size_t bufalign, uint16_t headroom,
+				       size_t privlen, uk_netbuf_dtor_t dtor,
+				       struct uk_netbuf *m[],
+				       unsigned int count);
+
 /**
  * Initialize netbuf with data buffer on a user given allocated memory area
  * m->len is initialized with 0. Metadata (struct uknetbuf, priv)
@@ -510,6 +539,17 @@ void uk_netbuf_free(struct uk_netbuf *m);
  */
 void uk_netbuf_free_single(struct uk_netbuf *m);
 
+/**
+ * Releases multiple uk_netbuf chains like `uk_netbuf_free()`. Allocations of
+ * netbufs that originate from the same allocator are handed back with
+ * batch free requests.
+ * @param m
+ *   Array of uk_netbuf chain heads to release
+ * @param count
+ *   Number of elements in `m`
+ */
+void uk_netbuf_free_batch(struct uk_netbuf *m[], unsigned int count);
+
 /**
  * Calculates the current available headroom bytes of a netbuf
  * @param m
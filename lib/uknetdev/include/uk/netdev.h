@@ -490,23 +490,23 @@ static inline int uk_netdev_rx_one(struct uk_netdev *dev, uint16_t queue_id,
 	if (ret >= 0 && (ret & UK_NETDEV_STATUS_SUCCESS)) {
 		struct uk_netbuf *nb;
 
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		UK_NETBUF_CHAIN_FOREACH(nb, *pkt)
 			dev->_stats.rx_m.bytes += (*pkt)->len;
 		dev->_stats.rx_m.packets++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 	if (ret >= 0 && (ret & UK_NETDEV_STATUS_UNDERRUN)) {
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		dev->_stats.rx_m.fifo++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 	if (ret < 0) {
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		dev->_stats.rx_m.errors++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 #endif /* CONFIG_LIBUKNETDEV_STATS */
@@ -558,23 +558,23 @@ static inline int uk_netdev_tx_one(struct uk_netdev *dev, uint16_t queue_id,
 	if (ret >= 0 && (ret & UK_NETDEV_STATUS_SUCCESS)) {
 		struct uk_netbuf *nb;
 
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		UK_NETBUF_CHAIN_FOREACH(nb, pkt)
 			dev->_stats.tx_m.bytes += nb->len;
 		dev->_stats.tx_m.packets++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 	if (ret >= 0 && (ret & UK_NETDEV_STATUS_UNDERRUN)) {
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		dev->_stats.tx_m.fifo++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 	if (ret < 0) {
-		ukarch_spin_lock(&dev->_stats_lock);
+		uk_spin_lock(&dev->_stats_lock);
 		dev->_stats.tx_m.errors++;
-		ukarch_spin_unlock(&dev->_stats_lock);
+		uk_spin_unlock(&dev->_stats_lock);
 		return ret;
 	}
 #endif /* CONFIG_LIBUKNETDEV_STATS */
@@ -48,7 +48,7 @@
 #include <uk/semaphore.h>
 #endif
 #ifdef CONFIG_LIBUKNETDEV_STATS
-#include <uk/arch/spinlock.h>
+#include <uk/spinlock.h>
 #endif /* CONFIG_LIBUKNETDEV_STATS */
 
 
@@ -532,7 +532,7 @@ struct uk_netdev {
 #ifdef CONFIG_LIBUKNETDEV_STATS
 	/* TODO: Per-queue stats to reduce contention */
 	struct uk_netdev_stats _stats;
-	__spinlock _stats_lock;
+	uk_spinlock _stats_lock;
 #endif /* CONFIG_LIBUKNETDEV_STATS */
 };
 
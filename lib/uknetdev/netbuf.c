@@ -156,6 +156,47 @@ struct uk_netbuf *uk_netbuf_alloc_buf(struct uk_alloc *a, size_t buflen,
 	return m;
 }
 
+unsigned int uk_netbuf_alloc_buf_batch(struct uk_alloc *a, size_t buflen,
+				       size_t bufalign, uint16_t headroom,
+				       size_t privlen, uk_netbuf_dtor_t dtor,
+				       struct uk_netbuf *m[],
+				       unsigned int count)
+{
+	size_t alloc_len;
+	unsigned int cnt, i;
+	void *mem;
+
+	UK_ASSERT(buflen > 0);
+	UK_ASSERT(headroom <= buflen);
+	UK_ASSERT(m || !count);
+
+	alloc_len = NETBUF_ADDR_ALIGN_UP(buflen)
+		    + NETBUF_ADDR_ALIGN_UP(sizeof(**m) + privlen);
+
+	/* The result array is used as temporary storage for the
+	 * allocations; each entry is replaced with its netbuf afterwards.
+	 */
+	cnt = uk_memalign_batch(a, bufalign, alloc_len, (void **) m, count);
+	for (i = 0; i < cnt; i++) {
+		mem = (void *) m[i];
+		m[i] = uk_netbuf_prepare_buf(mem,
+					     alloc_len,
+					     headroom,
+					     privlen,
+					     dtor);
+		/* Only fails if `alloc_len` cannot hold the metadata */
+		UK_ASSERT(m[i]);
+
+		/* Save reference to allocator and allocation
+		 * that is used for free'ing this uk_netbuf.
+		 */
+		m[i]->_a = a;
+		m[i]->_b = mem;
+	}
+
+	return cnt;
+}
+
 struct uk_netbuf *uk_netbuf_prepare_buf(void *mem, size_t size,
 					uint16_t headroom,
 					size_t privlen, uk_netbuf_dtor_t dtor)
@@ -241,13 +282,18 @@ void uk_netbuf_append(struct uk_netbuf *head,
 	tail->prev = headtail;
 }
 
-void uk_netbuf_free_single(struct uk_netbuf *m)
+/* Drops a reference of a single netbuf. When the last reference was released,
+ * the netbuf is disconnected and its destructor is called. The allocation that
+ * has to be free'd afterwards is returned with `a` and `b`.
+ */
+static void _netbuf_release(struct uk_netbuf *m,
+			    struct uk_alloc **a, void **b)
 {
-	struct uk_alloc *a;
-	void *b;
-
 	UK_ASSERT(m);
 
+	*a = NULL;
+	*b = NULL;
+
 	/* Decrease refcount and call destructor and free up memory
 	 * when last reference was released.
 	 */
@@ -264,19 +310,27 @@ void uk_netbuf_free_single(struct uk_netbuf *m)
 		 * however we need to access them for a check after
 		 * we have called the destructor.
 		 */
-		a = m->_a;
-		b = m->_b;
+		*a = m->_a;
+		*b = m->_b;
 
 		if (m->dtor)
 			m->dtor(m);
-		if (a && b)
-			uk_free(a, b);
 	} else {
 		uk_pr_debug("Not freeing netbuf %p (next: %p): refcount greater than 1",
 			    m, m->next);
 	}
 }
 
+void uk_netbuf_free_single(struct uk_netbuf *m)
+{
+	struct uk_alloc *a;
+	void *b;
+
+	_netbuf_release(m, &a, &b);
+	if (a && b)
+		uk_free(a, b);
+}
+
 void uk_netbuf_free(struct uk_netbuf *m)
 {
 	struct uk_netbuf *n;
@@ -290,3 +344,44 @@ void uk_netbuf_free(struct uk_netbuf *m)
 		m = n;
 	}
 }
+
+#define NETBUF_FREE_BATCHLEN 32
+
+void uk_netbuf_free_batch(struct uk_netbuf *m[], unsigned int count)
+{
+	void *batch[NETBUF_FREE_BATCHLEN];
+	struct uk_alloc *batch_a = NULL;
+	unsigned int batch_len = 0;
+	struct uk_netbuf *n, *next;
+	struct uk_alloc *a;
+	unsigned int i;
+	void *b;
+
+	UK_ASSERT(m || !count);
+
+	for (i = 0; i < count; i++) {
+		UK_ASSERT(m[i]);
+		UK_ASSERT(!m[i]->prev);
+
+		for (n = m[i]; n != NULL; n = next) {
+			next = n->next;
+			_netbuf_release(n, &a, &b);
+			if (!a || !b)
+				continue;
+
+			/* Flush pending frees when the batch is full or when
+			 * the netbuf belongs to a different allocator
+			 */
+			if (batch_len == NETBUF_FREE_BATCHLEN
+			    || (batch_len > 0 && a != batch_a)) {
+				uk_free_batch(batch_a, batch, batch_len);
+				batch_len = 0;
+			}
+			batch_a = a;
+			batch[batch_len++] = b;
+		}
+	}
+
+	if (batch_len > 0)
+		uk_free_batch(batch_a, batch, batch_len);
+}
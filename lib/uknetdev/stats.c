@@ -146,7 +146,7 @@ int uk_netdev_stats_init(struct uk_netdev *dev)
 	char *obj_name;
 
 	memset(&dev->_stats, 0, sizeof(dev->_stats));
-	ukarch_spin_init(&dev->_stats_lock);
+	uk_spin_init(&dev->_stats_lock);
 
 	/* Create stats object */
 	res = asprintf(&obj_name, "netdev%d", dev_id);
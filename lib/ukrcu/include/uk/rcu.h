@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Read-copy-update: readers access shared data without locks and without
+ * writing to shared memory. Writers publish new versions of the data with
+ * `uk_rcu_assign_pointer()` and reclaim old versions only after a grace
+ * period, i.e., after every reader that may still see them has left its
+ * read-side critical section.
+ *
+ * Grace periods are driven by the quiescent states that uksched reports
+ * (see `uk_sched_qs_count()`): read-side critical sections disable
+ * preemption and must not block or yield, so a logical CPU that switched
+ * threads or went idle since the start of a grace period cannot be in a
+ * critical section that started before it. Only logical CPUs that run a
+ * scheduler are tracked.
+ */
+
+#ifndef __UK_RCU_H__
+#define __UK_RCU_H__
+
+#include <uk/essentials.h>
+#include <uk/list.h>
+#include <uk/preempt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enters a read-side critical section. Sections can be nested. Until the
+ * matching `uk_rcu_read_unlock()`, the caller must not block, yield or
+ * sleep.
+ */
+static inline void uk_rcu_read_lock(void)
+{
+	uk_preempt_disable();
+	barrier();
+}
+
+/**
+ * Leaves a read-side critical section
+ */
+static inline void uk_rcu_read_unlock(void)
+{
+	barrier();
+	uk_preempt_enable();
+}
+
+/**
+ * Loads an RCU-protected pointer within a read-side critical section. The
+ * fields of the referenced object are then at least as recent as when the
+ * pointer was published.
+ */
+#define uk_rcu_dereference(p) \
+	__atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+/**
+ * Publishes an RCU-protected pointer. All initialization of the referenced
+ * object happens before readers can see the pointer.
+ */
+#define uk_rcu_assign_pointer(p, v) \
+	__atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Waits for a grace period: returns after all read-side critical sections
+ * that were entered before the call have been left. Must be called from
+ * thread context outside of read-side critical sections; it may block.
+ */
+void uk_rcu_synchronize(void);
+
+struct uk_rcu_head;
+
+typedef void (*uk_rcu_func_t)(struct uk_rcu_head *head);
+
+/* Embed into objects that are reclaimed with `uk_rcu_call()` */
+struct uk_rcu_head {
+	struct uk_rcu_head *next;
+	uk_rcu_func_t func;
+};
+
+/**
+ * Calls `func(head)` from the reclamation thread after a grace period.
+ * Does not block; must not be called from interrupt context.
+ *
+ * @param head
+ *   Head embedded in the object to reclaim, handed to `func`
+ * @param func
+ *   Function that reclaims the object, e.g., with `__containerof()` and
+ *   `free()`. It runs in thread context and may block.
+ */
+void uk_rcu_call(struct uk_rcu_head *head, uk_rcu_func_t func);
+
+/**
+ * Waits until all callbacks that were queued with `uk_rcu_call()` before
+ * this call have been executed
+ */
+void uk_rcu_barrier(void);
+
+/*
+ * RCU variants of the hash list operations. Writers serialize among each
+ * other with a lock and may run concurrently with readers that iterate the
+ * list in a read-side critical section. A removed node keeps its `next`
+ * pointer, so that readers on it can continue; it must not be freed before
+ * a grace period passed. Readers on a node that is moved to another list
+ * continue on that list and can miss nodes of the original one.
+ */
+static inline void
+uk_hlist_add_head_rcu(struct uk_hlist_node *n, struct uk_hlist_head *h)
+{
+	struct uk_hlist_node *first = h->first;
+
+	n->next = first;
+	n->pprev = &h->first;
+	uk_rcu_assign_pointer(h->first, n);
+	if (first)
+		first->pprev = &n->next;
+}
+
+static inline void
+uk_hlist_del_rcu(struct uk_hlist_node *n)
+{
+	struct uk_hlist_node *next = n->next;
+
+	UK_WRITE_ONCE(*(n->pprev), next);
+	if (next)
+		next->pprev = n->pprev;
+}
+
+#define uk_hlist_for_each_entry_rcu(pos, head, member)			\
+	for (pos = uk_hlist_entry_safe(uk_rcu_dereference((head)->first), \
+				       typeof(*(pos)), member);		\
+	     pos;							\
+	     pos = uk_hlist_entry_safe(uk_rcu_dereference((pos)->member.next), \
+				       typeof(*(pos)), member))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_RCU_H__ */
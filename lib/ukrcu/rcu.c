@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <errno.h>
+#include <uk/arch/lcpu.h>
+#include <uk/arch/spinlock.h>
+#include <uk/arch/time.h>
+#include <uk/assert.h>
+#include <uk/atomic.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/spinlock.h>
+#include <uk/print.h>
+#include <uk/rcu.h>
+#include <uk/sched.h>
+#include <uk/thread.h>
+#include <uk/wait.h>
+
+/* Interval at which uk_rcu_synchronize() checks the quiescent states */
+#define RCU_POLL_NSEC		ukarch_time_usec_to_nsec(10)
+
+static struct {
+	__spinlock lock;
+	struct uk_rcu_head *head;	/* callbacks waiting for a grace period */
+	struct uk_rcu_head **tail;
+	unsigned long nr_queued;	/* callbacks queued since boot */
+	unsigned long nr_done;		/* callbacks executed since boot */
+	struct uk_waitq wait;		/* reclamation thread waits for work */
+	struct uk_waitq done;		/* uk_rcu_barrier() waits for nr_done */
+} rcu = {
+	.lock = UKARCH_SPINLOCK_INITIALIZER(),
+	.head = NULL,
+	.tail = &rcu.head,
+	.nr_queued = 0,
+	.nr_done = 0,
+	.wait = __WAIT_QUEUE_INITIALIZER(rcu.wait),
+	.done = __WAIT_QUEUE_INITIALIZER(rcu.done),
+};
+
+/* Interrupts halted logical CPUs so that their idle threads report a
+ * quiescent state
+ */
+static void rcu_kick(__lcpuidx lcpuidx[] __maybe_unused,
+		     unsigned int num __maybe_unused)
+{
+#ifdef CONFIG_HAVE_SMP
+	if (num)
+		ukplat_lcpu_wakeup(lcpuidx, &num);
+#endif /* CONFIG_HAVE_SMP */
+}
+
+void uk_rcu_synchronize(void)
+{
+	unsigned long snap[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	__lcpuidx pending[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	unsigned int nr_lcpus = ukplat_lcpu_count();
+	unsigned int self, i, num;
+	int kicked = 0;
+
+	/* Order the removal of the data by the caller before the snapshot:
+	 * any critical section that started before that still runs on an
+	 * LCPU whose counter did not advance yet.
+	 */
+	mb();
+
+	/* Nobody else on our LCPU is in a critical section while we run.
+	 * Counters that are still 0 belong to LCPUs that did not run a
+	 * scheduler yet and that cannot see the removed data.
+	 */
+	self = ukplat_lcpu_idx();
+	for (i = 0; i < nr_lcpus; i++)
+		snap[i] = (i == self) ? 0 : uk_sched_qs_count(i);
+
+	for (;;) {
+		num = 0;
+		for (i = 0; i < nr_lcpus; i++) {
+			if (!snap[i])
+				continue;
+			if (uk_sched_qs_count(i) != snap[i])
+				snap[i] = 0;
+			else
+				pending[num++] = (__lcpuidx) i;
+		}
+		if (!num)
+			break;
+
+		if (!kicked) {
+			rcu_kick(pending, num);
+			kicked = 1;
+		}
+		uk_sched_thread_sleep(RCU_POLL_NSEC);
+	}
+}
+
+void uk_rcu_call(struct uk_rcu_head *head, uk_rcu_func_t func)
+{
+	unsigned long flags;
+	int was_empty;
+
+	UK_ASSERT(head);
+	UK_ASSERT(func);
+
+	head->next = NULL;
+	head->func = func;
+
+	ukplat_spin_lock_irqsave(&rcu.lock, flags);
+	was_empty = !rcu.head;
+	*rcu.tail = head;
+	rcu.tail = &head->next;
+	rcu.nr_queued++;
+	ukplat_spin_unlock_irqrestore(&rcu.lock, flags);
+
+	if (was_empty)
+		uk_waitq_wake_up(&rcu.wait);
+}
+
+void uk_rcu_barrier(void)
+{
+	unsigned long target, flags;
+
+	ukplat_spin_lock_irqsave(&rcu.lock, flags);
+	target = rcu.nr_queued;
+	ukplat_spin_unlock_irqrestore(&rcu.lock, flags);
+
+	uk_waitq_wait_event(&rcu.done,
+			    (long) (UK_READ_ONCE(rcu.nr_done) - target) >= 0);
+}
+
+static __noreturn void rcu_thread_fn(void *arg __unused)
+{
+	struct uk_rcu_head *batch, *next;
+	unsigned long nr, flags;
+
+	for (;;) {
+		uk_waitq_wait_event(&rcu.wait, UK_READ_ONCE(rcu.head) != NULL);
+
+		/* Take all queued callbacks, one grace period covers them */
+		ukplat_spin_lock_irqsave(&rcu.lock, flags);
+		batch = rcu.head;
+		rcu.head = NULL;
+		rcu.tail = &rcu.head;
+		nr = rcu.nr_queued;
+		ukplat_spin_unlock_irqrestore(&rcu.lock, flags);
+
+		uk_rcu_synchronize();
+
+		for (; batch; batch = next) {
+			next = batch->next;
+			batch->func(batch);
+		}
+
+		UK_WRITE_ONCE(rcu.nr_done, nr);
+		uk_waitq_wake_up(&rcu.done);
+	}
+}
+
+static int rcu_init(struct uk_init_ctx *ictx __unused)
+{
+	struct uk_sched *s = uk_sched_current();
+	struct uk_thread *t;
+
+	if (unlikely(!s)) {
+		uk_pr_err("Cannot start reclamation thread: no scheduler\n");
+		return -ENOTSUP;
+	}
+
+	t = uk_sched_thread_create(s, rcu_thread_fn, NULL, "rcu");
+	if (unlikely(!t))
+		return -ENOMEM;
+	return 0;
+}
+
+uk_lib_initcall(rcu_init, 0x0);
@@ -0,0 +1,208 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <string.h>
+#include <uk/arch/lcpu.h>
+#include <uk/arch/time.h>
+#include <uk/essentials.h>
+#include <uk/list.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/rcu.h>
+#include <uk/sched.h>
+#include <uk/syscall.h>
+#include <uk/test.h>
+#include <uk/thread.h>
+
+/* Time a reader stays in its read-side critical section */
+#define READER_NSEC	ukarch_time_msec_to_nsec(5)
+
+struct obj {
+	int key;
+	int freed;
+	struct uk_hlist_node link;
+	struct uk_rcu_head rcu;
+};
+
+static void obj_free(struct uk_rcu_head *head)
+{
+	struct obj *o = __containerof(head, struct obj, rcu);
+
+	o->freed = 1;
+}
+
+static struct {
+	struct obj *obj;	/* object the reader looks at */
+	int inside;		/* reader entered its critical section */
+	int left;		/* reader left it */
+	int saw_freed;		/* object was reclaimed while inside */
+	int freed_early;	/* callback ran before the reader left */
+	int done;
+} reader;
+
+UK_SYSCALL_R_PROTO(3, sched_setaffinity);
+
+/* Restricts the current thread to one LCPU. Schedulers without LCPU
+ * affinity leave the thread where it is.
+ */
+static void pin_current(unsigned int lcpu_idx)
+{
+	unsigned long mask[UK_THREAD_AFFINITY_LEN];
+	const unsigned int bits = sizeof(mask[0]) * 8;
+
+	memset(mask, 0, sizeof(mask));
+	mask[lcpu_idx / bits] = 1UL << (lcpu_idx % bits);
+	uk_syscall_r_sched_setaffinity(0, sizeof(mask), (long) mask);
+}
+
+static void unpin_current(void)
+{
+	unsigned long mask[UK_THREAD_AFFINITY_LEN];
+
+	memset(mask, 0xff, sizeof(mask));
+	uk_syscall_r_sched_setaffinity(0, sizeof(mask), (long) mask);
+}
+
+static __noreturn void reader_fn(void *arg)
+{
+	__nsec until;
+
+	pin_current((unsigned int) (__uptr) arg);
+
+	uk_rcu_read_lock();
+	UK_WRITE_ONCE(reader.inside, 1);
+	until = ukplat_monotonic_clock() + READER_NSEC;
+	while (ukplat_monotonic_clock() < until) {
+		if (UK_READ_ONCE(reader.obj->freed))
+			UK_WRITE_ONCE(reader.saw_freed, 1);
+		ukarch_spinwait();
+	}
+	UK_WRITE_ONCE(reader.left, 1);
+	uk_rcu_read_unlock();
+
+	UK_WRITE_ONCE(reader.done, 1);
+	uk_sched_thread_exit();
+}
+
+static void obj_free_checked(struct uk_rcu_head *head)
+{
+	if (!UK_READ_ONCE(reader.left))
+		UK_WRITE_ONCE(reader.freed_early, 1);
+	obj_free(head);
+}
+
+/* Starts a reader on another LCPU than ours and returns once it is in its
+ * critical section. Returns 0 if the reader could not run concurrently
+ * and has already left its section.
+ */
+static int reader_start(struct obj *o)
+{
+	unsigned int self, nr_lcpus = ukplat_lcpu_count();
+
+	memset(&reader, 0, sizeof(reader));
+	reader.obj = o;
+
+	self = ukplat_lcpu_idx();
+	pin_current(self);
+	if (!uk_sched_thread_create(uk_sched_current(), reader_fn,
+				    (__uptr) ((self + 1) % nr_lcpus),
+				    "rcu-reader"))
+		return -1;
+
+	while (!UK_READ_ONCE(reader.inside))
+		uk_sched_yield();
+	return !UK_READ_ONCE(reader.left);
+}
+
+static void reader_stop(int concurrent)
+{
+	while (!UK_READ_ONCE(reader.done))
+		uk_sched_yield();
+	unpin_current();
+
+	if (!concurrent)
+		uk_test_printf("reader did not overlap with the grace period "
+			       "(%u LCPU), ordering holds trivially\n",
+			       (unsigned int) ukplat_lcpu_count());
+}
+
+UK_TESTCASE(ukrcu, synchronize_waits_for_reader)
+{
+	static struct obj o = { .key = 1 };
+	int concurrent;
+
+	concurrent = reader_start(&o);
+	UK_TEST_ASSERT(concurrent >= 0);
+	if (concurrent < 0)
+		return;
+
+	uk_rcu_synchronize();
+	UK_TEST_EXPECT_SNUM_EQ(UK_READ_ONCE(reader.left), 1);
+
+	reader_stop(concurrent);
+}
+
+UK_TESTCASE(ukrcu, call_waits_for_reader)
+{
+	static struct obj o = { .key = 1 };
+	int concurrent;
+
+	concurrent = reader_start(&o);
+	UK_TEST_ASSERT(concurrent >= 0);
+	if (concurrent < 0)
+		return;
+
+	uk_rcu_call(&o.rcu, obj_free_checked);
+	uk_rcu_barrier();
+	UK_TEST_EXPECT_SNUM_EQ(o.freed, 1);
+	UK_TEST_EXPECT_ZERO(reader.freed_early);
+	UK_TEST_EXPECT_ZERO(reader.saw_freed);
+
+	reader_stop(concurrent);
+}
+
+UK_TESTCASE(ukrcu, call_after_grace_period)
+{
+	struct obj a = { .key = 1 }, b = { .key = 2 };
+
+	uk_rcu_call(&a.rcu, obj_free);
+	uk_rcu_call(&b.rcu, obj_free);
+	uk_rcu_barrier();
+
+	UK_TEST_EXPECT_SNUM_EQ(a.freed, 1);
+	UK_TEST_EXPECT_SNUM_EQ(b.freed, 1);
+}
+
+UK_TESTCASE(ukrcu, hlist_add_del)
+{
+	struct uk_hlist_head head = UK_HLIST_HEAD_INIT;
+	struct obj o[3] = { { .key = 0 }, { .key = 1 }, { .key = 2 } };
+	struct obj *pos;
+	int sum;
+
+	uk_hlist_add_head_rcu(&o[0].link, &head);
+	uk_hlist_add_head_rcu(&o[1].link, &head);
+	uk_hlist_add_head_rcu(&o[2].link, &head);
+
+	sum = 0;
+	uk_rcu_read_lock();
+	uk_hlist_for_each_entry_rcu(pos, &head, link)
+		sum += pos->key;
+	uk_rcu_read_unlock();
+	UK_TEST_EXPECT_SNUM_EQ(sum, 3);
+
+	/* A reader that stands on a removed node still reaches the rest */
+	uk_hlist_del_rcu(&o[1].link);
+	UK_TEST_EXPECT_PTR_EQ(o[1].link.next, &o[0].link);
+
+	sum = 0;
+	uk_rcu_read_lock();
+	uk_hlist_for_each_entry_rcu(pos, &head, link)
+		sum += pos->key;
+	uk_rcu_read_unlock();
+	UK_TEST_EXPECT_SNUM_EQ(sum, 2);
+}
+
+uk_testsuite_register(ukrcu, NULL);
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#ifndef __UKSCHED_ARCH_PREEMPT_H__
+#define __UKSCHED_ARCH_PREEMPT_H__
+
+#include <uk/arch/ctx.h>
+#include <uk/arch/lcpu.h>
+#include <uk/essentials.h>
+
+/* Bytes below the stack pointer of the interrupted code that the trampoline
+ * leaves untouched (red zone of the System V ABI)
+ */
+#define PREEMPT_REDZONE_SIZE	128
+
+#if !__ASSEMBLY__
+
+/* Trampoline entered at the return of the timer interrupt, see
+ * preempt_entry.S
+ */
+extern char uk_preempt_irq_entry[];
+extern char uk_preempt_irq_entry_end[];
+
+/* Entry of a thread that is executed for the first time */
+void uk_preempt_thread_entry(void);
+
+/*
+ * Lets the interrupt return to `uk_preempt_irq_entry` on the stack of the
+ * interrupted thread, which then continues at the interrupted instruction
+ * after `uk_preempt_schedule()` returned. All gates are interrupt gates, so
+ * an interrupt with IF set in the saved flags always interrupted thread
+ * context and never another interrupt or trap handler.
+ *
+ * Returns 0 if the interrupt is not redirected because the interrupted
+ * code is the trampoline itself.
+ */
+static inline int preempt_arch_redirect(struct __regs *regs)
+{
+	unsigned long sp;
+
+	if (unlikely(!(regs->eflags & X86_EFLAGS_IF)))
+		return 0;
+	if (regs->rip >= (unsigned long) uk_preempt_irq_entry &&
+	    regs->rip < (unsigned long) uk_preempt_irq_entry_end)
+		return 0;
+
+	sp = regs->rsp - PREEMPT_REDZONE_SIZE;
+	sp = ukarch_rstack_push(sp, regs->rip);
+	regs->rsp = sp;
+	regs->rip = (unsigned long) uk_preempt_irq_entry;
+	return 1;
+}
+
+#endif /* !__ASSEMBLY__ */
+
+#endif /* __UKSCHED_ARCH_PREEMPT_H__ */
@@ -0,0 +1,259 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#define _GNU_SOURCE /* asprintf */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <uk/arch/lcpu.h>
+#include <uk/arch/spinlock.h>
+#include <uk/arch/time.h>
+#include <uk/atomic.h>
+#include <uk/errptr.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/sched_idle.h>
+#include <uk/store.h>
+
+#define POLL_MIN_NS ((__nsec) ukarch_time_usec_to_nsec(	\
+	CONFIG_LIBUKSCHED_IDLE_POLL_MIN_USEC))
+#define POLL_MAX_NS ((__nsec) ukarch_time_usec_to_nsec(	\
+	CONFIG_LIBUKSCHED_IDLE_POLL_MAX_USEC))
+
+struct idle_lcpu {
+	int polled;		/* polled since the last halt */
+	struct uk_sched_idle_stats stats;
+} __align(CACHE_LINE_SIZE);
+
+static UKPLAT_PER_LCPU_DEFINE(struct idle_lcpu, idle_lcpu);
+
+static __nsec poll_max = POLL_MAX_NS;
+
+static struct uk_sched_idle_poller *pollers;
+static __spinlock pollers_lock = UKARCH_SPINLOCK_INITIALIZER();
+
+void uk_sched_idle_poller_register(struct uk_sched_idle_poller *p)
+{
+	UK_ASSERT(p);
+	UK_ASSERT(p->fn);
+
+	ukarch_spin_lock(&pollers_lock);
+	p->next = pollers;
+	/* Idle threads walk the list without taking the lock */
+	uk_store_n(&pollers, p);
+	ukarch_spin_unlock(&pollers_lock);
+}
+
+void uk_sched_idle_poll_set_max(__nsec max)
+{
+	UK_WRITE_ONCE(poll_max, max);
+}
+
+__nsec uk_sched_idle_poll_get_max(void)
+{
+	return UK_READ_ONCE(poll_max);
+}
+
+int uk_sched_idle_stats(unsigned int lcpu_idx,
+			struct uk_sched_idle_stats *stats)
+{
+	UK_ASSERT(stats);
+
+	if (unlikely(lcpu_idx >= ukplat_lcpu_count()))
+		return -EINVAL;
+
+	*stats = ukplat_per_lcpu(idle_lcpu, lcpu_idx).stats;
+	return 0;
+}
+
+static int run_pollers(void)
+{
+	struct uk_sched_idle_poller *p;
+	int found = 0;
+
+	for (p = uk_load_n(&pollers); p; p = p->next)
+		if (p->fn(p->arg) > 0)
+			found = 1;
+	return found;
+}
+
+int uk_sched_idle_poll(int (*has_work)(void *arg), void *arg, __nsec until)
+{
+	struct idle_lcpu *il = &ukplat_per_lcpu_current(idle_lcpu);
+	__nsec start, end, now, window;
+	int found = 0;
+
+	UK_ASSERT(has_work);
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	window = MIN(il->stats.window, UK_READ_ONCE(poll_max));
+	if (il->polled || !window)
+		return 0;
+
+	start = now = ukplat_monotonic_clock();
+	end = start + window;
+	if (until && until < end)
+		end = until;
+
+	/* Wakeups by interrupts make threads runnable while we spin */
+	ukplat_lcpu_enable_irq();
+	do {
+		found = run_pollers() || has_work(arg);
+		if (!found)
+			ukarch_spinwait();
+		now = ukplat_monotonic_clock();
+	} while (!found && now < end);
+	ukplat_lcpu_disable_irq();
+
+	il->stats.poll_time += now - start;
+	if (found || (until && now >= until)) {
+		/* A sleeping thread that became due counts as work */
+		il->stats.nr_poll_hits++;
+	} else {
+		il->stats.nr_poll_misses++;
+		il->polled = 1;
+	}
+	return 1;
+}
+
+void uk_sched_idle_halt_irq_until(__nsec until)
+{
+	struct idle_lcpu *il = &ukplat_per_lcpu_current(idle_lcpu);
+	__nsec start, halted, max, window;
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	start = ukplat_monotonic_clock();
+	if (until)
+		ukplat_lcpu_halt_irq_until(until);
+	else
+		ukplat_lcpu_halt_irq();
+	halted = ukplat_monotonic_clock() - start;
+
+	il->stats.halt_time += halted;
+	il->stats.nr_halts++;
+	il->polled = 0;
+
+	/* A halt that ended within the maximum window would have been
+	 * avoided by a longer window, so grow it. Long halts shrink the
+	 * window until polling is off.
+	 */
+	max = UK_READ_ONCE(poll_max);
+	window = il->stats.window;
+	if (!max) {
+		window = 0;
+	} else if (halted <= max) {
+		window = window ? MIN(window * 2, max) : MIN(POLL_MIN_NS, max);
+	} else {
+		window /= 2;
+		if (window < POLL_MIN_NS)
+			window = 0;
+	}
+	il->stats.window = window;
+}
+
+/*
+ * ukstore
+ */
+static int get_poll_max(void *cookie __unused, __u64 *out)
+{
+	*out = uk_sched_idle_poll_get_max();
+	return 0;
+}
+
+static int set_poll_max(void *cookie __unused, __u64 val)
+{
+	uk_sched_idle_poll_set_max(val);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_SCHED_IDLE_POLL_MAX_NS, idle_poll_max_ns, u64,
+		      get_poll_max, set_poll_max);
+
+#if CONFIG_LIBUKSTORE
+#define IDLE_STATS(cookie) \
+	(&ukplat_per_lcpu(idle_lcpu, (__uptr) (cookie)).stats)
+
+static int get_window(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->window;
+	return 0;
+}
+
+static int get_poll_ns(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->poll_time;
+	return 0;
+}
+
+static int get_halt_ns(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->halt_time;
+	return 0;
+}
+
+static int get_poll_hits(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->nr_poll_hits;
+	return 0;
+}
+
+static int get_poll_misses(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->nr_poll_misses;
+	return 0;
+}
+
+static int get_halts(void *cookie, __u64 *out)
+{
+	*out = IDLE_STATS(cookie)->nr_halts;
+	return 0;
+}
+
+static const struct uk_store_entry *idle_entries[] = {
+	UK_STORE_ENTRY(UK_SCHED_IDLE_WINDOW_NS, window_ns, u64,
+		       get_window, NULL),
+	UK_STORE_ENTRY(UK_SCHED_IDLE_POLL_NS, poll_ns, u64,
+		       get_poll_ns, NULL),
+	UK_STORE_ENTRY(UK_SCHED_IDLE_HALT_NS, halt_ns, u64,
+		       get_halt_ns, NULL),
+	UK_STORE_ENTRY(UK_SCHED_IDLE_POLL_HITS, poll_hits, u64,
+		       get_poll_hits, NULL),
+	UK_STORE_ENTRY(UK_SCHED_IDLE_POLL_MISSES, poll_misses, u64,
+		       get_poll_misses, NULL),
+	UK_STORE_ENTRY(UK_SCHED_IDLE_HALTS, halts, u64,
+		       get_halts, NULL),
+	NULL
+};
+
+/* Export one object per logical CPU, named "idle<idx>" */
+static int idle_store_init(struct uk_init_ctx *ictx __unused)
+{
+	struct uk_store_object *obj;
+	char *name;
+	__uptr i;
+	int rc;
+
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		if (unlikely(asprintf(&name, "idle%u", (unsigned int) i) < 0))
+			return -ENOMEM;
+
+		obj = uk_store_obj_alloc(uk_alloc_get_default(),
+					 UK_SCHED_IDLE_OBJ_BASE + i, name,
+					 idle_entries, (void *) i);
+		free(name);
+		if (unlikely(PTRISERR(obj)))
+			return PTR2ERR(obj);
+
+		rc = uk_store_obj_add(obj);
+		if (unlikely(rc))
+			return rc;
+	}
+	return 0;
+}
+
+uk_late_initcall(idle_store_init, 0x0);
+#endif /* CONFIG_LIBUKSTORE */
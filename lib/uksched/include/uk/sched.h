@@ -42,6 +42,7 @@
 #include <uk/thread.h>
 #include <uk/assert.h>
 #include <uk/arch/types.h>
+#include <uk/arch/spinlock.h>
 #include <uk/essentials.h>
 #include <errno.h>
 
@@ -51,6 +52,47 @@ extern "C" {
 
 struct uk_sched;
 
+/* Scheduling policies; the values are compatible with Linux */
+#define UK_SCHED_OTHER		0
+#define UK_SCHED_FIFO		1
+#define UK_SCHED_RR		2
+#define UK_SCHED_BATCH		3
+#define UK_SCHED_IDLE		5
+#define UK_SCHED_DEADLINE	6
+
+/* Flag that can be combined with a policy; ignored */
+#define UK_SCHED_RESET_ON_FORK	0x40000000
+
+/* Range of static priorities for UK_SCHED_FIFO and UK_SCHED_RR */
+#define UK_SCHED_PRIO_MIN	1
+#define UK_SCHED_PRIO_MAX	99
+
+/* Minimum runtime and deadline for UK_SCHED_DEADLINE */
+#define UK_SCHED_DEADLINE_MIN	1024
+
+/*
+ * Scheduling policy and parameters of a thread. The layout is equal to
+ * `struct sched_attr` of Linux (version 0), which is used by the
+ * sched_setattr()/sched_getattr() system calls.
+ */
+struct uk_sched_attr {
+	__u32 size;
+	__u32 sched_policy;
+	__u64 sched_flags;
+	__s32 sched_nice;
+	__u32 sched_priority;
+	__u64 sched_runtime;	/* ns */
+	__u64 sched_deadline;	/* ns */
+	__u64 sched_period;	/* ns */
+};
+
+#define UK_SCHED_ATTR_SIZE_VER0	48
+
+/* Equal to `struct sched_param` of Linux */
+struct uk_sched_param {
+	int sched_priority;
+};
+
 static inline struct uk_sched *uk_sched_current(void)
 {
 	struct uk_thread *th = uk_thread_current();
@@ -75,8 +117,25 @@ typedef void  (*uk_sched_thread_woken_func_t)
 typedef const struct uk_thread * (*uk_sched_idle_thread_func_t)
 		(struct uk_sched *s, unsigned int proc_id);
 
+typedef int   (*uk_sched_thread_set_policy_func_t)
+		(struct uk_sched *s, struct uk_thread *t,
+		 const struct uk_sched_attr *attr);
+
+typedef void  (*uk_sched_thread_set_affinity_func_t)
+		(struct uk_sched *s, struct uk_thread *t);
+
 typedef int   (*uk_sched_start_t)(struct uk_sched *s, struct uk_thread *main);
 
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+struct uk_sched_thread_cache_stats {
+	unsigned int len;	/**< Number of cached threads */
+	__u64 hits;		/**< Threads created from the cache */
+	__u64 misses;		/**< Threads created with allocations */
+	__u64 puts;		/**< Exited threads put into the cache */
+	__u64 drops;		/**< Exited threads that were released */
+};
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
 struct uk_sched {
 	uk_sched_yield_func_t yield;
 
@@ -86,17 +145,26 @@ struct uk_sched {
 	uk_sched_thread_woken_func_t    thread_woken;
 	uk_sched_thread_woken_func_t    thread_woken_isr;
 	uk_sched_idle_thread_func_t     idle_thread;
+	/* optional, only normal policies are supported if not set */
+	uk_sched_thread_set_policy_func_t thread_set_policy;
+	/* optional, called after the affinity mask of a thread has changed */
+	uk_sched_thread_set_affinity_func_t thread_set_affinity;
 
 	uk_sched_start_t sched_start;
 
 	/* internal */
 	bool is_started;
+	__spinlock lock;	/**< protects thread_list and exited_threads */
 	struct uk_thread_list thread_list;
 	struct uk_thread_list exited_threads;
 	struct uk_alloc *a;       /**< default allocator for struct uk_thread */
 	struct uk_alloc *a_stack; /**< default allocator for stacks */
 	struct uk_alloc *a_auxstack; /**< default allocator for aux stacks */
 	struct uk_alloc *a_uktls; /**< default allocator for TLS+ectx */
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	struct uk_thread_list thread_cache; /**< exited threads for reuse */
+	struct uk_sched_thread_cache_stats thread_cache_stats;
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
 	struct uk_sched *next;
 };
 
@@ -142,6 +210,30 @@ static inline void uk_sched_thread_woken(struct uk_thread *t)
 	s->thread_woken(s, t);
 }
 
+/**
+ * Sets the scheduling policy and its parameters for a thread. The normal
+ * policies (UK_SCHED_OTHER, UK_SCHED_BATCH, UK_SCHED_IDLE) are supported
+ * by every scheduler; the others depend on the scheduler of the thread.
+ *
+ * @param t
+ *   Reference to the thread
+ * @param attr
+ *   Policy and parameters. `size`, `sched_flags`, and `sched_nice` are
+ *   ignored.
+ * @return
+ *   - (0): Success
+ *   - (-EINVAL): Invalid policy or parameters
+ *   - (-EPERM): The policy is not supported by the scheduler of `t`
+ */
+int uk_sched_thread_set_policy(struct uk_thread *t,
+			       const struct uk_sched_attr *attr);
+
+/**
+ * Returns the scheduling policy and its parameters of a thread
+ */
+void uk_sched_thread_get_policy(struct uk_thread *t,
+				struct uk_sched_attr *attr);
+
 /**
  * Returns the reference to the idle thread that is responsible for
  * the processing unit `proc_id`. Please note that `proc_id` is not
@@ -266,6 +358,67 @@ void uk_sched_thread_exit2(uk_thread_gc_t gc_fn, void *gc_argp) __noreturn;
 /* Terminates another thread */
 void uk_sched_thread_terminate(struct uk_thread *thread);
 
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+/**
+ * Returns the statistics of the cache of exited threads of a scheduler.
+ * `uk_sched_thread_create_fn*()` reuse the struct, stacks and TLS of cached
+ * threads instead of allocating new ones.
+ *
+ * @param s
+ *   Reference to the scheduler
+ * @param[out] stats
+ *   Snapshot of the statistics
+ */
+void uk_sched_thread_cache_stats(struct uk_sched *s,
+				 struct uk_sched_thread_cache_stats *stats);
+
+/**
+ * Releases all threads of the cache of a scheduler, for instance to return
+ * memory to the allocators
+ *
+ * @return
+ *   Number of released threads
+ */
+unsigned int uk_sched_thread_cache_drain(struct uk_sched *s);
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+#if CONFIG_LIBUKSCHED_QS
+/* Quiescent state counters, indexed by logical CPU (internal!) */
+extern UKPLAT_PER_LCPU_DEFINE(unsigned long, _uk_sched_qs);
+
+/**
+ * Returns the number of quiescent states that a logical CPU passed. A
+ * logical CPU is in a quiescent state whenever it switches threads and
+ * whenever its idle thread looks for work. Code that does not block or
+ * yield, and that runs with preemption disabled, therefore does not span
+ * a quiescent state. Deferred reclamation (e.g., ukrcu) waits for the
+ * counters of all logical CPUs to advance.
+ *
+ * The counter of a logical CPU that never ran a scheduler stays at 0.
+ *
+ * @param lcpu_idx
+ *   Index of the logical CPU
+ */
+static inline unsigned long uk_sched_qs_count(unsigned int lcpu_idx)
+{
+	UK_ASSERT(lcpu_idx < CONFIG_UKPLAT_LCPU_MAXCOUNT);
+
+	return uk_load_n(&ukplat_per_lcpu(_uk_sched_qs, lcpu_idx));
+}
+
+/**
+ * Reports a quiescent state of the current logical CPU. Called by
+ * scheduler implementations; orders all memory accesses before the
+ * report against the ones after it.
+ */
+static inline void uk_sched_qs_report(void)
+{
+	uk_inc(&ukplat_per_lcpu_current(_uk_sched_qs));
+}
+#else /* !CONFIG_LIBUKSCHED_QS */
+#define uk_sched_qs_report() do {} while (0)
+#endif /* !CONFIG_LIBUKSCHED_QS */
+
 #ifdef __cplusplus
 }
 #endif
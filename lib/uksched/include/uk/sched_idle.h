@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Adaptive busy-polling in idle threads: before a logical CPU halts, its
+ * idle thread spins for a bounded window and calls the registered pollers
+ * (e.g., the receive queues of a network device). Work that shows up
+ * within the window is then picked up without the wakeup latency of an
+ * interrupt and a halt. The window of each logical CPU grows while halts
+ * are short and shrinks while they are long, so that an idle system
+ * does not burn cycles.
+ */
+
+#ifndef __UK_SCHED_IDLE_H__
+#define __UK_SCHED_IDLE_H__
+
+#include <uk/config.h>
+
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+#include <uk/arch/types.h>
+#include <uk/arch/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function that is called repeatedly by polling idle threads, with
+ * interrupts enabled. It must not block.
+ *
+ * @return
+ *   > 0 if it made a thread runnable or found other work, 0 otherwise
+ */
+typedef int (*uk_sched_idle_poll_func_t)(void *arg);
+
+struct uk_sched_idle_poller {
+	uk_sched_idle_poll_func_t fn;
+	void *arg;
+	struct uk_sched_idle_poller *next;
+};
+
+#define UK_SCHED_IDLE_POLLER_INITIALIZER(func, argp)	\
+	{ .fn = (func), .arg = (argp), .next = NULL }
+
+/**
+ * Registers a poller with the idle threads of all logical CPUs. Pollers
+ * cannot be unregistered.
+ *
+ * @param p
+ *   Poller, must stay valid
+ */
+void uk_sched_idle_poller_register(struct uk_sched_idle_poller *p);
+
+/**
+ * Sets the upper bound of the polling window. A value of 0 disables
+ * polling, the window of every logical CPU then adapts from zero again
+ * when it is enabled.
+ */
+void uk_sched_idle_poll_set_max(__nsec max);
+
+/* Returns the upper bound of the polling window */
+__nsec uk_sched_idle_poll_get_max(void);
+
+/* Statistics of the idle thread of a logical CPU */
+struct uk_sched_idle_stats {
+	__nsec window;		/* current polling window */
+	__nsec poll_time;	/* time spent polling */
+	__nsec halt_time;	/* time spent halted */
+	__u64 nr_poll_hits;	/* polling found work */
+	__u64 nr_poll_misses;	/* window expired without work */
+	__u64 nr_halts;
+};
+
+/**
+ * Copies the idle statistics of a logical CPU.
+ *
+ * @return
+ *   0 on success, -EINVAL if `lcpu_idx` is out of range
+ */
+int uk_sched_idle_stats(unsigned int lcpu_idx,
+			struct uk_sched_idle_stats *stats);
+
+/*
+ * Interface for scheduler implementations
+ */
+
+/**
+ * Called by the idle thread with interrupts disabled instead of halting.
+ * Busy-polls with interrupts enabled until `has_work(arg)` is true, a
+ * poller found work, the monotonic clock reaches `until` (if not 0), or
+ * the polling window expires. Polls at most once between two halts.
+ *
+ * @return
+ *   0 if the idle thread should halt now (interrupts stay disabled),
+ *   1 if it polled; interrupts are disabled again and the idle thread
+ *   should re-check for work before calling this function again
+ */
+int uk_sched_idle_poll(int (*has_work)(void *arg), void *arg, __nsec until);
+
+/**
+ * Halts the current logical CPU with interrupts disabled like
+ * `ukplat_lcpu_halt_irq_until()` (until the next interrupt if `until`
+ * is 0). Accounts the halted time and adapts the polling window.
+ */
+void uk_sched_idle_halt_irq_until(__nsec until);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
+/* ukstore entries, exported per logical CPU as object "idle<idx>" */
+#define UK_SCHED_IDLE_OBJ_BASE			0x100
+#define UK_SCHED_IDLE_WINDOW_NS			0x01
+#define UK_SCHED_IDLE_POLL_NS			0x02
+#define UK_SCHED_IDLE_HALT_NS			0x03
+#define UK_SCHED_IDLE_POLL_HITS			0x04
+#define UK_SCHED_IDLE_POLL_MISSES		0x05
+#define UK_SCHED_IDLE_HALTS			0x06
+
+/* Static ukstore entries of the library */
+#define UK_SCHED_IDLE_POLL_MAX_NS		0x11
+
+#endif /* __UK_SCHED_IDLE_H__ */
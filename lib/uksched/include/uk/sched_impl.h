@@ -43,6 +43,8 @@
 #define __UK_SCHED_IMPL_H__
 
 #include <uk/sched.h>
+#include <uk/sched_idle.h>
+#include <uk/preempt.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,16 +68,47 @@ int uk_sched_register(struct uk_sched *s);
 		(s)->thread_woken     = thread_woken_func; \
 		(s)->thread_woken_isr = thread_woken_isr_func; \
 		(s)->idle_thread      = idle_thread_func; \
+		(s)->thread_set_policy = NULL; \
+		(s)->thread_set_affinity = NULL; \
 		uk_sched_register((s)); \
 		\
 		(s)->a = (sched_a); \
 		(s)->a_stack = (sched_a_stack); \
 		(s)->a_auxstack = (sched_a_auxstack); \
 		(s)->a_uktls = (sched_a_uktls); \
+		ukarch_spin_init(&(s)->lock); \
 		UK_TAILQ_INIT(&(s)->thread_list); \
 		UK_TAILQ_INIT(&(s)->exited_threads); \
+		_uk_sched_thread_cache_init((s)); \
 	} while (0)
 
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+#define _uk_sched_thread_cache_init(s) \
+	do { \
+		UK_TAILQ_INIT(&(s)->thread_cache); \
+		(s)->thread_cache_stats = \
+			(struct uk_sched_thread_cache_stats) { 0 }; \
+	} while (0)
+#else /* !CONFIG_LIBUKSCHED_THREAD_CACHE */
+#define _uk_sched_thread_cache_init(s) do {} while (0)
+#endif /* !CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+/**
+ * Stores a validated scheduling policy with its parameters in a thread.
+ * Schedulers that implement `thread_set_policy` call this while the thread
+ * is not on any of their queues.
+ */
+static inline void uk_sched_thread_policy_store(struct uk_thread *t,
+						const struct uk_sched_attr *attr)
+{
+	t->sched_param.policy   = (int) attr->sched_policy;
+	t->sched_param.prio     = attr->sched_priority;
+	t->sched_param.runtime  = attr->sched_runtime;
+	t->sched_param.deadline = attr->sched_deadline;
+	t->sched_param.period   = attr->sched_period ? attr->sched_period
+						     : attr->sched_deadline;
+}
+
 /**
  * Releases self-exited threads (garbage collection)
  *
@@ -85,6 +118,70 @@ int uk_sched_register(struct uk_sched *s);
  */
 unsigned int uk_sched_thread_gc(struct uk_sched *sched);
 
+/**
+ * Releases self-exited threads for which `filter` returns a non-zero value.
+ * Schedulers that serve multiple logical CPUs use the filter to release only
+ * threads that are known to be switched out completely.
+ *
+ * @return
+ *   - (0): No work was done
+ *   - (>0): Number of threads that were cleaned up
+ */
+unsigned int uk_sched_thread_gc_filter(struct uk_sched *sched,
+				       int (*filter)(struct uk_thread *t,
+						     void *argp),
+				       void *argp);
+
+/*
+ * Sleep queue for scheduler implementations. Sleeping threads are kept in a
+ * rank-balanced tree that is sorted by wakeup time. Inserting and removing a
+ * thread costs O(log n); the thread that expires first is cached so that it
+ * is found in O(1). The queue is not synchronized.
+ */
+UK_RB_HEAD(uk_sched_sleepq_tree, uk_thread);
+
+struct uk_sched_sleepq {
+	struct uk_sched_sleepq_tree tree;
+	struct uk_thread *first;
+};
+
+static inline void uk_sched_sleepq_init(struct uk_sched_sleepq *q)
+{
+	UK_ASSERT(q);
+
+	UK_RB_INIT(&q->tree);
+	q->first = NULL;
+}
+
+/* Inserts a thread using its current `wakeup_time` */
+void uk_sched_sleepq_insert(struct uk_sched_sleepq *q, struct uk_thread *t);
+
+/* Removes a thread. Nothing is done if the thread is not queued. */
+void uk_sched_sleepq_remove(struct uk_sched_sleepq *q, struct uk_thread *t);
+
+/* Returns the thread that expires first or NULL if the queue is empty */
+static inline struct uk_thread *uk_sched_sleepq_first(struct uk_sched_sleepq *q)
+{
+	return q->first;
+}
+
+/* Tests if a thread is on a sleep queue */
+static inline int uk_sched_sleepq_queued(struct uk_thread *t)
+{
+	return t->_sleep.until != 0;
+}
+
+#if CONFIG_LIBUKSCHED_PREEMPT
+/* Starts the time slice of `next` (see preempt.c) */
+void uk_sched_preempt_switch(struct uk_thread *prev, struct uk_thread *next);
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
+
+/**
+ * Switches the current logical CPU to `next`. Schedulers disable
+ * preemption with `uk_preempt_disable()` before they call this function,
+ * so that the scheduling decision cannot be interrupted by a preemption.
+ * Preemption is enabled again when the thread resumes.
+ */
 static inline
 void uk_sched_thread_switch(struct uk_thread *next)
 {
@@ -93,6 +190,9 @@ void uk_sched_thread_switch(struct uk_thread *next)
 	prev = ukplat_per_lcpu_current(__uk_sched_thread_current);
 
 	UK_ASSERT(prev);
+#if CONFIG_LIBUKSCHED_PREEMPT
+	UK_ASSERT(uk_preempt_count() == 1);
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
 
 	ukplat_per_lcpu_current(__uk_sched_thread_current) = next;
 
@@ -110,7 +210,19 @@ void uk_sched_thread_switch(struct uk_thread *next)
 
 	ukplat_lcpu_set_auxsp(next->auxsp);
 
+#if CONFIG_LIBUKSCHED_PREEMPT
+	uk_sched_preempt_switch(prev, next);
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
+	uk_sched_stats_switch(prev, next);
+
+	/* `prev` stops running here, so it holds no RCU read-side
+	 * references anymore
+	 */
+	uk_sched_qs_report();
+
 	ukarch_ctx_switch(&prev->ctx, &next->ctx);
+
+	uk_preempt_enable_no_resched();
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/*
+ * Scheduler statistics: run queue wait time and wakeup-to-run latency of
+ * every switched-in thread, context switches and idle time. Samples are
+ * taken in `uk_sched_thread_switch()` and when a thread becomes runnable,
+ * so they are available with every scheduler.
+ */
+
+#ifndef __UK_SCHED_STATS_H__
+#define __UK_SCHED_STATS_H__
+
+#include <uk/config.h>
+
+#if CONFIG_LIBUKSCHED_STATS
+#include <uk/arch/types.h>
+#include <uk/arch/time.h>
+#include <uk/essentials.h>
+#include <uk/plat/lcpu.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uk_sched;
+struct uk_thread;
+
+/*
+ * Histogram of durations with power-of-two buckets. Bucket 0 counts
+ * durations below 2^UK_SCHED_HIST_SHIFT ns, bucket i > 0 those in
+ * [2^(i + UK_SCHED_HIST_SHIFT - 1), 2^(i + UK_SCHED_HIST_SHIFT)) ns. The
+ * last bucket is open-ended (about one second and more).
+ */
+#define UK_SCHED_HIST_SHIFT	8
+#define UK_SCHED_HIST_BUCKETS	24
+
+struct uk_sched_hist {
+	__u32 buckets[UK_SCHED_HIST_BUCKETS];
+	__u64 count;
+	__nsec sum;
+	__nsec max;
+};
+
+/* Statistics of a thread (part of struct uk_thread) */
+struct uk_sched_thread_stats {
+	__nsec ready_since;	/* became runnable, 0 if unknown */
+	__nsec run_since;	/* was switched in */
+	int woken;		/* became runnable by a wakeup */
+	__u64 nr_switches;	/* times switched in */
+	struct uk_sched_hist wait;	/* runnable until switched in */
+	struct uk_sched_hist wakeup;	/* woken until switched in */
+};
+
+/* Statistics of a logical CPU */
+struct uk_sched_lcpu_stats {
+	__u64 nr_switches;
+	__nsec idle_time;	/* time in the idle thread */
+	struct uk_sched_hist wait;
+	struct uk_sched_hist wakeup;
+} __align(CACHE_LINE_SIZE);
+
+extern UKPLAT_PER_LCPU_DEFINE(struct uk_sched_lcpu_stats,
+			      _uk_sched_lcpu_stats);
+
+/* Runtime switch, see `uk_sched_stats_enable()` */
+extern int _uk_sched_stats_on;
+/* Samples that started before this time are dropped */
+extern __nsec _uk_sched_stats_epoch;
+
+void _uk_sched_stats_ready(struct uk_thread *t, int woken);
+void _uk_sched_stats_switch(struct uk_thread *prev, struct uk_thread *next);
+
+/* Called when `t` becomes runnable, with interrupts disabled */
+static inline void uk_sched_stats_ready(struct uk_thread *t, int woken)
+{
+	if (_uk_sched_stats_on)
+		_uk_sched_stats_ready(t, woken);
+}
+
+/* Called by `uk_sched_thread_switch()` with interrupts disabled */
+static inline void uk_sched_stats_switch(struct uk_thread *prev,
+					 struct uk_thread *next)
+{
+	if (_uk_sched_stats_on)
+		_uk_sched_stats_switch(prev, next);
+}
+
+/**
+ * Enables or disables the collection of statistics at run time. The
+ * statistics are kept; samples that started while the collection was
+ * disabled are dropped.
+ */
+void uk_sched_stats_enable(int enable);
+
+/**
+ * Returns the upper bound of the bucket that contains the p-th percentile
+ * (0 < p <= 100) of the histogram, or the maximum for the last bucket.
+ * Returns 0 for an empty histogram.
+ */
+__nsec uk_sched_hist_percentile(const struct uk_sched_hist *h,
+				unsigned int p);
+
+/**
+ * Copies the statistics of a logical CPU.
+ *
+ * @return
+ *   0 on success, -EINVAL if `lcpu_idx` is out of range
+ */
+int uk_sched_lcpu_stats(unsigned int lcpu_idx,
+			struct uk_sched_lcpu_stats *stats);
+
+/**
+ * Prints the statistics of all logical CPUs and of the threads of `s`,
+ * like `uk_sched_dumpk_threads()`.
+ */
+void uk_sched_dumpk_stats(int klvl, struct uk_sched *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#else /* !CONFIG_LIBUKSCHED_STATS */
+
+#define uk_sched_stats_ready(t, woken) do {} while (0)
+#define uk_sched_stats_switch(prev, next) do {} while (0)
+
+#endif /* !CONFIG_LIBUKSCHED_STATS */
+
+/* ukstore entries, exported per logical CPU as object "lcpu<idx>" */
+#define UK_SCHED_STATS_NUM_SWITCHES		0x01
+#define UK_SCHED_STATS_IDLE_NS			0x02
+#define UK_SCHED_STATS_WAIT_COUNT		0x03
+#define UK_SCHED_STATS_WAIT_P50_NS		0x04
+#define UK_SCHED_STATS_WAIT_P99_NS		0x05
+#define UK_SCHED_STATS_WAIT_MAX_NS		0x06
+#define UK_SCHED_STATS_WAKEUP_COUNT		0x07
+#define UK_SCHED_STATS_WAKEUP_P50_NS		0x08
+#define UK_SCHED_STATS_WAKEUP_P99_NS		0x09
+#define UK_SCHED_STATS_WAKEUP_MAX_NS		0x0a
+
+/* Static ukstore entries of the library */
+#define UK_SCHED_STATS_ENABLED			0x10
+
+#endif /* __UK_SCHED_STATS_H__ */
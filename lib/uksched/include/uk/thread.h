@@ -38,8 +38,11 @@
 #include <uk/plat/tls.h>
 #include <uk/wait_types.h>
 #include <uk/list.h>
+#include <uk/tree.h>
+#include <uk/atomic.h>
 #include <uk/prio.h>
 #include <uk/essentials.h>
+#include <uk/sched_stats.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +50,10 @@ extern "C" {
 
 struct uk_sched;
 
+/* Number of words of the LCPU affinity mask of a thread */
+#define UK_THREAD_AFFINITY_LEN						\
+	DIV_ROUND_UP(CONFIG_UKPLAT_LCPU_MAXCOUNT, sizeof(unsigned long) * 8)
+
 typedef void (*uk_thread_dtor_t)(struct uk_thread *);
 typedef void (*uk_thread_gc_t)(struct uk_thread *, void *);
 
@@ -66,6 +73,27 @@ struct uk_thread {
 	__snsec wakeup_time;
 	struct uk_sched *sched;
 
+	struct {
+		UK_RB_ENTRY(uk_thread) entry;
+		__snsec until;		/**< Deadline the thread is sorted by */
+	} _sleep;			/**< Sleep queue node (internal!) */
+
+	/** LCPUs (by index) on which the thread may run */
+	unsigned long affinity[UK_THREAD_AFFINITY_LEN];
+	struct {
+		unsigned int lcpu;	/**< LCPU the thread is assigned to */
+		bool queued;		/**< Thread is on a run queue */
+		__snsec deadline;	/**< Absolute deadline (DEADLINE) */
+	} _rq;				/**< Run queue state (internal!) */
+
+	struct {
+		int policy;		/**< Scheduling policy (UK_SCHED_*) */
+		unsigned int prio;	/**< Static priority (FIFO, RR) */
+		__nsec runtime;		/**< Runtime per period (DEADLINE) */
+		__nsec deadline;	/**< Relative deadline (DEADLINE) */
+		__nsec period;		/**< Period (DEADLINE) */
+	} sched_param;			/**< Scheduling policy and parameters */
+
 	struct {
 		struct uk_alloc *t_a;
 		void            *stack;
@@ -74,6 +102,8 @@ struct uk_thread {
 		struct uk_alloc *uktls_a;
 		void            *auxstack;
 		struct uk_alloc *auxstack_a;
+		size_t           stack_len;
+		size_t           auxstack_len;
 	} _mem;				/**< Associated allocs (internal!) */
 	uk_thread_gc_t _gc_fn;		/**< Extra gc function (internal!) */
 	void *_gc_argp;			/**< Argument for gc fn (internal!) */
@@ -82,6 +112,12 @@ struct uk_thread {
 	void *priv;			/**< Private field, free for use */
 
 	__nsec exec_time;		/**< Time the thread was scheduled */
+#if CONFIG_LIBUKSCHED_PREEMPT
+	__u64 nr_preempted;		/**< Number of times preempted */
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
+#if CONFIG_LIBUKSCHED_STATS
+	struct uk_sched_thread_stats _stats; /**< Statistics (internal!) */
+#endif /* CONFIG_LIBUKSCHED_STATS */
 	const char *name;		/**< Reference to thread name */
 	UK_TAILQ_ENTRY(struct uk_thread) thread_list;
 };
@@ -102,6 +138,25 @@ struct uk_thread *uk_thread_current(void)
 	return ukplat_per_lcpu_current(__uk_sched_thread_current);
 }
 
+/**
+ * Checks if a thread is executing on its logical CPU right now. The result
+ * is a hint for waiters that spin on a resource held by the thread: the
+ * thread can be switched out or migrated right after the check.
+ *
+ * @param t
+ *   Reference to the thread
+ */
+static inline
+bool uk_thread_is_running(const struct uk_thread *t)
+{
+	unsigned int lcpu_idx = UK_READ_ONCE(t->_rq.lcpu);
+
+	if (unlikely(lcpu_idx >= CONFIG_UKPLAT_LCPU_MAXCOUNT))
+		return false;
+	return UK_READ_ONCE(ukplat_per_lcpu(__uk_sched_thread_current,
+					    lcpu_idx)) == t;
+}
+
 /*
  * STATES OF THREADS
  * =================
@@ -155,6 +210,8 @@ struct uk_thread *uk_thread_current(void)
  *  present in the run queue.
  */
 #define UK_THREADF_QUEUEABLE  (0x020)
+/* The thread was executed at least once (set with preemption only) */
+#define UK_THREADF_STARTED    (0x040)
 
 #define uk_thread_is_exited(t)   ((t)->flags & UK_THREADF_EXITED)
 #define uk_thread_is_runnable(t) (!uk_thread_is_exited(t) \
@@ -164,14 +221,43 @@ struct uk_thread *uk_thread_current(void)
 				  0x0)
 #define uk_thread_is_queueable(t) ((t)->flags & UK_THREADF_QUEUEABLE)
 
+#ifdef CONFIG_HAVE_SMP
+/* State flags can be changed concurrently from multiple LCPUs */
+#define _uk_thread_flags_set(t, f)	uk_or(&(t)->flags, (f))
+#define _uk_thread_flags_clear(t, f)	uk_and(&(t)->flags, ~(f))
+#else /* !CONFIG_HAVE_SMP */
+#define _uk_thread_flags_set(t, f)	((t)->flags |= (f))
+#define _uk_thread_flags_clear(t, f)	((t)->flags &= ~(f))
+#endif /* !CONFIG_HAVE_SMP */
+
 #define uk_thread_set_runnable(t) \
-	do { (t)->flags |= UK_THREADF_RUNNABLE; } while (0)
+	do { _uk_thread_flags_set(t, UK_THREADF_RUNNABLE); } while (0)
 #define uk_thread_set_blocked(t) \
-	do { (t)->flags &= ~UK_THREADF_RUNNABLE; } while (0)
+	do { _uk_thread_flags_clear(t, UK_THREADF_RUNNABLE); } while (0)
 #define uk_thread_set_queueable(t) \
-	do { (t)->flags |= UK_THREADF_QUEUEABLE; } while (0)
+	do { _uk_thread_flags_set(t, UK_THREADF_QUEUEABLE); } while (0)
 #define uk_thread_clear_queueable(t) \
-	do { (t)->flags &= ~UK_THREADF_QUEUEABLE; } while (0)
+	do { _uk_thread_flags_clear(t, UK_THREADF_QUEUEABLE); } while (0)
+
+/**
+ * Tests if a thread may run on a logical CPU
+ *
+ * @param t
+ *   Reference to the thread
+ * @param lcpu_idx
+ *   Index of the logical CPU
+ */
+static inline bool uk_thread_lcpu_allowed(const struct uk_thread *t,
+					  unsigned int lcpu_idx)
+{
+	const unsigned int bits = sizeof(t->affinity[0]) * 8;
+
+	if (unlikely(lcpu_idx >= CONFIG_UKPLAT_LCPU_MAXCOUNT))
+		return false;
+	return !!(UK_READ_ONCE(t->affinity[lcpu_idx / bits])
+		  & (1UL << (lcpu_idx % bits)));
+}
+
 /* NOTE: Setting a thread as EXITED cannot be undone. */
 /* NOTE: Never change the EXIT flag manually. Trnasition to exit state reqiures
  * the terminate funcrtiomns to be called.
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <uk/event.h>
+#include <uk/intctlr.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/preempt.h>
+#include <arch/preempt.h>
+
+/* Runs before the platform timer handler, which keeps running as well */
+static int preempt_tick(void *arg)
+{
+	struct uk_intctlr_event_irq_data *data = arg;
+	struct uk_preempt_lcpu *p;
+	__nsec now;
+
+	if (data->irq != ukplat_time_get_irq())
+		return UK_EVENT_NOT_HANDLED;
+
+	p = &ukplat_per_lcpu_current(uk_preempt_lcpu);
+	if (!p->slice_end)
+		return UK_EVENT_NOT_HANDLED;
+
+	now = ukplat_monotonic_clock();
+	if (now < p->slice_end) {
+		/* Early interrupt, e.g., the slice exceeds the timer range */
+		ukplat_time_set_alarm(p->slice_end);
+		return UK_EVENT_HANDLED_CONT;
+	}
+
+	p->need_resched = 1;
+	if (p->count || !preempt_arch_redirect(data->regs)) {
+		/* Preemption is deferred to `uk_preempt_enable()`, which does
+		 * not reschedule if interrupts are disabled at that time. In
+		 * that case, the next tick tries again.
+		 */
+		ukplat_time_set_alarm(now + UKPLAT_TIME_TICK_NSEC);
+	}
+	return UK_EVENT_HANDLED_CONT;
+}
+
+UK_EVENT_HANDLER(UK_INTCTLR_EVENT_IRQ, preempt_tick);
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/sched.h>
+#include <uk/sched_stats.h>
+#include <uk/thread.h>
+
+UKPLAT_PER_LCPU_DEFINE(struct uk_sched_lcpu_stats, _uk_sched_lcpu_stats);
+
+int _uk_sched_stats_on = 1;
+__nsec _uk_sched_stats_epoch;
+
+static inline unsigned int hist_bucket(__nsec d)
+{
+	unsigned int b;
+
+	if (d < (1UL << UK_SCHED_HIST_SHIFT))
+		return 0;
+	/* Number of significant bits minus the shift */
+	b = (unsigned int) (sizeof(unsigned long) * 8
+			    - __builtin_clzl((unsigned long) d))
+	    - UK_SCHED_HIST_SHIFT;
+	return MIN(b, UK_SCHED_HIST_BUCKETS - 1U);
+}
+
+static inline void hist_record(struct uk_sched_hist *h, __nsec d)
+{
+	h->buckets[hist_bucket(d)]++;
+	h->count++;
+	h->sum += d;
+	if (d > h->max)
+		h->max = d;
+}
+
+/* Idle threads do not wait for a logical CPU, they are not sampled */
+static inline int is_idle(struct uk_thread *t)
+{
+	return t->sched &&
+	       t == uk_sched_idle_thread(t->sched, ukplat_lcpu_idx());
+}
+
+void _uk_sched_stats_ready(struct uk_thread *t, int woken)
+{
+	t->_stats.ready_since = ukplat_monotonic_clock();
+	t->_stats.woken = woken;
+}
+
+void _uk_sched_stats_switch(struct uk_thread *prev, struct uk_thread *next)
+{
+	struct uk_sched_lcpu_stats *ls;
+	__nsec now, d;
+
+	ls = &ukplat_per_lcpu_current(_uk_sched_lcpu_stats);
+	now = ukplat_monotonic_clock();
+	ls->nr_switches++;
+
+	if (is_idle(prev)) {
+		if (prev->_stats.run_since >= _uk_sched_stats_epoch)
+			ls->idle_time += now - prev->_stats.run_since;
+	} else if (uk_thread_is_runnable(prev)) {
+		/* Yielded or preempted, waits on the run queue again */
+		prev->_stats.ready_since = now;
+		prev->_stats.woken = 0;
+	}
+
+	next->_stats.run_since = now;
+	next->_stats.nr_switches++;
+	if (is_idle(next) || !next->_stats.ready_since)
+		return;
+	/* The clocks of different logical CPUs may be slightly apart */
+	if (next->_stats.ready_since >= _uk_sched_stats_epoch &&
+	    next->_stats.ready_since <= now) {
+		d = now - next->_stats.ready_since;
+		hist_record(&next->_stats.wait, d);
+		hist_record(&ls->wait, d);
+		if (next->_stats.woken) {
+			hist_record(&next->_stats.wakeup, d);
+			hist_record(&ls->wakeup, d);
+		}
+	}
+	next->_stats.ready_since = 0;
+}
@@ -13,6 +13,7 @@ void uk_thread_wake_isr(struct uk_thread *thread)
 	flags = ukplat_lcpu_save_irqf();
 	if (!uk_thread_is_runnable(thread)) {
 		uk_thread_set_runnable(thread);
+		uk_sched_stats_ready(thread, 1);
 		if (thread->sched)
 			uk_sched_thread_woken_isr(thread);
 	}
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * Preemptive time slicing. The timer interrupt handler (isrpreempt.c)
+ * checks the time slice of the interrupted thread. If the slice expired and
+ * preemption is enabled, the interrupt returns to a trampoline
+ * (`uk_preempt_irq_entry`) that saves the interrupted register state and
+ * calls `uk_preempt_schedule()` like a regular function call. Otherwise, the
+ * reschedule is deferred to `uk_preempt_enable()`.
+ */
+#include <uk/arch/ctx.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/preempt.h>
+#include <uk/sched_impl.h>
+#include <uk/thread.h>
+#include <arch/preempt.h>
+
+#define PREEMPT_SLICE_NSEC \
+	ukarch_time_usec_to_nsec(CONFIG_LIBUKSCHED_PREEMPT_SLICE_USEC)
+
+UKPLAT_PER_LCPU_DEFINE(struct uk_preempt_lcpu, uk_preempt_lcpu);
+
+static inline void preempt_slice_start(struct uk_preempt_lcpu *p)
+{
+	p->need_resched = 0;
+	p->slice_end = ukplat_monotonic_clock() + PREEMPT_SLICE_NSEC;
+	ukplat_time_set_alarm(p->slice_end);
+}
+
+void uk_preempt_schedule(void)
+{
+	struct uk_preempt_lcpu *p;
+	unsigned long flags;
+
+	UK_ASSERT(!ukplat_lcpu_irqs_disabled());
+
+	flags = ukplat_lcpu_save_irqf();
+	p = &ukplat_per_lcpu_current(uk_preempt_lcpu);
+	if (unlikely(!p->slice_end || p->count)) {
+		ukplat_lcpu_restore_irqf(flags);
+		return;
+	}
+
+	/* Renew the slice before interrupts are enabled again, so that the
+	 * timer interrupt does not preempt us a second time while we yield.
+	 * The scheduler starts a new slice anyway if it switches.
+	 */
+	preempt_slice_start(p);
+	uk_thread_current()->nr_preempted++;
+	ukplat_lcpu_restore_irqf(flags);
+
+	uk_sched_yield();
+}
+
+/* Called by `uk_preempt_thread_entry` when a thread is executed for the
+ * first time. It drops the preemption count that the scheduler raised
+ * before the switch.
+ */
+void uk_preempt_schedule_tail(void)
+{
+	uk_preempt_enable();
+}
+
+void uk_sched_preempt_switch(struct uk_thread *prev, struct uk_thread *next)
+{
+	struct uk_preempt_lcpu *p;
+
+	UK_ASSERT(uk_preempt_count() > 0);
+
+	_uk_thread_flags_set(prev, UK_THREADF_STARTED);
+
+	/* A thread that was never executed does not resume from
+	 * `uk_sched_thread_switch()`, so it would not enable preemption
+	 * again. We let it enter through a trampoline that does.
+	 */
+	if (!(next->flags & UK_THREADF_STARTED)) {
+		_uk_thread_flags_set(next, UK_THREADF_STARTED);
+		ukarch_rctx_stackpush(&next->ctx, next->ctx.ip);
+		next->ctx.ip = (__uptr) uk_preempt_thread_entry;
+	}
+
+	p = &ukplat_per_lcpu_current(uk_preempt_lcpu);
+	if (next->sched &&
+	    next == uk_sched_idle_thread(next->sched, ukplat_lcpu_idx())) {
+		/* The idle thread is never preempted */
+		p->need_resched = 0;
+		p->slice_end = 0;
+		return;
+	}
+	preempt_slice_start(p);
+}
@@ -39,14 +39,24 @@
 #include <uk/plat/config.h>
 #include <uk/plat/time.h>
 #include <uk/alloc.h>
+#include <uk/arch/limits.h>
 #include <uk/plat/lcpu.h>
 #include <uk/sched.h>
+#include <uk/sched_impl.h>
 #include <uk/syscall.h>
+#include "thread_cache.h"
+#if CONFIG_LIBPOSIX_PROCESS_PIDS
+#include <uk/process.h>
+#endif /* CONFIG_LIBPOSIX_PROCESS_PIDS */
 
 struct uk_sched *uk_sched_head;
 
 UKPLAT_PER_LCPU_DEFINE(struct uk_thread *, __uk_sched_thread_current);
 
+#if CONFIG_LIBUKSCHED_QS
+UKPLAT_PER_LCPU_DEFINE(unsigned long, _uk_sched_qs);
+#endif /* CONFIG_LIBUKSCHED_QS */
+
 int uk_sched_register(struct uk_sched *s)
 {
 	struct uk_sched *this = uk_sched_head;
@@ -64,6 +74,34 @@ int uk_sched_register(struct uk_sched *s)
 	return 0;
 }
 
+/* Allocates a thread container with the allocators of `s`, or takes one
+ * from the thread cache
+ */
+static struct uk_thread *sched_thread_container(struct uk_sched *s,
+						size_t stack_len,
+						size_t auxstack_len,
+						bool no_uktls,
+						bool no_ectx,
+						const char *name,
+						void *priv,
+						uk_thread_dtor_t dtor)
+{
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	struct uk_thread *t;
+
+	t = uk_sched_thread_cache_get(s, stack_len, auxstack_len,
+				      no_uktls, no_ectx, name, priv, dtor);
+	if (t)
+		return t;
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+	return uk_thread_create_container(s->a,
+					  s->a_stack, stack_len,
+					  s->a_auxstack, auxstack_len,
+					  no_uktls ? NULL : s->a_uktls,
+					  no_ectx, name, priv, dtor);
+}
+
 struct uk_thread *uk_sched_thread_create_fn0(struct uk_sched *s,
 					     uk_thread_fn0_t fn0,
 					     size_t stack_len,
@@ -84,17 +122,11 @@ struct uk_thread *uk_sched_thread_create_fn0(struct uk_sched *s,
 	if (!no_uktls && !s->a_uktls)
 		goto err_out;
 
-	t = uk_thread_create_fn0(s->a,
-				 fn0,
-				 s->a_stack, stack_len,
-				 s->a_auxstack, auxstack_len,
-				 no_uktls ? NULL : s->a_uktls,
-				 no_ectx,
-				 name,
-				 priv,
-				 dtor);
+	t = sched_thread_container(s, stack_len, auxstack_len,
+				   no_uktls, no_ectx, name, priv, dtor);
 	if (!t)
 		goto err_out;
+	uk_thread_container_init_fn0(t, fn0);
 
 	rc = uk_sched_thread_add(s, t);
 	if (rc < 0)
@@ -129,17 +161,11 @@ struct uk_thread *uk_sched_thread_create_fn1(struct uk_sched *s,
 	if (!no_uktls && !s->a_uktls)
 		goto err_out;
 
-	t = uk_thread_create_fn1(s->a,
-				 fn1, argp,
-				 s->a_stack, stack_len,
-				 s->a_auxstack, auxstack_len,
-				 no_uktls ? NULL : s->a_uktls,
-				 no_ectx,
-				 name,
-				 priv,
-				 dtor);
+	t = sched_thread_container(s, stack_len, auxstack_len,
+				   no_uktls, no_ectx, name, priv, dtor);
 	if (!t)
 		goto err_out;
+	uk_thread_container_init_fn1(t, fn1, argp);
 
 	rc = uk_sched_thread_add(s, t);
 	if (rc < 0)
@@ -174,17 +200,11 @@ struct uk_thread *uk_sched_thread_create_fn2(struct uk_sched *s,
 	if (!no_uktls && !s->a_uktls)
 		goto err_out;
 
-	t = uk_thread_create_fn2(s->a,
-				 fn2, argp0, argp1,
-				 s->a_stack, stack_len,
-				 s->a_auxstack, auxstack_len,
-				 no_uktls ? NULL : s->a_uktls,
-				 no_ectx,
-				 name,
-				 priv,
-				 dtor);
+	t = sched_thread_container(s, stack_len, auxstack_len,
+				   no_uktls, no_ectx, name, priv, dtor);
 	if (!t)
 		goto err_out;
+	uk_thread_container_init_fn2(t, fn2, argp0, argp1);
 
 	rc = uk_sched_thread_add(s, t);
 	if (rc < 0)
@@ -254,14 +274,36 @@ err_out:
 	return ret;
 }
 
-unsigned int uk_sched_thread_gc(struct uk_sched *sched)
+unsigned int uk_sched_thread_gc_filter(struct uk_sched *sched,
+				       int (*filter)(struct uk_thread *t,
+						     void *argp),
+				       void *argp)
 {
+	struct uk_thread_list released;
 	struct uk_thread *thread, *tmp;
+	unsigned long flags;
 	unsigned int num = 0;
 
-	/* Cleanup finished threads */
+	UK_TAILQ_INIT(&released);
+
+	/* Take the threads off the list first. The release is done without
+	 * holding the lock.
+	 */
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&sched->lock);
 	UK_TAILQ_FOREACH_SAFE(thread, &sched->exited_threads,
 			      thread_list, tmp) {
+		if (filter && !filter(thread, argp))
+			continue;
+
+		UK_TAILQ_REMOVE(&sched->exited_threads, thread, thread_list);
+		UK_TAILQ_INSERT_TAIL(&released, thread, thread_list);
+	}
+	ukarch_spin_unlock(&sched->lock);
+	ukplat_lcpu_restore_irqf(flags);
+
+	/* Cleanup finished threads */
+	UK_TAILQ_FOREACH_SAFE(thread, &released, thread_list, tmp) {
 		UK_ASSERT(thread != uk_thread_current());
 		UK_ASSERT(uk_thread_is_exited(thread));
 
@@ -269,19 +311,28 @@ unsigned int uk_sched_thread_gc(struct uk_sched *sched)
 			    sched, thread,
 			    thread->name ? thread->name : "<unnamed>");
 
-		UK_TAILQ_REMOVE(&sched->exited_threads, thread, thread_list);
+		UK_TAILQ_REMOVE(&released, thread, thread_list);
 		if (thread->_gc_fn)
 			thread->_gc_fn(thread,  thread->_gc_argp);
-		uk_thread_release(thread);
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+		if (!uk_sched_thread_cache_put(sched, thread))
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+			uk_thread_release(thread);
 		++num;
 	}
 
 	return num;
 }
 
+unsigned int uk_sched_thread_gc(struct uk_sched *sched)
+{
+	return uk_sched_thread_gc_filter(sched, NULL, NULL);
+}
+
 void uk_sched_thread_terminate(struct uk_thread *thread)
 {
 	struct uk_sched *sched;
+	unsigned long flags;
 
 	UK_ASSERT(thread);
 	 /* NOTE: The following assertion can also fail on a double-termination.
@@ -307,15 +358,22 @@ void uk_sched_thread_terminate(struct uk_thread *thread)
 		uk_pr_debug("%p: thread %p (%s) on gc list\n",
 			    sched, thread, thread->name ?
 					   thread->name : "<unnamed>");
+		flags = ukplat_lcpu_save_irqf();
+		ukarch_spin_lock(&sched->lock);
 		UK_TAILQ_INSERT_TAIL(&sched->exited_threads, thread,
 				     thread_list);
+		ukarch_spin_unlock(&sched->lock);
+		ukplat_lcpu_restore_irqf(flags);
 
 		/* leave this thread */
 		sched->yield(sched); /* we won't return */
 		UK_CRASH("Unexpectedly returned to exited thread %p\n", thread);
 	} else {
 		/* free thread resources immediately */
-		uk_thread_release(thread);
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+		if (!uk_sched_thread_cache_put(sched, thread))
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+			uk_thread_release(thread);
 	}
 }
 
@@ -356,12 +414,20 @@ int uk_sched_thread_add(struct uk_sched *s, struct uk_thread *t)
 
 	flags = ukplat_lcpu_save_irqf();
 
+	/* NOTE: The scheduler might run the thread on another LCPU as soon as
+	 *       it is added, so `sched` must be set beforehand.
+	 */
+	t->sched = s;
+	uk_sched_stats_ready(t, 0);
 	rc = s->thread_add(s, t);
-	if (rc < 0)
+	if (rc < 0) {
+		t->sched = NULL;
 		goto out;
+	}
 
-	t->sched = s;
+	ukarch_spin_lock(&s->lock);
 	UK_TAILQ_INSERT_TAIL(&s->thread_list, t, thread_list);
+	ukarch_spin_unlock(&s->lock);
 out:
 	ukplat_lcpu_restore_irqf(flags);
 	return rc;
@@ -379,11 +445,93 @@ int uk_sched_thread_remove(struct uk_thread *t)
 	s = t->sched;
 	s->thread_remove(s, t);
 	t->sched = NULL;
+	ukarch_spin_lock(&s->lock);
 	UK_TAILQ_REMOVE(&s->thread_list, t, thread_list);
+	ukarch_spin_unlock(&s->lock);
 	ukplat_lcpu_restore_irqf(flags);
 	return 0;
 }
 
+static int uk_sched_attr_check(const struct uk_sched_attr *attr)
+{
+	switch (attr->sched_policy) {
+	case UK_SCHED_OTHER:
+	case UK_SCHED_BATCH:
+	case UK_SCHED_IDLE:
+		if (unlikely(attr->sched_priority != 0))
+			return -EINVAL;
+		return 0;
+	case UK_SCHED_FIFO:
+	case UK_SCHED_RR:
+		if (unlikely(attr->sched_priority < UK_SCHED_PRIO_MIN
+			     || attr->sched_priority > UK_SCHED_PRIO_MAX))
+			return -EINVAL;
+		return 0;
+	case UK_SCHED_DEADLINE:
+		/* runtime <= deadline <= period */
+		if (unlikely(attr->sched_priority != 0
+			     || attr->sched_runtime < UK_SCHED_DEADLINE_MIN
+			     || attr->sched_deadline < attr->sched_runtime
+			     || (attr->sched_period
+				 && attr->sched_period < attr->sched_deadline)
+			     || attr->sched_deadline > (__u64) __S64_MAX
+			     || attr->sched_period > (__u64) __S64_MAX))
+			return -EINVAL;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+int uk_sched_thread_set_policy(struct uk_thread *t,
+			       const struct uk_sched_attr *attr)
+{
+	struct uk_sched *s;
+	unsigned long flags;
+	int rc;
+
+	UK_ASSERT(t);
+	UK_ASSERT(attr);
+
+	rc = uk_sched_attr_check(attr);
+	if (unlikely(rc < 0))
+		return rc;
+
+	flags = ukplat_lcpu_save_irqf();
+	s = t->sched;
+	if (s && s->thread_set_policy) {
+		rc = s->thread_set_policy(s, t, attr);
+	} else if (attr->sched_policy == UK_SCHED_OTHER
+		   || attr->sched_policy == UK_SCHED_BATCH
+		   || attr->sched_policy == UK_SCHED_IDLE) {
+		/* Normal policies are the same for schedulers without
+		 * policy support
+		 */
+		uk_sched_thread_policy_store(t, attr);
+	} else {
+		rc = -EPERM;
+	}
+	ukplat_lcpu_restore_irqf(flags);
+	return rc;
+}
+
+void uk_sched_thread_get_policy(struct uk_thread *t,
+				struct uk_sched_attr *attr)
+{
+	UK_ASSERT(t);
+	UK_ASSERT(attr);
+
+	memset(attr, 0, sizeof(*attr));
+	attr->size           = UK_SCHED_ATTR_SIZE_VER0;
+	attr->sched_policy   = (__u32) t->sched_param.policy;
+	attr->sched_priority = t->sched_param.prio;
+	if (t->sched_param.policy == UK_SCHED_DEADLINE) {
+		attr->sched_runtime  = t->sched_param.runtime;
+		attr->sched_deadline = t->sched_param.deadline;
+		attr->sched_period   = t->sched_param.period;
+	}
+}
+
 UK_SYSCALL_R_DEFINE(int, sched_yield)
 {
 	uk_sched_yield();
@@ -402,6 +550,13 @@ void uk_sched_dumpk_threads(int klvl, struct uk_sched *s)
 	}
 
 	uk_printk(klvl, "sched %p:\n", s);
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	uk_printk(klvl, " thread cache: %u cached, %"__PRIu64" hits, "
+		  "%"__PRIu64" misses, %"__PRIu64" puts, %"__PRIu64" drops\n",
+		  s->thread_cache_stats.len, s->thread_cache_stats.hits,
+		  s->thread_cache_stats.misses, s->thread_cache_stats.puts,
+		  s->thread_cache_stats.drops);
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
 	uk_sched_foreach_thread_safe(s, t, tmp) {
 		uk_printk(klvl,
 			  " + thread %p (%s), ctx: %p, "
@@ -416,23 +571,51 @@ void uk_sched_dumpk_threads(int klvl, struct uk_sched *s)
 			  (t->flags & UK_THREADF_ECTX)     ? 'E' : '-',
 			  (t->flags & UK_THREADF_AUXSP)    ? 'A' : '-',
 			  (t->flags & UK_THREADF_UKTLS)    ? 'T' : '-');
+#if CONFIG_LIBUKSCHED_PREEMPT
+		uk_printk(klvl, "   preempted: %"__PRIu64" times\n",
+			  t->nr_preempted);
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
 	}
 }
 
+static struct uk_thread *sched_pid2thread(int pid)
+{
+	if (pid == 0)
+		return uk_thread_current();
+#if CONFIG_LIBPOSIX_PROCESS_PIDS
+	return tid2ukthread(pid);
+#else /* !CONFIG_LIBPOSIX_PROCESS_PIDS */
+	/* Without PIDs, every thread sees itself under the same ID */
+	return uk_thread_current();
+#endif /* !CONFIG_LIBPOSIX_PROCESS_PIDS */
+}
+
+#define SCHED_MASK_BITS		(sizeof(unsigned long) * 8)
+
 UK_SYSCALL_R_DEFINE(int, sched_getaffinity, int, pid, long, cpusetsize,
 						unsigned long*, mask)
 {
-	UK_WARN_STUBBED();
+	struct uk_thread *t;
+	unsigned int i, count;
+
 	/* NOTE: Some applications use this to get the count of CPUs,
 	 *       and the result must be positive.
-	 *       So just return CPU0 to make them run.
 	 */
-	UK_ASSERT(cpusetsize > 0);
-	UK_ASSERT(mask);
-	memset(mask, 0, cpusetsize);
+	if (unlikely(cpusetsize < (long) sizeof(unsigned long)
+		     || cpusetsize % sizeof(unsigned long)))
+		return -EINVAL;
+	if (unlikely(!mask))
+		return -EFAULT;
 
-	/* Set CPU0 */
-	*mask = 1UL << 0;
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	memset(mask, 0, cpusetsize);
+	count = MIN((__u32) ukplat_lcpu_count(), (__u32) cpusetsize * 8);
+	for (i = 0; i < count; i++)
+		if (uk_thread_lcpu_allowed(t, i))
+			mask[i / SCHED_MASK_BITS] |= 1UL << (i % SCHED_MASK_BITS);
 
 	return cpusetsize;
 }
@@ -440,7 +623,183 @@ UK_SYSCALL_R_DEFINE(int, sched_getaffinity, int, pid, long, cpusetsize,
 UK_SYSCALL_R_DEFINE(int, sched_setaffinity, int, pid, long, cpusetsize,
 						unsigned long*, mask)
 {
-	UK_WARN_STUBBED();
+	unsigned long affinity[UK_THREAD_AFFINITY_LEN];
+	struct uk_thread *t;
+	unsigned int i, count;
+	bool empty = true;
+
+	/* The mask is read in words, so partial words are rejected */
+	if (unlikely(cpusetsize < (long) sizeof(unsigned long)
+		     || cpusetsize % sizeof(unsigned long)))
+		return -EINVAL;
+	if (unlikely(!mask))
+		return -EFAULT;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	/* Only online LCPUs are taken over */
+	memset(affinity, 0, sizeof(affinity));
+	count = MIN((__u32) ukplat_lcpu_count(), (__u32) cpusetsize * 8);
+	for (i = 0; i < count; i++) {
+		if (!(mask[i / SCHED_MASK_BITS] & (1UL << (i % SCHED_MASK_BITS))))
+			continue;
+		affinity[i / SCHED_MASK_BITS] |= 1UL << (i % SCHED_MASK_BITS);
+		empty = false;
+	}
+	if (unlikely(empty))
+		return -EINVAL;
+
+	/* The scheduler honors the mask with the next scheduling decision
+	 * of the thread. A thread that waits on a logical CPU that it may no
+	 * longer run on is moved by the scheduler.
+	 */
+	for (i = 0; i < UK_THREAD_AFFINITY_LEN; i++)
+		UK_WRITE_ONCE(t->affinity[i], affinity[i]);
+	if (t->sched && t->sched->thread_set_affinity)
+		t->sched->thread_set_affinity(t->sched, t);
+
+	if (t == uk_thread_current()
+	    && !uk_thread_lcpu_allowed(t, ukplat_lcpu_idx()))
+		uk_sched_yield();
+	return 0;
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_setscheduler, int, pid, int, policy,
+		    const struct uk_sched_param *, param)
+{
+	struct uk_sched_attr attr = { .size = UK_SCHED_ATTR_SIZE_VER0 };
+	struct uk_thread *t;
+
+	if (unlikely(!param))
+		return -EINVAL;
+
+	/* Deadline scheduling can only be set with sched_setattr() */
+	policy &= ~UK_SCHED_RESET_ON_FORK;
+	if (unlikely(policy < 0 || policy == UK_SCHED_DEADLINE))
+		return -EINVAL;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	attr.sched_policy   = (__u32) policy;
+	attr.sched_priority = (__u32) param->sched_priority;
+	return uk_sched_thread_set_policy(t, &attr);
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_getscheduler, int, pid)
+{
+	struct uk_thread *t;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	return t->sched_param.policy;
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_setparam, int, pid,
+		    const struct uk_sched_param *, param)
+{
+	struct uk_sched_attr attr;
+	struct uk_thread *t;
+
+	if (unlikely(!param))
+		return -EINVAL;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	uk_sched_thread_get_policy(t, &attr);
+	if (unlikely(attr.sched_policy == UK_SCHED_DEADLINE))
+		return -EINVAL;
+
+	attr.sched_priority = (__u32) param->sched_priority;
+	return uk_sched_thread_set_policy(t, &attr);
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_getparam, int, pid,
+		    struct uk_sched_param *, param)
+{
+	struct uk_thread *t;
+
+	if (unlikely(!param))
+		return -EINVAL;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	param->sched_priority = (int) t->sched_param.prio;
+	return 0;
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_get_priority_max, int, policy)
+{
+	switch (policy) {
+	case UK_SCHED_FIFO:
+	case UK_SCHED_RR:
+		return UK_SCHED_PRIO_MAX;
+	case UK_SCHED_OTHER:
+	case UK_SCHED_BATCH:
+	case UK_SCHED_IDLE:
+	case UK_SCHED_DEADLINE:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_get_priority_min, int, policy)
+{
+	switch (policy) {
+	case UK_SCHED_FIFO:
+	case UK_SCHED_RR:
+		return UK_SCHED_PRIO_MIN;
+	case UK_SCHED_OTHER:
+	case UK_SCHED_BATCH:
+	case UK_SCHED_IDLE:
+	case UK_SCHED_DEADLINE:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_setattr, int, pid,
+		    const struct uk_sched_attr *, attr, unsigned int, flags)
+{
+	struct uk_thread *t;
+
+	if (unlikely(!attr || flags))
+		return -EINVAL;
+	if (unlikely(attr->size && attr->size < UK_SCHED_ATTR_SIZE_VER0))
+		return -EINVAL;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	return uk_sched_thread_set_policy(t, attr);
+}
+
+UK_SYSCALL_R_DEFINE(int, sched_getattr, int, pid,
+		    struct uk_sched_attr *, attr, unsigned int, size,
+		    unsigned int, flags)
+{
+	struct uk_thread *t;
+
+	if (unlikely(!attr || flags || size < UK_SCHED_ATTR_SIZE_VER0))
+		return -EINVAL;
+
+	t = sched_pid2thread(pid);
+	if (unlikely(!t))
+		return -ESRCH;
+
+	uk_sched_thread_get_policy(t, attr);
 	return 0;
 }
 
@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/* A thread is sorted by a copy of its wakeup time (`_sleep.until`) because
+ * `wakeup_time` may be changed while the thread is queued. A zero copy means
+ * that the thread is not queued.
+ */
+
+#include <uk/sched_impl.h>
+
+static inline int sleepq_cmp(struct uk_thread *a, struct uk_thread *b)
+{
+	if (a->_sleep.until != b->_sleep.until)
+		return (a->_sleep.until < b->_sleep.until) ? -1 : 1;
+
+	/* Threads with the same deadline are ordered by their address */
+	if (a != b)
+		return ((__uptr) a < (__uptr) b) ? -1 : 1;
+	return 0;
+}
+
+UK_RB_GENERATE_STATIC(uk_sched_sleepq_tree, uk_thread, _sleep.entry,
+		      sleepq_cmp);
+
+void uk_sched_sleepq_insert(struct uk_sched_sleepq *q, struct uk_thread *t)
+{
+	UK_ASSERT(q);
+	UK_ASSERT(t);
+	UK_ASSERT(t->wakeup_time > 0);
+	UK_ASSERT(!uk_sched_sleepq_queued(t));
+
+	t->_sleep.until = t->wakeup_time;
+	UK_RB_INSERT(uk_sched_sleepq_tree, &q->tree, t);
+
+	if (!q->first || sleepq_cmp(t, q->first) < 0)
+		q->first = t;
+}
+
+void uk_sched_sleepq_remove(struct uk_sched_sleepq *q, struct uk_thread *t)
+{
+	UK_ASSERT(q);
+	UK_ASSERT(t);
+
+	if (!uk_sched_sleepq_queued(t))
+		return;
+
+	if (t == q->first)
+		q->first = UK_RB_NEXT(uk_sched_sleepq_tree, &q->tree, t);
+	UK_RB_REMOVE(uk_sched_sleepq_tree, &q->tree, t);
+	t->_sleep.until = 0;
+}
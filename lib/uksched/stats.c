@@ -0,0 +1,254 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#define _GNU_SOURCE /* asprintf */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <uk/arch/time.h>
+#include <uk/errptr.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/print.h>
+#include <uk/sched.h>
+#include <uk/sched_idle.h>
+#include <uk/sched_stats.h>
+#include <uk/store.h>
+#include <uk/thread.h>
+
+void uk_sched_stats_enable(int enable)
+{
+	if (enable && !_uk_sched_stats_on)
+		_uk_sched_stats_epoch = ukplat_monotonic_clock();
+	_uk_sched_stats_on = !!enable;
+}
+
+__nsec uk_sched_hist_percentile(const struct uk_sched_hist *h,
+				unsigned int p)
+{
+	__u64 rank, seen = 0;
+	unsigned int i;
+
+	UK_ASSERT(h);
+	UK_ASSERT(p > 0 && p <= 100);
+
+	if (!h->count)
+		return 0;
+
+	rank = (h->count * p + 99) / 100;
+	for (i = 0; i < UK_SCHED_HIST_BUCKETS - 1; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			return MIN((__nsec) 1 << (i + UK_SCHED_HIST_SHIFT),
+				   h->max);
+	}
+	return h->max;
+}
+
+int uk_sched_lcpu_stats(unsigned int lcpu_idx,
+			struct uk_sched_lcpu_stats *stats)
+{
+	UK_ASSERT(stats);
+
+	if (unlikely(lcpu_idx >= ukplat_lcpu_count()))
+		return -EINVAL;
+
+	*stats = ukplat_per_lcpu(_uk_sched_lcpu_stats, lcpu_idx);
+	return 0;
+}
+
+static void dumpk_hist(int klvl, const char *prefix, const char *name,
+		       const struct uk_sched_hist *h)
+{
+	if (!h->count)
+		return;
+	uk_printk(klvl, "%s%s: %"__PRIu64" samples, avg %"__PRInsec"ns, "
+		  "p50 <%"__PRInsec"ns, p99 <%"__PRInsec"ns, "
+		  "max %"__PRInsec"ns\n",
+		  prefix, name, h->count, h->sum / h->count,
+		  uk_sched_hist_percentile(h, 50),
+		  uk_sched_hist_percentile(h, 99), h->max);
+}
+
+void uk_sched_dumpk_stats(int klvl, struct uk_sched *s)
+{
+	struct uk_sched_lcpu_stats ls;
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+	struct uk_sched_idle_stats is;
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+	struct uk_thread *t, *tmp;
+	__nsec uptime = ukplat_monotonic_clock();
+	unsigned int i;
+
+	uk_printk(klvl, "sched %p statistics%s:\n", s,
+		  _uk_sched_stats_on ? "" : " (disabled)");
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		uk_sched_lcpu_stats(i, &ls);
+		uk_printk(klvl, " lcpu %u: %"__PRIu64" switches "
+			  "(%"__PRIu64"/s), idle %"__PRInsec".%03"__PRInsec"s\n",
+			  i, ls.nr_switches,
+			  uptime ? ls.nr_switches
+				   * (__u64) UKARCH_NSEC_PER_SEC / uptime
+				 : 0,
+			  ukarch_time_nsec_to_sec(ls.idle_time),
+			  ukarch_time_nsec_to_msec(ls.idle_time) % 1000);
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+		uk_sched_idle_stats(i, &is);
+		uk_printk(klvl, "   idle polling %"__PRInsec"us "
+			  "(%"__PRIu64" hits, %"__PRIu64" misses), "
+			  "halted %"__PRInsec"us (%"__PRIu64" halts), "
+			  "window %"__PRInsec"ns\n",
+			  ukarch_time_nsec_to_usec(is.poll_time),
+			  is.nr_poll_hits, is.nr_poll_misses,
+			  ukarch_time_nsec_to_usec(is.halt_time),
+			  is.nr_halts, is.window);
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+		dumpk_hist(klvl, "   ", "run queue wait", &ls.wait);
+		dumpk_hist(klvl, "   ", "wakeup latency", &ls.wakeup);
+	}
+
+	uk_sched_foreach_thread_safe(s, t, tmp) {
+		uk_printk(klvl, " + thread %p (%s): %"__PRIu64" switches\n",
+			  t, t->name ? t->name : "<unnamed>",
+			  t->_stats.nr_switches);
+		dumpk_hist(klvl, "   ", "run queue wait", &t->_stats.wait);
+		dumpk_hist(klvl, "   ", "wakeup latency", &t->_stats.wakeup);
+	}
+}
+
+/*
+ * ukstore
+ */
+static int get_enabled(void *cookie __unused, __u8 *out)
+{
+	*out = (__u8) _uk_sched_stats_on;
+	return 0;
+}
+
+static int set_enabled(void *cookie __unused, __u8 val)
+{
+	uk_sched_stats_enable(val);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_SCHED_STATS_ENABLED, stats_enabled, u8,
+		      get_enabled, set_enabled);
+
+#if CONFIG_LIBUKSTORE
+#define LCPU_STATS(cookie) \
+	(&ukplat_per_lcpu(_uk_sched_lcpu_stats, (__uptr) (cookie)))
+
+static int get_nr_switches(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->nr_switches;
+	return 0;
+}
+
+static int get_idle_ns(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->idle_time;
+	return 0;
+}
+
+static int get_wait_count(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->wait.count;
+	return 0;
+}
+
+static int get_wait_p50(void *cookie, __u64 *out)
+{
+	*out = uk_sched_hist_percentile(&LCPU_STATS(cookie)->wait, 50);
+	return 0;
+}
+
+static int get_wait_p99(void *cookie, __u64 *out)
+{
+	*out = uk_sched_hist_percentile(&LCPU_STATS(cookie)->wait, 99);
+	return 0;
+}
+
+static int get_wait_max(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->wait.max;
+	return 0;
+}
+
+static int get_wakeup_count(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->wakeup.count;
+	return 0;
+}
+
+static int get_wakeup_p50(void *cookie, __u64 *out)
+{
+	*out = uk_sched_hist_percentile(&LCPU_STATS(cookie)->wakeup, 50);
+	return 0;
+}
+
+static int get_wakeup_p99(void *cookie, __u64 *out)
+{
+	*out = uk_sched_hist_percentile(&LCPU_STATS(cookie)->wakeup, 99);
+	return 0;
+}
+
+static int get_wakeup_max(void *cookie, __u64 *out)
+{
+	*out = LCPU_STATS(cookie)->wakeup.max;
+	return 0;
+}
+
+static const struct uk_store_entry *lcpu_entries[] = {
+	UK_STORE_ENTRY(UK_SCHED_STATS_NUM_SWITCHES, nr_switches, u64,
+		       get_nr_switches, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_IDLE_NS, idle_ns, u64,
+		       get_idle_ns, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAIT_COUNT, wait_count, u64,
+		       get_wait_count, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAIT_P50_NS, wait_p50_ns, u64,
+		       get_wait_p50, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAIT_P99_NS, wait_p99_ns, u64,
+		       get_wait_p99, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAIT_MAX_NS, wait_max_ns, u64,
+		       get_wait_max, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAKEUP_COUNT, wakeup_count, u64,
+		       get_wakeup_count, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAKEUP_P50_NS, wakeup_p50_ns, u64,
+		       get_wakeup_p50, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAKEUP_P99_NS, wakeup_p99_ns, u64,
+		       get_wakeup_p99, NULL),
+	UK_STORE_ENTRY(UK_SCHED_STATS_WAKEUP_MAX_NS, wakeup_max_ns, u64,
+		       get_wakeup_max, NULL),
+	NULL
+};
+
+/* Export one object per logical CPU, named "lcpu<idx>" */
+static int stats_store_init(struct uk_init_ctx *ictx __unused)
+{
+	struct uk_store_object *obj;
+	char *name;
+	__uptr i;
+	int rc;
+
+	for (i = 0; i < ukplat_lcpu_count(); i++) {
+		if (unlikely(asprintf(&name, "lcpu%u", (unsigned int) i) < 0))
+			return -ENOMEM;
+
+		obj = uk_store_obj_alloc(uk_alloc_get_default(), i, name,
+					 lcpu_entries, (void *) i);
+		free(name);
+		if (unlikely(PTRISERR(obj)))
+			return PTR2ERR(obj);
+
+		rc = uk_store_obj_add(obj);
+		if (unlikely(rc))
+			return rc;
+	}
+	return 0;
+}
+
+uk_late_initcall(stats_store_init, 0x0);
+#endif /* CONFIG_LIBUKSTORE */
@@ -45,6 +45,7 @@
 #include <uk/assert.h>
 #include <uk/arch/tls.h>
 #include <uk/plat/memory.h>
+#include "thread_cache.h"
 
 #if CONFIG_LIBUKSCHED_TCB_INIT && !CONFIG_UKARCH_TLS_HAVE_TCB
 #error CONFIG_LIBUKSCHED_TCB_INIT requires that a TLS contains reserved space for a TCB
@@ -250,6 +251,7 @@ static void _uk_thread_struct_init(struct uk_thread *t,
 	t->priv = priv;
 	t->dtor = dtor;
 	t->exec_time = 0;
+	memset(t->affinity, 0xff, sizeof(t->affinity));
 
 	if (auxsp) {
 		t->flags |= UK_THREADF_AUXSP;
@@ -456,11 +458,13 @@ static int _uk_thread_struct_init_alloc(struct uk_thread *t,
 	if (stack) {
 		t->_mem.stack = stack;
 		t->_mem.stack_a = a_stack;
+		t->_mem.stack_len = stack_len;
 	}
 
 	if (auxstack) {
 		t->_mem.auxstack = auxstack;
 		t->_mem.auxstack_a = a_auxstack;
+		t->_mem.auxstack_len = auxstack_len;
 	}
 
 	if (tls) {
@@ -521,6 +525,52 @@ void _uk_thread_struct_free_alloc(struct uk_thread *t)
 	}
 }
 
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+int _uk_thread_container_reinit(struct uk_thread *t,
+				const char *name,
+				void *priv,
+				uk_thread_dtor_t dtor)
+{
+	typeof(t->_mem) mem = t->_mem;
+	struct ukarch_ectx *ectx = t->ectx;
+	uintptr_t auxsp = 0x0;
+	uintptr_t tlsp = 0x0;
+	int rc;
+
+	UK_ASSERT(t);
+	UK_ASSERT(mem.stack);
+
+	if (mem.auxstack)
+		auxsp = ukarch_gen_sp(mem.auxstack, mem.auxstack_len);
+	if (mem.uktls) {
+		ukarch_tls_area_init(mem.uktls);
+		tlsp = ukarch_tls_tlsp(mem.uktls);
+	}
+
+	_uk_thread_struct_init(t, auxsp, tlsp, !(!tlsp), ectx, name, priv,
+			       dtor);
+	t->_mem = mem;
+
+#if CONFIG_LIBUKSCHED_TCB_INIT
+	if (mem.uktls) {
+		rc = uk_thread_uktcb_init(t, uk_thread_uktcb(t));
+		if (rc < 0)
+			return rc;
+	}
+#endif /* CONFIG_LIBUKSCHED_TCB_INIT */
+
+	ukarch_ctx_init_bare(&t->ctx,
+			     ukarch_gen_sp(mem.stack, mem.stack_len), 0x0);
+
+	rc = _uk_thread_call_inittab(t);
+#if CONFIG_LIBUKSCHED_TCB_INIT
+	if (rc < 0 && mem.uktls)
+		uk_thread_uktcb_fini(t, uk_thread_uktcb(t));
+#endif /* CONFIG_LIBUKSCHED_TCB_INIT */
+	return rc;
+}
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
 int uk_thread_init_fn0(struct uk_thread *t,
 		       uk_thread_fn0_t fn,
 		       struct uk_alloc *a_stack,
@@ -1075,6 +1125,7 @@ void uk_thread_wake(struct uk_thread *thread)
 	flags = ukplat_lcpu_save_irqf();
 	if (!uk_thread_is_runnable(thread)) {
 		uk_thread_set_runnable(thread);
+		uk_sched_stats_ready(thread, 1);
 		if (thread->sched)
 			uk_sched_thread_woken(thread);
 	}
@@ -0,0 +1,188 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * Cache of exited threads. Instead of freeing the struct, stacks and TLS of
+ * an exited thread, the garbage collection puts the thread on a list of its
+ * scheduler. `uk_sched_thread_create_fn*()` take a thread with matching
+ * sizes from there and only reinitialize it.
+ */
+#include <uk/plat/config.h>
+#include <uk/plat/lcpu.h>
+#include <uk/alloc.h>
+#include <uk/tcb_impl.h>
+#include <uk/sched.h>
+#include "thread_cache.h"
+
+#define THREAD_CACHE_SIZE	CONFIG_LIBUKSCHED_THREAD_CACHE_SIZE
+
+/* Frees a cached thread, its TCB was already finalized */
+static void thread_cache_free(struct uk_thread *t)
+{
+	if (t->_mem.uktls)
+		uk_free(t->_mem.uktls_a, t->_mem.uktls);
+	uk_free(t->_mem.stack_a, t->_mem.stack);
+	if (t->_mem.auxstack)
+		uk_free(t->_mem.auxstack_a, t->_mem.auxstack);
+	uk_free(t->_mem.t_a, t);
+}
+
+/* Only threads whose memory was allocated entirely from the allocators of
+ * the scheduler can be reused by `uk_sched_thread_create_fn*()`
+ */
+static bool thread_cache_suitable(struct uk_sched *s, struct uk_thread *t)
+{
+	if (t->dtor || t->_mem.t_a != s->a)
+		return false;
+	if (!t->_mem.stack || t->_mem.stack_a != s->a_stack)
+		return false;
+	if (t->_mem.auxstack ? t->_mem.auxstack_a != s->a_auxstack
+			     : t->auxsp != 0x0)
+		return false;
+	if (t->_mem.uktls ? t->_mem.uktls_a != s->a_uktls
+			  : t->tlsp != 0x0)
+		return false;
+	return true;
+}
+
+int uk_sched_thread_cache_put(struct uk_sched *s, struct uk_thread *t)
+{
+	unsigned long flags;
+
+	UK_ASSERT(s);
+	UK_ASSERT(t);
+	UK_ASSERT(!t->sched);
+	UK_ASSERT(t != uk_thread_current());
+
+	if (!thread_cache_suitable(s, t)) {
+		flags = ukplat_lcpu_save_irqf();
+		ukarch_spin_lock(&s->lock);
+		s->thread_cache_stats.drops++;
+		ukarch_spin_unlock(&s->lock);
+		ukplat_lcpu_restore_irqf(flags);
+		return 0;
+	}
+
+	/* Same as `uk_thread_release()` up to freeing the memory */
+	uk_thread_set_exited(t);
+#if CONFIG_LIBUKSCHED_TCB_INIT
+	if (t->_mem.uktls)
+		uk_thread_uktcb_fini(t, uk_thread_uktcb(t));
+#endif /* CONFIG_LIBUKSCHED_TCB_INIT */
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&s->lock);
+	if (s->thread_cache_stats.len >= THREAD_CACHE_SIZE) {
+		s->thread_cache_stats.drops++;
+		ukarch_spin_unlock(&s->lock);
+		ukplat_lcpu_restore_irqf(flags);
+
+		thread_cache_free(t);
+		return 1;
+	}
+	UK_TAILQ_INSERT_HEAD(&s->thread_cache, t, thread_list);
+	s->thread_cache_stats.len++;
+	s->thread_cache_stats.puts++;
+	ukarch_spin_unlock(&s->lock);
+	ukplat_lcpu_restore_irqf(flags);
+	return 1;
+}
+
+struct uk_thread *uk_sched_thread_cache_get(struct uk_sched *s,
+					    size_t stack_len,
+					    size_t auxstack_len,
+					    bool no_uktls,
+					    bool no_ectx,
+					    const char *name,
+					    void *priv,
+					    uk_thread_dtor_t dtor)
+{
+	struct uk_thread *t;
+	unsigned long flags;
+	bool uktls = !no_uktls;
+	/* With a TLS, the ectx is always allocated together with it */
+	bool ectx = !no_ectx || uktls;
+
+	UK_ASSERT(s);
+
+	stack_len = (!!stack_len) ? stack_len : STACK_SIZE;
+	/* Without an auxiliary stack allocator, threads have no auxiliary
+	 * stack
+	 */
+	if (!s->a_auxstack)
+		auxstack_len = 0;
+	else
+		auxstack_len = (!!auxstack_len) ? auxstack_len : AUXSTACK_SIZE;
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&s->lock);
+	/* Most recently cached threads come first, their memory is more
+	 * likely still in the CPU caches
+	 */
+	UK_TAILQ_FOREACH(t, &s->thread_cache, thread_list) {
+		if (t->_mem.stack_len == stack_len &&
+		    t->_mem.auxstack_len == auxstack_len &&
+		    !(!t->_mem.uktls) == uktls &&
+		    !(!t->ectx) == ectx)
+			break;
+	}
+	if (t) {
+		UK_TAILQ_REMOVE(&s->thread_cache, t, thread_list);
+		s->thread_cache_stats.len--;
+		s->thread_cache_stats.hits++;
+	} else {
+		s->thread_cache_stats.misses++;
+	}
+	ukarch_spin_unlock(&s->lock);
+	ukplat_lcpu_restore_irqf(flags);
+
+	if (!t)
+		return NULL;
+
+	if (unlikely(_uk_thread_container_reinit(t, name, priv, dtor) < 0)) {
+		thread_cache_free(t);
+		return NULL;
+	}
+	return t;
+}
+
+void uk_sched_thread_cache_stats(struct uk_sched *s,
+				 struct uk_sched_thread_cache_stats *stats)
+{
+	unsigned long flags;
+
+	UK_ASSERT(s);
+	UK_ASSERT(stats);
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&s->lock);
+	*stats = s->thread_cache_stats;
+	ukarch_spin_unlock(&s->lock);
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+unsigned int uk_sched_thread_cache_drain(struct uk_sched *s)
+{
+	struct uk_thread_list drained;
+	struct uk_thread *t, *tmp;
+	unsigned long flags;
+	unsigned int num = 0;
+
+	UK_ASSERT(s);
+
+	flags = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&s->lock);
+	UK_TAILQ_INIT(&drained);
+	UK_TAILQ_CONCAT(&drained, &s->thread_cache, thread_list);
+	s->thread_cache_stats.len = 0;
+	ukarch_spin_unlock(&s->lock);
+	ukplat_lcpu_restore_irqf(flags);
+
+	UK_TAILQ_FOREACH_SAFE(t, &drained, thread_list, tmp) {
+		thread_cache_free(t);
+		++num;
+	}
+	return num;
+}
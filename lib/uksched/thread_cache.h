@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#ifndef __UKSCHED_THREAD_CACHE_H__
+#define __UKSCHED_THREAD_CACHE_H__
+
+#include <uk/sched.h>
+#include <uk/thread.h>
+
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+/**
+ * Reinitializes a cached thread as container like
+ * `uk_thread_create_container()` does, while keeping the struct, stacks
+ * and TLS. The TLS is initialized again from the template.
+ */
+int _uk_thread_container_reinit(struct uk_thread *t,
+				const char *name,
+				void *priv,
+				uk_thread_dtor_t dtor);
+
+/**
+ * Takes a thread with matching properties out of the cache of `s` and
+ * returns it as container. Returns NULL if there is none.
+ */
+struct uk_thread *uk_sched_thread_cache_get(struct uk_sched *s,
+					    size_t stack_len,
+					    size_t auxstack_len,
+					    bool no_uktls,
+					    bool no_ectx,
+					    const char *name,
+					    void *priv,
+					    uk_thread_dtor_t dtor);
+
+/**
+ * Releases an exited thread of `s` into its cache. If the cache is full,
+ * the memory of the thread is freed. Returns 0 if the thread is not
+ * suitable for the cache; the caller has to release it with
+ * `uk_thread_release()` then.
+ */
+int uk_sched_thread_cache_put(struct uk_sched *s, struct uk_thread *t);
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+#endif /* __UKSCHED_THREAD_CACHE_H__ */
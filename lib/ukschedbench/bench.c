@@ -0,0 +1,1056 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <uk/schedbench.h>
+#include <uk/alloc.h>
+#include <uk/arch/limits.h>
+#include <uk/arch/time.h>
+#include <uk/atomic.h>
+#include <uk/assert.h>
+#include <uk/bench.h>
+#include <uk/essentials.h>
+#include <uk/init.h>
+#include <uk/print.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/time.h>
+#include <uk/sched.h>
+#include <uk/thread.h>
+#if CONFIG_LIBUKFIBER
+#include <uk/fiber.h>
+#endif /* CONFIG_LIBUKFIBER */
+#if CONFIG_LIBPOSIX_FUTEX
+#include <linux/futex.h>
+#include <uk/syscall.h>
+#endif /* CONFIG_LIBPOSIX_FUTEX */
+#if CONFIG_LIBUKLOCK
+#include <uk/brlock.h>
+#include <uk/mutex.h>
+#include <uk/rwlock.h>
+#include <uk/spinlock.h>
+#endif /* CONFIG_LIBUKLOCK */
+#if CONFIG_LIBVFSCORE
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* CONFIG_LIBVFSCORE */
+
+#define bench_printf(fmt, ...)						\
+	_uk_printk(KLVL_INFO, UKLIBID_NONE, __NULL, 0x0,		\
+		   "schedbench: " fmt, ##__VA_ARGS__)
+
+#define BENCH_ITERATIONS	CONFIG_LIBUKSCHEDBENCH_ITERATIONS
+
+/*
+ * Benchmark state that is shared between the runner and the workloads
+ */
+struct bench_ctx {
+	__u64 rnd;		/* workload random sequence */
+	struct uk_bench_lat lat;
+};
+
+static struct bench_ctx ctx;
+
+static void bench_reset(struct bench_ctx *c)
+{
+	c->rnd = 0x9e3779b97f4a7c15ULL;
+	uk_bench_lat_reset(&c->lat);
+}
+
+#define BENCH_TIMED(c, expr)	UK_BENCH_TIMED(&(c)->lat, expr)
+#define bench_percentile(c, p)	uk_bench_percentile(&(c)->lat, p)
+
+/* Give threads that were just created or woken up the chance to run and
+ * the idle thread the chance to release exited threads
+ */
+static inline void bench_settle(void)
+{
+	uk_sched_thread_sleep(ukarch_time_msec_to_nsec(10));
+}
+
+/*
+ * Yield latency with sleeping threads in the background
+ */
+#define SLEEPER_STACK_LEN	(__PAGE_SIZE * 4)
+#define SLEEPER_AUXSTACK_LEN	(__PAGE_SIZE * 2)
+/* Sleepers must not expire during the measurement. Their timeouts are
+ * spread over one second so that they are all distinct.
+ */
+#define SLEEPER_NSEC		ukarch_time_sec_to_nsec(3600)
+
+static const unsigned int yield_levels[] = { 10, 1000, 10000 };
+
+static struct uk_thread **sleepers;
+static volatile int sleepers_stop;
+static volatile unsigned int sleepers_exited;
+
+static volatile int partner_stop;
+static volatile int partner_done;
+
+static __noreturn void sleeper_fn(void *arg)
+{
+	__nsec timeout = SLEEPER_NSEC + (__nsec) (__uptr) arg;
+
+	while (!sleepers_stop)
+		uk_sched_thread_sleep(timeout);
+
+	sleepers_exited++;
+	uk_sched_thread_exit();
+}
+
+static __noreturn void partner_fn(void *arg __unused)
+{
+	while (!partner_stop)
+		uk_sched_yield();
+
+	partner_done = 1;
+	uk_sched_thread_exit();
+}
+
+static unsigned int sleepers_start(struct bench_ctx *c, unsigned int nr)
+{
+	struct uk_sched *s = uk_sched_current();
+	__uptr spread;
+	unsigned int i;
+
+	sleepers_stop = 0;
+	sleepers_exited = 0;
+	for (i = 0; i < nr; i++) {
+		spread = uk_bench_rand(&c->rnd) % UKARCH_NSEC_PER_SEC;
+		sleepers[i] = uk_sched_thread_create_fn1(s, sleeper_fn,
+							 (void *) spread,
+							 SLEEPER_STACK_LEN,
+							 SLEEPER_AUXSTACK_LEN,
+							 false, false,
+							 "schedbench-sleeper",
+							 NULL, NULL);
+		if (unlikely(!sleepers[i]))
+			break;
+	}
+
+	/* Let all sleepers enter their sleep */
+	bench_settle();
+	return i;
+}
+
+static void sleepers_stop_all(unsigned int nr)
+{
+	unsigned int i;
+
+	sleepers_stop = 1;
+	for (i = 0; i < nr; i++)
+		uk_thread_wake(sleepers[i]);
+
+	while (sleepers_exited < nr)
+		uk_sched_yield();
+	bench_settle();
+}
+
+static int yield_run_one(struct bench_ctx *c, unsigned int nr_sleepers)
+{
+	struct uk_thread *partner;
+	unsigned int nr, i;
+	__nsec ns_per_yield;
+
+	bench_reset(c);
+
+	nr = sleepers_start(c, nr_sleepers);
+	if (unlikely(nr < nr_sleepers)) {
+		uk_pr_err("Could only create %u of %u sleeping threads\n",
+			  nr, nr_sleepers);
+		sleepers_stop_all(nr);
+		return -ENOMEM;
+	}
+
+	partner_stop = 0;
+	partner_done = 0;
+	partner = uk_sched_thread_create(uk_sched_current(), partner_fn, NULL,
+					 "schedbench-partner");
+	if (unlikely(!partner)) {
+		sleepers_stop_all(nr);
+		return -ENOMEM;
+	}
+
+	/* Every round trip switches to the partner and back */
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		BENCH_TIMED(c, uk_sched_yield());
+
+	partner_stop = 1;
+	while (!partner_done)
+		uk_sched_yield();
+	sleepers_stop_all(nr);
+
+	uk_bench_sort(&c->lat);
+	ns_per_yield = c->lat.ops ? c->lat.total / (2 * c->lat.ops) : 0;
+	bench_printf("workload=yield sleepers=%u ops=%u total_ns=%"__PRInsec" ns_per_yield=%"__PRInsec" p50_ns=%"__PRInsec" p90_ns=%"__PRInsec" p99_ns=%"__PRInsec" max_ns=%"__PRInsec"\n",
+		     nr, c->lat.ops, c->lat.total, ns_per_yield,
+		     bench_percentile(c, 50), bench_percentile(c, 90),
+		     bench_percentile(c, 99), c->lat.max);
+	return 0;
+}
+
+static int yield_run(struct bench_ctx *c)
+{
+	struct uk_alloc *a = uk_alloc_get_default();
+	unsigned int i;
+	int rc = 0;
+
+	sleepers = uk_calloc(a, CONFIG_LIBUKSCHEDBENCH_SLEEPERS_MAX,
+			     sizeof(*sleepers));
+	if (unlikely(!sleepers))
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(yield_levels); i++) {
+		if (yield_levels[i] > CONFIG_LIBUKSCHEDBENCH_SLEEPERS_MAX)
+			break;
+		rc = yield_run_one(c, yield_levels[i]);
+		if (unlikely(rc < 0))
+			break;
+	}
+
+	uk_free(a, sleepers);
+	sleepers = NULL;
+	return rc;
+}
+
+/*
+ * Throughput of independent threads. Every worker does the same amount of
+ * work and yields in between, so that a scheduler that uses all logical CPUs
+ * finishes k workers in about the time of one.
+ */
+#define SCALE_CHUNKS		64
+#define SCALE_CHUNK_OPS		16384
+
+static volatile unsigned int scale_done;
+
+static __noreturn void scale_worker_fn(void *arg)
+{
+	__u64 state = (__u64) (__uptr) arg | 1;
+	unsigned int i, j;
+
+	for (i = 0; i < SCALE_CHUNKS; i++) {
+		for (j = 0; j < SCALE_CHUNK_OPS; j++)
+			uk_bench_rand(&state);
+		uk_sched_yield();
+	}
+
+	/* Keep the result alive */
+	if (unlikely(state == 0))
+		uk_pr_debug("Unexpected worker state\n");
+
+	uk_inc(&scale_done);
+	uk_sched_thread_exit();
+}
+
+static int scale_run_one(unsigned int nr_workers, __nsec *ns_one)
+{
+	struct uk_sched *s = uk_sched_current();
+	struct uk_thread *worker;
+	__nsec t0, total;
+	__u64 ops;
+	unsigned int i;
+
+	scale_done = 0;
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < nr_workers; i++) {
+		worker = uk_sched_thread_create(s, scale_worker_fn,
+						(__uptr) (i + 1),
+						"schedbench-worker");
+		if (unlikely(!worker)) {
+			/* Wait for the workers that were started */
+			nr_workers = i;
+			break;
+		}
+	}
+
+	/* The runner sleeps so that it does not occupy a logical CPU */
+	while (UK_READ_ONCE(scale_done) < nr_workers)
+		uk_sched_thread_sleep(ukarch_time_usec_to_nsec(100));
+	total = ukplat_monotonic_clock() - t0;
+	bench_settle();
+
+	if (unlikely(!nr_workers))
+		return -ENOMEM;
+
+	if (nr_workers == 1)
+		*ns_one = total;
+	ops = (__u64) nr_workers * SCALE_CHUNKS * SCALE_CHUNK_OPS;
+	bench_printf("workload=scale threads=%u lcpus=%u ops=%"__PRIu64" total_ns=%"__PRInsec" ops_per_sec=%"__PRIu64" speedup_x100=%"__PRIu64"\n",
+		     nr_workers, (unsigned int) ukplat_lcpu_count(), ops, total,
+		     total ? (ops * UKARCH_NSEC_PER_SEC) / total : 0,
+		     total ? ((__u64) *ns_one * nr_workers * 100) / total : 0);
+	return 0;
+}
+
+static int scale_run(void)
+{
+	unsigned int nr_lcpus = ukplat_lcpu_count();
+	__nsec ns_one = 0;
+	unsigned int k;
+	int rc = 0;
+
+	/* From one thread to twice the number of logical CPUs */
+	for (k = 1; k <= 2 * nr_lcpus; k *= 2) {
+		rc = scale_run_one(k, &ns_one);
+		if (unlikely(rc < 0))
+			break;
+	}
+	return rc;
+}
+
+/*
+ * Wakeup latency of a sleeping thread while another thread spins without
+ * ever yielding. Without preemption, the sleeper waits for the spinner to
+ * give up after its time budget.
+ */
+#define LATENCY_SAMPLES		200
+#define LATENCY_SLEEP_NSEC	ukarch_time_msec_to_nsec(1)
+#define LATENCY_SPIN_NSEC	ukarch_time_sec_to_nsec(1)
+
+static volatile int spinner_stop;
+static volatile int spinner_done;
+static __u64 spinner_preempted;
+
+static __noreturn void spinner_fn(void *arg __unused)
+{
+	__nsec until = ukplat_monotonic_clock() + LATENCY_SPIN_NSEC;
+
+	while (!spinner_stop && ukplat_monotonic_clock() < until)
+		;
+
+#if CONFIG_LIBUKSCHED_PREEMPT
+	spinner_preempted = uk_thread_current()->nr_preempted;
+#endif /* CONFIG_LIBUKSCHED_PREEMPT */
+	spinner_done = 1;
+	uk_sched_thread_exit();
+}
+
+static int latency_run(struct bench_ctx *c)
+{
+	struct uk_thread *spinner;
+	__nsec t0, now;
+	unsigned int i;
+
+	bench_reset(c);
+
+	spinner_stop = 0;
+	spinner_done = 0;
+	spinner_preempted = 0;
+	spinner = uk_sched_thread_create(uk_sched_current(), spinner_fn, NULL,
+					 "schedbench-spinner");
+	if (unlikely(!spinner))
+		return -ENOMEM;
+
+	for (i = 0; i < LATENCY_SAMPLES; i++) {
+		t0 = ukplat_monotonic_clock();
+		uk_sched_thread_sleep(LATENCY_SLEEP_NSEC);
+		now = ukplat_monotonic_clock();
+		uk_bench_record(&c->lat, now - MIN(now, t0 + LATENCY_SLEEP_NSEC));
+	}
+
+	spinner_stop = 1;
+	while (!spinner_done)
+		uk_sched_yield();
+	bench_settle();
+
+	uk_bench_sort(&c->lat);
+	bench_printf("workload=latency samples=%u p50_ns=%"__PRInsec" p99_ns=%"__PRInsec" max_ns=%"__PRInsec" preempted=%"__PRIu64"\n",
+		     c->lat.ops, bench_percentile(c, 50), bench_percentile(c, 99),
+		     c->lat.max, spinner_preempted);
+	return 0;
+}
+
+/*
+ * Thread creation latency. Threads are created in batches and exit right
+ * away. The runner sleeps after each batch, so that the exited threads are
+ * released (and possibly cached) before the next batch is created.
+ */
+#define CREATE_BATCH		16
+#define CREATE_ROUNDS		64
+
+static volatile unsigned int create_exited;
+
+static __noreturn void create_fn(void *arg __unused)
+{
+	uk_inc(&create_exited);
+	uk_sched_thread_exit();
+}
+
+static int create_run(struct bench_ctx *c)
+{
+	struct uk_sched *s = uk_sched_current();
+	struct uk_thread *t;
+	__u64 hits = 0, misses = 0;
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	struct uk_sched_thread_cache_stats st0, st1;
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+	unsigned int i, j, nr = 0;
+
+	bench_reset(c);
+	create_exited = 0;
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	uk_sched_thread_cache_stats(s, &st0);
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+	for (i = 0; i < CREATE_ROUNDS; i++) {
+		for (j = 0; j < CREATE_BATCH; j++) {
+			BENCH_TIMED(c, t = uk_sched_thread_create(s, create_fn,
+								  NULL,
+								  "schedbench-create"));
+			if (unlikely(!t))
+				break;
+			nr++;
+		}
+		while (UK_READ_ONCE(create_exited) < nr)
+			uk_sched_thread_sleep(ukarch_time_msec_to_nsec(1));
+		uk_sched_thread_sleep(ukarch_time_msec_to_nsec(1));
+		if (unlikely(!t))
+			return -ENOMEM;
+	}
+	bench_settle();
+
+#if CONFIG_LIBUKSCHED_THREAD_CACHE
+	uk_sched_thread_cache_stats(s, &st1);
+	hits = st1.hits - st0.hits;
+	misses = st1.misses - st0.misses;
+#endif /* CONFIG_LIBUKSCHED_THREAD_CACHE */
+
+	uk_bench_sort(&c->lat);
+	bench_printf("workload=create threads=%u total_ns=%"__PRInsec" ns_per_create=%"__PRInsec" p50_ns=%"__PRInsec" p99_ns=%"__PRInsec" max_ns=%"__PRInsec" cache_hits=%"__PRIu64" cache_misses=%"__PRIu64"\n",
+		     c->lat.ops, c->lat.total, c->lat.ops ? c->lat.total / c->lat.ops : 0,
+		     bench_percentile(c, 50), bench_percentile(c, 99),
+		     c->lat.max, hits, misses);
+	return 0;
+}
+
+#if CONFIG_LIBUKFIBER
+/*
+ * Switch latency between two fibers of the same thread, the counterpart of
+ * the yield workload without the scheduler
+ */
+static struct uk_fiber *fiber_ping, *fiber_pong;
+static int fiber_pingpong_done;
+
+static void fiber_ping_fn(void *arg)
+{
+	struct bench_ctx *c = (struct bench_ctx *) arg;
+	unsigned int i;
+
+	if (unlikely(!fiber_pong))
+		return;
+
+	/* Every round trip switches to pong and back */
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		BENCH_TIMED(c, uk_fiber_switch(fiber_pong));
+
+	/* Stay ready, so that we continue when pong exits */
+	fiber_pingpong_done = 1;
+	uk_fiber_yield_to(fiber_pong);
+}
+
+static void fiber_pong_fn(void *arg __unused)
+{
+	while (!fiber_pingpong_done)
+		uk_fiber_switch(fiber_ping);
+}
+
+static int fiber_pingpong_run(struct bench_ctx *c)
+{
+	struct uk_fiber_host h;
+	__nsec ns_per_switch;
+
+	bench_reset(c);
+	fiber_pingpong_done = 0;
+	fiber_pong = NULL;
+
+	uk_fiber_host_init(&h, uk_alloc_get_default());
+	fiber_ping = uk_fiber_create("schedbench-ping", 0, fiber_ping_fn, c);
+	if (unlikely(!fiber_ping)) {
+		uk_fiber_host_fini();
+		return -ENOMEM;
+	}
+	uk_fiber_detach(fiber_ping);
+	fiber_pong = uk_fiber_create("schedbench-pong", 0, fiber_pong_fn,
+				     NULL);
+	if (likely(fiber_pong))
+		uk_fiber_detach(fiber_pong);
+	/* Without pong, ping returns right away */
+	uk_fiber_host_run();
+	uk_fiber_host_fini();
+	if (unlikely(!fiber_pong))
+		return -ENOMEM;
+
+	uk_bench_sort(&c->lat);
+	ns_per_switch = c->lat.ops ? c->lat.total / (2 * c->lat.ops) : 0;
+	bench_printf("workload=fiber_pingpong ops=%u total_ns=%"__PRInsec" ns_per_switch=%"__PRInsec" p50_ns=%"__PRInsec" p90_ns=%"__PRInsec" p99_ns=%"__PRInsec" max_ns=%"__PRInsec"\n",
+		     c->lat.ops, c->lat.total, ns_per_switch,
+		     bench_percentile(c, 50), bench_percentile(c, 90),
+		     bench_percentile(c, 99), c->lat.max);
+	return 0;
+}
+#endif /* CONFIG_LIBUKFIBER */
+
+#if CONFIG_LIBPOSIX_FUTEX
+/*
+ * Throughput of futex-based mutexes. Two threads share each mutex and yield
+ * while they hold it, so that every acquisition of the partner waits on the
+ * futex. The mutexes are independent; with a hashed futex table their wait
+ * and wake operations do not interfere.
+ */
+UK_SYSCALL_R_PROTO(6, futex);
+
+static const unsigned int futex_levels[] = { 1, 16, 256 };
+
+struct futex_mutex {
+	__u32 word;	/* 0: unlocked, 1: locked, 2: locked with waiters */
+} __align(CACHE_LINE_SIZE);
+
+static struct futex_mutex *futex_mutexes;
+static unsigned int futex_ops_per_thread;
+static volatile unsigned int futex_done;
+static __u64 futex_waits;
+static __u64 futex_wakes;
+
+static void futex_mutex_lock(struct futex_mutex *m)
+{
+	__u32 c = 0;
+
+	if (uk_compare_exchange_n(&m->word, &c, 1))
+		return;
+
+	if (c != 2)
+		c = uk_exchange_n(&m->word, 2);
+	while (c != 0) {
+		uk_inc(&futex_waits);
+		uk_syscall_r_futex((long) &m->word, FUTEX_WAIT_PRIVATE, 2,
+				   0, 0, 0);
+		c = uk_exchange_n(&m->word, 2);
+	}
+}
+
+static void futex_mutex_unlock(struct futex_mutex *m)
+{
+	if (uk_fetch_sub(&m->word, 1) != 1) {
+		uk_store_n(&m->word, 0);
+		uk_inc(&futex_wakes);
+		uk_syscall_r_futex((long) &m->word, FUTEX_WAKE_PRIVATE, 1,
+				   0, 0, 0);
+	}
+}
+
+static __noreturn void futex_worker_fn(void *arg)
+{
+	struct futex_mutex *m = (struct futex_mutex *) arg;
+	unsigned int i;
+
+	for (i = 0; i < futex_ops_per_thread; i++) {
+		futex_mutex_lock(m);
+		uk_sched_yield();
+		futex_mutex_unlock(m);
+	}
+
+	uk_inc(&futex_done);
+	uk_sched_thread_exit();
+}
+
+static int futex_run_one(unsigned int nr_mutexes)
+{
+	struct uk_sched *s = uk_sched_current();
+	unsigned int i, nr_threads = 2 * nr_mutexes;
+	struct uk_thread *worker;
+	__nsec t0, total;
+	__u64 ops;
+
+	memset(futex_mutexes, 0, nr_mutexes * sizeof(*futex_mutexes));
+	futex_ops_per_thread = MAX(BENCH_ITERATIONS / nr_threads, 1U);
+	futex_done = 0;
+	futex_waits = 0;
+	futex_wakes = 0;
+
+	t0 = ukplat_monotonic_clock();
+	for (i = 0; i < nr_threads; i++) {
+		worker = uk_sched_thread_create(s, futex_worker_fn,
+						&futex_mutexes[i / 2],
+						"schedbench-futex");
+		if (unlikely(!worker)) {
+			/* Wait for the workers that were started */
+			nr_threads = i;
+			break;
+		}
+	}
+
+	while (UK_READ_ONCE(futex_done) < nr_threads)
+		uk_sched_thread_sleep(ukarch_time_usec_to_nsec(100));
+	total = ukplat_monotonic_clock() - t0;
+	bench_settle();
+
+	if (unlikely(nr_threads < 2 * nr_mutexes))
+		return -ENOMEM;
+
+	ops = (__u64) nr_threads * futex_ops_per_thread;
+	bench_printf("workload=futex mutexes=%u threads=%u ops=%"__PRIu64" total_ns=%"__PRInsec" ns_per_op=%"__PRInsec" waits=%"__PRIu64" wakes=%"__PRIu64"\n",
+		     nr_mutexes, nr_threads, ops, total,
+		     ops ? total / ops : 0, futex_waits, futex_wakes);
+	return 0;
+}
+
+static int futex_run(void)
+{
+	struct uk_alloc *a = uk_alloc_get_default();
+	unsigned int i;
+	int rc = 0;
+
+	futex_mutexes = uk_memalign(a, CACHE_LINE_SIZE,
+				    futex_levels[ARRAY_SIZE(futex_levels) - 1]
+				    * sizeof(*futex_mutexes));
+	if (unlikely(!futex_mutexes))
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(futex_levels); i++) {
+		rc = futex_run_one(futex_levels[i]);
+		if (unlikely(rc < 0))
+			break;
+	}
+
+	uk_free(a, futex_mutexes);
+	return rc;
+}
+#endif /* CONFIG_LIBPOSIX_FUTEX */
+
+#if CONFIG_LIBUKLOCK
+/*
+ * Throughput and fairness of locks under contention: 1, 2, 4 and 8
+ * threads acquire the same lock in a tight loop for a fixed time and
+ * increment a counter in the critical section.
+ */
+#define CONTEND_DURATION_NSEC	ukarch_time_msec_to_nsec(100)
+#define CONTEND_BATCH		64	/* acquisitions between clock reads */
+#define CONTEND_THREADS_MAX	8
+
+#if CONFIG_LIBUKLOCK_MCSLOCK
+#define SPIN_ALGO		"mcs"
+#elif CONFIG_LIBUKLOCK_TICKETLOCK
+#define SPIN_ALGO		"ticket"
+#else
+#define SPIN_ALGO		"tas"
+#endif
+
+#if CONFIG_LIBUKLOCK_MUTEX_ADAPTIVE
+#define MUTEX_ADAPTIVE		1
+#else
+#define MUTEX_ADAPTIVE		0
+#endif
+
+struct contend_worker {
+	__u64 acquisitions;
+	__u64 expected;		/* increments of contend_counter */
+	__u64 torn;		/* inconsistent reads */
+} __align(CACHE_LINE_SIZE);
+
+struct contend_result {
+	unsigned int threads;
+	__u64 acquisitions;
+	__u64 min, max;
+	__u64 lost;
+};
+
+static struct contend_worker contend_workers[CONTEND_THREADS_MAX];
+static __u64 contend_counter;	/* protected by the lock under test */
+static __u64 contend_shadow;	/* always equal to contend_counter */
+static volatile __nsec contend_end;
+static volatile unsigned int contend_ready;
+static volatile unsigned int contend_done;
+
+static uk_spinlock spin_lock = UK_SPINLOCK_INITIALIZER();
+
+/* Waits for the start signal, returns the end of the measurement */
+static __nsec contend_start(void)
+{
+	__nsec end;
+
+	uk_inc(&contend_ready);
+	while (!(end = UK_READ_ONCE(contend_end)))
+		uk_sched_yield();
+	return end;
+}
+
+static __noreturn void contend_finish(struct contend_worker *w, __u64 n,
+				      __u64 expected)
+{
+	w->acquisitions = n;
+	w->expected = expected;
+	uk_inc(&contend_done);
+	uk_sched_thread_exit();
+}
+
+static __noreturn void spin_worker_fn(void *arg)
+{
+	__nsec end = contend_start();
+	__u64 n = 0;
+	unsigned int i;
+
+	do {
+		for (i = 0; i < CONTEND_BATCH; i++) {
+			uk_spin_lock(&spin_lock);
+			contend_counter++;
+			uk_spin_unlock(&spin_lock);
+		}
+		n += CONTEND_BATCH;
+	} while (ukplat_monotonic_clock() < end);
+
+	contend_finish(arg, n, n);
+}
+
+static int contend_run_one(uk_thread_fn1_t fn, unsigned int nr_threads,
+			   struct contend_result *res)
+{
+	struct uk_sched *s = uk_sched_current();
+	struct uk_thread *worker;
+	unsigned int i;
+
+	memset(contend_workers, 0, sizeof(contend_workers));
+	contend_counter = 0;
+	contend_shadow = 0;
+	contend_end = 0;
+	contend_ready = 0;
+	contend_done = 0;
+
+	for (i = 0; i < nr_threads; i++) {
+		worker = uk_sched_thread_create(s, fn, &contend_workers[i],
+						"schedbench-contend");
+		if (unlikely(!worker)) {
+			/* Let the workers that were started finish */
+			nr_threads = i;
+			break;
+		}
+	}
+
+	/* Start all workers at the same time */
+	while (UK_READ_ONCE(contend_ready) < nr_threads)
+		uk_sched_thread_sleep(ukarch_time_usec_to_nsec(100));
+	UK_WRITE_ONCE(contend_end,
+		      ukplat_monotonic_clock() + CONTEND_DURATION_NSEC);
+
+	while (UK_READ_ONCE(contend_done) < nr_threads)
+		uk_sched_thread_sleep(ukarch_time_msec_to_nsec(1));
+	bench_settle();
+
+	if (unlikely(!nr_threads))
+		return -ENOMEM;
+
+	res->threads = nr_threads;
+	res->acquisitions = 0;
+	res->min = __U64_MAX;
+	res->max = 0;
+	res->lost = 0;
+	for (i = 0; i < nr_threads; i++) {
+		res->acquisitions += contend_workers[i].acquisitions;
+		res->min = MIN(res->min, contend_workers[i].acquisitions);
+		res->max = MAX(res->max, contend_workers[i].acquisitions);
+		res->lost += contend_workers[i].expected
+			     + contend_workers[i].torn;
+	}
+	res->lost -= contend_counter;
+	return 0;
+}
+
+/* fairness_x100 is the share of the slowest relative to the fastest
+ * thread; lost counts increments that were not mutually exclusive and
+ * reads that saw a partial update
+ */
+#define CONTEND_FMT							\
+	"threads=%u lcpus=%u acquisitions=%"__PRIu64" acq_per_sec=%"__PRIu64" fairness_x100=%"__PRIu64" lost=%"__PRIu64"\n"
+#define CONTEND_ARGS(res)						\
+	(res).threads, (unsigned int) ukplat_lcpu_count(),		\
+	(res).acquisitions,						\
+	(res).acquisitions * UKARCH_NSEC_PER_SEC / CONTEND_DURATION_NSEC, \
+	(res).max ? (res).min * 100 / (res).max : 0, (res).lost
+
+static int spinlock_run(void)
+{
+	unsigned int nr_lcpus = ukplat_lcpu_count();
+	struct contend_result res;
+	unsigned int k;
+	int rc = 0;
+
+	/* Spinning threads on the same LCPU only measure the scheduler */
+	for (k = 1; k <= MIN(nr_lcpus, (unsigned int) CONTEND_THREADS_MAX);
+	     k *= 2) {
+		rc = contend_run_one(spin_worker_fn, k, &res);
+		if (unlikely(rc < 0))
+			break;
+		bench_printf("workload=spinlock algo=%s " CONTEND_FMT,
+			     SPIN_ALGO, CONTEND_ARGS(res));
+	}
+	return rc;
+}
+
+#if CONFIG_LIBUKLOCK_MUTEX
+static struct uk_mutex contend_mutex =
+	UK_MUTEX_INITIALIZER(contend_mutex);
+
+static __noreturn void mutex_worker_fn(void *arg)
+{
+	__nsec end = contend_start();
+	__u64 n = 0;
+	unsigned int i;
+
+	do {
+		for (i = 0; i < CONTEND_BATCH; i++) {
+			uk_mutex_lock(&contend_mutex);
+			contend_counter++;
+			uk_mutex_unlock(&contend_mutex);
+		}
+		n += CONTEND_BATCH;
+	} while (ukplat_monotonic_clock() < end);
+
+	contend_finish(arg, n, n);
+}
+
+static int mutex_run(void)
+{
+	struct contend_result res;
+	unsigned int k;
+	int rc = 0;
+
+	for (k = 1; k <= CONTEND_THREADS_MAX; k *= 2) {
+		rc = contend_run_one(mutex_worker_fn, k, &res);
+		if (unlikely(rc < 0))
+			break;
+		bench_printf("workload=mutex adaptive=%d " CONTEND_FMT,
+			     MUTEX_ADAPTIVE,
+			     CONTEND_ARGS(res));
+	}
+	return rc;
+}
+#endif /* CONFIG_LIBUKLOCK_MUTEX */
+
+#if CONFIG_LIBUKLOCK_RWLOCK || CONFIG_LIBUKLOCK_BRLOCK
+/* One write in every batch of CONTEND_RW_BATCH acquisitions. Writers update
+ * contend_counter and contend_shadow, readers check that they are equal.
+ */
+#define CONTEND_RW_BATCH	100
+
+#define CONTEND_RW_WORKER(name, rlock, runlock, wlock, wunlock)		\
+static __noreturn void name(void *arg)					\
+{									\
+	struct contend_worker *w = (struct contend_worker *) arg;	\
+	__nsec end = contend_start();					\
+	__u64 n = 0;							\
+	unsigned int i;							\
+									\
+	do {								\
+		wlock;							\
+		contend_counter++;					\
+		contend_shadow++;					\
+		wunlock;						\
+		for (i = 1; i < CONTEND_RW_BATCH; i++) {		\
+			rlock;						\
+			if (unlikely(UK_READ_ONCE(contend_counter)	\
+				     != UK_READ_ONCE(contend_shadow)))	\
+				w->torn++;				\
+			runlock;					\
+		}							\
+		n += CONTEND_RW_BATCH;					\
+	} while (ukplat_monotonic_clock() < end);			\
+									\
+	contend_finish(w, n, n / CONTEND_RW_BATCH);			\
+}
+
+#if CONFIG_LIBUKLOCK_RWLOCK
+static struct uk_rwlock contend_rwlock;
+
+CONTEND_RW_WORKER(rwlock_worker_fn,
+		  uk_rwlock_rlock(&contend_rwlock),
+		  uk_rwlock_runlock(&contend_rwlock),
+		  uk_rwlock_wlock(&contend_rwlock),
+		  uk_rwlock_wunlock(&contend_rwlock))
+#endif /* CONFIG_LIBUKLOCK_RWLOCK */
+
+#if CONFIG_LIBUKLOCK_BRLOCK
+static struct uk_brlock contend_brlock;
+
+CONTEND_RW_WORKER(brlock_worker_fn,
+		  uk_brlock_rlock(&contend_brlock),
+		  uk_brlock_runlock(&contend_brlock),
+		  uk_brlock_wlock(&contend_brlock),
+		  uk_brlock_wunlock(&contend_brlock))
+#endif /* CONFIG_LIBUKLOCK_BRLOCK */
+
+static int rwlock_run(void)
+{
+	unsigned int nr_lcpus = ukplat_lcpu_count();
+	struct contend_result res;
+	unsigned int k;
+	int rc = 0;
+
+#if CONFIG_LIBUKLOCK_RWLOCK
+	uk_rwlock_init(&contend_rwlock);
+#endif /* CONFIG_LIBUKLOCK_RWLOCK */
+#if CONFIG_LIBUKLOCK_BRLOCK
+	uk_brlock_init(&contend_brlock);
+#endif /* CONFIG_LIBUKLOCK_BRLOCK */
+
+	/* Readers only contend on the lock itself across LCPUs */
+	for (k = 1; k <= MIN(nr_lcpus, (unsigned int) CONTEND_THREADS_MAX);
+	     k *= 2) {
+#if CONFIG_LIBUKLOCK_RWLOCK
+		rc = contend_run_one(rwlock_worker_fn, k, &res);
+		if (unlikely(rc < 0))
+			break;
+		bench_printf("workload=rwlock lock=rwlock " CONTEND_FMT,
+			     CONTEND_ARGS(res));
+#endif /* CONFIG_LIBUKLOCK_RWLOCK */
+#if CONFIG_LIBUKLOCK_BRLOCK
+		rc = contend_run_one(brlock_worker_fn, k, &res);
+		if (unlikely(rc < 0))
+			break;
+		bench_printf("workload=rwlock lock=brlock " CONTEND_FMT,
+			     CONTEND_ARGS(res));
+#endif /* CONFIG_LIBUKLOCK_BRLOCK */
+	}
+	return rc;
+}
+#endif /* CONFIG_LIBUKLOCK_RWLOCK || CONFIG_LIBUKLOCK_BRLOCK */
+
+#if CONFIG_LIBVFSCORE
+/* Every worker resolves its own file, so that only the dentry cache is
+ * shared between them
+ */
+static char dentry_paths[CONTEND_THREADS_MAX][32];
+
+static __noreturn void dentry_worker_fn(void *arg)
+{
+	struct contend_worker *w = (struct contend_worker *) arg;
+	const char *path = dentry_paths[w - contend_workers];
+	__nsec end = contend_start();
+	struct stat st;
+	__u64 n = 0;
+	unsigned int i;
+
+	do {
+		for (i = 0; i < CONTEND_BATCH; i++) {
+			if (unlikely(stat(path, &st) < 0))
+				w->torn++;
+		}
+		n += CONTEND_BATCH;
+	} while (ukplat_monotonic_clock() < end);
+
+	contend_finish(w, n, 0);
+}
+
+static int dentry_run(void)
+{
+	unsigned int nr_lcpus = ukplat_lcpu_count();
+	struct contend_result res;
+	unsigned int i, k;
+	int fd, rc = 0;
+
+	for (i = 0; i < CONTEND_THREADS_MAX; i++) {
+		snprintf(dentry_paths[i], sizeof(dentry_paths[i]),
+			 "/schedbench-dentry-%u", i);
+		fd = open(dentry_paths[i], O_CREAT | O_RDWR, 0600);
+		if (unlikely(fd < 0)) {
+			bench_printf("workload=dentry skipped=1\n");
+			goto out;
+		}
+		close(fd);
+	}
+
+	/* Lookups only contend on the dentry cache across LCPUs */
+	for (k = 1; k <= MIN(nr_lcpus, (unsigned int) CONTEND_THREADS_MAX);
+	     k *= 2) {
+		rc = contend_run_one(dentry_worker_fn, k, &res);
+		if (unlikely(rc < 0))
+			break;
+		bench_printf("workload=dentry " CONTEND_FMT,
+			     CONTEND_ARGS(res));
+	}
+
+out:
+	while (i--)
+		unlink(dentry_paths[i]);
+	return rc;
+}
+#endif /* CONFIG_LIBVFSCORE */
+#endif /* CONFIG_LIBUKLOCK */
+
+int uk_schedbench_run(void)
+{
+	int rc;
+
+	if (unlikely(!uk_sched_current())) {
+		uk_pr_err("No scheduler available\n");
+		return -ENODEV;
+	}
+
+	bench_printf("version=1 iterations=%u\n",
+		     (unsigned int) BENCH_ITERATIONS);
+
+	rc = yield_run(&ctx);
+	if (unlikely(rc < 0))
+		return rc;
+
+	rc = latency_run(&ctx);
+	if (unlikely(rc < 0))
+		return rc;
+
+	rc = create_run(&ctx);
+	if (unlikely(rc < 0))
+		return rc;
+
+#if CONFIG_LIBUKFIBER
+	rc = fiber_pingpong_run(&ctx);
+	if (unlikely(rc < 0))
+		return rc;
+#endif /* CONFIG_LIBUKFIBER */
+
+#if CONFIG_LIBPOSIX_FUTEX
+	rc = futex_run();
+	if (unlikely(rc < 0))
+		return rc;
+#endif /* CONFIG_LIBPOSIX_FUTEX */
+
+#if CONFIG_LIBUKLOCK
+	rc = spinlock_run();
+	if (unlikely(rc < 0))
+		return rc;
+
+#if CONFIG_LIBUKLOCK_MUTEX
+	rc = mutex_run();
+	if (unlikely(rc < 0))
+		return rc;
+#endif /* CONFIG_LIBUKLOCK_MUTEX */
+
+#if CONFIG_LIBUKLOCK_RWLOCK || CONFIG_LIBUKLOCK_BRLOCK
+	rc = rwlock_run();
+	if (unlikely(rc < 0))
+		return rc;
+#endif /* CONFIG_LIBUKLOCK_RWLOCK || CONFIG_LIBUKLOCK_BRLOCK */
+
+#if CONFIG_LIBVFSCORE
+	rc = dentry_run();
+	if (unlikely(rc < 0))
+		return rc;
+#endif /* CONFIG_LIBVFSCORE */
+#endif /* CONFIG_LIBUKLOCK */
+
+	return scale_run();
+}
+
+#if CONFIG_LIBUKSCHEDBENCH_AUTORUN
+static int schedbench_autorun(struct uk_init_ctx *ictx __unused)
+{
+	/* A failing benchmark should not stop the boot */
+	uk_schedbench_run();
+	return 0;
+}
+
+uk_late_initcall(schedbench_autorun, 0x0);
+#endif /* CONFIG_LIBUKSCHEDBENCH_AUTORUN */
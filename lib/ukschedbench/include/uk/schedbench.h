@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+#ifndef __UKSCHEDBENCH_H__
+#define __UKSCHEDBENCH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Run all scheduler workloads on the scheduler of the calling thread.
+ * Every workload prints one line of the form:
+ *
+ *   schedbench: workload=<name> ...
+ *
+ * Workload `yield`: Two threads yield to each other while a number of
+ * threads sleep with distinct timeouts in the background. The following
+ * keys are printed:
+ *   sleepers             Number of sleeping threads
+ *   ops                  Number of round trips (two yields each)
+ *   total_ns,
+ *   ns_per_yield         Time of all round trips and of a single yield
+ *   p50_ns, p90_ns,
+ *   p99_ns, max_ns       Latency percentiles of single round trips
+ *
+ * Workload `latency`: A thread sleeps repeatedly for one millisecond while
+ * another thread spins for up to one second without yielding. Only a
+ * preemptive scheduler wakes the sleeper on time. The following keys are
+ * printed:
+ *   samples              Number of sleeps
+ *   p50_ns, p99_ns,
+ *   max_ns               Percentiles of the delay after the requested
+ *                        wakeup time
+ *   preempted            Number of times the spinner was preempted
+ *
+ * Workload `create`: Threads are created in batches and exit right away.
+ * The runner waits until they were released before the next batch, so
+ * that a thread cache (LIBUKSCHED_THREAD_CACHE) can serve the next batch.
+ * The following keys are printed:
+ *   threads              Number of created threads
+ *   total_ns,
+ *   ns_per_create        Time of all creations and of a single one
+ *   p50_ns, p99_ns,
+ *   max_ns               Latency percentiles of single creations
+ *   cache_hits,
+ *   cache_misses         Creations served by the thread cache or not
+ *                        (0 without thread cache)
+ *
+ * Workload `fiber_pingpong` (only with LIBUKFIBER): Two fibers of the
+ * calling thread switch to each other with `uk_fiber_switch()`. The
+ * printed keys are the same as for `yield`, without `sleepers` and with
+ * `ns_per_switch` instead of `ns_per_yield`.
+ *
+ * Workload `futex` (only with LIBPOSIX_FUTEX): Pairs of threads lock and
+ * unlock a futex-based mutex and yield while holding it, so that most
+ * acquisitions wait on the futex. It is run with 1, 16 and 256 independent
+ * mutexes. The following keys are printed:
+ *   mutexes              Number of mutexes
+ *   threads              Number of threads (two per mutex)
+ *   ops                  Number of lock/unlock pairs of all threads
+ *   total_ns,
+ *   ns_per_op            Time until all threads finished and per pair
+ *   waits, wakes         Number of FUTEX_WAIT and FUTEX_WAKE calls
+ *
+ * Workload `spinlock` (only with LIBUKLOCK): 1, 2, 4 and 8 threads, up to
+ * the number of logical CPUs, acquire and release the same `uk_spinlock`
+ * in a loop for 100ms. The following keys are printed:
+ *   algo                 Spinlock algorithm: tas, ticket or mcs
+ *   threads              Number of threads
+ *   lcpus                Number of logical CPUs
+ *   acquisitions,
+ *   acq_per_sec          Acquisitions of all threads, in total and per
+ *                        second
+ *   fairness_x100        Acquisitions of the slowest thread relative to
+ *                        the fastest one, in percent
+ *   lost                 Increments in the critical section that were
+ *                        lost; non-zero means the lock is broken
+ *
+ * Workload `mutex` (only with LIBUKLOCK_MUTEX): Like `spinlock` with a
+ * `uk_mutex` and always with 1, 2, 4 and 8 threads. Instead of `algo`, the
+ * following key is printed:
+ *   adaptive             1 if contended threads spin before they block
+ *                        (LIBUKLOCK_MUTEX_ADAPTIVE), 0 otherwise
+ *
+ * Workload `rwlock` (only with LIBUKLOCK_RWLOCK or LIBUKLOCK_BRLOCK): Like
+ * `spinlock` with a read-mostly mix of 99 read locks for every write lock,
+ * run once with `uk_rwlock` and once with `uk_brlock`. Instead of `algo`,
+ * the following key is printed:
+ *   lock                 Lock under test: rwlock or brlock
+ * `lost` also counts reads that saw a partial update.
+ *
+ * Workload `dentry` (only with LIBVFSCORE): Like `spinlock`, but every
+ * thread calls `stat()` on its own file in the root directory, so that
+ * the threads only share the dentry cache. `acquisitions` counts path
+ * lookups and `lost` failed ones. `skipped=1` is printed instead if the
+ * files cannot be created.
+ *
+ * Workload `scale`: A number of independent threads do the same amount of
+ * computation and yield in between. It is run with 1, 2, 4, ... threads up
+ * to twice the number of logical CPUs. The following keys are printed:
+ *   threads              Number of worker threads
+ *   lcpus                Number of logical CPUs
+ *   ops                  Number of operations of all workers
+ *   total_ns             Time until all workers finished
+ *   ops_per_sec          Throughput of all workers
+ *   speedup_x100         Throughput relative to a single worker, in percent
+ *
+ * @return
+ *   0 on success, negative errno if a workload could not be set up
+ */
+int uk_schedbench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UKSCHEDBENCH_H__ */
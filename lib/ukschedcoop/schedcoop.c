@@ -36,12 +36,15 @@
 #include <uk/sched_impl.h>
 #include <uk/schedcoop.h>
 #include <uk/essentials.h>
+#if CONFIG_LIBUKVMEM_ZPOOL
+#include <uk/vmem.h>
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
 #include "schedcoop.h"
 
 static void schedcoop_schedule(struct uk_sched *s)
 {
 	struct schedcoop *c = uksched2schedcoop(s);
-	struct uk_thread *prev, *next, *thread, *tmp;
+	struct uk_thread *prev, *next, *thread;
 	__snsec now, min_wakeup_time;
 	unsigned long flags;
 
@@ -65,20 +68,23 @@ static void schedcoop_schedule(struct uk_sched *s)
 	prev->exec_time += now - c->ts_prev_switch;
 	c->ts_prev_switch = now;
 
-	/* Examine all sleeping threads.
-	 * Wake up expired ones and find the time when the next timeout expires.
+	/* Wake up expired threads. The sleep queue is sorted by wakeup time,
+	 * so we only touch expired threads and the first one that is not.
 	 */
-	min_wakeup_time = 0;
-	UK_TAILQ_FOREACH_SAFE(thread, &c->sleep_queue,
-			      queue, tmp) {
-		if (likely(thread->wakeup_time)) {
-			if (thread->wakeup_time <= now)
-				uk_thread_wake(thread);
-			else if (!min_wakeup_time
-				 || thread->wakeup_time < min_wakeup_time)
-				min_wakeup_time = thread->wakeup_time;
+	while ((thread = uk_sched_sleepq_first(&c->sleep_queue))
+	       && thread->_sleep.until <= now) {
+		uk_sched_sleepq_remove(&c->sleep_queue, thread);
+
+		/* The wakeup time might have been changed while sleeping */
+		if (unlikely(thread->wakeup_time > now)) {
+			uk_sched_sleepq_insert(&c->sleep_queue, thread);
+			continue;
 		}
+		if (likely(thread->wakeup_time))
+			uk_thread_wake(thread);
 	}
+	thread = uk_sched_sleepq_first(&c->sleep_queue);
+	min_wakeup_time = thread ? thread->_sleep.until : 0;
 
 	next = UK_TAILQ_FIRST(&c->run_queue);
 	if (next) {
@@ -115,6 +121,7 @@ static void schedcoop_schedule(struct uk_sched *s)
 		 */
 		uk_thread_set_queueable(prev);
 		uk_thread_clear_queueable(next);
+		uk_preempt_disable();
 	}
 
 	ukplat_lcpu_restore_irqf(flags);
@@ -148,6 +155,9 @@ static void schedcoop_thread_remove(struct uk_sched *s, struct uk_thread *t)
 	if (t != uk_thread_current()
 	    && uk_thread_is_runnable(t))
 		UK_TAILQ_REMOVE(&c->run_queue, t, queue);
+
+	/* Remove from sleep queue */
+	uk_sched_sleepq_remove(&c->sleep_queue, t);
 }
 
 static void schedcoop_thread_blocked(struct uk_sched *s, struct uk_thread *t)
@@ -158,19 +168,37 @@ static void schedcoop_thread_blocked(struct uk_sched *s, struct uk_thread *t)
 
 	if (t != uk_thread_current())
 		UK_TAILQ_REMOVE(&c->run_queue, t, queue);
-	if (t->wakeup_time > 0)
-		UK_TAILQ_INSERT_TAIL(&c->sleep_queue, t, queue);
+	if (t->wakeup_time > 0) {
+		uk_sched_sleepq_remove(&c->sleep_queue, t);
+		uk_sched_sleepq_insert(&c->sleep_queue, t);
+	}
 }
 
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+/* Called by the polling idle thread with interrupts enabled */
+static int schedcoop_has_work(void *arg)
+{
+	struct schedcoop *c = (struct schedcoop *) arg;
+
+	return UK_READ_ONCE(UK_TAILQ_FIRST(&c->run_queue)) != NULL;
+}
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
 static __noreturn void idle_thread_fn(void *argp)
 {
 	struct schedcoop *c = (struct schedcoop *) argp;
 	__nsec now, wake_up_time;
 	unsigned long flags;
+#if CONFIG_LIBUKVMEM_ZPOOL
+	bool zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
 
 	UK_ASSERT(c);
 
 	for (;;) {
+		/* The idle thread holds no RCU read-side references */
+		uk_sched_qs_report();
+
 		flags = ukplat_lcpu_save_irqf();
 
 		/*
@@ -196,15 +224,48 @@ static __noreturn void idle_thread_fn(void *argp)
 			continue;
 		}
 
+#if CONFIG_LIBUKVMEM_ZPOOL
+		/* Zero frames for anonymous page faults instead of halting.
+		 * Interrupts are enabled in between, so that a woken thread
+		 * is delayed by at most one batch. If no frame could be
+		 * zeroed, we halt until the next interrupt before trying
+		 * again.
+		 */
+		if (zpool_fill && uk_vmem_zpool_needs_fill()) {
+			ukplat_lcpu_restore_irqf(flags);
+			zpool_fill = uk_vmem_zpool_fill(
+					UK_VMEM_ZPOOL_FILL_BATCH) > 0;
+			schedcoop_schedule(&c->sched);
+
+			continue;
+		}
+		zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
 		/* Read return time set by last schedule operation */
 		wake_up_time = (volatile __nsec) c->idle_return_time;
 		now = ukplat_monotonic_clock();
 
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+		/* Spin for a while before halting, see <uk/sched_idle.h> */
+		if ((!wake_up_time || wake_up_time > now) &&
+		    uk_sched_idle_poll(schedcoop_has_work, c, wake_up_time)) {
+			ukplat_lcpu_restore_irqf(flags);
+			schedcoop_schedule(&c->sched);
+
+			continue;
+		}
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
 		if (!wake_up_time || wake_up_time > now) {
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+			uk_sched_idle_halt_irq_until(wake_up_time);
+#else /* !CONFIG_LIBUKSCHED_IDLE_POLL */
 			if (wake_up_time)
 				ukplat_lcpu_halt_irq_until(wake_up_time);
 			else
 				ukplat_lcpu_halt_irq();
+#endif /* !CONFIG_LIBUKSCHED_IDLE_POLL */
 
 			/* handle pending events if any */
 			ukplat_lcpu_irqs_handle_pending();
@@ -269,7 +330,7 @@ struct uk_sched *uk_schedcoop_create(struct uk_alloc *a,
 		goto err_out;
 
 	UK_TAILQ_INIT(&c->run_queue);
-	UK_TAILQ_INIT(&c->sleep_queue);
+	uk_sched_sleepq_init(&c->sleep_queue);
 
 	/* Create idle thread */
 	rc = uk_thread_init_fn1(&c->idle,
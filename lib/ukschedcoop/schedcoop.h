@@ -7,11 +7,12 @@
 #define __UK_SCHEDCOOP_SCHEDCOOP_H__
 
 #include <uk/schedcoop.h>
+#include <uk/sched_impl.h>
 
 struct schedcoop {
 	struct uk_sched sched;
 	struct uk_thread_list run_queue;
-	struct uk_thread_list sleep_queue;
+	struct uk_sched_sleepq sleep_queue;
 
 	struct uk_thread idle;
 	__nsec idle_return_time;
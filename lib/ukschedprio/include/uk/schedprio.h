@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * Non-preemptive (cooperative) scheduler with fixed priorities and
+ * optionally earliest deadline first (EDF) scheduling.
+ *
+ * The runnable thread with the highest precedence is scheduled when the
+ * current thread yields or blocks:
+ *   1. UK_SCHED_DEADLINE threads, by earliest absolute deadline
+ *   2. UK_SCHED_FIFO and UK_SCHED_RR threads, by static priority
+ *      (UK_SCHED_PRIO_MAX first)
+ *   3. Threads with a normal policy. UK_SCHED_IDLE and UK_SCHED_BATCH
+ *      are treated like UK_SCHED_OTHER.
+ * Threads of the same precedence are scheduled Round-Robin. A yield puts
+ * the thread to the end of its priority. Because there is no preemption,
+ * UK_SCHED_RR behaves like UK_SCHED_FIFO.
+ *
+ * A deadline thread starts a new instance when it is woken up after its
+ * absolute deadline passed and when it yields. The absolute deadline of the
+ * new instance is advanced by the period, but to at least the relative
+ * deadline from now.
+ */
+
+#ifndef __UK_SCHEDPRIO_H__
+#define __UK_SCHEDPRIO_H__
+
+#include <uk/sched.h>
+#include <uk/alloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct uk_sched *uk_schedprio_create(struct uk_alloc *a,
+				     struct uk_alloc *sa,
+				     struct uk_alloc *auxsa,
+				     struct uk_alloc *tls_a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_SCHEDPRIO_H__ */
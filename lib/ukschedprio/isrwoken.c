@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <uk/plat/time.h>
+#include "schedprio.h"
+
+void schedprio_thread_woken_isr(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedprio *c = uksched2schedprio(s);
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	__snsec now;
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	uk_sched_sleepq_remove(&c->sleep_queue, t);
+
+	/* The current thread is queued by the next scheduling decision */
+	if (t == c->current || t->_rq.queued || !uk_thread_is_runnable(t))
+		return;
+
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (schedprio_is_dl(t)) {
+		now = (__snsec) ukplat_monotonic_clock();
+		if (t->_rq.deadline <= now)
+			schedprio_dl_renew(t, now);
+	}
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+	schedprio_enqueue(c, t);
+}
@@ -0,0 +1,382 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * The scheduler is non-preemptive (cooperative) and runs on a single
+ * logical CPU. On each scheduling decision, it selects the deadline thread
+ * with the earliest deadline, then the real-time thread with the highest
+ * static priority, and only then the next thread with a normal policy.
+ */
+#include <errno.h>
+#include <uk/plat/config.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/memory.h>
+#include <uk/plat/time.h>
+#include <uk/sched_impl.h>
+#include <uk/schedprio.h>
+#include <uk/essentials.h>
+#if CONFIG_LIBUKVMEM_ZPOOL
+#include <uk/vmem.h>
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+#include "schedprio.h"
+
+static void schedprio_schedule(struct uk_sched *s)
+{
+	struct schedprio *c = uksched2schedprio(s);
+	struct uk_thread *prev, *next, *thread;
+	__snsec now, min_wakeup_time;
+	unsigned long flags;
+
+	if (unlikely(ukplat_lcpu_irqs_disabled()))
+		UK_CRASH("Must not call %s with IRQs disabled\n", __func__);
+
+	now = ukplat_monotonic_clock();
+	prev = uk_thread_current();
+	flags = ukplat_lcpu_save_irqf();
+
+	/* Update execution time of current thread */
+	prev->exec_time += now - c->ts_prev_switch;
+	c->ts_prev_switch = now;
+
+	/* Wake up expired threads. The sleep queue is sorted by wakeup time,
+	 * so we only touch expired threads and the first one that is not.
+	 */
+	while ((thread = uk_sched_sleepq_first(&c->sleep_queue))
+	       && thread->_sleep.until <= now) {
+		uk_sched_sleepq_remove(&c->sleep_queue, thread);
+
+		/* The wakeup time might have been changed while sleeping */
+		if (unlikely(thread->wakeup_time > now)) {
+			uk_sched_sleepq_insert(&c->sleep_queue, thread);
+			continue;
+		}
+		if (likely(thread->wakeup_time))
+			uk_thread_wake(thread);
+	}
+	thread = uk_sched_sleepq_first(&c->sleep_queue);
+	min_wakeup_time = thread ? thread->_sleep.until : 0;
+
+	/* Put the previous thread at the end of its queue, so that it
+	 * competes with the queued threads. A deadline thread that gives up
+	 * the CPU has completed its current instance.
+	 */
+	if ((prev != &c->idle)
+	    && uk_thread_is_runnable(prev)
+	    && !uk_thread_is_exited(prev)
+	    && !prev->_rq.queued) {
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+		if (schedprio_is_dl(prev))
+			schedprio_dl_renew(prev, now);
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+		schedprio_enqueue(c, prev);
+	}
+
+	next = schedprio_first(c);
+	if (next) {
+		UK_ASSERT(uk_thread_is_runnable(next));
+		UK_ASSERT(!uk_thread_is_exited(next));
+		schedprio_dequeue(c, next);
+	} else {
+		/*
+		 * Schedule idle thread that will halt the CPU
+		 * We select the idle thread only if we do not have anything
+		 * else to execute
+		 */
+		c->idle_return_time = min_wakeup_time;
+		next = &c->idle;
+	}
+	c->current = next;
+
+	if (next != prev) {
+		/*
+		 * Queueable is used to cover the case when during a
+		 * context switch, the thread that is about to be
+		 * evacuated is interrupted and woken up.
+		 */
+		uk_thread_set_queueable(prev);
+		uk_thread_clear_queueable(next);
+		uk_preempt_disable();
+	}
+
+	ukplat_lcpu_restore_irqf(flags);
+
+	/* Interrupting the switch is equivalent to having the next thread
+	 * interrupted at the return instruction. And therefore at safe point.
+	 */
+	if (prev != next)
+		uk_sched_thread_switch(next);
+}
+
+static int schedprio_thread_add(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedprio *c = uksched2schedprio(s);
+	unsigned long flags;
+
+	UK_ASSERT(t);
+	UK_ASSERT(!uk_thread_is_exited(t));
+
+	/* Add to run queue if runnable */
+	flags = ukplat_lcpu_save_irqf();
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (schedprio_is_dl(t))
+		t->_rq.deadline = (__snsec) ukplat_monotonic_clock()
+				  + (__snsec) t->sched_param.deadline;
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+	if (uk_thread_is_runnable(t) && t != c->current)
+		schedprio_enqueue(c, t);
+	ukplat_lcpu_restore_irqf(flags);
+
+	return 0;
+}
+
+static void schedprio_thread_remove(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedprio *c = uksched2schedprio(s);
+	unsigned long flags;
+
+	flags = ukplat_lcpu_save_irqf();
+	schedprio_dequeue(c, t);
+	uk_sched_sleepq_remove(&c->sleep_queue, t);
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+static void schedprio_thread_blocked(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedprio *c = uksched2schedprio(s);
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	schedprio_dequeue(c, t);
+	if (t->wakeup_time > 0) {
+		uk_sched_sleepq_remove(&c->sleep_queue, t);
+		uk_sched_sleepq_insert(&c->sleep_queue, t);
+	}
+}
+
+static int schedprio_thread_set_policy(struct uk_sched *s,
+				       struct uk_thread *t,
+				       const struct uk_sched_attr *attr)
+{
+	struct schedprio *c = uksched2schedprio(s);
+	bool queued;
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	if (t == &c->idle)
+		return -EPERM;
+#if !CONFIG_LIBUKSCHEDPRIO_EDF
+	if (attr->sched_policy == UK_SCHED_DEADLINE)
+		return -EPERM;
+#endif /* !CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	/* Requeue the thread according to its new policy */
+	queued = t->_rq.queued;
+	schedprio_dequeue(c, t);
+	uk_sched_thread_policy_store(t, attr);
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (schedprio_is_dl(t))
+		t->_rq.deadline = (__snsec) ukplat_monotonic_clock()
+				  + (__snsec) t->sched_param.deadline;
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+	if (queued)
+		schedprio_enqueue(c, t);
+
+	return 0;
+}
+
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+/* Called by the polling idle thread with interrupts enabled */
+static int schedprio_has_work(void *arg)
+{
+	struct schedprio *c = (struct schedprio *) arg;
+
+	return schedprio_first(c) != NULL;
+}
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
+static __noreturn void idle_thread_fn(void *argp)
+{
+	struct schedprio *c = (struct schedprio *) argp;
+	__nsec now, wake_up_time;
+	unsigned long flags;
+#if CONFIG_LIBUKVMEM_ZPOOL
+	bool zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
+	UK_ASSERT(c);
+
+	for (;;) {
+		/* The idle thread holds no RCU read-side references */
+		uk_sched_qs_report();
+
+		flags = ukplat_lcpu_save_irqf();
+
+		/*
+		 * NOTE: Like with the cooperative scheduler, we assume that
+		 *       `uk_sched_thread_gc()` is non-blocking. This idle
+		 *       thread must be non-blocking so that the scheduler has
+		 *       always something to schedule.
+		 */
+		if (uk_sched_thread_gc(&c->sched) > 0 || schedprio_first(c)) {
+			/* We collected successfully some garbage or there is
+			 * a runnable thread in the queue.
+			 * Check if something else can be scheduled now.
+			 */
+			ukplat_lcpu_restore_irqf(flags);
+			schedprio_schedule(&c->sched);
+
+			continue;
+		}
+
+#if CONFIG_LIBUKVMEM_ZPOOL
+		/* Zero frames for anonymous page faults instead of halting.
+		 * Interrupts are enabled in between, so that a woken thread
+		 * is delayed by at most one batch. If no frame could be
+		 * zeroed, we halt until the next interrupt before trying
+		 * again.
+		 */
+		if (zpool_fill && uk_vmem_zpool_needs_fill()) {
+			ukplat_lcpu_restore_irqf(flags);
+			zpool_fill = uk_vmem_zpool_fill(
+					UK_VMEM_ZPOOL_FILL_BATCH) > 0;
+			schedprio_schedule(&c->sched);
+
+			continue;
+		}
+		zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
+		/* Read return time set by last schedule operation */
+		wake_up_time = (volatile __nsec) c->idle_return_time;
+		now = ukplat_monotonic_clock();
+
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+		/* Spin for a while before halting, see <uk/sched_idle.h> */
+		if ((!wake_up_time || wake_up_time > now) &&
+		    uk_sched_idle_poll(schedprio_has_work, c, wake_up_time)) {
+			ukplat_lcpu_restore_irqf(flags);
+			schedprio_schedule(&c->sched);
+
+			continue;
+		}
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
+		if (!wake_up_time || wake_up_time > now) {
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+			uk_sched_idle_halt_irq_until(wake_up_time);
+#else /* !CONFIG_LIBUKSCHED_IDLE_POLL */
+			if (wake_up_time)
+				ukplat_lcpu_halt_irq_until(wake_up_time);
+			else
+				ukplat_lcpu_halt_irq();
+#endif /* !CONFIG_LIBUKSCHED_IDLE_POLL */
+
+			/* handle pending events if any */
+			ukplat_lcpu_irqs_handle_pending();
+		}
+
+		ukplat_lcpu_restore_irqf(flags);
+
+		/* try to schedule a thread that might now be available */
+		schedprio_schedule(&c->sched);
+	}
+}
+
+static int schedprio_start(struct uk_sched *s,
+			   struct uk_thread *main_thread __maybe_unused)
+{
+	struct schedprio *c = uksched2schedprio(s);
+
+	UK_ASSERT(main_thread);
+	UK_ASSERT(main_thread->sched == s);
+	UK_ASSERT(uk_thread_is_runnable(main_thread));
+	UK_ASSERT(!uk_thread_is_exited(main_thread));
+	UK_ASSERT(uk_thread_current() == main_thread);
+
+	/* Since we are now starting to schedule, we save the current timestamp
+	 * as the start time for the first time slice.
+	 */
+	c->ts_prev_switch = ukplat_monotonic_clock();
+
+	/* NOTE: `main_thread` is running and thus not queued. It is queued
+	 *       as soon as a different thread is scheduled.
+	 */
+	c->current = main_thread;
+
+	ukplat_lcpu_enable_irq();
+
+	return 0;
+}
+
+static const struct uk_thread *schedprio_idle_thread(struct uk_sched *s,
+						     unsigned int proc_id)
+{
+	struct schedprio *c = uksched2schedprio(s);
+
+	/* NOTE: We only support one processing LCPU */
+	if (proc_id > 0)
+		return NULL;
+
+	return &(c->idle);
+}
+
+struct uk_sched *uk_schedprio_create(struct uk_alloc *a,
+				     struct uk_alloc *sa,
+				     struct uk_alloc *auxsa,
+				     struct uk_alloc *tls_a)
+{
+	struct schedprio *c = NULL;
+	unsigned int i;
+	int rc;
+
+	uk_pr_info("Initializing priority scheduler\n");
+	c = uk_zalloc(a, sizeof(struct schedprio));
+	if (!c)
+		goto err_out;
+
+	for (i = 0; i < SCHEDPRIO_NR_LEVELS; ++i)
+		UK_TAILQ_INIT(&c->run_queue[i]);
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	UK_TAILQ_INIT(&c->dl_queue);
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+	uk_sched_sleepq_init(&c->sleep_queue);
+
+	/* Create idle thread */
+	rc = uk_thread_init_fn1(&c->idle,
+				idle_thread_fn, (void *) c,
+				sa, STACK_SIZE,
+				auxsa, AUXSTACK_SIZE,
+				a, false,
+				NULL,
+				"idle",
+				NULL,
+				NULL);
+	if (rc < 0)
+		goto err_free_c;
+
+	c->idle.sched = &c->sched;
+
+	uk_sched_init(&c->sched,
+			schedprio_start,
+			schedprio_schedule,
+			schedprio_thread_add,
+			schedprio_thread_remove,
+			schedprio_thread_blocked,
+			schedprio_thread_woken_isr,
+			schedprio_thread_woken_isr,
+			schedprio_idle_thread,
+			a, sa, auxsa, tls_a);
+	c->sched.thread_set_policy = schedprio_thread_set_policy;
+
+	/* Add idle thread to the scheduler's thread list */
+	UK_TAILQ_INSERT_TAIL(&c->sched.thread_list, &c->idle, thread_list);
+
+	return &c->sched;
+
+err_free_c:
+	uk_free(a, c);
+err_out:
+	return NULL;
+}
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#ifndef __UK_SCHEDPRIO_SCHEDPRIO_H__
+#define __UK_SCHEDPRIO_SCHEDPRIO_H__
+
+#include <uk/schedprio.h>
+#include <uk/sched_impl.h>
+#include <uk/bitops.h>
+#include <uk/essentials.h>
+
+/* Level 0 holds the threads with a normal policy */
+#define SCHEDPRIO_NR_LEVELS	(UK_SCHED_PRIO_MAX + 1)
+#define SCHEDPRIO_LEVEL_BITS	(sizeof(unsigned long) * 8)
+#define SCHEDPRIO_LEVEL_WORDS	DIV_ROUND_UP(SCHEDPRIO_NR_LEVELS,	\
+					     SCHEDPRIO_LEVEL_BITS)
+
+struct schedprio {
+	struct uk_sched sched;
+	/* One run queue per static priority and a bitmap of the non-empty
+	 * ones, so that the highest priority is found in O(1)
+	 */
+	struct uk_thread_list run_queue[SCHEDPRIO_NR_LEVELS];
+	unsigned long levels[SCHEDPRIO_LEVEL_WORDS];
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	/* Sorted by absolute deadline */
+	struct uk_thread_list dl_queue;
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+	struct uk_sched_sleepq sleep_queue;
+
+	/* Thread that was selected by the last scheduling decision */
+	struct uk_thread *current;
+
+	struct uk_thread idle;
+	__nsec idle_return_time;
+	__nsec ts_prev_switch;
+};
+
+static inline struct schedprio *uksched2schedprio(struct uk_sched *s)
+{
+	UK_ASSERT(s);
+
+	return __containerof(s, struct schedprio, sched);
+}
+
+static inline unsigned int schedprio_level(const struct uk_thread *t)
+{
+	switch (t->sched_param.policy) {
+	case UK_SCHED_FIFO:
+	case UK_SCHED_RR:
+		return t->sched_param.prio;
+	default:
+		/* UK_SCHED_BATCH and UK_SCHED_IDLE are not ranked below
+		 * UK_SCHED_OTHER: all normal threads share level 0
+		 */
+		return 0;
+	}
+}
+
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+static inline bool schedprio_is_dl(const struct uk_thread *t)
+{
+	return t->sched_param.policy == UK_SCHED_DEADLINE;
+}
+
+/* Starts a new instance of a deadline thread */
+static inline void schedprio_dl_renew(struct uk_thread *t, __snsec now)
+{
+	__snsec next = t->_rq.deadline + (__snsec) t->sched_param.period;
+
+	t->_rq.deadline = MAX(next, now + (__snsec) t->sched_param.deadline);
+}
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+static inline void schedprio_enqueue(struct schedprio *c, struct uk_thread *t)
+{
+	unsigned int lvl;
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	struct uk_thread *itr;
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	UK_ASSERT(!t->_rq.queued);
+
+	t->_rq.queued = true;
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (schedprio_is_dl(t)) {
+		/* Deadline threads are few, a sorted list is sufficient */
+		UK_TAILQ_FOREACH(itr, &c->dl_queue, queue) {
+			if (itr->_rq.deadline > t->_rq.deadline) {
+				UK_TAILQ_INSERT_BEFORE(itr, t, queue);
+				return;
+			}
+		}
+		UK_TAILQ_INSERT_TAIL(&c->dl_queue, t, queue);
+		return;
+	}
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	lvl = schedprio_level(t);
+	UK_TAILQ_INSERT_TAIL(&c->run_queue[lvl], t, queue);
+	c->levels[lvl / SCHEDPRIO_LEVEL_BITS] |=
+		1UL << (lvl % SCHEDPRIO_LEVEL_BITS);
+}
+
+static inline void schedprio_dequeue(struct schedprio *c, struct uk_thread *t)
+{
+	unsigned int lvl;
+
+	if (!t->_rq.queued)
+		return;
+
+	t->_rq.queued = false;
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (schedprio_is_dl(t)) {
+		UK_TAILQ_REMOVE(&c->dl_queue, t, queue);
+		return;
+	}
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	lvl = schedprio_level(t);
+	UK_TAILQ_REMOVE(&c->run_queue[lvl], t, queue);
+	if (UK_TAILQ_EMPTY(&c->run_queue[lvl]))
+		c->levels[lvl / SCHEDPRIO_LEVEL_BITS] &=
+			~(1UL << (lvl % SCHEDPRIO_LEVEL_BITS));
+}
+
+/* Returns the queued thread with the highest precedence */
+static inline struct uk_thread *schedprio_first(struct schedprio *c)
+{
+	unsigned int w;
+
+#if CONFIG_LIBUKSCHEDPRIO_EDF
+	if (!UK_TAILQ_EMPTY(&c->dl_queue))
+		return UK_TAILQ_FIRST(&c->dl_queue);
+#endif /* CONFIG_LIBUKSCHEDPRIO_EDF */
+
+	for (w = SCHEDPRIO_LEVEL_WORDS; w-- > 0;) {
+		if (c->levels[w])
+			return UK_TAILQ_FIRST(&c->run_queue[
+				w * SCHEDPRIO_LEVEL_BITS + uk_flsl(c->levels[w])]);
+	}
+	return NULL;
+}
+
+void schedprio_thread_woken_isr(struct uk_sched *s, struct uk_thread *t);
+
+#endif /* __UK_SCHEDPRIO_SCHEDPRIO_H__ */
@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include <errno.h>
+#include <uk/arch/time.h>
+#include <uk/atomic.h>
+#include <uk/bench.h>
+#include <uk/essentials.h>
+#include <uk/plat/time.h>
+#include <uk/print.h>
+#include <uk/sched.h>
+#include <uk/thread.h>
+#include <uk/test.h>
+
+#define NR_WORKERS	100
+#define NR_SAMPLES	200
+#define CHUNK_NSEC	ukarch_time_usec_to_nsec(20)
+#define SLEEP_NSEC	ukarch_time_msec_to_nsec(1)
+
+static unsigned int workers_alive;
+static int workers_stop;
+
+/* Busy threads that yielded after the high priority thread was due */
+static __nsec wake_due;
+static unsigned int late_yields;
+
+/* Fails if the current thread is not scheduled by ukschedprio */
+static int set_fifo(unsigned int prio)
+{
+	struct uk_sched_attr attr = {
+		.sched_policy = UK_SCHED_FIFO,
+		.sched_priority = prio,
+	};
+
+	return uk_sched_thread_set_policy(uk_thread_current(), &attr);
+}
+
+/* The test cases need ukschedprio, so they fail visibly without it */
+#define EXPECT_SCHEDPRIO(rc)						\
+	UK_TEST_ASSERTF((rc) == 0,					\
+			"ukschedprio is not the scheduler of the boot "	\
+			"CPU (%d)", (rc))
+
+static void set_other(void)
+{
+	struct uk_sched_attr attr = { .sched_policy = UK_SCHED_OTHER };
+
+	uk_sched_thread_set_policy(uk_thread_current(), &attr);
+}
+
+UK_TESTCASE(ukschedprio, policy_params)
+{
+	struct uk_sched_attr attr = { .sched_policy = UK_SCHED_FIFO };
+	struct uk_sched_attr cur;
+	int rc;
+
+	/* Out of range priorities */
+	attr.sched_priority = UK_SCHED_PRIO_MIN - 1;
+	UK_TEST_EXPECT_SNUM_EQ(uk_sched_thread_set_policy(uk_thread_current(),
+							  &attr), -EINVAL);
+	attr.sched_priority = UK_SCHED_PRIO_MAX + 1;
+	UK_TEST_EXPECT_SNUM_EQ(uk_sched_thread_set_policy(uk_thread_current(),
+							  &attr), -EINVAL);
+
+	/* Runtime must not exceed the deadline */
+	attr.sched_policy = UK_SCHED_DEADLINE;
+	attr.sched_priority = 0;
+	attr.sched_runtime = ukarch_time_msec_to_nsec(2);
+	attr.sched_deadline = ukarch_time_msec_to_nsec(1);
+	UK_TEST_EXPECT_SNUM_EQ(uk_sched_thread_set_policy(uk_thread_current(),
+							  &attr), -EINVAL);
+
+	rc = set_fifo(UK_SCHED_PRIO_MAX);
+	EXPECT_SCHEDPRIO(rc);
+	if (rc)
+		return;
+
+	uk_sched_thread_get_policy(uk_thread_current(), &cur);
+	UK_TEST_EXPECT_SNUM_EQ(cur.sched_policy, UK_SCHED_FIFO);
+	UK_TEST_EXPECT_SNUM_EQ(cur.sched_priority, UK_SCHED_PRIO_MAX);
+
+	set_other();
+	uk_sched_thread_get_policy(uk_thread_current(), &cur);
+	UK_TEST_EXPECT_SNUM_EQ(cur.sched_policy, UK_SCHED_OTHER);
+	UK_TEST_EXPECT_SNUM_EQ(cur.sched_priority, 0);
+}
+
+static __noreturn void busy_worker_fn(void)
+{
+	__nsec until;
+
+	while (!UK_READ_ONCE(workers_stop)) {
+		until = ukplat_monotonic_clock() + CHUNK_NSEC;
+		while (ukplat_monotonic_clock() < until)
+			;
+		if (until >= UK_READ_ONCE(wake_due))
+			uk_inc(&late_yields);
+		uk_sched_yield();
+	}
+
+	uk_dec(&workers_alive);
+	uk_sched_thread_exit();
+}
+
+/*
+ * A high priority thread that wakes up periodically must not wait for the
+ * busy normal threads: it runs at the next scheduling point, while with
+ * Round-Robin it would wait for every busy thread to yield once. The
+ * lateness depends on the host and is only printed, the test checks the
+ * order in which the threads run.
+ */
+UK_TESTCASE(ukschedprio, wakeup_latency)
+{
+	static struct uk_bench_lat lateness;
+	struct uk_sched *s = uk_sched_current();
+	unsigned int i, nr_workers, late, late_max = 0;
+	__nsec t0, now;
+	int rc;
+
+	rc = set_fifo(90);
+	EXPECT_SCHEDPRIO(rc);
+	if (rc)
+		return;
+
+	uk_bench_lat_reset(&lateness);
+	workers_stop = 0;
+	workers_alive = 0;
+	wake_due = __NSEC_MAX;
+	for (nr_workers = 0; nr_workers < NR_WORKERS; nr_workers++) {
+		if (!uk_sched_thread_create_fn0(s, busy_worker_fn, 0x0, 0x0,
+						false, false, "busy-worker",
+						NULL, NULL))
+			break;
+		uk_inc(&workers_alive);
+	}
+	UK_TEST_EXPECT_SNUM_GT(nr_workers, 0);
+
+	for (i = 0; i < NR_SAMPLES; i++) {
+		t0 = ukplat_monotonic_clock();
+		UK_WRITE_ONCE(late_yields, 0);
+		UK_WRITE_ONCE(wake_due, t0 + SLEEP_NSEC);
+		uk_sched_thread_sleep(SLEEP_NSEC);
+		now = ukplat_monotonic_clock();
+		late = UK_READ_ONCE(late_yields);
+		UK_WRITE_ONCE(wake_due, __NSEC_MAX);
+
+		uk_bench_record(&lateness, now - MIN(now, t0 + SLEEP_NSEC));
+		late_max = MAX(late_max, late);
+	}
+
+	UK_WRITE_ONCE(workers_stop, 1);
+	set_other();
+	while (UK_READ_ONCE(workers_alive))
+		uk_sched_thread_sleep(ukarch_time_usec_to_nsec(100));
+
+	uk_bench_sort(&lateness);
+	uk_pr_info("wakeup lateness: p50=%"__PRInsec" p99=%"__PRInsec
+		   " max=%"__PRInsec" ns\n",
+		   uk_bench_percentile(&lateness, 50),
+		   uk_bench_percentile(&lateness, 99), lateness.max);
+	uk_pr_info("busy threads run while due: max %u of %u\n",
+		   late_max, nr_workers);
+
+	/* Only the busy thread that was running when the sleep expired may
+	 * yield before us. Another one can finish its chunk between our
+	 * clock read and the start of the sleep.
+	 */
+	UK_TEST_EXPECT_SNUM_LE(late_max, 2);
+}
+
+uk_testsuite_register(ukschedprio, NULL);
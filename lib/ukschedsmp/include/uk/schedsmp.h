@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * Non-preemptive (cooperative) Round Robin scheduler for multiple logical
+ * CPUs. Every logical CPU has its own run queue; idle logical CPUs take over
+ * queued threads from busy ones.
+ */
+
+#ifndef __UK_SCHEDSMP_H__
+#define __UK_SCHEDSMP_H__
+
+#include <uk/sched.h>
+#include <uk/alloc.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Creates the SMP scheduler. The logical CPUs that are known to the platform
+ * at this point (see ukplat_lcpu_count()) are started with `uk_sched_start()`
+ * and execute threads from then on.
+ *
+ * NOTE: Timeouts of sleeping threads are driven by the timer of the boot
+ *       CPU. A thread that does not yield on the boot CPU can delay
+ *       timeouts of threads on all logical CPUs.
+ *
+ * @param a
+ *   Allocator for scheduler and thread structures
+ * @param sa
+ *   Allocator for thread stacks
+ * @param auxsa
+ *   Allocator for auxiliary stacks
+ * @param tls_a
+ *   Allocator for thread-local storage
+ * @return
+ *   Reference to the scheduler or NULL on failure
+ */
+struct uk_sched *uk_schedsmp_create(struct uk_alloc *a,
+				    struct uk_alloc *sa,
+				    struct uk_alloc *auxsa,
+				    struct uk_alloc *tls_a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __UK_SCHEDSMP_H__ */
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#include "schedsmp.h"
+
+void schedsmp_thread_woken_isr(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *lc;
+	int kick = -1;
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	schedsmp_sleep_remove(smp, t);
+
+	/* The thread stays on the logical CPU it was assigned to. If it is
+	 * still the current thread there, it gets queued with the next
+	 * scheduling decision of that logical CPU.
+	 */
+	lc = schedsmp_lock_thread(smp, t);
+	if (uk_thread_is_runnable(t) && !uk_thread_is_exited(t)
+	    && !t->_rq.queued && t != lc->current) {
+		schedsmp_rq_enqueue(lc, t);
+
+		/* Wake up the logical CPU if it is idle. Otherwise, let an
+		 * idle logical CPU take the thread over.
+		 */
+		if (lc->current == &lc->idle)
+			kick = (int) lc->idx;
+		else
+			kick = schedsmp_idle_lcpu(smp, lc->idx, t);
+	}
+	ukarch_spin_unlock(&lc->lock);
+
+	schedsmp_kick(kick);
+}
@@ -0,0 +1,707 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+/*
+ * The scheduler is non-preemptive (cooperative) and schedules the threads of
+ * each logical CPU according to the Round Robin algorithm. Threads are placed
+ * on the least loaded logical CPU when they are added and stay there until an
+ * idle logical CPU takes them over. A thread that is switched out is never
+ * taken over before its logical CPU has completed the context switch.
+ */
+#include <string.h>
+#include <errno.h>
+#include <uk/arch/limits.h>
+#include <uk/plat/config.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/memory.h>
+#include <uk/plat/time.h>
+#include <uk/sched_impl.h>
+#include <uk/schedsmp.h>
+#include <uk/essentials.h>
+#if CONFIG_LIBUKVMEM_ZPOOL
+#include <uk/vmem.h>
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+#include "schedsmp.h"
+
+/* Secondary logical CPUs need to find the scheduler at startup */
+static struct schedsmp *schedsmp_instance;
+
+static void schedsmp_wake_expired(struct schedsmp *smp, __nsec now)
+{
+	struct uk_thread *thread;
+	__nsec next = UK_READ_ONCE(smp->sleep_next);
+
+	if (!next || next > now)
+		return;
+
+	/* Threads are woken up without holding the sleep queue lock because
+	 * waking up takes the lock of a run queue
+	 */
+	for (;;) {
+		ukarch_spin_lock(&smp->sleep_lock);
+		thread = uk_sched_sleepq_first(&smp->sleep_queue);
+		if (!thread || (__nsec) thread->_sleep.until > now) {
+			schedsmp_sleep_next_update(smp);
+			ukarch_spin_unlock(&smp->sleep_lock);
+			break;
+		}
+		uk_sched_sleepq_remove(&smp->sleep_queue, thread);
+
+		/* The wakeup time might have been changed while sleeping */
+		if (unlikely(thread->wakeup_time > (__snsec) now)) {
+			uk_sched_sleepq_insert(&smp->sleep_queue, thread);
+			ukarch_spin_unlock(&smp->sleep_lock);
+			continue;
+		}
+		ukarch_spin_unlock(&smp->sleep_lock);
+
+		if (likely(thread->wakeup_time))
+			uk_thread_wake(thread);
+	}
+}
+
+/* Returns the least loaded logical CPU that `t` may run on, or -1. On a tie,
+ * `self` is preferred.
+ */
+static int schedsmp_least_loaded(struct schedsmp *smp, struct uk_thread *t,
+				 unsigned int self)
+{
+	unsigned int i, idx, load, best = 0;
+	unsigned int best_load = __U32_MAX;
+	struct schedsmp_lcpu *lc;
+
+	for (i = 0; i < smp->nr_lcpus; i++) {
+		idx = (self + i) % smp->nr_lcpus;
+		if (!uk_thread_lcpu_allowed(t, idx))
+			continue;
+
+		lc = &smp->lcpu[idx];
+		load = UK_READ_ONCE(lc->nr_queued)
+		       + (UK_READ_ONCE(lc->current) != &lc->idle);
+		if (load < best_load) {
+			best = idx;
+			best_load = load;
+		}
+	}
+	if (unlikely(best_load == __U32_MAX))
+		return -1;
+	return (int) best;
+}
+
+/* Moves a thread that is not running from `src` to `dst`. Both logical CPUs
+ * must be locked. Returns the logical CPU to kick, or -1.
+ */
+static int schedsmp_move(struct schedsmp_lcpu *src, struct schedsmp_lcpu *dst,
+			 struct uk_thread *t)
+{
+	UK_ASSERT(t->_rq.lcpu == src->idx);
+	UK_ASSERT(t != src->current && t != src->switching);
+
+	if (!t->_rq.queued) {
+		/* A blocked thread is queued on `dst` when woken up */
+		t->_rq.lcpu = dst->idx;
+		return -1;
+	}
+
+	schedsmp_rq_dequeue(src, t);
+	t->_rq.lcpu = dst->idx;
+	schedsmp_rq_enqueue(dst, t);
+	return (dst->current == &dst->idle) ? (int) dst->idx : -1;
+}
+
+/* Moves a queued thread that may not run on `lc` to another logical CPU.
+ * Called with the lock of `lc` held, so the lock of a logical CPU with a
+ * lower index is only tried. Returns false if that failed.
+ */
+static bool schedsmp_push(struct schedsmp *smp, struct schedsmp_lcpu *lc,
+			  struct uk_thread *t, int *kick)
+{
+	struct schedsmp_lcpu *dst;
+	int idx;
+
+	idx = schedsmp_least_loaded(smp, t, lc->idx);
+	if (unlikely(idx < 0))
+		return true;
+
+	dst = &smp->lcpu[idx];
+	if (dst->idx > lc->idx)
+		ukarch_spin_lock(&dst->lock);
+	else if (!ukarch_spin_trylock(&dst->lock))
+		return false;
+
+	*kick = schedsmp_move(lc, dst, t);
+	ukarch_spin_unlock(&dst->lock);
+	return true;
+}
+
+static void schedsmp_schedule(struct uk_sched *s)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct uk_thread *prev, *next, *first, *tmp;
+	struct schedsmp_lcpu *lc;
+	unsigned long flags;
+	int kick = -1, push = -1;
+	bool pushed = false;
+	__nsec now;
+
+	if (unlikely(ukplat_lcpu_irqs_disabled()))
+		UK_CRASH("Must not call %s with IRQs disabled\n", __func__);
+
+	prev = uk_thread_current();
+	flags = ukplat_lcpu_save_irqf();
+	lc = schedsmp_lcpu_current(smp);
+	now = ukplat_monotonic_clock();
+
+	schedsmp_wake_expired(smp, now);
+
+	ukarch_spin_lock(&lc->lock);
+
+	/* We are executing, so the last context switch has completed */
+	lc->switching = NULL;
+
+	/* Update execution time of current thread */
+	prev->exec_time += now - lc->ts_prev_switch;
+	lc->ts_prev_switch = now;
+
+	/* Put previous thread on the end of the list */
+	if ((prev != &lc->idle)
+	    && uk_thread_is_runnable(prev)
+	    && !uk_thread_is_exited(prev)
+	    && !prev->_rq.queued)
+		schedsmp_rq_enqueue(lc, prev);
+
+	/* Threads that may no longer run here are left for other logical
+	 * CPUs. One of them is moved per scheduling decision, so that it
+	 * does not wait for an allowed logical CPU to become idle. The
+	 * previous thread still runs on its stack and is moved later.
+	 */
+	UK_TAILQ_FOREACH_SAFE(next, &lc->run_queue, queue, tmp) {
+		if (likely(uk_thread_lcpu_allowed(next, lc->idx)))
+			break;
+		if (!pushed && next != prev)
+			pushed = schedsmp_push(smp, lc, next, &push);
+	}
+
+	if (next) {
+		UK_ASSERT(uk_thread_is_runnable(next));
+		UK_ASSERT(!uk_thread_is_exited(next));
+		schedsmp_rq_dequeue(lc, next);
+	} else {
+		/*
+		 * Schedule idle thread that will halt the CPU
+		 * We select the idle thread only if we do not have anything
+		 * else to execute
+		 */
+		next = &lc->idle;
+	}
+
+	UK_WRITE_ONCE(lc->current, next);
+	if (next != prev) {
+		lc->switching = prev;
+		uk_preempt_disable();
+	}
+
+	/* Hand remaining threads to an idle logical CPU */
+	first = UK_TAILQ_FIRST(&lc->run_queue);
+	if (first)
+		kick = schedsmp_idle_lcpu(smp, lc->idx, first);
+
+	ukarch_spin_unlock(&lc->lock);
+	ukplat_lcpu_restore_irqf(flags);
+
+	schedsmp_kick(kick);
+	schedsmp_kick(push);
+
+	/* Interrupting the switch is equivalent to having the next thread
+	 * interrupted at the return instruction. And therefore at safe point.
+	 */
+	if (prev != next)
+		uk_sched_thread_switch(next);
+}
+
+static int schedsmp_thread_add(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *lc;
+	int best, kick = -1;
+
+	UK_ASSERT(t);
+	UK_ASSERT(!uk_thread_is_exited(t));
+
+	/* Place the thread on the least loaded logical CPU that it may run
+	 * on. On a tie, the current logical CPU is preferred.
+	 */
+	best = schedsmp_least_loaded(smp, t, ukplat_lcpu_idx());
+	if (unlikely(best < 0))
+		return -EINVAL;
+
+	lc = &smp->lcpu[best];
+	ukarch_spin_lock(&lc->lock);
+	t->_rq.lcpu = (unsigned int) best;
+	if (uk_thread_is_runnable(t)) {
+		schedsmp_rq_enqueue(lc, t);
+		if (lc->current == &lc->idle)
+			kick = best;
+	}
+	ukarch_spin_unlock(&lc->lock);
+
+	schedsmp_kick(kick);
+	return 0;
+}
+
+static void schedsmp_thread_remove(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *lc;
+
+	/* Remove from run_queue */
+	lc = schedsmp_lock_thread(smp, t);
+	schedsmp_rq_dequeue(lc, t);
+	ukarch_spin_unlock(&lc->lock);
+
+	/* Remove from sleep queue */
+	schedsmp_sleep_remove(smp, t);
+}
+
+static void schedsmp_thread_blocked(struct uk_sched *s, struct uk_thread *t)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *lc;
+	bool first;
+
+	UK_ASSERT(ukplat_lcpu_irqs_disabled());
+
+	lc = schedsmp_lock_thread(smp, t);
+	schedsmp_rq_dequeue(lc, t);
+	ukarch_spin_unlock(&lc->lock);
+
+	if (t->wakeup_time > 0) {
+		ukarch_spin_lock(&smp->sleep_lock);
+		uk_sched_sleepq_remove(&smp->sleep_queue, t);
+		uk_sched_sleepq_insert(&smp->sleep_queue, t);
+		first = (uk_sched_sleepq_first(&smp->sleep_queue) == t);
+		schedsmp_sleep_next_update(smp);
+		ukarch_spin_unlock(&smp->sleep_lock);
+
+		/* The timer LCPU might halt until a later wakeup time */
+		lc = &smp->lcpu[SCHEDSMP_TIMER_LCPU];
+		if (first && UK_READ_ONCE(lc->current) == &lc->idle)
+			schedsmp_kick(SCHEDSMP_TIMER_LCPU);
+	}
+}
+
+static void schedsmp_thread_set_affinity(struct uk_sched *s,
+					 struct uk_thread *t)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *src, *dst, *lc_first, *lc_second;
+	unsigned long flags;
+	int idx, kick = -1;
+
+	flags = ukplat_lcpu_save_irqf();
+	for (;;) {
+		src = &smp->lcpu[UK_READ_ONCE(t->_rq.lcpu)];
+		if (uk_thread_lcpu_allowed(t, src->idx))
+			goto out;
+		idx = schedsmp_least_loaded(smp, t, src->idx);
+		if (unlikely(idx < 0))
+			goto out;
+		dst = &smp->lcpu[idx];
+
+		if (dst->idx < src->idx) {
+			lc_first  = dst;
+			lc_second = src;
+		} else {
+			lc_first  = src;
+			lc_second = dst;
+		}
+		ukarch_spin_lock(&lc_first->lock);
+		ukarch_spin_lock(&lc_second->lock);
+		if (likely(src->idx == t->_rq.lcpu))
+			break;
+		ukarch_spin_unlock(&lc_second->lock);
+		ukarch_spin_unlock(&lc_first->lock);
+	}
+
+	/* A running thread is moved by the scheduling decision of its
+	 * logical CPU. Exited threads stay for garbage collection.
+	 */
+	if (t != src->current && t != src->switching
+	    && !uk_thread_is_exited(t))
+		kick = schedsmp_move(src, dst, t);
+
+	ukarch_spin_unlock(&lc_second->lock);
+	ukarch_spin_unlock(&lc_first->lock);
+out:
+	ukplat_lcpu_restore_irqf(flags);
+	schedsmp_kick(kick);
+}
+
+/* Takes over a queued thread from another logical CPU */
+static bool schedsmp_steal(struct schedsmp *smp, struct schedsmp_lcpu *lc)
+{
+	struct schedsmp_lcpu *victim, *lc_first, *lc_second;
+	struct uk_thread *t;
+	unsigned int i;
+
+	for (i = 1; i < smp->nr_lcpus; i++) {
+		victim = &smp->lcpu[(lc->idx + i) % smp->nr_lcpus];
+		if (!UK_READ_ONCE(victim->nr_queued))
+			continue;
+
+		if (victim->idx < lc->idx) {
+			lc_first  = victim;
+			lc_second = lc;
+		} else {
+			lc_first  = lc;
+			lc_second = victim;
+		}
+		ukarch_spin_lock(&lc_first->lock);
+		ukarch_spin_lock(&lc_second->lock);
+
+		UK_TAILQ_FOREACH(t, &victim->run_queue, queue) {
+			if (t == victim->switching
+			    || !uk_thread_lcpu_allowed(t, lc->idx))
+				continue;
+
+			schedsmp_rq_dequeue(victim, t);
+			t->_rq.lcpu = lc->idx;
+			schedsmp_rq_enqueue(lc, t);
+			break;
+		}
+
+		ukarch_spin_unlock(&lc_second->lock);
+		ukarch_spin_unlock(&lc_first->lock);
+
+		if (t)
+			return true;
+	}
+	return false;
+}
+
+/* Exited threads are released on the logical CPU they ran last because
+ * that one has certainly switched away from their stack
+ */
+static int schedsmp_gc_filter(struct uk_thread *t, void *argp)
+{
+	struct schedsmp_lcpu *lc = (struct schedsmp_lcpu *) argp;
+
+	return t->_rq.lcpu == lc->idx;
+}
+
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+/* Called by the polling idle thread with interrupts enabled */
+static int schedsmp_has_work(void *arg)
+{
+	struct schedsmp_lcpu *lc = (struct schedsmp_lcpu *) arg;
+
+	return UK_READ_ONCE(lc->nr_queued) > lc->poll_queued;
+}
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
+static __noreturn void idle_thread_fn(void *argp)
+{
+	struct schedsmp_lcpu *lc = (struct schedsmp_lcpu *) argp;
+	struct schedsmp *smp;
+	struct uk_thread *t;
+	__nsec now, wake_up_time;
+	unsigned long flags;
+	bool runnable, pushed;
+	int kick;
+#if CONFIG_LIBUKVMEM_ZPOOL
+	bool zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
+	UK_ASSERT(lc);
+	smp = lc->smp;
+
+	for (;;) {
+		/* The idle thread holds no RCU read-side references */
+		uk_sched_qs_report();
+
+		flags = ukplat_lcpu_save_irqf();
+
+		/* Check for threads that may run here. Threads that are
+		 * queued but must run elsewhere are moved to another logical
+		 * CPU, one at a time. If that fails, we try again instead of
+		 * halting.
+		 */
+		ukarch_spin_lock(&lc->lock);
+		lc->switching = NULL;
+		UK_TAILQ_FOREACH(t, &lc->run_queue, queue)
+			if (uk_thread_lcpu_allowed(t, lc->idx))
+				break;
+		runnable = !!t;
+		t = UK_TAILQ_FIRST(&lc->run_queue);
+		kick = -1;
+		pushed = runnable || !t || schedsmp_push(smp, lc, t, &kick);
+		ukarch_spin_unlock(&lc->lock);
+		schedsmp_kick(kick);
+
+		/*
+		 * NOTE: This idle thread must be non-blocking so that the
+		 *       scheduler has always something to schedule. See
+		 *       ukschedcoop for the assumptions on garbage collection.
+		 */
+		if (runnable || !pushed
+		    || uk_sched_thread_gc_filter(&smp->sched,
+						 schedsmp_gc_filter, lc) > 0
+		    || schedsmp_steal(smp, lc)) {
+			ukplat_lcpu_restore_irqf(flags);
+			schedsmp_schedule(&smp->sched);
+
+			continue;
+		}
+
+#if CONFIG_LIBUKVMEM_ZPOOL
+		/* Zero frames for anonymous page faults instead of halting.
+		 * If no frame could be zeroed, we halt until the next
+		 * interrupt before trying again.
+		 */
+		if (zpool_fill && uk_vmem_zpool_needs_fill()) {
+			ukplat_lcpu_restore_irqf(flags);
+			zpool_fill = uk_vmem_zpool_fill(
+					UK_VMEM_ZPOOL_FILL_BATCH) > 0;
+			schedsmp_schedule(&smp->sched);
+
+			continue;
+		}
+		zpool_fill = true;
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
+		/* Only the timer LCPU halts with a timeout. Others are woken
+		 * up with an IPI when there is work for them.
+		 */
+		wake_up_time = 0;
+		now = 0;
+		if (lc->idx == SCHEDSMP_TIMER_LCPU) {
+			wake_up_time = UK_READ_ONCE(smp->sleep_next);
+			now = ukplat_monotonic_clock();
+		}
+
+		if (!wake_up_time || wake_up_time > now) {
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+			/* Spin for a while before halting, see
+			 * <uk/sched_idle.h>. Queued threads that cannot run
+			 * here were handed on above, so only newly queued
+			 * threads end the polling.
+			 */
+			lc->poll_queued = UK_READ_ONCE(lc->nr_queued);
+			if (uk_sched_idle_poll(schedsmp_has_work, lc,
+					       wake_up_time)) {
+				ukplat_lcpu_restore_irqf(flags);
+				schedsmp_schedule(&smp->sched);
+
+				continue;
+			}
+			uk_sched_idle_halt_irq_until(wake_up_time);
+#else /* !CONFIG_LIBUKSCHED_IDLE_POLL */
+			if (wake_up_time)
+				ukplat_lcpu_halt_irq_until(wake_up_time);
+			else
+				ukplat_lcpu_halt_irq();
+#endif /* !CONFIG_LIBUKSCHED_IDLE_POLL */
+		}
+
+		/* handle pending events if any */
+		ukplat_lcpu_irqs_handle_pending();
+
+		ukplat_lcpu_restore_irqf(flags);
+
+		/* try to schedule a thread that might now be available */
+		schedsmp_schedule(&smp->sched);
+	}
+}
+
+#ifdef CONFIG_HAVE_SMP
+static __noreturn void schedsmp_lcpu_entry(void)
+{
+	struct schedsmp *smp = schedsmp_instance;
+	struct schedsmp_lcpu *lc;
+
+	UK_ASSERT(smp);
+	lc = schedsmp_lcpu_current(smp);
+
+	/* The startup context is left with the first context switch and
+	 * never resumed
+	 */
+	ukplat_per_lcpu_current(__uk_sched_thread_current) = &lc->boot;
+	lc->ts_prev_switch = ukplat_monotonic_clock();
+	ukplat_lcpu_enable_irq();
+
+	uk_preempt_disable();
+	uk_sched_thread_switch(&lc->idle);
+	UK_CRASH("Unexpectedly returned to startup context of LCPU %u\n",
+		 lc->idx);
+}
+
+static void schedsmp_start_lcpus(struct schedsmp *smp)
+{
+	__lcpuidx lcpuidx[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	ukplat_lcpu_entry_t entry[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	void *sp[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+	unsigned int i, num;
+	int rc;
+
+	if (smp->nr_lcpus <= 1)
+		return;
+
+	for (i = 1; i < smp->nr_lcpus; i++) {
+		lcpuidx[i - 1] = i;
+		entry[i - 1]   = schedsmp_lcpu_entry;
+		sp[i - 1]      = (void *) ((__uptr) smp->lcpu[i].boot_stack
+					   + STACK_SIZE);
+	}
+
+	num = smp->nr_lcpus - 1;
+	rc = ukplat_lcpu_start(lcpuidx, &num, sp, entry, 0);
+	if (unlikely(rc)) {
+		/* CPUs are started in order, so we continue with the ones
+		 * that came up
+		 */
+		uk_pr_err("Could only start %u of %u secondary LCPUs: %d\n",
+			  num, smp->nr_lcpus - 1, rc);
+		UK_WRITE_ONCE(smp->nr_lcpus, num + 1);
+	}
+}
+#endif /* CONFIG_HAVE_SMP */
+
+static int schedsmp_start(struct uk_sched *s,
+			  struct uk_thread *main_thread __maybe_unused)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+	struct schedsmp_lcpu *lc = schedsmp_lcpu_current(smp);
+	__nsec now;
+	unsigned int i;
+
+	UK_ASSERT(main_thread);
+	UK_ASSERT(main_thread->sched == s);
+	UK_ASSERT(uk_thread_is_runnable(main_thread));
+	UK_ASSERT(!uk_thread_is_exited(main_thread));
+	UK_ASSERT(uk_thread_current() == main_thread);
+
+	/* Since we are now starting to schedule, we save the current timestamp
+	 * as the start time for the first time slice.
+	 */
+	now = ukplat_monotonic_clock();
+	for (i = 0; i < smp->nr_lcpus; i++)
+		smp->lcpu[i].ts_prev_switch = now;
+
+	main_thread->_rq.lcpu = lc->idx;
+	lc->current = main_thread;
+
+#ifdef CONFIG_HAVE_SMP
+	schedsmp_start_lcpus(smp);
+#endif /* CONFIG_HAVE_SMP */
+
+	ukplat_lcpu_enable_irq();
+
+	return 0;
+}
+
+static const struct uk_thread *schedsmp_idle_thread(struct uk_sched *s,
+						    unsigned int proc_id)
+{
+	struct schedsmp *smp = uksched2schedsmp(s);
+
+	if (proc_id >= smp->nr_lcpus)
+		return NULL;
+
+	return &smp->lcpu[proc_id].idle;
+}
+
+struct uk_sched *uk_schedsmp_create(struct uk_alloc *a,
+				    struct uk_alloc *sa,
+				    struct uk_alloc *auxsa,
+				    struct uk_alloc *tls_a)
+{
+	struct schedsmp *smp = NULL;
+	struct schedsmp_lcpu *lc;
+	unsigned int i;
+	int rc;
+
+	uk_pr_info("Initializing SMP scheduler\n");
+	smp = uk_memalign(a, __alignof__(*smp), sizeof(*smp));
+	if (!smp)
+		goto err_out;
+	memset(smp, 0, sizeof(*smp));
+
+	ukarch_spin_init(&smp->sleep_lock);
+	uk_sched_sleepq_init(&smp->sleep_queue);
+	smp->nr_lcpus = ukplat_lcpu_count();
+	UK_ASSERT(smp->nr_lcpus <= CONFIG_UKPLAT_LCPU_MAXCOUNT);
+
+	for (i = 0; i < smp->nr_lcpus; i++) {
+		lc = &smp->lcpu[i];
+		ukarch_spin_init(&lc->lock);
+		UK_TAILQ_INIT(&lc->run_queue);
+		lc->idx = i;
+		lc->smp = smp;
+
+		/* Create idle thread */
+		rc = uk_thread_init_fn1(&lc->idle,
+					idle_thread_fn, (void *) lc,
+					sa, STACK_SIZE,
+					auxsa, AUXSTACK_SIZE,
+					a, false,
+					NULL,
+					"idle",
+					NULL,
+					NULL);
+		if (rc < 0)
+			goto err_free_lcpus;
+
+		lc->idle.sched = &smp->sched;
+		lc->idle._rq.lcpu = i;
+		lc->current = &lc->idle;
+
+		if (i == 0)
+			continue;
+
+		/* Secondary LCPUs start on a separate stack and switch to
+		 * their idle thread from there
+		 */
+		lc->boot_stack = uk_memalign(sa, UKARCH_SP_ALIGN, STACK_SIZE);
+		if (!lc->boot_stack) {
+			uk_thread_release(&lc->idle);
+			goto err_free_lcpus;
+		}
+		uk_thread_init_bare(&lc->boot, 0x0, 0x0, 0x0, 0x0, false,
+				    NULL, "boot", NULL, NULL);
+		lc->boot.sched = &smp->sched;
+		lc->boot._rq.lcpu = i;
+	}
+
+	uk_sched_init(&smp->sched,
+			schedsmp_start,
+			schedsmp_schedule,
+			schedsmp_thread_add,
+			schedsmp_thread_remove,
+			schedsmp_thread_blocked,
+			schedsmp_thread_woken_isr,
+			schedsmp_thread_woken_isr,
+			schedsmp_idle_thread,
+			a, sa, auxsa, tls_a);
+	smp->sched.thread_set_affinity = schedsmp_thread_set_affinity;
+
+	/* Add idle threads to the scheduler's thread list */
+	for (i = 0; i < smp->nr_lcpus; i++)
+		UK_TAILQ_INSERT_TAIL(&smp->sched.thread_list,
+				     &smp->lcpu[i].idle, thread_list);
+
+	schedsmp_instance = smp;
+	return &smp->sched;
+
+err_free_lcpus:
+	while (i-- > 0) {
+		lc = &smp->lcpu[i];
+		if (lc->boot_stack)
+			uk_free(sa, lc->boot_stack);
+		uk_thread_release(&lc->idle);
+	}
+	uk_free(a, smp);
+err_out:
+	return NULL;
+}
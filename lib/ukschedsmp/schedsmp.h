@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#ifndef __UK_SCHEDSMP_SCHEDSMP_H__
+#define __UK_SCHEDSMP_SCHEDSMP_H__
+
+#include <uk/schedsmp.h>
+#include <uk/sched_impl.h>
+#include <uk/arch/lcpu.h>
+#include <uk/arch/spinlock.h>
+#include <uk/atomic.h>
+#include <uk/plat/lcpu.h>
+
+/* Logical CPU whose timer wakes up sleeping threads */
+#define SCHEDSMP_TIMER_LCPU	0
+
+/*
+ * Locking: A run queue and the fields of the queued threads (`queue`,
+ * `_rq`) are protected by the lock of the logical CPU. When two logical
+ * CPUs are locked, the lock with the lower index is taken first. The sleep
+ * queue has its own lock, which is never held together with a run queue lock.
+ */
+struct schedsmp_lcpu {
+	__spinlock lock;
+	struct uk_thread_list run_queue;
+	unsigned int nr_queued;
+
+	/* Thread that executes on the logical CPU */
+	struct uk_thread *current;
+	/* Previous thread of the last context switch. It might still run on
+	 * its stack, so it must not be taken over by another logical CPU.
+	 */
+	struct uk_thread *switching;
+	__nsec ts_prev_switch;
+#if CONFIG_LIBUKSCHED_IDLE_POLL
+	/* Run queue length when the idle thread started to poll */
+	unsigned int poll_queued;
+#endif /* CONFIG_LIBUKSCHED_IDLE_POLL */
+
+	unsigned int idx;
+	struct schedsmp *smp;
+
+	struct uk_thread idle;
+	/* Startup context of secondary logical CPUs */
+	struct uk_thread boot;
+	void *boot_stack;
+} __align(CACHE_LINE_SIZE);
+
+struct schedsmp {
+	struct uk_sched sched;
+
+	__spinlock sleep_lock;
+	struct uk_sched_sleepq sleep_queue;
+	__nsec sleep_next;	/* first wakeup time, 0 if none */
+
+	unsigned int nr_lcpus;
+	struct schedsmp_lcpu lcpu[CONFIG_UKPLAT_LCPU_MAXCOUNT];
+};
+
+static inline struct schedsmp *uksched2schedsmp(struct uk_sched *s)
+{
+	UK_ASSERT(s);
+
+	return __containerof(s, struct schedsmp, sched);
+}
+
+static inline struct schedsmp_lcpu *schedsmp_lcpu_current(struct schedsmp *smp)
+{
+	UK_ASSERT(ukplat_lcpu_idx() < smp->nr_lcpus);
+
+	return &smp->lcpu[ukplat_lcpu_idx()];
+}
+
+/* Locks the run queue of the logical CPU that the thread is assigned to */
+static inline struct schedsmp_lcpu *schedsmp_lock_thread(struct schedsmp *smp,
+							 struct uk_thread *t)
+{
+	struct schedsmp_lcpu *lc;
+
+	/* The assignment can only change while the run queue is locked */
+	for (;;) {
+		lc = &smp->lcpu[UK_READ_ONCE(t->_rq.lcpu)];
+		ukarch_spin_lock(&lc->lock);
+		if (likely(lc->idx == t->_rq.lcpu))
+			return lc;
+		ukarch_spin_unlock(&lc->lock);
+	}
+}
+
+static inline void schedsmp_rq_enqueue(struct schedsmp_lcpu *lc,
+				       struct uk_thread *t)
+{
+	UK_ASSERT(!t->_rq.queued);
+	UK_ASSERT(t->_rq.lcpu == lc->idx);
+
+	UK_TAILQ_INSERT_TAIL(&lc->run_queue, t, queue);
+	t->_rq.queued = true;
+	UK_WRITE_ONCE(lc->nr_queued, lc->nr_queued + 1);
+}
+
+static inline void schedsmp_rq_dequeue(struct schedsmp_lcpu *lc,
+				       struct uk_thread *t)
+{
+	if (!t->_rq.queued)
+		return;
+
+	UK_ASSERT(t->_rq.lcpu == lc->idx);
+
+	UK_TAILQ_REMOVE(&lc->run_queue, t, queue);
+	t->_rq.queued = false;
+	UK_WRITE_ONCE(lc->nr_queued, lc->nr_queued - 1);
+}
+
+/* Returns an idle logical CPU other than `self` that `t` may run on, or -1 */
+static inline int schedsmp_idle_lcpu(struct schedsmp *smp, unsigned int self,
+				     const struct uk_thread *t)
+{
+	unsigned int nr_lcpus = UK_READ_ONCE(smp->nr_lcpus);
+	struct schedsmp_lcpu *lc;
+	unsigned int i, idx;
+
+	/* Start with the next logical CPU to spread the work */
+	for (i = 1; i < nr_lcpus; i++) {
+		idx = (self + i) % nr_lcpus;
+		lc = &smp->lcpu[idx];
+		if (!uk_thread_lcpu_allowed(t, idx))
+			continue;
+		if (UK_READ_ONCE(lc->current) == &lc->idle)
+			return (int) idx;
+	}
+	return -1;
+}
+
+/* Interrupts a logical CPU that halts so that it checks for work */
+static inline void schedsmp_kick(int idx __maybe_unused)
+{
+#ifdef CONFIG_HAVE_SMP
+	__lcpuidx lcpuidx = (__lcpuidx) idx;
+	unsigned int num = 1;
+
+	if (idx < 0 || lcpuidx == ukplat_lcpu_idx())
+		return;
+	ukplat_lcpu_wakeup(&lcpuidx, &num);
+#endif /* CONFIG_HAVE_SMP */
+}
+
+/* Sets the time at which the timer LCPU has to wake up the first sleeper.
+ * Must be called with `sleep_lock` held.
+ */
+static inline void schedsmp_sleep_next_update(struct schedsmp *smp)
+{
+	struct uk_thread *first = uk_sched_sleepq_first(&smp->sleep_queue);
+
+	UK_WRITE_ONCE(smp->sleep_next, first ? (__nsec) first->_sleep.until : 0);
+}
+
+static inline void schedsmp_sleep_remove(struct schedsmp *smp,
+					 struct uk_thread *t)
+{
+	if (!uk_sched_sleepq_queued(t))
+		return;
+
+	ukarch_spin_lock(&smp->sleep_lock);
+	uk_sched_sleepq_remove(&smp->sleep_queue, t);
+	schedsmp_sleep_next_update(smp);
+	ukarch_spin_unlock(&smp->sleep_lock);
+}
+
+void schedsmp_thread_woken_isr(struct uk_sched *s, struct uk_thread *t);
+
+#endif /* __UK_SCHEDSMP_SCHEDSMP_H__ */
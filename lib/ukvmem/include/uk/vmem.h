@@ -120,6 +120,7 @@ struct uk_vma {
 
 	/** VMA flags - high word bits are from mapping flags */
 #define UK_VMA_FLAG_UNINITIALIZED	0x1 /* Do not initialize memory */
+#define UK_VMA_FLAG_HUGE		0x2 /* Demand-page with large pages */
 	unsigned long flags;
 
 	/** Desired page level (-1 = no preference) */
@@ -485,6 +486,7 @@ static inline const struct uk_vma *uk_vma_next(const struct uk_vma *vma)
 #define UK_VMA_MAP_POPULATE		0x01 /* Prefault memory */
 #define UK_VMA_MAP_UNINITIALIZED	0x02 /* Do not zero anonymous memory */
 #define UK_VMA_MAP_REPLACE		0x04 /* Replace existing VMAs */
+#define UK_VMA_MAP_HUGE			0x08 /* Prefer large pages on faults */
 
 #define UK_VMA_MAP_SIZE_SHIFT		5
 #define UK_VMA_MAP_SIZE_BITS		6
@@ -543,6 +545,13 @@ static inline const struct uk_vma *uk_vma_next(const struct uk_vma *vma)
  *   Use UK_VMA_MAP_REPLACE to replace any colliding address ranges from other
  *   VMAs with this one. Note that this only works if the conflicting VMAs
  *   implement and allow the split and unmap operations.
+ *
+ *   UK_VMA_MAP_HUGE asks demand paging to page-in large pages where the VMA
+ *   covers a whole large page, falling back to the default page size if
+ *   there is not enough contiguous physical memory. If vaddr is __VADDR_ANY
+ *   and len is at least the size of a large page, the VMA is placed at a
+ *   large page boundary. Only effective with CONFIG_LIBUKVMEM_ANON_HUGE and
+ *   without an enforced page size.
  * @param name
  *   Optional pointer to a null-terminated string used as name for the VMA in
  *   listings. Can be __NULL.
@@ -665,6 +674,94 @@ int uk_vma_set_attr(struct uk_vas *vas, __vaddr_t vaddr, __sz len,
 int uk_vma_advise(struct uk_vas *vas, __vaddr_t vaddr, __sz len,
 		  unsigned long advice, unsigned long flags);
 
+#ifdef CONFIG_LIBUKVMEM_PAGEFAULT_STATS
+/** Page fault statistics */
+struct uk_vmem_pagefault_stats {
+	/** Faults resolved with a base page (e.g., 4 KiB) */
+	__u64 nr_small;
+	/** Faults resolved with a large page (e.g., 2 MiB) */
+	__u64 nr_large;
+	/** Large page faults that fell back to a base page */
+	__u64 nr_fallback;
+};
+
+/**
+ * Returns the page fault statistics of all address spaces.
+ *
+ * @param[out] stats
+ *   Receives the counters
+ */
+void uk_vmem_pagefault_stats(struct uk_vmem_pagefault_stats *stats);
+#endif /* CONFIG_LIBUKVMEM_PAGEFAULT_STATS */
+
+#ifdef CONFIG_LIBUKVMEM_ZPOOL
+/**
+ * Pre-zeroed frame pool -------------------------------------------------------
+ *
+ * Page faults in anonymous memory that must be zero-initialized take a frame
+ * from the pool if available and thereby avoid clearing the frame on the
+ * fault path. The pool is filled with uk_vmem_zpool_fill() when the CPU would
+ * otherwise be idle (e.g., by the idle thread of the scheduler). Frames in
+ * the pool are allocated from the frame allocator and do not count as free
+ * memory.
+ */
+
+/** Number of frames that the idle thread zeroes at once */
+#define UK_VMEM_ZPOOL_FILL_BATCH	16
+
+/** Pre-zeroed frame pool statistics */
+struct uk_vmem_zpool_stats {
+	/** Number of zeroed frames in the pool */
+	unsigned int level;
+	/** Number of frames the pool is filled up to */
+	unsigned int target;
+	/** Requests for a zeroed frame that were served from the pool */
+	__u64 nr_hits;
+	/** Requests for a zeroed frame that found the pool empty */
+	__u64 nr_misses;
+	/** Number of frames zeroed and added to the pool */
+	__u64 nr_fills;
+};
+
+/**
+ * @return
+ *   A non-zero value if the pool is below its target level
+ */
+int uk_vmem_zpool_needs_fill(void);
+
+/**
+ * Zeroes frames of the active address space's frame allocator and adds them
+ * to the pool until the pool reaches its target level.
+ *
+ * @param max
+ *   Maximum number of frames to zero
+ *
+ * @return
+ *   The number of frames added to the pool
+ */
+unsigned int uk_vmem_zpool_fill(unsigned int max);
+
+/**
+ * Sets the level up to which the pool is filled. Frames above the new target
+ * are returned to the frame allocator.
+ *
+ * @param frames
+ *   The new target, at most CONFIG_LIBUKVMEM_ZPOOL_SIZE frames
+ *
+ * @return
+ *   0 on success, -EINVAL if the target exceeds the pool capacity
+ */
+int uk_vmem_zpool_set_target(unsigned int frames);
+
+/**
+ * Returns the statistics of the pre-zeroed frame pool.
+ *
+ * @param[out] stats
+ *   Receives the statistics
+ */
+void uk_vmem_zpool_stats(struct uk_vmem_zpool_stats *stats);
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+#ifndef __UK_VMEM_STORE_H__
+#define __UK_VMEM_STORE_H__
+
+/* stats entry IDs */
+#define UK_VMEM_STATS_PF_NUM_SMALL		0x01
+#define UK_VMEM_STATS_PF_NUM_LARGE		0x02
+#define UK_VMEM_STATS_PF_NUM_FALLBACK		0x03
+#define UK_VMEM_STATS_ZPOOL_LEVEL		0x04
+#define UK_VMEM_STATS_ZPOOL_TARGET		0x05
+#define UK_VMEM_STATS_ZPOOL_NUM_HITS		0x06
+#define UK_VMEM_STATS_ZPOOL_NUM_MISSES		0x07
+#define UK_VMEM_STATS_ZPOOL_HIT_RATE		0x08
+
+#endif /* __UK_VMEM_STORE_H__ */
@@ -19,6 +19,11 @@
 #endif /* CONFIG_HAVE_PAGING */
 #include <uk/isr/string.h>
 
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE
+#define VMA_ANON_HUGE_RESERVE						\
+	((__sz) CONFIG_LIBUKVMEM_ANON_HUGE_RESERVE << 20)
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE */
+
 #ifdef CONFIG_LIBUKVMEM_ANON_BASE
 static __vaddr_t vma_op_anon_get_base(struct uk_vas *vas __unused,
 				      void *data __unused,
@@ -40,6 +45,24 @@ static int vma_op_anon_fault(struct uk_vma *vma, struct uk_vm_fault *fault)
 	UK_ASSERT(fault->len == PAGE_Lx_SIZE(fault->level));
 	UK_ASSERT(fault->type & UK_VMA_FAULT_NONPRESENT);
 
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE
+	/* Keep a reserve of free memory for base pages. The fault is retried
+	 * with a base page if we return -ENOMEM for a large page.
+	 */
+	if (fault->level > PAGE_LEVEL &&
+	    pt->fa->free_memory < fault->len + VMA_ANON_HUGE_RESERVE)
+		return -ENOMEM;
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE */
+
+#ifdef CONFIG_LIBUKVMEM_ZPOOL
+	/* Take an already zeroed frame if available */
+	if (pages == 1 && !(vma->flags & UK_VMA_FLAG_UNINITIALIZED) &&
+	    vmem_zpool_get(pt, &paddr) == 0) {
+		fault->paddr = paddr;
+		return 0;
+	}
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
 	rc = pt->fa->falloc(pt->fa, &paddr, pages, FALLOC_FLAG_ALIGNED);
 	if (unlikely(rc))
 		return rc;
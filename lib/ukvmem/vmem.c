@@ -19,6 +19,11 @@
 #include <uk/assert.h>
 #include <uk/list.h>
 #include <uk/config.h>
+#ifdef CONFIG_LIBUKVMEM_PAGEFAULT_STATS
+#include <uk/atomic.h>
+#include <uk/store.h>
+#include <uk/vmem_store.h>
+#endif /* CONFIG_LIBUKVMEM_PAGEFAULT_STATS */
 
 /*
  * Pointer to currently active virtual address space.
@@ -30,6 +35,14 @@ static struct uk_vas *vmem_active_vas;
 static void vmem_vma_unmap(struct uk_vma *vma, __vaddr_t vaddr, __sz len);
 static void vmem_vma_unlink_and_free(struct uk_vma *vma);
 
+#ifdef CONFIG_LIBUKVMEM_PAGEFAULT_STATS
+static struct uk_vmem_pagefault_stats vmem_pf_stats;
+
+#define vmem_pf_stats_inc(counter)	uk_inc(&vmem_pf_stats.counter)
+#else /* !CONFIG_LIBUKVMEM_PAGEFAULT_STATS */
+#define vmem_pf_stats_inc(counter)	do {} while (0)
+#endif /* !CONFIG_LIBUKVMEM_PAGEFAULT_STATS */
+
 struct uk_vas *uk_vas_get_active(void)
 {
 	return vmem_active_vas;
@@ -597,6 +610,7 @@ int uk_vma_map(struct uk_vas *vas, __vaddr_t *vaddr, __sz len,
 {
 	unsigned int order = UK_VMA_MAP_SIZE_TO_ORDER(flags);
 	int rc, to_lvl, algn_lvl, strict;
+	int huge __maybe_unused = 0;
 	struct uk_vma *vma_start = __NULL;
 	struct uk_vma *vma_end = __NULL;
 	struct uk_vma *vma = __NULL;
@@ -624,6 +638,18 @@ int uk_vma_map(struct uk_vas *vas, __vaddr_t *vaddr, __sz len,
 	if (unlikely(!PAGE_Lx_ALIGNED(len, algn_lvl)))
 		return -EINVAL;
 
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE
+	/* Only anonymous memory is paged-in with large pages on demand. The
+	 * fault handlers of the other VMA types expect base pages.
+	 */
+	if (ops == &uk_vma_anon_ops && to_lvl < 0) {
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE_ALL
+		flags |= UK_VMA_MAP_HUGE;
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE_ALL */
+		huge = (flags & UK_VMA_MAP_HUGE);
+	}
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE */
+
 	va = *vaddr;
 	if (va == __VADDR_ANY) {
 		/* Select the first virtual address range starting at the
@@ -632,7 +658,20 @@ int uk_vma_map(struct uk_vas *vas, __vaddr_t *vaddr, __sz len,
 		base = (ops->get_base) ? ops->get_base(vas, args, flags) :
 					 vas->vma_base;
 
-		va = vmem_first_fit(vas, base, PAGE_Lx_SIZE(algn_lvl), len);
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE
+		/* Place VMAs that can hold large pages so that they start
+		 * at a large page boundary. Otherwise, only the large pages
+		 * between the first and the last boundary could be used.
+		 */
+		if (huge && len >= PAGE_Lx_SIZE(PAGE_LARGE_LEVEL))
+			va = vmem_first_fit(vas, base,
+					    PAGE_Lx_SIZE(PAGE_LARGE_LEVEL),
+					    len);
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE */
+
+		if (va == __VADDR_INV)
+			va = vmem_first_fit(vas, base, PAGE_Lx_SIZE(algn_lvl),
+					    len);
 		if (unlikely(va == __VADDR_INV))
 			return -ENOMEM;
 	} else {
@@ -718,6 +757,9 @@ int uk_vma_map(struct uk_vas *vas, __vaddr_t *vaddr, __sz len,
 	if (flags & UK_VMA_MAP_UNINITIALIZED)
 		vma->flags |= UK_VMA_FLAG_UNINITIALIZED;
 
+	if (huge)
+		vma->flags |= UK_VMA_FLAG_HUGE;
+
 	if (flags & UK_VMA_MAP_POPULATE) {
 		UK_ASSERT(vma->ops->fault);
 
@@ -1029,7 +1071,7 @@ static int vmem_mapx_pagefault(struct uk_pagetable *pt __unused,
 
 int vmem_pagefault(__vaddr_t vaddr, unsigned int type, struct __regs *regs)
 {
-	const unsigned int demand_lvl =
+	unsigned int demand_lvl =
 		PAGE_SHIFT_Lx(CONFIG_LIBUKVMEM_DEMAND_PAGE_IN_SIZE);
 	struct uk_vas *vas;
 	struct uk_pagetable *pt;
@@ -1073,6 +1115,11 @@ int vmem_pagefault(__vaddr_t vaddr, unsigned int type, struct __regs *regs)
 	UK_ASSERT(ctx.vma->vas->pt);
 	pt = ctx.vma->vas->pt;
 
+#ifdef CONFIG_LIBUKVMEM_ANON_HUGE
+	if (ctx.vma->flags & UK_VMA_FLAG_HUGE)
+		demand_lvl = MAX(demand_lvl, (unsigned int) PAGE_LARGE_LEVEL);
+#endif /* CONFIG_LIBUKVMEM_ANON_HUGE */
+
 	/* Find the page level at which we want to page-in. If the VMA does not
 	 * enforce a specific page size and the configuration allows to page-in
 	 * large pages, we first check up to which level we find page tables.
@@ -1103,7 +1150,63 @@ int vmem_pagefault(__vaddr_t vaddr, unsigned int type, struct __regs *regs)
 	UK_ASSERT(vbase + PAGE_Lx_SIZE(lvl) >= ctx.vma->start &&
 		  vbase + PAGE_Lx_SIZE(lvl) <= ctx.vma->end);
 
-	return ukplat_page_mapx(pt, vbase, 0, 1, ctx.vma->attr,
-				PAGE_FLAG_SIZE(lvl) | flags, &mapx);
+	rc = ukplat_page_mapx(pt, vbase, 0, 1, ctx.vma->attr,
+			      PAGE_FLAG_SIZE(lvl) | flags, &mapx);
+	if (unlikely(rc == -ENOMEM) && (flags & PAGE_FLAG_FORCE_SIZE) &&
+	    lvl > PAGE_LEVEL) {
+		/* There is not enough contiguous physical memory for a large
+		 * page. Fall back to a base page.
+		 */
+		vmem_pf_stats_inc(nr_fallback);
+
+		lvl   = PAGE_LEVEL;
+		vbase = PAGE_ALIGN_DOWN(vaddr);
+		rc = ukplat_page_mapx(pt, vbase, 0, 1, ctx.vma->attr,
+				      PAGE_FLAG_SIZE(lvl) | flags, &mapx);
+	}
+	if (unlikely(rc))
+		return rc;
+
+	if (lvl > PAGE_LEVEL)
+		vmem_pf_stats_inc(nr_large);
+	else
+		vmem_pf_stats_inc(nr_small);
+
+	return 0;
 }
 #endif /* CONFIG_HAVE_PAGING */
+
+#ifdef CONFIG_LIBUKVMEM_PAGEFAULT_STATS
+void uk_vmem_pagefault_stats(struct uk_vmem_pagefault_stats *stats)
+{
+	UK_ASSERT(stats);
+
+	stats->nr_small    = uk_load_n(&vmem_pf_stats.nr_small);
+	stats->nr_large    = uk_load_n(&vmem_pf_stats.nr_large);
+	stats->nr_fallback = uk_load_n(&vmem_pf_stats.nr_fallback);
+}
+
+static int get_pf_nr_small(void *cookie __unused, __u64 *out)
+{
+	*out = uk_load_n(&vmem_pf_stats.nr_small);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_PF_NUM_SMALL, pf_nr_small, u64,
+		      get_pf_nr_small, NULL);
+
+static int get_pf_nr_large(void *cookie __unused, __u64 *out)
+{
+	*out = uk_load_n(&vmem_pf_stats.nr_large);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_PF_NUM_LARGE, pf_nr_large, u64,
+		      get_pf_nr_large, NULL);
+
+static int get_pf_nr_fallback(void *cookie __unused, __u64 *out)
+{
+	*out = uk_load_n(&vmem_pf_stats.nr_fallback);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_PF_NUM_FALLBACK, pf_nr_fallback, u64,
+		      get_pf_nr_fallback, NULL);
+#endif /* CONFIG_LIBUKVMEM_PAGEFAULT_STATS */
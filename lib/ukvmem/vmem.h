@@ -61,6 +61,22 @@ vmem_len_to_pages(struct uk_vma *vma, __sz len, unsigned long *flags)
 }
 #endif /* CONFIG_HAVE_PAGING */
 
+#ifdef CONFIG_LIBUKVMEM_ZPOOL
+/**
+ * Takes a zeroed frame from the pre-zeroed frame pool.
+ *
+ * @param pt
+ *   The page table for which the frame is allocated. The frame is taken
+ *   from the frame allocator of the page table.
+ * @param[out] paddr
+ *   Receives the physical address of the zeroed frame
+ *
+ * @return
+ *   0 on success, -ENOENT if the pool is empty
+ */
+int vmem_zpool_get(struct uk_pagetable *pt, __paddr_t *paddr);
+#endif /* CONFIG_LIBUKVMEM_ZPOOL */
+
 /* Macros for safe VMA op invocation */
 #define _VMA_OP(vma, op, def, ...)					\
 	(((vma)->ops->op) ? (vma)->ops->op(vma, __VA_ARGS__) : (def))
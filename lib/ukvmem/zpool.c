@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Copyright (c) 2024, Unikraft GmbH and The Unikraft Authors.
+ * Licensed under the BSD-3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ */
+
+/* Pool of pre-zeroed frames. Zeroing a fresh frame dominates the latency of
+ * the first touch of anonymous memory. The pool is filled while the CPU would
+ * otherwise be idle (see uk_vmem_zpool_fill()) so that page faults can take
+ * a zeroed frame instead of clearing one on the fault path.
+ */
+
+#include <stddef.h>
+#include <errno.h>
+
+#include "vmem.h"
+
+#include <uk/config.h>
+#include <uk/assert.h>
+#include <uk/essentials.h>
+#include <uk/arch/paging.h>
+#include <uk/arch/spinlock.h>
+#include <uk/atomic.h>
+#include <uk/plat/lcpu.h>
+#include <uk/plat/paging.h>
+#include <uk/falloc.h>
+#include <uk/isr/string.h>
+#include <uk/store.h>
+#include <uk/vmem_store.h>
+
+#define ZPOOL_CAPACITY		CONFIG_LIBUKVMEM_ZPOOL_SIZE
+
+static struct {
+	__spinlock lock;
+
+	/* Frame allocator from which the frames are taken */
+	struct uk_falloc *fa;
+
+	unsigned int count;
+	unsigned int target;
+	__paddr_t frames[ZPOOL_CAPACITY];
+
+	__u64 nr_hits;
+	__u64 nr_misses;
+	__u64 nr_fills;
+} zpool = {
+	.lock   = UKARCH_SPINLOCK_INITIALIZER(),
+	.target = ZPOOL_CAPACITY,
+};
+
+int vmem_zpool_get(struct uk_pagetable *pt, __paddr_t *paddr)
+{
+	unsigned long irqf;
+	int rc = -ENOENT;
+
+	UK_ASSERT(pt);
+	UK_ASSERT(paddr);
+
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&zpool.lock);
+
+	if (likely(zpool.count && zpool.fa == pt->fa)) {
+		*paddr = zpool.frames[--zpool.count];
+		zpool.nr_hits++;
+		rc = 0;
+	} else {
+		zpool.nr_misses++;
+	}
+
+	ukarch_spin_unlock(&zpool.lock);
+	ukplat_lcpu_restore_irqf(irqf);
+	return rc;
+}
+
+int uk_vmem_zpool_needs_fill(void)
+{
+	return UK_READ_ONCE(zpool.count) < UK_READ_ONCE(zpool.target);
+}
+
+unsigned int uk_vmem_zpool_fill(unsigned int max)
+{
+	struct uk_vas *vas = uk_vas_get_active();
+	struct uk_pagetable *pt;
+	unsigned long irqf;
+	unsigned int filled = 0;
+	__paddr_t paddr;
+	__vaddr_t vaddr;
+	int rc;
+
+	if (unlikely(!vas || !vas->pt))
+		return 0;
+
+	pt = vas->pt;
+	UK_ASSERT(pt->fa);
+
+	while (filled < max && uk_vmem_zpool_needs_fill()) {
+		paddr = __PADDR_ANY;
+		rc = pt->fa->falloc(pt->fa, &paddr, 1, 0);
+		if (unlikely(rc))
+			break;
+
+		/* Zero the frame outside of the lock */
+		vaddr = ukplat_page_kmap(pt, paddr, 1, 0);
+		if (unlikely(vaddr == __VADDR_INV)) {
+			pt->fa->ffree(pt->fa, paddr, 1);
+			break;
+		}
+
+		memset_isr((void *)vaddr, 0, PAGE_SIZE);
+		ukplat_page_kunmap(pt, vaddr, 1, 0);
+
+		irqf = ukplat_lcpu_save_irqf();
+		ukarch_spin_lock(&zpool.lock);
+
+		if (!zpool.fa)
+			zpool.fa = pt->fa;
+
+		/* The pool might have been filled by another CPU or belong
+		 * to a different frame allocator
+		 */
+		if (unlikely(zpool.count >= zpool.target ||
+			     zpool.fa != pt->fa)) {
+			ukarch_spin_unlock(&zpool.lock);
+			ukplat_lcpu_restore_irqf(irqf);
+
+			pt->fa->ffree(pt->fa, paddr, 1);
+			break;
+		}
+
+		zpool.frames[zpool.count++] = paddr;
+		zpool.nr_fills++;
+
+		ukarch_spin_unlock(&zpool.lock);
+		ukplat_lcpu_restore_irqf(irqf);
+
+		filled++;
+	}
+
+	return filled;
+}
+
+int uk_vmem_zpool_set_target(unsigned int frames)
+{
+	struct uk_falloc *fa;
+	unsigned long irqf;
+	__paddr_t paddr;
+
+	if (unlikely(frames > ZPOOL_CAPACITY))
+		return -EINVAL;
+
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&zpool.lock);
+
+	zpool.target = frames;
+
+	/* Return the frames above the new target */
+	while (zpool.count > zpool.target) {
+		fa = zpool.fa;
+		paddr = zpool.frames[--zpool.count];
+
+		UK_ASSERT(fa);
+		fa->ffree(fa, paddr, 1);
+	}
+
+	ukarch_spin_unlock(&zpool.lock);
+	ukplat_lcpu_restore_irqf(irqf);
+	return 0;
+}
+
+void uk_vmem_zpool_stats(struct uk_vmem_zpool_stats *stats)
+{
+	unsigned long irqf;
+
+	UK_ASSERT(stats);
+
+	irqf = ukplat_lcpu_save_irqf();
+	ukarch_spin_lock(&zpool.lock);
+
+	stats->level     = zpool.count;
+	stats->target    = zpool.target;
+	stats->nr_hits   = zpool.nr_hits;
+	stats->nr_misses = zpool.nr_misses;
+	stats->nr_fills  = zpool.nr_fills;
+
+	ukarch_spin_unlock(&zpool.lock);
+	ukplat_lcpu_restore_irqf(irqf);
+}
+
+/*
+ * ukstore
+ */
+static int get_zpool_level(void *cookie __unused, __u64 *out)
+{
+	*out = UK_READ_ONCE(zpool.count);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_ZPOOL_LEVEL, zpool_level, u64,
+		      get_zpool_level, NULL);
+
+static int get_zpool_target(void *cookie __unused, __u64 *out)
+{
+	*out = UK_READ_ONCE(zpool.target);
+	return 0;
+}
+
+static int set_zpool_target(void *cookie __unused, __u64 val)
+{
+	if (unlikely(val > ZPOOL_CAPACITY))
+		return -EINVAL;
+
+	return uk_vmem_zpool_set_target((unsigned int)val);
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_ZPOOL_TARGET, zpool_target, u64,
+		      get_zpool_target, set_zpool_target);
+
+static int get_zpool_nr_hits(void *cookie __unused, __u64 *out)
+{
+	*out = UK_READ_ONCE(zpool.nr_hits);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_ZPOOL_NUM_HITS, zpool_nr_hits, u64,
+		      get_zpool_nr_hits, NULL);
+
+static int get_zpool_nr_misses(void *cookie __unused, __u64 *out)
+{
+	*out = UK_READ_ONCE(zpool.nr_misses);
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_ZPOOL_NUM_MISSES, zpool_nr_misses, u64,
+		      get_zpool_nr_misses, NULL);
+
+/* Percentage of zeroed-frame requests that were served from the pool */
+static int get_zpool_hit_rate(void *cookie __unused, __u64 *out)
+{
+	struct uk_vmem_zpool_stats stats;
+	__u64 total;
+
+	uk_vmem_zpool_stats(&stats);
+	total = stats.nr_hits + stats.nr_misses;
+	*out = total ? (stats.nr_hits * 100) / total : 0;
+	return 0;
+}
+UK_STORE_STATIC_ENTRY(UK_VMEM_STATS_ZPOOL_HIT_RATE, zpool_hit_rate, u64,
+		      get_zpool_hit_rate, NULL);
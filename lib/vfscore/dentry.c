@@ -35,7 +35,10 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <uk/arch/lcpu.h>
+#include <uk/atomic.h>
 #include <uk/list.h>
+#include <uk/rcu.h>
 #include <vfscore/dentry.h>
 #include <vfscore/vnode.h>
 #include <uk/mutex.h>
@@ -47,6 +50,25 @@ static struct uk_hlist_head dentry_hash_table[DENTRY_BUCKETS];
 static UK_HLIST_HEAD(fake);
 static struct uk_mutex dentry_hash_lock = UK_MUTEX_INITIALIZER(dentry_hash_lock);
 
+/*
+ * Lookups walk the hash chains without dentry_hash_lock, within an RCU
+ * read-side critical section. Writers still serialize on the lock. Moving a
+ * dentry to another chain can make a concurrent lookup miss entries, so
+ * writers that do so bump this sequence count (odd while in progress) and
+ * lookups that miss retry under the lock if it changed.
+ */
+static unsigned long dentry_hash_seq;
+
+static inline void dentry_hash_write_begin(void)
+{
+	uk_inc(&dentry_hash_seq);
+}
+
+static inline void dentry_hash_write_end(void)
+{
+	uk_inc(&dentry_hash_seq);
+}
+
 /*
  * Get the hash value from the mount point and path name.
  * XXX: replace with a better hash for 64-bit pointers.
@@ -101,21 +123,69 @@ dentry_alloc(struct dentry *parent_dp, struct vnode *vp, const char *path)
 	vn_add_name(vp, dp);
 
 	uk_mutex_lock(&dentry_hash_lock);
-	uk_hlist_add_head(&dp->d_link,
-			  &dentry_hash_table[dentry_hash(mp, path)]);
+	uk_hlist_add_head_rcu(&dp->d_link,
+			      &dentry_hash_table[dentry_hash(mp, path)]);
 	uk_mutex_unlock(&dentry_hash_lock);
 	return dp;
 };
 
+/*
+ * Take a reference unless the last one is being dropped: the dentry is then
+ * about to leave the hash table and must not be revived.
+ */
+static int
+dentry_tryget(struct dentry *dp)
+{
+	int refcnt = uk_load_n(&dp->d_refcnt);
+
+	do {
+		if (refcnt == 0)
+			return 0;
+	} while (!uk_compare_exchange_n(&dp->d_refcnt, &refcnt, refcnt + 1));
+	return 1;
+}
+
+static struct dentry *
+dentry_lookup_rcu(struct mount *mp, const char *path, unsigned int hash)
+{
+	struct dentry *dp;
+
+	uk_rcu_read_lock();
+	uk_hlist_for_each_entry_rcu(dp, &dentry_hash_table[hash], d_link) {
+		if (dp->d_mount == mp &&
+		    !strncmp(uk_rcu_dereference(dp->d_path), path, PATH_MAX)) {
+			if (!dentry_tryget(dp))
+				dp = NULL;
+			break;
+		}
+	}
+	uk_rcu_read_unlock();
+	return dp;
+}
+
 struct dentry *
 dentry_lookup(struct mount *mp, char *path)
 {
+	unsigned int hash = dentry_hash(mp, path);
 	struct dentry *dp;
+	unsigned long seq;
+
+	seq = uk_load_n(&dentry_hash_seq);
+	if (!(seq & 1)) {
+		dp = dentry_lookup_rcu(mp, path, hash);
+		if (dp)
+			return dp;
+
+		/* The miss is reliable if no entry changed its chain */
+		rmb();
+		if (uk_load_n(&dentry_hash_seq) == seq)
+			return NULL;
+	}
 
 	uk_mutex_lock(&dentry_hash_lock);
-	uk_hlist_for_each_entry(dp, &dentry_hash_table[dentry_hash(mp, path)], d_link) {
+	uk_hlist_for_each_entry(dp, &dentry_hash_table[hash], d_link) {
 		if (dp->d_mount == mp && !strncmp(dp->d_path, path, PATH_MAX)) {
-			dp->d_refcnt++;
+			uk_inc(&dp->d_refcnt);
 			uk_mutex_unlock(&dentry_hash_lock);
 			return dp;
 		}
@@ -131,8 +201,8 @@ static void dentry_children_remove(struct dentry *dp)
 	uk_mutex_lock(&dp->d_lock);
 	uk_list_for_each_entry(entry, &dp->d_child_list, d_child_link) {
 		UK_ASSERT(entry);
-		UK_ASSERT(entry->d_refcnt > 0);
-		uk_hlist_del(&entry->d_link);
+		UK_ASSERT(uk_load_n(&entry->d_refcnt) > 0);
+		uk_hlist_del_rcu(&entry->d_link);
 	}
 	uk_mutex_unlock(&dp->d_lock);
 
@@ -167,23 +237,27 @@ dentry_move(struct dentry *dp, struct dentry *parent_dp, char *path)
 	}
 
 	uk_mutex_lock(&dentry_hash_lock);
+	dentry_hash_write_begin();
 	// Remove all dp's child dentries from the hashtable.
 	dentry_children_remove(dp);
 	// Remove dp with outdated hash info from the hashtable.
-	uk_hlist_del(&dp->d_link);
+	uk_hlist_del_rcu(&dp->d_link);
 	// Update dp.
-	dp->d_path = new_path;
+	uk_rcu_assign_pointer(dp->d_path, new_path);
 
 	dp->d_parent = parent_dp;
 	// Insert dp updated hash info into the hashtable.
-	uk_hlist_add_head(&dp->d_link,
-			  &dentry_hash_table[dentry_hash(dp->d_mount, path)]);
+	uk_hlist_add_head_rcu(&dp->d_link,
+			      &dentry_hash_table[dentry_hash(dp->d_mount, path)]);
+	dentry_hash_write_end();
 	uk_mutex_unlock(&dentry_hash_lock);
 
 	if (old_pdp) {
 		drele(old_pdp);
 	}
 
+	// Lookups may still compare against the old path.
+	uk_rcu_synchronize();
 	free(old_path);
 	return 0;
 }
@@ -192,9 +266,11 @@ void
 dentry_remove(struct dentry *dp)
 {
 	uk_mutex_lock(&dentry_hash_lock);
-	uk_hlist_del(&dp->d_link);
+	dentry_hash_write_begin();
+	uk_hlist_del_rcu(&dp->d_link);
 	/* put it on a fake list for drele() to work*/
-	uk_hlist_add_head(&dp->d_link, &fake);
+	uk_hlist_add_head_rcu(&dp->d_link, &fake);
+	dentry_hash_write_end();
 	uk_mutex_unlock(&dentry_hash_lock);
 }
 
@@ -202,25 +278,43 @@ void
 dref(struct dentry *dp)
 {
 	UK_ASSERT(dp);
-	UK_ASSERT(dp->d_refcnt > 0);
+	UK_ASSERT(uk_load_n(&dp->d_refcnt) > 0);
 
-	uk_mutex_lock(&dentry_hash_lock);
-	dp->d_refcnt++;
-	uk_mutex_unlock(&dentry_hash_lock);
+	uk_inc(&dp->d_refcnt);
+}
+
+static void
+dentry_free_rcu(struct uk_rcu_head *head)
+{
+	struct dentry *dp = __containerof(head, struct dentry, d_rcu);
+
+	free(dp->d_path);
+	free(dp);
 }
 
 void
 drele(struct dentry *dp)
 {
+	int refcnt;
+
 	UK_ASSERT(dp);
-	UK_ASSERT(dp->d_refcnt > 0);
+
+	/* Only the last reference needs the lock, so that lookups under the
+	 * lock do not find the dentry while it is torn down
+	 */
+	refcnt = uk_load_n(&dp->d_refcnt);
+	UK_ASSERT(refcnt > 0);
+	while (refcnt > 1) {
+		if (uk_compare_exchange_n(&dp->d_refcnt, &refcnt, refcnt - 1))
+			return;
+	}
 
 	uk_mutex_lock(&dentry_hash_lock);
-	if (--dp->d_refcnt) {
+	if (uk_dec(&dp->d_refcnt) != 1) {
 		uk_mutex_unlock(&dentry_hash_lock);
 		return;
 	}
-	uk_hlist_del(&dp->d_link);
+	uk_hlist_del_rcu(&dp->d_link);
 	vn_del_name(dp->d_vnode, dp);
 
 	uk_mutex_unlock(&dentry_hash_lock);
@@ -236,8 +330,7 @@ drele(struct dentry *dp)
 
 	vrele(dp->d_vnode);
 
-	free(dp->d_path);
-	free(dp);
+	uk_rcu_call(&dp->d_rcu, dentry_free_rcu);
 }
 
 void
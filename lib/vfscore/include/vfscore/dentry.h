@@ -36,6 +36,7 @@
 
 #include <uk/mutex.h>
 #include <uk/list.h>
+#include <uk/rcu.h>
 
 struct vnode;
 
@@ -50,6 +51,7 @@ struct dentry {
 	struct uk_mutex	d_lock;
 	struct uk_list_head d_child_list;
 	struct uk_list_head d_child_link;
+	struct uk_rcu_head d_rcu;	/* deferred free after lookups left */
 };
 
 struct dentry *dentry_alloc(struct dentry *parent_dp, struct vnode *vp, const char *path);
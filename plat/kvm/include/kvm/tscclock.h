@@ -36,5 +36,7 @@
 int tscclock_init(void);
 __u64 tscclock_monotonic(void);
 __u64 tscclock_epochoffset(void);
+void tscclock_set_alarm(__u64 until);
+void tscclock_alarm_expired(void);
 
 #endif /* __KVM_TSCCLOCK_H__ */
@@ -56,16 +56,22 @@ __nsec ukplat_wall_clock(void)
 	return tscclock_monotonic() + tscclock_epochoffset();
 }
 
-/* NB: If this ever does more than an immediate return, it will need to be
- * compiled with NO_X86_EXTREGS_FLAGS to prevent potential clobbering of
- * registers that are not saved on interrupt handling.
+/* NB: This file is compiled with ISR flags (see Makefile.uk) because the
+ * handler runs in interrupt context without saving extended registers.
  */
 static int timer_handler(void *arg __unused)
 {
+	tscclock_alarm_expired();
+
 	/* Yes, we handled the irq. */
 	return 1;
 }
 
+void ukplat_time_set_alarm(__nsec until)
+{
+	tscclock_set_alarm(until);
+}
+
 /* must be called before interrupts are enabled */
 void ukplat_time_init(void)
 {
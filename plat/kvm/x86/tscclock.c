@@ -59,6 +59,7 @@
 #include <uk/print.h>
 #include <uk/assert.h>
 #include <uk/bitops.h>
+#include <uk/essentials.h>
 
 #define TIMER_CNTR           0x40
 #define TIMER_MODE           0x43
@@ -312,6 +313,31 @@ __u64 tscclock_epochoffset(void)
  */
 #define PIT_MIN_DELTA	16
 
+/* Time until which an alarm is programmed into the PIT, 0 if none */
+static __nsec pit_alarm;
+
+/*
+ * Programs the PIT to interrupt the CPU after `delta_ticks` have expired.
+ * Maximum timer delay is 65535 ticks, longer delays are cut.
+ */
+static void pit_program(__u64 delta_ticks)
+{
+	unsigned int ticks;
+
+	if (delta_ticks > 65535)
+		ticks = 65535;
+	else
+		ticks = delta_ticks;
+
+	/*
+	 * Note that according to the Intel 82C54 datasheet, p12 the
+	 * interrupt is actually delivered in N + 1 ticks.
+	 */
+	ticks -= 1;
+	outb(TIMER_CNTR, ticks & 0xff);
+	outb(TIMER_CNTR, ticks >> 8);
+}
+
 /*
  * Returns early if any interrupts are serviced, or if the requested delay is
  * too short. Must be called with interrupts disabled, will enable interrupts
@@ -327,7 +353,6 @@ static void tscclock_cpu_block(__u64 until)
 {
 	__u64 now, delta_ns;
 	__u64 delta_ticks;
-	unsigned int ticks;
 
 	UK_ASSERT(ukplat_lcpu_irqs_disabled());
 
@@ -354,20 +379,10 @@ static void tscclock_cpu_block(__u64 until)
 
 	/*
 	 * Program the timer to interrupt the CPU after the delay has expired.
-	 * Maximum timer delay is 65535 ticks.
+	 * This replaces a pending alarm.
 	 */
-	if (delta_ticks > 65535)
-		ticks = 65535;
-	else
-		ticks = delta_ticks;
-
-	/*
-	 * Note that according to the Intel 82C54 datasheet, p12 the
-	 * interrupt is actually delivered in N + 1 ticks.
-	 */
-	ticks -= 1;
-	outb(TIMER_CNTR, ticks & 0xff);
-	outb(TIMER_CNTR, ticks >> 8);
+	pit_program(delta_ticks);
+	pit_alarm = 0;
 
 	/*
 	 * Wait for any interrupt. If we got an interrupt then just
@@ -382,6 +397,43 @@ static void tscclock_cpu_block(__u64 until)
 	ukplat_lcpu_halt_irq();
 }
 
+/*
+ * Programs the PIT to interrupt the CPU at `until` without halting. Nothing
+ * is done if an alarm that expires earlier is already pending. The
+ * interrupt may arrive before `until` if the delay exceeds the range of the
+ * PIT. The PIT interrupt is delivered to the boot CPU only, so requests of
+ * other CPUs are ignored.
+ */
+void tscclock_set_alarm(__u64 until)
+{
+	__u64 now, delta_ticks;
+	unsigned long flags;
+
+	if (ukplat_lcpu_idx() != 0)
+		return;
+
+	flags = ukplat_lcpu_save_irqf();
+	now = ukplat_monotonic_clock();
+	if (pit_alarm > now && pit_alarm <= until)
+		goto out;
+
+	delta_ticks = (until > now) ? mul64_32(until - now, pit_mult) : 0;
+	pit_program(MAX(delta_ticks, (__u64) PIT_MIN_DELTA));
+	pit_alarm = until;
+out:
+	ukplat_lcpu_restore_irqf(flags);
+}
+
+/*
+ * Called by the timer interrupt handler. An alarm that was requested again
+ * by an earlier handler of the same interrupt is kept.
+ */
+void tscclock_alarm_expired(void)
+{
+	if (pit_alarm <= ukplat_monotonic_clock())
+		pit_alarm = 0;
+}
+
 unsigned long sched_have_pending_events;
 
 void time_block_until(__snsec until)